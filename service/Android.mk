@@ -57,6 +57,41 @@ LOCAL_MODULE := libwifi-hal-stub
 
 include $(BUILD_STATIC_LIBRARY)
 
+# Make simulated HAL library, for load testing without hardware
+# ============================================================
+
+include $(CLEAR_VARS)
+
+LOCAL_REQUIRED_MODULES :=
+
+LOCAL_CFLAGS += -Wno-unused-parameter
+
+LOCAL_C_INCLUDES += \
+	external/libnl-headers \
+	$(call include-path-for, libhardware_legacy)/hardware_legacy
+
+LOCAL_SRC_FILES := \
+	lib/wifi_hal_sim.cpp
+
+LOCAL_MODULE := libwifi-hal-sim
+
+include $(BUILD_STATIC_LIBRARY)
+
+# Same library for the host, so it can be driven on a Linux box
+include $(CLEAR_VARS)
+
+LOCAL_CFLAGS += -Wno-unused-parameter
+
+LOCAL_C_INCLUDES += \
+	$(call include-path-for, libhardware_legacy)/hardware_legacy
+
+LOCAL_SRC_FILES := \
+	lib/wifi_hal_sim.cpp
+
+LOCAL_MODULE := libwifi-hal-sim
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
 # set correct hal library path
 # ============================================================
 LIB_WIFI_HAL := libwifi-hal
@@ -72,6 +107,9 @@ else ifeq ($(BOARD_WLAN_DEVICE), mrvl)
 else ifeq ($(BOARD_WLAN_DEVICE), MediaTek)
   # support MTK WIFI HAL
   LIB_WIFI_HAL := libwifi-hal-mt66xx
+else ifeq ($(BOARD_WLAN_DEVICE), sim)
+  # synthetic scan, RTT, stats and logging events; see lib/wifi_hal_sim.h
+  LIB_WIFI_HAL := libwifi-hal-sim
 endif
 
 # Make the JNI part
@@ -86,7 +124,8 @@ LOCAL_C_INCLUDES += \
 	$(JNI_H_INCLUDE) \
 	$(call include-path-for, libhardware)/hardware \
 	$(call include-path-for, libhardware_legacy)/hardware_legacy \
-	libcore/include
+	libcore/include \
+	external/zlib
 
 LOCAL_SHARED_LIBRARIES += \
 	libnativehelper \
@@ -96,6 +135,7 @@ LOCAL_SHARED_LIBRARIES += \
 	libhardware_legacy \
 	libandroid_runtime \
 	libnl \
+	libz \
     libdl
 
 LOCAL_STATIC_LIBRARIES += libwifi-hal-stub
@@ -103,7 +143,29 @@ LOCAL_STATIC_LIBRARIES += $(LIB_WIFI_HAL)
 
 LOCAL_SRC_FILES := \
 	jni/com_android_server_wifi_WifiNative.cpp \
-	jni/jni_helper.cpp
+	jni/jni_helper.cpp \
+	jni/wifi_fw_dump.cpp \
+	jni/wifi_ring_log.cpp \
+	jni/wifi_ring_decoder.cpp \
+	jni/wifi_ring_status.cpp \
+	jni/wifi_epno.cpp \
+	jni/wifi_hotlist.cpp \
+	jni/wifi_significant_change.cpp \
+	jni/wifi_timer_wheel.cpp \
+	jni/wifi_scan_cache.cpp \
+	jni/wifi_gscan_emu.cpp \
+	jni/wifi_hal_trace.cpp \
+	jni/wifi_call_stats.cpp \
+	jni/wifi_ie_summary.cpp \
+	jni/wifi_anqp.cpp \
+	jni/wifi_domain_trie.cpp \
+	jni/wifi_scan_filter.cpp \
+	jni/wifi_roam_scorer.cpp \
+	jni/wifi_blacklist.cpp \
+	jni/wifi_ssid_table.cpp \
+	jni/wifi_keepalive.cpp \
+	jni/wifi_rssi_monitor.cpp \
+	jni/wifi_tdls.cpp
 
 LOCAL_MODULE := libwifi-service
 
@@ -128,4 +190,8 @@ LOCAL_MODULE := wifi-service
 
 include $(BUILD_JAVA_LIBRARY)
 
+# Build the host fuzzers and benchmarks for the JNI part
+# ============================================================
+include $(LOCAL_PATH)/tests/jni/Android.mk
+
 endif
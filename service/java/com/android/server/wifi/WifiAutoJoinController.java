@@ -997,6 +997,81 @@ public class WifiAutoJoinController {
         return 0;
     }
 
+    /* how many BSSIDs the native scorer ranks for attemptRoam */
+    private static final int MAX_RANKED_ROAM_CANDIDATES = 16;
+    /* RSSI modifier per IP config failure of a BSSID, as handed to the scorer and lazy roam */
+    private static final int IP_CONFIG_FAILURE_RSSI_PENALTY = 5;
+
+    /* BSSID preferences last handed to WifiNative, so they are only set when they change */
+    private String mBssidPreferences = "";
+
+    private static boolean isRoamCandidate(ScanDetail sd, long nowMs, int age) {
+        ScanResult b = sd.getScanResult();
+        return sd.getSeen() != 0 && b.BSSID != null
+                && (nowMs - sd.getSeen()) <= age
+                && b.autoJoinStatus == ScanResult.ENABLED
+                && b.numIpConfigFailures <= 8;
+    }
+
+    /**
+     * Picks the BSSID of current that the native roam scorer ranks best among those
+     * attemptRoam() would consider, or null if it ranks none of them, as before the first
+     * gscan results. BSSIDs with IP config failures are preferred against, by the scorer and
+     * by lazy roam alike.
+     */
+    private ScanResult attemptRoamByRank(ScanDetailCache scanDetailCache,
+            WifiConfiguration current, long nowMs, int age, String currentBSSID) {
+        HashMap<String, ScanResult> candidates = new HashMap<String, ScanResult>();
+        ArrayList<String> bssids = new ArrayList<String>();
+        ArrayList<Integer> modifiers = new ArrayList<Integer>();
+        StringBuilder preferences = new StringBuilder();
+        for (ScanDetail sd : scanDetailCache.values()) {
+            if (!isRoamCandidate(sd, nowMs, age)) {
+                continue;
+            }
+            ScanResult b = sd.getScanResult();
+            candidates.put(b.BSSID, b);
+            if (b.numIpConfigFailures > 0) {
+                int modifier = -IP_CONFIG_FAILURE_RSSI_PENALTY * b.numIpConfigFailures;
+                bssids.add(b.BSSID);
+                modifiers.add(modifier);
+                preferences.append(b.BSSID).append('=').append(modifier).append(' ');
+            }
+        }
+        if (candidates.isEmpty()) {
+            return null;
+        }
+
+        if (!mBssidPreferences.equals(preferences.toString())) {
+            int rssiModifiers[] = new int[modifiers.size()];
+            for (int i = 0; i < rssiModifiers.length; i++) {
+                rssiModifiers[i] = modifiers.get(i);
+            }
+            WifiNative.setBssidPreference(bssids.toArray(new String[bssids.size()]),
+                    rssiModifiers);
+            mBssidPreferences = preferences.toString();
+        }
+
+        String ssid = current.SSID;
+        if (ssid != null && ssid.length() > 1 && ssid.startsWith("\"") && ssid.endsWith("\"")) {
+            ssid = ssid.substring(1, ssid.length() - 1);
+        } else {
+            ssid = null;    // hex SSIDs aren't matched natively; rank all, keep ours
+        }
+        WifiNative.RoamCandidate[] ranked = WifiNative.rankRoamCandidates(ssid, currentBSSID,
+                MAX_RANKED_ROAM_CANDIDATES, age);
+        for (WifiNative.RoamCandidate candidate : ranked) {
+            ScanResult b = candidates.get(candidate.bssid);
+            if (b != null) {
+                if (VDBG) {
+                    logDbg("attemptRoam: " + current.configKey() + " ranked " + candidate);
+                }
+                return b;
+            }
+        }
+        return null;
+    }
+
     /**
      * attemptRoam() function implements the core of the same SSID switching algorithm
      * <p/>
@@ -1043,16 +1118,23 @@ public class WifiAutoJoinController {
         // relative strength of 5 and 2.4 GHz BSSIDs
         long nowMs = System.currentTimeMillis();
 
+        // The native scorer ranks as lazy roam does, so the choice is the same whether or not
+        // the firmware roams by itself; fall back to ranking here when it knows none of them
+        if (a == null) {
+            ScanResult ranked = attemptRoamByRank(scanDetailCache, current, nowMs, age,
+                    currentBSSID);
+            if (ranked != null) {
+                return ranked;
+            }
+        }
+
         for (ScanDetail sd : scanDetailCache.values()) {
             ScanResult b = sd.getScanResult();
             int bRssiBoost5 = 0;
             int aRssiBoost5 = 0;
             int bRssiBoost = 0;
             int aRssiBoost = 0;
-            if ((sd.getSeen() == 0) || (b.BSSID == null)
-                    || ((nowMs - sd.getSeen()) > age)
-                    || b.autoJoinStatus != ScanResult.ENABLED
-                    || b.numIpConfigFailures > 8) {
+            if (!isRoamCandidate(sd, nowMs, age)) {
                 continue;
             }
 
@@ -1972,6 +2054,7 @@ public class WifiAutoJoinController {
                         }
                         list.add(network);
                         network.rssi_threshold = mWifiConfigStore.thresholdGoodRssi24.get();
+                        network.score = choice;
                     }
                 }
             }
@@ -1987,6 +2070,7 @@ public class WifiAutoJoinController {
                 }
                 list.add(network);
                 network.rssi_threshold = mWifiConfigStore.thresholdGoodRssi24.get();
+                network.score = 0;
             }
         }
         return list;
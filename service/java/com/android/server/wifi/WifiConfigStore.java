@@ -65,6 +65,7 @@ import com.android.server.wifi.hotspot2.ANQPData;
 import com.android.server.wifi.hotspot2.AnqpCache;
 import com.android.server.wifi.hotspot2.NetworkDetail;
 import com.android.server.wifi.hotspot2.PasspointMatch;
+import com.android.server.wifi.hotspot2.PasspointMatcher;
 import com.android.server.wifi.hotspot2.SupplicantBridge;
 import com.android.server.wifi.hotspot2.Utils;
 import com.android.server.wifi.hotspot2.omadm.MOManager;
@@ -510,11 +511,6 @@ public class WifiConfigStore extends IpConfigStore {
     ArrayList<WifiNative.WifiPnoNetwork> mCachedPnoList
             = new ArrayList<WifiNative.WifiPnoNetwork>();
 
-    /*
-     * BSSID blacklist, i.e. list of BSSID we want to avoid
-     */
-    HashSet<String> mBssidBlacklist = new HashSet<String>();
-
     /*
      * Lost config list, whenever we read a config from networkHistory.txt that was not in
      * wpa_supplicant.conf
@@ -525,6 +521,7 @@ public class WifiConfigStore extends IpConfigStore {
     private final SupplicantBridge mSupplicantBridge;
     private final MOManager mMOManager;
     private final SIMAccessor mSIMAccessor;
+    private final PasspointMatcher mPasspointMatcher = new PasspointMatcher();
 
     private WifiStateMachine mWifiStateMachine;
 
@@ -3289,8 +3286,16 @@ public class WifiConfigStore extends IpConfigStore {
                 ", anqp " + ( anqpData != null ? "present" : "missing" ) +
                 ", query " + query + ", home sps: " + homeSPs.size());
 
+        // Domain names are matched against all home SPs in one go
+        mPasspointMatcher.update(homeSPs);
+        int[] nameMatches = anqpElements != null ?
+                mPasspointMatcher.match(Collections.singletonList(anqpElements)) : null;
+
         for (HomeSP homeSP : homeSPs) {
-            PasspointMatch match = homeSP.match(networkDetail, anqpElements, mSIMAccessor);
+            int provider = mPasspointMatcher.getProviderIndex(homeSP);
+            int nameMatch = nameMatches != null && provider >= 0 ? nameMatches[provider] : -1;
+            PasspointMatch match =
+                    homeSP.match(networkDetail, anqpElements, mSIMAccessor, nameMatch);
 
             Log.d(Utils.hs2LogTag(getClass()), " -- " +
                     homeSP.getFQDN() + ": match " + match + ", queried " + queried);
@@ -4149,8 +4154,12 @@ public class WifiConfigStore extends IpConfigStore {
         lastUnwantedNetworkDisconnectTimestamp = System.currentTimeMillis();
     }
 
+    // How long a BSSID that rejected an association is kept off the firmware's roam list
+    static final int ASSOC_REJECT_BLACKLIST_MS = 5 * 60 * 1000;
+
     boolean handleBSSIDBlackList(int netId, String BSSID, boolean enable) {
         boolean found = false;
+        boolean wasDisabled = false;
         if (BSSID == null)
             return found;
 
@@ -4160,6 +4169,8 @@ public class WifiConfigStore extends IpConfigStore {
                 for (ScanDetail scanDetail : getScanDetailCache(config).values()) {
                     if (scanDetail.getBSSIDString().equals(BSSID)) {
                         if (enable) {
+                            wasDisabled |= scanDetail.getScanResult().autoJoinStatus
+                                    == ScanResult.AUTO_ROAM_DISABLED;
                             scanDetail.getScanResult().setAutoJoinStatus(ScanResult.ENABLED);
                         } else {
                             // Black list the BSSID we were trying to join
@@ -4173,9 +4184,43 @@ public class WifiConfigStore extends IpConfigStore {
                 }
             }
         }
+
+        // Keep the firmware and the roam scorer off it too, until it expires or we get on it
+        if (found) {
+            mWifiNative.blacklistBssid(BSSID, WifiNative.BSSID_BLACKLIST_REASON_ASSOC_REJECTED,
+                    ASSOC_REJECT_BLACKLIST_MS);
+        } else if (wasDisabled) {
+            mWifiNative.unblacklistBssid(BSSID);
+        }
         return found;
     }
 
+    /**
+     * Lets autojoin pick the BSSIDs blacklisted on association rejection again once their
+     * time on the native blacklist is up. Called as scan results come in.
+     */
+    void expireBssidBlacklist() {
+        for (long expired : mWifiNative.getExpiredBssids()) {
+            if (WifiNative.getExpiredReason(expired)
+                    != WifiNative.BSSID_BLACKLIST_REASON_ASSOC_REJECTED) {
+                continue;
+            }
+            String BSSID = WifiNative.getExpiredBssid(expired);
+            for (WifiConfiguration config : mConfiguredNetworks.values()) {
+                if (getScanDetailCache(config) == null) {
+                    continue;
+                }
+                for (ScanDetail scanDetail : getScanDetailCache(config).values()) {
+                    ScanResult result = scanDetail.getScanResult();
+                    if (scanDetail.getBSSIDString().equals(BSSID)
+                            && result.autoJoinStatus == ScanResult.AUTO_ROAM_DISABLED) {
+                        result.setAutoJoinStatus(ScanResult.ENABLED);
+                    }
+                }
+            }
+        }
+    }
+
     int getMaxDhcpRetries() {
         return Settings.Global.getInt(mContext.getContentResolver(),
                 Settings.Global.WIFI_MAX_DHCP_RETRY_COUNT,
@@ -4189,7 +4234,6 @@ public class WifiConfigStore extends IpConfigStore {
             }
             return;
         }
-        mBssidBlacklist = new HashSet<String>();
         mWifiNative.clearBlacklist();
         mWifiNative.setBssidBlacklist(null);
     }
@@ -4203,16 +4247,10 @@ public class WifiConfigStore extends IpConfigStore {
         }
         if (BSSID == null)
             return;
-        mBssidBlacklist.add(BSSID);
         // Blacklist at wpa_supplicant
         mWifiNative.addToBlacklist(BSSID);
-        // Blacklist at firmware
-        String list[] = new String[mBssidBlacklist.size()];
-        int count = 0;
-        for (String bssid : mBssidBlacklist) {
-            list[count++] = bssid;
-        }
-        mWifiNative.setBssidBlacklist(list);
+        // Blacklist at firmware, until cleared as at wpa_supplicant
+        mWifiNative.blacklistBssid(BSSID, WifiNative.BSSID_BLACKLIST_REASON_REQUESTED, 0);
     }
 
     void handleSSIDStateChange(int netId, boolean enabled, String message, String BSSID) {
@@ -19,6 +19,7 @@ package com.android.server.wifi;
 import com.android.internal.app.IBatteryStats;
 import com.android.internal.util.Protocol;
 
+import android.os.SystemProperties;
 import android.support.v4.util.CircularArray;
 import android.util.Base64;
 import android.util.LocalLog;
@@ -26,6 +27,8 @@ import android.util.Log;
 
 import java.io.ByteArrayOutputStream;
 import java.io.FileDescriptor;
+import java.io.FileInputStream;
+import java.io.FileOutputStream;
 import java.io.IOException;
 import java.io.PrintWriter;
 import java.util.Calendar;
@@ -75,6 +78,21 @@ class WifiLogger extends DummyWifiLogger  {
     /** number of alerts to hold */
     public static final int MAX_ALERT_REPORTS                       = 1;
 
+    /** firmware memory dumps are streamed here rather than kept in memory */
+    private static final String FW_MEMORY_DUMP_DIR = "/data/misc/wifi/";
+
+    /** ring buffer data is kept by the native layer in one file per ring here */
+    private static final String RING_BUFFER_LOG_DIR = "/data/misc/wifi/logs";
+
+    /** size of each ring buffer log file */
+    private static final int RING_BUFFER_LOG_BYTES_PER_RING = 256 * 1024;
+
+    /** HAL callbacks are recorded here when persist.wifi.hal_trace is set */
+    private static final String HAL_TRACE_FILE = "/data/misc/wifi/hal_trace";
+
+    /** per thread buffer for the HAL trace */
+    private static final int HAL_TRACE_BUFFER_BYTES = 256 * 1024;
+
     /** minimum wakeup interval for each of the log levels */
     private static final int MinWakeupIntervals[] = new int[] { 0, 3600, 60, 10 };
     /** minimum buffer size for each of the log levels */
@@ -87,6 +105,12 @@ class WifiLogger extends DummyWifiLogger  {
     private WifiNative.RingBufferStatus[] mRingBuffers;
     private WifiNative.RingBufferStatus mPerPacketRingBuffer;
     private WifiStateMachine mWifiStateMachine;
+    private int mBugReportCount;
+    private int mAlertCount;
+    private boolean mRingBufferLogSinkEnabled;
+    private long mRingBufferLogBytesWritten;
+    private int mRingBufferLogWraps;
+    private boolean mHalTraceEnabled;
 
     public WifiLogger(WifiStateMachine wifiStateMachine) {
         mWifiStateMachine = wifiStateMachine;
@@ -98,6 +122,15 @@ class WifiLogger extends DummyWifiLogger  {
         mDriverVersion = WifiNative.getDriverVersion();
         mSupportedFeatureSet = WifiNative.getSupportedLoggerFeatureSet();
 
+        if (!mRingBufferLogSinkEnabled) {
+            mRingBufferLogSinkEnabled = WifiNative.enableRingBufferLogSink(
+                    RING_BUFFER_LOG_DIR, RING_BUFFER_LOG_BYTES_PER_RING);
+        }
+
+        if (!mHalTraceEnabled && SystemProperties.getBoolean("persist.wifi.hal_trace", false)) {
+            mHalTraceEnabled = WifiNative.startHalTrace(HAL_TRACE_FILE, HAL_TRACE_BUFFER_BYTES);
+        }
+
         if (mLogLevel == VERBOSE_NO_LOG)
             WifiNative.setLoggingEventHandler(mHandler);
 
@@ -145,17 +178,26 @@ class WifiLogger extends DummyWifiLogger  {
             mRingBuffers = null;
             mLogLevel = VERBOSE_NO_LOG;
         }
+        if (mHalTraceEnabled) {
+            WifiNative.stopHalTrace();
+            mHalTraceEnabled = false;
+        }
     }
 
     @Override
     public synchronized void captureBugReportData(int reason) {
-        BugReport report = captureBugreport(reason, true);
+        /* reuse the dump file of the report that is about to be evicted */
+        String fwDumpFile = FW_MEMORY_DUMP_DIR + "fw_memory_dump_bug_" +
+                (mBugReportCount++ % MAX_BUG_REPORTS);
+        BugReport report = captureBugreport(reason, fwDumpFile);
         mLastBugReports.addLast(report);
     }
 
     @Override
     public synchronized void captureAlertData(int errorCode, byte[] alertData) {
-        BugReport report = captureBugreport(errorCode, /* captureFWDump = */ true);
+        String fwDumpFile = FW_MEMORY_DUMP_DIR + "fw_memory_dump_alert_" +
+                (mAlertCount++ % MAX_ALERT_REPORTS);
+        BugReport report = captureBugreport(errorCode, fwDumpFile);
         report.alertData = alertData;
         mLastAlerts.addLast(report);
     }
@@ -166,18 +208,33 @@ class WifiLogger extends DummyWifiLogger  {
         pw.println("FW Version is: " + mFirmwareVersion);
         pw.println("Driver Version is: " + mDriverVersion);
         pw.println("Supported Feature set: " + mSupportedFeatureSet);
+        if (mRingBuffers != null) {
+            for (WifiNative.RingBufferStatus buffer : mRingBuffers) {
+                pw.println("Ring buffer " + buffer);
+            }
+        }
+        if (mRingBufferLogSinkEnabled) {
+            pw.println("Ring buffer log: " + mRingBufferLogBytesWritten + " bytes written, "
+                    + mRingBufferLogWraps + " wraps");
+        }
+        long[] traceStats = WifiNative.getHalTraceStats();
+        if (traceStats != null && (mHalTraceEnabled || traceStats[0] != 0)) {
+            pw.println("HAL trace" + (mHalTraceEnabled ? " (recording)" : "") + ": "
+                    + traceStats[0] + " records, " + traceStats[1] + " dropped, "
+                    + traceStats[2] + " bytes");
+        }
 
         for (int i = 0; i < mLastAlerts.size(); i++) {
             pw.println("--------------------------------------------------------------------");
             pw.println("Alert dump " + i);
-            pw.print(mLastAlerts.get(i));
+            mLastAlerts.get(i).dump(pw);
             pw.println("--------------------------------------------------------------------");
         }
 
         for (int i = 0; i < mLastBugReports.size(); i++) {
             pw.println("--------------------------------------------------------------------");
             pw.println("Bug dump " + i);
-            pw.print(mLastBugReports.get(i));
+            mLastBugReports.get(i).dump(pw);
             pw.println("--------------------------------------------------------------------");
         }
 
@@ -190,9 +247,19 @@ class WifiLogger extends DummyWifiLogger  {
         long kernelTimeNanos;
         int errorCode;
         HashMap<String, byte[][]> ringBuffers = new HashMap();
-        byte[] fwMemoryDump;
+        String fwMemoryDumpFile;
+        WifiNative.FwMemoryDumpInfo fwMemoryDumpInfo;
         byte[] alertData;
 
+        /* prints the report, streaming the firmware memory dump from its file */
+        public void dump(PrintWriter pw) {
+            pw.print(this);
+            if (fwMemoryDumpFile != null) {
+                pw.println("FW Memory dump " + fwMemoryDumpInfo);
+                printFileAsBase64(pw, fwMemoryDumpFile);
+            }
+        }
+
         public String toString() {
             StringBuilder builder = new StringBuilder();
 
@@ -234,11 +301,6 @@ class WifiLogger extends DummyWifiLogger  {
                 builder.append("\n");
             }
 
-            if (fwMemoryDump != null) {
-                builder.append("FW Memory dump \n");
-                builder.append(compressToBase64(fwMemoryDump));
-            }
-
             return builder.toString();
         }
     }
@@ -279,6 +341,18 @@ class WifiLogger extends DummyWifiLogger  {
             WifiLogger.this.onRingBufferData(status, buffer);
         }
 
+        @Override
+        public void onRingBufferDataWritten(int ringBufferId, int bytes, boolean wrapped) {
+            WifiLogger.this.onRingBufferDataWritten(ringBufferId, bytes, wrapped);
+        }
+
+        @Override
+        public void onRingBufferStatusChanged(int ringBufferId, int writtenBytes,
+                int readBytes, int writtenRecords) {
+            WifiLogger.this.onRingBufferStatusChanged(ringBufferId, writtenBytes, readBytes,
+                    writtenRecords);
+        }
+
         @Override
         public void onWifiAlert(int errorCode, byte[] buffer) {
             WifiLogger.this.onWifiAlert(errorCode, buffer);
@@ -292,6 +366,27 @@ class WifiLogger extends DummyWifiLogger  {
         }
     }
 
+    synchronized void onRingBufferDataWritten(int ringBufferId, int bytes, boolean wrapped) {
+        mRingBufferLogBytesWritten += bytes;
+        if (wrapped) {
+            mRingBufferLogWraps++;
+        }
+    }
+
+    synchronized void onRingBufferStatusChanged(int ringBufferId, int writtenBytes,
+            int readBytes, int writtenRecords) {
+        if (mRingBuffers == null) return;
+
+        for (WifiNative.RingBufferStatus buffer : mRingBuffers) {
+            if (buffer.ringBufferId == ringBufferId) {
+                buffer.writtenBytes = writtenBytes;
+                buffer.readBytes = readBytes;
+                buffer.writtenRecords = writtenRecords;
+                break;
+            }
+        }
+    }
+
     synchronized void onWifiAlert(int errorCode, byte[] buffer) {
         if (mWifiStateMachine != null) {
             mWifiStateMachine.sendMessage(
@@ -390,7 +485,7 @@ class WifiLogger extends DummyWifiLogger  {
         return true;
     }
 
-    private BugReport captureBugreport(int errorCode, boolean captureFWDump) {
+    private BugReport captureBugreport(int errorCode, String fwDumpFile) {
         BugReport report = new BugReport();
         report.errorCode = errorCode;
         report.systemTimeMs = System.currentTimeMillis();
@@ -400,6 +495,13 @@ class WifiLogger extends DummyWifiLogger  {
             for (WifiNative.RingBufferStatus buffer : mRingBuffers) {
                 /* this will push data in mRingBuffers */
                 WifiNative.getRingBufferData(buffer.name);
+                if (mRingBufferLogSinkEnabled) {
+                    byte[] records = WifiNative.readRingBufferLog(buffer.name);
+                    if (records != null) {
+                        report.ringBuffers.put(buffer.name, new byte[][] { records });
+                    }
+                    continue;
+                }
                 LimitedCircularArray<byte[]> data = mRingBufferData.get(buffer.name);
                 byte[][] buffers = new byte[data.size()][];
                 for (int i = 0; i < data.size(); i++) {
@@ -409,12 +511,69 @@ class WifiLogger extends DummyWifiLogger  {
             }
         }
 
-        if (captureFWDump) {
-            report.fwMemoryDump = WifiNative.getFwMemoryDump();
+        if (fwDumpFile != null) {
+            captureFwMemoryDump(report, fwDumpFile);
         }
         return report;
     }
 
+    private static void captureFwMemoryDump(BugReport report, String path) {
+        FileOutputStream out = null;
+        try {
+            out = new FileOutputStream(path);
+            WifiNative.FwMemoryDumpInfo info = WifiNative.getFwMemoryDump(out.getFD(), true);
+            if (info != null) {
+                report.fwMemoryDumpFile = path;
+                report.fwMemoryDumpInfo = info;
+            } else {
+                Log.e(TAG, "Fail to get FW memory dump");
+            }
+        } catch (IOException e) {
+            Log.e(TAG, "Could not write FW memory dump to " + path + ": " + e);
+        } finally {
+            if (out != null) {
+                try {
+                    out.close();
+                } catch (IOException e) {
+                    Log.e(TAG, "FileOutputStream close error");
+                }
+            }
+        }
+    }
+
+    /** 57 input bytes encode to exactly one 76 character Base64.DEFAULT line */
+    private static final int BASE64_CHUNK_SIZE = 57 * 64;
+
+    private static void printFileAsBase64(PrintWriter pw, String path) {
+        FileInputStream in = null;
+        try {
+            in = new FileInputStream(path);
+            final byte[] buf = new byte[BASE64_CHUNK_SIZE];
+            while (true) {
+                /* fill whole chunks so that lines are not broken between reads */
+                int count = 0;
+                while (count < buf.length) {
+                    int n = in.read(buf, count, buf.length - count);
+                    if (n < 0) break;
+                    count += n;
+                }
+                if (count == 0) break;
+                pw.print(Base64.encodeToString(buf, 0, count, Base64.DEFAULT));
+                if (count < buf.length) break;
+            }
+        } catch (IOException e) {
+            pw.println("Could not read " + path + ": " + e);
+        } finally {
+            if (in != null) {
+                try {
+                    in.close();
+                } catch (IOException e) {
+                    Log.e(TAG, "FileInputStream close error");
+                }
+            }
+        }
+    }
+
     private static String compressToBase64(byte[] input) {
         String result;
         //compress
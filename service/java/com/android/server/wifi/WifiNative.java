@@ -35,21 +35,26 @@ import android.text.TextUtils;
 import android.util.Base64;
 import android.util.LocalLog;
 import android.util.Log;
+import android.util.SparseArray;
 import android.content.Context;
 import android.content.Intent;
 import android.app.PendingIntent;
 import android.content.IntentFilter;
 import android.content.BroadcastReceiver;
 import com.android.server.connectivity.KeepalivePacketData;
+import com.android.server.wifi.hotspot2.NetworkDetail;
 
 import java.io.ByteArrayOutputStream;
+import java.io.FileDescriptor;
 import java.io.IOException;
+import java.net.InetAddress;
 import java.nio.ByteBuffer;
 import java.nio.CharBuffer;
 import java.nio.charset.CharacterCodingException;
 import java.nio.charset.CharsetDecoder;
 import java.nio.charset.StandardCharsets;
 import java.util.ArrayList;
+import java.util.Arrays;
 import java.util.List;
 import java.util.Locale;
 import java.util.zip.Deflater;
@@ -90,6 +95,49 @@ public class WifiNative {
     private static final int EID_VHT_OPERATION = 192;
     private static final int EID_EXTENDED_CAPS = 127;
     private static final int RTT_RESP_ENABLE_BIT = 70;
+
+    /*
+     * Layout of the IE summary that comes with full scan results; keep these consistent with
+     * wifi_ie_summary.h
+     */
+    public static final int IE_SUMMARY_FLAGS                    = 0;
+    public static final int IE_SUMMARY_ELEMENT_COUNT            = 1;
+    public static final int IE_SUMMARY_HT_SECONDARY_OFFSET      = 2;
+    public static final int IE_SUMMARY_VHT_CHANNEL_WIDTH        = 3;
+    public static final int IE_SUMMARY_VHT_CENTER_INDEX0        = 4;
+    public static final int IE_SUMMARY_VHT_CENTER_INDEX1        = 5;
+    public static final int IE_SUMMARY_RSN_GROUP_CIPHER         = 6;
+    public static final int IE_SUMMARY_RSN_PAIRWISE_CIPHERS     = 7;
+    public static final int IE_SUMMARY_RSN_AKMS                 = 8;
+    public static final int IE_SUMMARY_RSN_CAPABILITIES         = 9;
+    public static final int IE_SUMMARY_WPA_GROUP_CIPHER         = 10;
+    public static final int IE_SUMMARY_WPA_PAIRWISE_CIPHERS     = 11;
+    public static final int IE_SUMMARY_WPA_AKMS                 = 12;
+    public static final int IE_SUMMARY_HT_CAPABILITIES          = 13;
+    public static final int IE_SUMMARY_VHT_CAPABILITIES         = 14;
+    public static final int IE_SUMMARY_STATION_COUNT            = 15;
+    public static final int IE_SUMMARY_CHANNEL_UTILIZATION      = 16;
+    public static final int IE_SUMMARY_AVAILABLE_CAPACITY       = 17;
+    public static final int IE_SUMMARY_ACCESS_NETWORK_TYPE      = 18;
+    public static final int IE_SUMMARY_HS20_RELEASE             = 19;
+    public static final int IE_SUMMARY_ANQP_DOMAIN_ID           = 20;
+    public static final int IE_SUMMARY_CAPABILITY_INFO          = 21;
+    public static final int IE_SUMMARY_LEN                      = 22;
+
+    /* bits of summary[IE_SUMMARY_FLAGS] */
+    public static final int IE_SUMMARY_HAS_HT_OPERATION         = 1 << 0;
+    public static final int IE_SUMMARY_HAS_VHT_OPERATION        = 1 << 1;
+    public static final int IE_SUMMARY_RTT_RESPONDER            = 1 << 2;
+    public static final int IE_SUMMARY_MALFORMED                = 1 << 3;
+    public static final int IE_SUMMARY_HAS_RSN                  = 1 << 4;
+    public static final int IE_SUMMARY_HAS_WPA                  = 1 << 5;
+    public static final int IE_SUMMARY_HAS_HT                   = 1 << 6;
+    public static final int IE_SUMMARY_HAS_VHT                  = 1 << 7;
+    public static final int IE_SUMMARY_HAS_BSS_LOAD             = 1 << 8;
+    public static final int IE_SUMMARY_HAS_INTERWORKING         = 1 << 9;
+    public static final int IE_SUMMARY_INTERNET                 = 1 << 10;
+    public static final int IE_SUMMARY_HAS_HS20                 = 1 << 11;
+    public static final int IE_SUMMARY_HAS_ANQP_DOMAIN_ID       = 1 << 12;
     /* Register native functions */
 
     static {
@@ -158,6 +206,7 @@ public class WifiNative {
         } else {
             DBG = false;
         }
+        setOffloadedPacketDumpNative(verbose > 0);
     }
 
     private static final LocalLog mLocalLog = new LocalLog(16384);
@@ -173,6 +222,26 @@ public class WifiNative {
         return sCmdId++;
     }
 
+    /* the id getNewCmdIdLocked() hands out next, for native calls that may not reach the HAL */
+    private static int peekNewCmdIdLocked() {
+        return sCmdId;
+    }
+
+    /*
+     * Uses up offeredId if the native call came back with it as the id the HAL was programmed
+     * under, and records that id. Returns false if the HAL isn't programmed.
+     */
+    private static boolean takeCmdIdLocked(int offeredId, int programmedId) {
+        if (programmedId == offeredId) {
+            getNewCmdIdLocked();
+        }
+        if (programmedId >= 0) {
+            sPnoCmdId = programmedId;
+            return true;
+        }
+        return false;
+    }
+
     private void localLog(String s) {
         if (mLocalLog != null)
             mLocalLog.log(mInterfaceName + ": " + s);
@@ -1354,8 +1423,35 @@ public class WifiNative {
     private static MonitorThread sThread;
     private static final int STOP_HAL_TIMEOUT_MS = 1000;
 
+    /* HAL capability bits; keep these consistent with com_android_server_wifi_WifiNative.cpp */
+    public static final int HAL_CAPABILITY_GSCAN                = 1 << 0;
+    public static final int HAL_CAPABILITY_HOTLIST              = 1 << 1;
+    public static final int HAL_CAPABILITY_SIGNIFICANT_CHANGE   = 1 << 2;
+    public static final int HAL_CAPABILITY_LINK_STATS           = 1 << 3;
+    public static final int HAL_CAPABILITY_RTT                  = 1 << 4;
+    public static final int HAL_CAPABILITY_VALID_CHANNELS       = 1 << 5;
+    public static final int HAL_CAPABILITY_SCANNING_MAC_OUI     = 1 << 6;
+    public static final int HAL_CAPABILITY_COUNTRY_CODE         = 1 << 7;
+    public static final int HAL_CAPABILITY_NODFS                = 1 << 8;
+    public static final int HAL_CAPABILITY_TDLS                 = 1 << 9;
+    public static final int HAL_CAPABILITY_LOGGER               = 1 << 10;
+    public static final int HAL_CAPABILITY_FW_MEMORY_DUMP       = 1 << 11;
+    public static final int HAL_CAPABILITY_ALERT                = 1 << 12;
+    public static final int HAL_CAPABILITY_EPNO                 = 1 << 13;
+    public static final int HAL_CAPABILITY_SSID_WHITELIST       = 1 << 14;
+    public static final int HAL_CAPABILITY_ROAM_PARAMS          = 1 << 15;
+    public static final int HAL_CAPABILITY_LAZY_ROAM            = 1 << 16;
+    public static final int HAL_CAPABILITY_BSSID_BLACKLIST      = 1 << 17;
+    public static final int HAL_CAPABILITY_PACKET_OFFLOAD       = 1 << 18;
+    public static final int HAL_CAPABILITY_RSSI_MONITOR         = 1 << 19;
+    public static final int HAL_CAPABILITY_VERSION_INFO         = 1 << 20;
+
+    /* probed once by startHal; functions the vendor HAL left as stubs have no bit set */
+    private static int sHalCapabilities = 0;
+
     private static native boolean startHalNative();
     private static native void stopHalNative();
+    private static native int getHalCapabilitiesNative();
     private static native void waitForHalEventNative();
 
     private static class MonitorThread extends Thread {
@@ -1377,6 +1473,7 @@ public class WifiNative {
 
         synchronized (mLock) {
             if (startHalNative() && (getInterfaces() != 0) && (sWlan0Index != -1)) {
+                sHalCapabilities = getHalCapabilitiesNative();
                 sThread = new MonitorThread();
                 sThread.start();
                 return true;
@@ -1403,10 +1500,19 @@ public class WifiNative {
                 sWifiIfaceHandles = null;
                 sWlan0Index = -1;
                 sP2p0Index = -1;
+                sHalCapabilities = 0;
             }
         }
     }
 
+    /**
+     * Whether the vendor HAL implements a HAL_CAPABILITY_* group; callers check this
+     * instead of finding out from a WIFI_ERROR_NOT_SUPPORTED round trip.
+     */
+    public static boolean hasHalCapability(int capability) {
+        return (sHalCapabilities & capability) == capability;
+    }
+
     public static boolean isHalStarted() {
         return (sWifiHalHandle != 0);
     }
@@ -1465,7 +1571,9 @@ public class WifiNative {
 
     private static native boolean startScanNative(int iface, int id, ScanSettings settings);
     private static native boolean stopScanNative(int iface, int id);
-    private static native WifiScanner.ScanData[] getScanResultsNative(int iface, boolean flush);
+    private static native WifiScanner.ScanData[] getScanResultsNative(int iface, boolean flush,
+            ScanFilter filter);
+    private static native boolean setFullScanResultFilterNative(ScanFilter filter);
     private static native WifiLinkLayerStats getWifiLinkLayerStatsNative(int iface);
     private static native void setWifiLinkLayerStatsNative(int iface, int enable);
 
@@ -1493,6 +1601,20 @@ public class WifiNative {
         BucketSettings buckets[];
     }
 
+    /**
+     * Scan results that don't pass are dropped natively, before any ScanResult is made for
+     * them. A result passes if it is on the band, at or above min_rssi, no older than
+     * max_age_ms, and, if ssids or bssids is set, has one of those. DFS channels are the ones
+     * the HAL lists for WifiScanner.WIFI_BAND_5_GHZ_DFS_ONLY.
+     */
+    public static class ScanFilter {
+        String ssids[];                     // unquoted
+        String bssids[];
+        int band;                           // WifiScanner.WIFI_BAND_*; unspecified for any
+        int min_rssi = Integer.MIN_VALUE;
+        int max_age_ms;                     // 0 for any
+    }
+
     public static interface ScanEventHandler {
         void onScanResultsAvailable();
         void onFullScanResult(ScanResult fullScanResult);
@@ -1561,11 +1683,22 @@ public class WifiNative {
         return true;
     }
 
-    static void populateScanResult(ScanResult result, byte bytes[], String dbg) {
+    /*
+     * summary is what the native side already parsed out of bytes, see IE_SUMMARY_*; when it
+     * is null the IEs are walked here.
+     */
+    static void populateScanResult(ScanResult result, byte bytes[], int summary[], String dbg) {
         int num = 0;
         if (bytes == null) return;
         if (dbg == null) dbg = "";
-        for (int i = 0; i < bytes.length - 1; ) {
+        if (summary != null) {
+            num = summary[IE_SUMMARY_ELEMENT_COUNT];
+            if ((summary[IE_SUMMARY_FLAGS] & IE_SUMMARY_MALFORMED) != 0) {
+                Log.w(TAG, dbg + "malformed IE from " + result.BSSID + ", ignoring it and the "
+                        + "rest of the IEs");
+            }
+        }
+        for (int i = 0; summary == null && i < bytes.length - 1; ) {
             int type  = bytes[i] & 0xFF;
             int len = bytes[i + 1] & 0xFF;
             if (i + len + 2 > bytes.length) {
@@ -1601,7 +1734,9 @@ public class WifiNative {
             int inforStart = index + 2;
             index += (len + 2);
 
-            if(type == EID_HT_OPERATION) {
+            if (summary != null) {
+                continue;
+            } else if(type == EID_HT_OPERATION) {
                 secondChanelOffset = bytes[inforStart + 1] & 0x3;
             } else if(type == EID_VHT_OPERATION) {
                 channelMode = bytes[inforStart];
@@ -1623,6 +1758,28 @@ public class WifiNative {
             }
         }
 
+        if (summary != null) {
+            /* the summary has what NetworkDetail and parse_akm would walk the IEs for */
+            result.informationElements = elements;
+            NetworkDetail detail = new NetworkDetail(result, summary);
+            result.channelWidth = detail.getChannelWidth();
+            result.centerFreq0 = detail.getCenterfreq0();
+            result.centerFreq1 = detail.getCenterfreq1();
+            if (detail.is80211McResponderSupport()) {
+                result.setFlag(ScanResult.FLAG_80211mc_RESPONDER);
+            } else {
+                result.clearFlag(ScanResult.FLAG_80211mc_RESPONDER);
+            }
+            if (detail.isInterworking()) {
+                result.setFlag(ScanResult.FLAG_PASSPOINT_NETWORK);
+            }
+            if (result.capabilities == null) {
+                result.capabilities = WifiParser.parse_akm(summary);
+            }
+            if (DBG) Log.d(TAG, dbg + detail);
+            return;
+        }
+
         if (is80211McRTTResponder) {
             result.setFlag(ScanResult.FLAG_80211mc_RESPONDER);
         } else {
@@ -1670,14 +1827,15 @@ public class WifiNative {
         result.informationElements = elements;
     }
 
-    synchronized static void onFullScanResult(int id, ScanResult result, byte bytes[]) {
+    synchronized static void onFullScanResult(int id, ScanResult result, byte bytes[],
+            int summary[]) {
         if (DBG) Log.i(TAG, "Got a full scan results event, ssid = " + result.SSID + ", " +
                 "num = " + bytes.length);
 
         if (sScanEventHandler == null) {
             return;
         }
-        populateScanResult(result, bytes, " onFullScanResult ");
+        populateScanResult(result, bytes, summary, " onFullScanResult ");
 
         sScanEventHandler.onFullScanResult(result);
     }
@@ -1734,7 +1892,8 @@ public class WifiNative {
             if (isHalStarted()) {
                 if (sScanCmdId != 0 && sScanSettings != null && sScanEventHandler != null) {
                     Log.d(TAG, "Pausing scan");
-                    WifiScanner.ScanData scanData[] = getScanResultsNative(sWlan0Index, true);
+                    WifiScanner.ScanData scanData[] =
+                            getScanResultsNative(sWlan0Index, true, null);
                     stopScanNative(sWlan0Index, sScanCmdId);
                     sScanCmdId = 0;
                     sScanEventHandler.onScanPaused(scanData);
@@ -1763,10 +1922,16 @@ public class WifiNative {
     }
 
     synchronized public static WifiScanner.ScanData[] getScanResults(boolean flush) {
+        return getScanResults(flush, null);
+    }
+
+    /** Only returns the results that pass filter; a null filter passes all of them. */
+    synchronized public static WifiScanner.ScanData[] getScanResults(boolean flush,
+            ScanFilter filter) {
         synchronized (mLock) {
             WifiScanner.ScanData[] sd = null;
             if (isHalStarted()) {
-                sd = getScanResultsNative(sWlan0Index, flush);
+                sd = getScanResultsNative(sWlan0Index, flush, filter);
             }
 
             if (sd != null) {
@@ -1777,48 +1942,55 @@ public class WifiNative {
         }
     }
 
+    /**
+     * Full scan results that don't pass filter are no longer reported; null reports all of
+     * them again. Stays in place until the HAL is stopped.
+     */
+    public static boolean setFullScanResultFilter(ScanFilter filter) {
+        return setFullScanResultFilterNative(filter);
+    }
+
     public static interface HotlistEventHandler {
-        void onHotlistApFound (ScanResult[] result);
-        void onHotlistApLost  (ScanResult[] result);
+        void onHotlistApFound (int id, ScanResult[] result);
+        void onHotlistApLost  (int id, ScanResult[] result);
     }
 
-    private static int sHotlistCmdId = 0;
-    private static HotlistEventHandler sHotlistEventHandler;
+    /* hotlist requests by id; the native side merges them into the single HAL hotlist */
+    private static final SparseArray<HotlistEventHandler> sHotlistEventHandlers =
+            new SparseArray<HotlistEventHandler>();
 
     private native static boolean setHotlistNative(int iface, int id,
             WifiScanner.HotlistSettings settings);
     private native static boolean resetHotlistNative(int iface, int id);
 
-    synchronized public static boolean setHotlist(WifiScanner.HotlistSettings settings,
+    /**
+     * Adds a hotlist request; events for the BSSIDs in settings are reported to eventHandler
+     * along with the returned id. Returns -1 if the request could not be installed.
+     */
+    synchronized public static int setHotlist(WifiScanner.HotlistSettings settings,
                                     HotlistEventHandler eventHandler) {
         synchronized (mLock) {
             if (isHalStarted()) {
-                if (sHotlistCmdId != 0) {
-                    return false;
-                } else {
-                    sHotlistCmdId = getNewCmdIdLocked();
-                }
-
-                sHotlistEventHandler = eventHandler;
-                if (setHotlistNative(sWlan0Index, sHotlistCmdId, settings) == false) {
-                    sHotlistEventHandler = null;
-                    return false;
+                int id = getNewCmdIdLocked();
+                sHotlistEventHandlers.put(id, eventHandler);
+                if (setHotlistNative(sWlan0Index, id, settings) == false) {
+                    sHotlistEventHandlers.remove(id);
+                    return -1;
                 }
 
-                return true;
+                return id;
             } else {
-                return false;
+                return -1;
             }
         }
     }
 
-    synchronized public static void resetHotlist() {
+    synchronized public static void resetHotlist(int id) {
         synchronized (mLock) {
             if (isHalStarted()) {
-                if (sHotlistCmdId != 0) {
-                    resetHotlistNative(sWlan0Index, sHotlistCmdId);
-                    sHotlistCmdId = 0;
-                    sHotlistEventHandler = null;
+                if (sHotlistEventHandlers.get(id) != null) {
+                    resetHotlistNative(sWlan0Index, id);
+                    sHotlistEventHandlers.remove(id);
                 }
             }
         }
@@ -1827,8 +1999,9 @@ public class WifiNative {
     synchronized public static void onHotlistApFound(int id, ScanResult[] results) {
         synchronized (mLock) {
             if (isHalStarted()) {
-                if (sHotlistCmdId != 0) {
-                    sHotlistEventHandler.onHotlistApFound(results);
+                HotlistEventHandler handler = sHotlistEventHandlers.get(id);
+                if (handler != null) {
+                    handler.onHotlistApFound(id, results);
                 } else {
                 /* this can happen because of race conditions */
                     Log.d(TAG, "Ignoring hotlist AP found event");
@@ -1840,8 +2013,9 @@ public class WifiNative {
     synchronized public static void onHotlistApLost(int id, ScanResult[] results) {
         synchronized (mLock) {
             if (isHalStarted()) {
-                if (sHotlistCmdId != 0) {
-                    sHotlistEventHandler.onHotlistApLost(results);
+                HotlistEventHandler handler = sHotlistEventHandlers.get(id);
+                if (handler != null) {
+                    handler.onHotlistApLost(id, results);
                 } else {
                 /* this can happen because of race conditions */
                     Log.d(TAG, "Ignoring hotlist AP lost event");
@@ -1967,7 +2141,7 @@ public class WifiNative {
     synchronized public static boolean requestRtt(
             RttManager.RttParams[] params, RttEventHandler handler) {
         synchronized (mLock) {
-            if (isHalStarted()) {
+            if (isHalStarted() && hasHalCapability(HAL_CAPABILITY_RTT)) {
                 if (sRttCmdId != 0) {
                     Log.v("TAG", "Last one is still under measurement!");
                     return false;
@@ -2067,7 +2241,7 @@ public class WifiNative {
     private static native RttManager.RttCapabilities getRttCapabilitiesNative(int iface);
     synchronized public static RttManager.RttCapabilities getRttCapabilities() {
         synchronized (mLock) {
-            if (isHalStarted()) {
+            if (isHalStarted() && hasHalCapability(HAL_CAPABILITY_RTT)) {
                 return getRttCapabilitiesNative(sWlan0Index);
             }else {
                 return null;
@@ -2098,6 +2272,9 @@ public class WifiNative {
     synchronized public static boolean enableDisableTdls(boolean enable, String macAdd,
             TdlsEventHandler tdlsCallBack) {
         synchronized (mLock) {
+            if (!hasHalCapability(HAL_CAPABILITY_TDLS)) {
+                return false;
+            }
             sTdlsEventHandler = tdlsCallBack;
             return enableDisableTdlsNative(sWlan0Index, enable, macAdd);
         }
@@ -2114,7 +2291,7 @@ public class WifiNative {
     private static native TdlsStatus getTdlsStatusNative(int iface, String macAddr);
     synchronized public static TdlsStatus getTdlsStatus (String macAdd) {
         synchronized (mLock) {
-            if (isHalStarted()) {
+            if (isHalStarted() && hasHalCapability(HAL_CAPABILITY_TDLS)) {
                 return getTdlsStatusNative(sWlan0Index, macAdd);
             } else {
                 return null;
@@ -2137,7 +2314,7 @@ public class WifiNative {
     private static native TdlsCapabilities getTdlsCapabilitiesNative(int iface);
     synchronized public static TdlsCapabilities getTdlsCapabilities () {
         synchronized (mLock) {
-            if (isHalStarted()) {
+            if (isHalStarted() && hasHalCapability(HAL_CAPABILITY_TDLS)) {
                 return getTdlsCapabilitiesNative(sWlan0Index);
             } else {
                 return null;
@@ -2145,15 +2322,32 @@ public class WifiNative {
         }
     }
 
-    synchronized private static boolean onTdlsStatus(String macAddr, int status, int reason) {
-         if (sTdlsEventHandler == null) {
-             return false;
-         } else {
+    synchronized private static void onTdlsStatus(String macAddr, int status, int reason) {
+         if (sTdlsEventHandler != null) {
              sTdlsEventHandler.onTdlsStatus(macAddr, status, reason);
-             return true;
          }
     }
 
+    private static native boolean setTdlsAutoNative(int iface, boolean enable, int setupRate,
+            int teardownRate);
+    /**
+     * Has TDLS sessions set up natively with peers that carry at least setupRate MPDUs per
+     * second, and torn down again below teardownRate, up to the number of sessions the
+     * firmware supports. The rates are taken from link layer stats as they are polled, so
+     * nothing is torn down while they aren't. Enabling forgets the peers of the link before;
+     * disabling tears down the sessions set up this way.
+     */
+    synchronized public static boolean setTdlsAuto(boolean enable, int setupRate,
+            int teardownRate) {
+        synchronized (mLock) {
+            if (isHalStarted() && hasHalCapability(HAL_CAPABILITY_TDLS)) {
+                return setTdlsAutoNative(sWlan0Index, enable, setupRate, teardownRate);
+            } else {
+                return false;
+            }
+        }
+    }
+
     //---------------------------------------------------------------------------------
 
     /* Wifi Logger commands/events */
@@ -2162,6 +2356,11 @@ public class WifiNative {
 
     public static interface WifiLoggerEventHandler {
         void onRingBufferData(RingBufferStatus status, byte[] buffer);
+        /* called instead of onRingBufferData once the ring buffer log sink is enabled */
+        void onRingBufferDataWritten(int ringBufferId, int bytes, boolean wrapped);
+        /* called once the counters of a ring moved by the status threshold */
+        void onRingBufferStatusChanged(int ringBufferId, int writtenBytes, int readBytes,
+                int writtenRecords);
         void onWifiAlert(int errorCode, byte[] buffer);
     }
 
@@ -2172,6 +2371,18 @@ public class WifiNative {
             sWifiLoggerEventHandler.onRingBufferData(status, buffer);
     }
 
+    private static void onRingBufferDataWritten(int ringBufferId, int bytes, boolean wrapped) {
+        if (sWifiLoggerEventHandler != null)
+            sWifiLoggerEventHandler.onRingBufferDataWritten(ringBufferId, bytes, wrapped);
+    }
+
+    private static void onRingBufferStatusChanged(int ringBufferId, int writtenBytes,
+            int readBytes, int writtenRecords) {
+        if (sWifiLoggerEventHandler != null)
+            sWifiLoggerEventHandler.onRingBufferStatusChanged(ringBufferId, writtenBytes,
+                    readBytes, writtenRecords);
+    }
+
     private static void onWifiAlert(byte[] buffer, int errorCode) {
         if (sWifiLoggerEventHandler != null)
             sWifiLoggerEventHandler.onWifiAlert(errorCode, buffer);
@@ -2284,6 +2495,18 @@ public class WifiNative {
         }
     }
 
+    private static native void setRingBufferStatusThresholdNative(int bytes);
+    /**
+     * Sets by how many bytes the written or read counter of a ring has to move before
+     * onRingBufferStatusChanged is reported; 0 selects a quarter of each ring's size.
+     */
+    synchronized public static void setRingBufferStatusThreshold(int bytes) {
+        synchronized (mLock) {
+            setRingBufferStatusThresholdNative(bytes);
+        }
+    }
+
+    /* served from a native table that ring buffer callbacks keep current */
     private static native RingBufferStatus[] getRingBufferStatusNative(int iface);
     synchronized public static RingBufferStatus[] getRingBufferStatus() {
         synchronized (mLock) {
@@ -2315,6 +2538,56 @@ public class WifiNative {
         }
     }
 
+    private static native boolean enableRingBufferLogSinkNative(String dir, int bytesPerRing);
+    /**
+     * Makes the native layer keep ring buffer data in per ring files under dir, each holding
+     * up to bytesPerRing bytes of records. Once enabled, onRingBufferDataWritten is reported
+     * instead of onRingBufferData, and the records are fetched with readRingBufferLog.
+     */
+    synchronized public static boolean enableRingBufferLogSink(String dir, int bytesPerRing) {
+        synchronized (mLock) {
+            return enableRingBufferLogSinkNative(dir, bytesPerRing);
+        }
+    }
+
+    private static native byte[] readRingBufferLogNative(String ringName);
+    /** returns the records held for ringName, oldest first */
+    synchronized public static byte[] readRingBufferLog(String ringName) {
+        synchronized (mLock) {
+            return readRingBufferLogNative(ringName);
+        }
+    }
+
+    /** ring buffer entry types; keep these consistent with wifi_logger.h */
+    public static final int RING_BUFFER_ENTRY_TYPE_CONNECT_EVENT = 1;
+    public static final int RING_BUFFER_ENTRY_TYPE_PKT           = 2;
+    public static final int RING_BUFFER_ENTRY_TYPE_WAKE_LOCK     = 3;
+    public static final int RING_BUFFER_ENTRY_TYPE_POWER_EVENT   = 4;
+    public static final int RING_BUFFER_ENTRY_TYPE_DATA          = 5;
+
+    private static native byte[] queryRingBufferLogNative(String ringName, int typeMask,
+            long start, long end);
+    /**
+     * Returns the records held for ringName, oldest first, whose type is set in typeMask
+     * (bit n selects RING_BUFFER_ENTRY_TYPE n) and whose firmware timestamp lies within
+     * [start, end]; a negative end means up to the newest record. Only the selected records
+     * are copied out of the native index.
+     */
+    synchronized public static byte[] queryRingBufferLog(String ringName, int typeMask,
+            long start, long end) {
+        synchronized (mLock) {
+            return queryRingBufferLogNative(ringName, typeMask, start, end);
+        }
+    }
+
+    /** like queryRingBufferLog, for the records logged within window of the newest one */
+    synchronized public static byte[] queryRecentRingBufferLog(String ringName, int typeMask,
+            long window) {
+        synchronized (mLock) {
+            return queryRingBufferLogNative(ringName, typeMask, -window, Long.MAX_VALUE);
+        }
+    }
+
     private static native boolean getFwMemoryDumpNative(int iface);
     synchronized public static byte[] getFwMemoryDump() {
         synchronized (mLock) {
@@ -2332,6 +2605,40 @@ public class WifiNative {
         }
     }
 
+    public static class FwMemoryDumpInfo {
+        long size;              /* bytes received from the firmware */
+        long writtenBytes;      /* bytes written to the file descriptor */
+        long checksum;          /* CRC32 of the uncompressed dump */
+        long durationNs;
+        boolean compressed;     /* zlib stream, same format as java.util.zip.Deflater */
+
+        @Override
+        public String toString() {
+            return "size: " + size + " writtenBytes: " + writtenBytes +
+                    " checksum: " + Long.toHexString(checksum) + " durationMs: " +
+                    durationNs / 1000000 + " compressed: " + compressed;
+        }
+    }
+
+    private static native FwMemoryDumpInfo getFwMemoryDumpToFdNative(int iface,
+            FileDescriptor fd, boolean compress);
+
+    /**
+     * Streams the firmware memory dump into fd instead of handing it back as a byte array,
+     * so that the dump is never held in the Java heap. Returns null if the HAL fails or
+     * does not deliver the dump in time.
+     */
+    synchronized public static FwMemoryDumpInfo getFwMemoryDump(FileDescriptor fd,
+            boolean compress) {
+        synchronized (mLock) {
+            if (isHalStarted()) {
+                return getFwMemoryDumpToFdNative(sWlan0Index, fd, compress);
+            } else {
+                return null;
+            }
+        }
+    }
+
     //---------------------------------------------------------------------------------
     /* Configure ePNO */
 
@@ -2340,6 +2647,9 @@ public class WifiNative {
         int rssi_threshold;
         int flags;
         int auth;
+        int priority;   // networks of higher priority are programmed first
+        int score;      // breaks ties between networks of the same priority
+        boolean dropped; // set if ePNO had no room for the network
         String configKey; // kept for reference
 
         WifiPnoNetwork(WifiConfiguration config, int threshold) {
@@ -2362,6 +2672,7 @@ public class WifiNative {
             }
 //            auth = 0;
             flags |= 6; //A and G
+            priority = config.priority;
             configKey = config.configKey();
         }
 
@@ -2372,6 +2683,11 @@ public class WifiNative {
             sbuf.append(" flags=").append(this.flags);
             sbuf.append(" rssi=").append(this.rssi_threshold);
             sbuf.append(" auth=").append(this.auth);
+            sbuf.append(" priority=").append(this.priority);
+            sbuf.append(" score=").append(this.score);
+            if (this.dropped) {
+                sbuf.append(" dropped");
+            }
             return sbuf.toString();
         }
     }
@@ -2384,19 +2700,25 @@ public class WifiNative {
 
     private static int sPnoCmdId = 0;
 
-    private native static boolean setPnoListNative(int iface, int id, WifiPnoNetwork list[]);
+    /*
+     * Only as many networks as the firmware can hold are programmed, picked by priority and
+     * score; the others get their dropped flag set. The firmware is not reprogrammed if the
+     * picked networks did not change since the last call; they then stay under the id they
+     * were programmed with. Returns the id ePNO is programmed under, or -1.
+     */
+    private native static int setPnoListNative(int iface, int id, WifiPnoNetwork list[]);
 
     synchronized public static boolean setPnoList(WifiPnoNetwork list[],
                                                   WifiPnoEventHandler eventHandler) {
         Log.e(TAG, "setPnoList cmd " + sPnoCmdId);
 
         synchronized (mLock) {
-            if (isHalStarted()) {
-
-                sPnoCmdId = getNewCmdIdLocked();
+            if (isHalStarted() && hasHalCapability(HAL_CAPABILITY_EPNO)) {
 
                 sWifiPnoEventHandler = eventHandler;
-                if (setPnoListNative(sWlan0Index, sPnoCmdId, list)) {
+                int programmedId = setPnoListNative(sWlan0Index, getNewCmdIdLocked(), list);
+                if (programmedId >= 0) {
+                    sPnoCmdId = programmedId;
                     return true;
                 }
             }
@@ -2421,7 +2743,7 @@ public class WifiNative {
             Log.e(TAG, "onPnoNetworkFound SSID " + results[i].SSID
                     + " " + results[i].level + " " + results[i].frequency);
 
-            populateScanResult(results[i], results[i].bytes, "onPnoNetworkFound ");
+            populateScanResult(results[i], results[i].bytes, null, "onPnoNetworkFound ");
             results[i].wifiSsid = WifiSsid.createFromAsciiEncoded(results[i].SSID);
         }
         synchronized (mLock) {
@@ -2463,9 +2785,74 @@ public class WifiNative {
     private native static boolean setLazyRoamNative(int iface, int id,
                                               boolean enabled, WifiLazyRoamParams param);
 
+    private static native void setRoamScorerParamsNative(WifiLazyRoamParams params);
+
+    /**
+     * Gives the roam scorer the lazy roam parameters. Needs no HAL; it should be given them
+     * whether or not the firmware does lazy roam, so that rankRoamCandidates ranks the same
+     * either way.
+     */
+    public static void setRoamScorerParams(WifiLazyRoamParams params) {
+        setRoamScorerParamsNative(params);
+    }
+
+    private static native boolean setBssidPreferenceNative(int iface, int id, String bssids[],
+            int rssiModifiers[], boolean program);
+
+    /**
+     * Sets the RSSI modifiers lazy roam applies to bssids. The roam scorer takes them even if
+     * the firmware can't.
+     */
+    synchronized public static boolean setBssidPreference(String bssids[], int rssiModifiers[]) {
+        synchronized (mLock) {
+            boolean program = isHalStarted() && hasHalCapability(HAL_CAPABILITY_LAZY_ROAM);
+            int id = program ? getNewCmdIdLocked() : 0;
+            return setBssidPreferenceNative(sWlan0Index, id, bssids, rssiModifiers, program)
+                    && program;
+        }
+    }
+
+    /** A roam candidate as ranked by rankRoamCandidates, with how its score came about. */
+    public static class RoamCandidate {
+        String bssid;
+        int frequency;
+        int rssi;
+        int hysteresis_boost;
+        int band_boost;
+        int preference_boost;
+        int score;
+
+        @Override
+        public String toString() {
+            StringBuilder sbuf = new StringBuilder();
+            sbuf.append(bssid).append(" freq=").append(frequency);
+            sbuf.append(" rssi=").append(rssi);
+            sbuf.append(" hysteresis=").append(hysteresis_boost);
+            sbuf.append(" band=").append(band_boost);
+            sbuf.append(" preference=").append(preference_boost);
+            sbuf.append(" score=").append(score);
+            return sbuf.toString();
+        }
+    }
+
+    private static native RoamCandidate[] rankRoamCandidatesNative(String ssid,
+            String currentBssid, int maxCandidates, int maxAgeMs);
+
+    /**
+     * Ranks the BSSIDs of ssid (unquoted; null for any) seen in the last gscan results fetched,
+     * and no more than maxAgeMs ago (0 for any), the way lazy roam would, best first, and
+     * returns up to maxCandidates of them. Needs no HAL.
+     */
+    public static RoamCandidate[] rankRoamCandidates(String ssid, String currentBssid,
+            int maxCandidates, int maxAgeMs) {
+        RoamCandidate[] candidates = rankRoamCandidatesNative(ssid, currentBssid, maxCandidates,
+                maxAgeMs);
+        return candidates != null ? candidates : new RoamCandidate[0];
+    }
+
     synchronized public static boolean setLazyRoam(boolean enabled, WifiLazyRoamParams params) {
         synchronized (mLock) {
-            if (isHalStarted()) {
+            if (isHalStarted() && hasHalCapability(HAL_CAPABILITY_LAZY_ROAM)) {
                 sPnoCmdId = getNewCmdIdLocked();
                 return setLazyRoamNative(sWlan0Index, sPnoCmdId, enabled, params);
             } else {
@@ -2474,9 +2861,33 @@ public class WifiNative {
         }
     }
 
-    private native static boolean setBssidBlacklistNative(int iface, int id,
-                                              String list[]);
+    // Why a BSSID was blacklisted; kept natively and handed back when it expires
+    public static final int BSSID_BLACKLIST_REASON_UNSPECIFIED = 0;
+    public static final int BSSID_BLACKLIST_REASON_REQUESTED = 1;
+    public static final int BSSID_BLACKLIST_REASON_ASSOC_REJECTED = 2;
+
+    /*
+     * These return the id the firmware blacklist is programmed under, which is id only if the
+     * HAL was called, or -1 if it isn't programmed; getExpiredBssidsNative returns it first.
+     */
+    private native static int setBssidBlacklistNative(int iface, int id,
+                                              String list[], boolean program);
+    private native static int blacklistBssidNative(int iface, int id, String bssid,
+            int reason, int durationMs, boolean program);
+    private native static int unblacklistBssidNative(int iface, int id, String bssid,
+            boolean program);
+    private native static long[] getExpiredBssidsNative(int iface, int id, boolean program);
+
+    /*
+     * The blacklist is kept natively whether or not the firmware takes it, so that the roam
+     * scorer sees it either way; the firmware is only programmed when the set changed, and
+     * only then is a command id used up.
+     */
+    private static boolean canProgramBssidBlacklistLocked() {
+        return isHalStarted() && hasHalCapability(HAL_CAPABILITY_BSSID_BLACKLIST);
+    }
 
+    /** Replaces the blacklist with list; none of them expire. */
     synchronized public static boolean setBssidBlacklist(String list[]) {
         int size = 0;
         if (list != null) {
@@ -2485,16 +2896,62 @@ public class WifiNative {
         Log.e(TAG, "setBssidBlacklist cmd " + sPnoCmdId + " size " + size);
 
         synchronized (mLock) {
-            if (isHalStarted()) {
-                sPnoCmdId = getNewCmdIdLocked();
-                return setBssidBlacklistNative(sWlan0Index, sPnoCmdId, list);
-            } else {
-                return false;
+            int id = peekNewCmdIdLocked();
+            return takeCmdIdLocked(id, setBssidBlacklistNative(sWlan0Index, id, list,
+                    canProgramBssidBlacklistLocked()));
+        }
+    }
+
+    /**
+     * Blacklists bssid for durationMs, or until it is unblacklisted if durationMs is 0. Once
+     * the blacklist is full the BSSID blacklisted longest ago makes room.
+     */
+    synchronized public static boolean blacklistBssid(String bssid, int reason, int durationMs) {
+        synchronized (mLock) {
+            int id = peekNewCmdIdLocked();
+            return takeCmdIdLocked(id, blacklistBssidNative(sWlan0Index, id, bssid, reason,
+                    durationMs, canProgramBssidBlacklistLocked()));
+        }
+    }
+
+    synchronized public static boolean unblacklistBssid(String bssid) {
+        synchronized (mLock) {
+            int id = peekNewCmdIdLocked();
+            return takeCmdIdLocked(id, unblacklistBssidNative(sWlan0Index, id, bssid,
+                    canProgramBssidBlacklistLocked()));
+        }
+    }
+
+    /**
+     * Expires the BSSIDs whose time is up and returns those that expired since the last call,
+     * packed as getExpiredBssid / getExpiredReason take them apart.
+     */
+    synchronized public static long[] getExpiredBssids() {
+        synchronized (mLock) {
+            int id = peekNewCmdIdLocked();
+            long[] expired = getExpiredBssidsNative(sWlan0Index, id,
+                    canProgramBssidBlacklistLocked());
+            if (expired == null || expired.length == 0) {
+                return new long[0];
             }
+            takeCmdIdLocked(id, (int) expired[0]);
+            return Arrays.copyOfRange(expired, 1, expired.length);
         }
     }
 
-    private native static boolean setSsidWhitelistNative(int iface, int id, String list[]);
+    public static String getExpiredBssid(long expired) {
+        return NetworkDetail.toMACString(expired >>> 16);
+    }
+
+    public static int getExpiredReason(long expired) {
+        return (int) (expired & 0xffff);
+    }
+
+    /*
+     * Only the first MAX_WHITELIST_SSID (gscan.h) SSIDs are programmed. An unchanged list is not
+     * programmed again and keeps its id. Returns the id it is programmed under, or -1.
+     */
+    private native static int setSsidWhitelistNative(int iface, int id, String list[]);
 
     synchronized public static boolean setSsidWhitelist(String list[]) {
         int size = 0;
@@ -2504,10 +2961,14 @@ public class WifiNative {
         Log.e(TAG, "setSsidWhitelist cmd " + sPnoCmdId + " size " + size);
 
         synchronized (mLock) {
-            if (isHalStarted()) {
-                sPnoCmdId = getNewCmdIdLocked();
-
-                return setSsidWhitelistNative(sWlan0Index, sPnoCmdId, list);
+            if (isHalStarted() && hasHalCapability(HAL_CAPABILITY_SSID_WHITELIST)) {
+                int programmedId = setSsidWhitelistNative(sWlan0Index, getNewCmdIdLocked(),
+                        list);
+                if (programmedId < 0) {
+                    return false;
+                }
+                sPnoCmdId = programmedId;
+                return true;
             } else {
                 return false;
             }
@@ -2517,16 +2978,24 @@ public class WifiNative {
     private native static int startSendingOffloadedPacketNative(int iface, int idx,
                                     byte[] srcMac, byte[] dstMac, byte[] pktData, int period);
 
-    synchronized public int
-    startSendingOffloadedPacket(int slot, KeepalivePacketData keepAlivePacket, int period) {
-        Log.d(TAG, "startSendingOffloadedPacket slot=" + slot + " period=" + period);
-
+    private byte[] getMacAddressBytes() {
         String[] macAddrStr = getMacAddress().split(":");
         byte[] srcMac = new byte[6];
         for(int i = 0; i < 6; i++) {
             Integer hexVal = Integer.parseInt(macAddrStr[i], 16);
             srcMac[i] = hexVal.byteValue();
         }
+        return srcMac;
+    }
+
+    synchronized public int
+    startSendingOffloadedPacket(int slot, KeepalivePacketData keepAlivePacket, int period) {
+        Log.d(TAG, "startSendingOffloadedPacket slot=" + slot + " period=" + period);
+        if (!hasHalCapability(HAL_CAPABILITY_PACKET_OFFLOAD)) {
+            return -1;
+        }
+
+        byte[] srcMac = getMacAddressBytes();
         synchronized (mLock) {
             if (isHalStarted()) {
                 return startSendingOffloadedPacketNative(sWlan0Index, slot, srcMac,
@@ -2543,7 +3012,7 @@ public class WifiNative {
     stopSendingOffloadedPacket(int slot) {
         Log.d(TAG, "stopSendingOffloadedPacket " + slot);
         synchronized (mLock) {
-            if (isHalStarted()) {
+            if (isHalStarted() && hasHalCapability(HAL_CAPABILITY_PACKET_OFFLOAD)) {
                 return stopSendingOffloadedPacketNative(sWlan0Index, slot);
             } else {
                 return -1;
@@ -2551,60 +3020,202 @@ public class WifiNative {
         }
     }
 
+    /** A keepalive packet for the firmware to send on its own, see setOffloadedPackets */
+    public static class OffloadedPacket {
+        int slot;
+        byte[] dst_mac;                     // next hop
+        byte[] data;                        // the IP packet
+        int period_ms;
+        InetAddress dst_address;            // not used natively; to find the next hop again
+    }
+
+    private native static int[] setOffloadedPacketsNative(int iface, byte[] srcMac,
+            OffloadedPacket[] packets);
+
+    /**
+     * Makes packets the complete set of keepalives the firmware sends: slots not among them
+     * are stopped, and only the ones that are new or changed are programmed, so calling this
+     * again after a roam leaves the packets whose next hop stayed the same alone. Returns a
+     * result per packet, 0 on success, or null if packet offload is unavailable.
+     */
+    synchronized public int[] setOffloadedPackets(OffloadedPacket[] packets) {
+        Log.d(TAG, "setOffloadedPackets " + packets.length);
+        if (!hasHalCapability(HAL_CAPABILITY_PACKET_OFFLOAD)) {
+            return null;
+        }
+
+        byte[] srcMac = getMacAddressBytes();
+        synchronized (mLock) {
+            if (isHalStarted()) {
+                return setOffloadedPacketsNative(sWlan0Index, srcMac, packets);
+            } else {
+                return null;
+            }
+        }
+    }
+
+    private native static int stopAllSendingOffloadedPacketsNative(int iface);
+
+    /** Stops every offloaded keepalive at once; returns how many were stopped, or -1 */
+    synchronized public int stopAllSendingOffloadedPackets() {
+        synchronized (mLock) {
+            if (isHalStarted() && hasHalCapability(HAL_CAPABILITY_PACKET_OFFLOAD)) {
+                return stopAllSendingOffloadedPacketsNative(sWlan0Index);
+            } else {
+                return -1;
+            }
+        }
+    }
+
+    private static native int[] getOffloadedPacketStatsNative();
+
+    /**
+     * Returns the offloaded keepalive slots in use, the slots available, then how many times
+     * slots were started, stopped, left alone as unchanged, and refused. Reads native state
+     * only, so it is neither synchronized nor checked against isHalStarted.
+     */
+    public static int[] getOffloadedPacketStats() {
+        return getOffloadedPacketStatsNative();
+    }
+
+    private static native void setOffloadedPacketDumpNative(boolean enable);
+
     public static interface WifiRssiEventHandler {
-        void onRssiThresholdBreached(byte curRssi);
+        /** The RSSI moved past a threshold of each of clients, see setRssiThresholds */
+        void onRssiThresholdBreached(byte curRssi, int[] clients);
     }
 
     private static WifiRssiEventHandler sWifiRssiEventHandler;
 
-    synchronized static void onRssiThresholdBreached(int id, byte curRssi) {
-        sWifiRssiEventHandler.onRssiThresholdBreached(curRssi);
+    synchronized static void onRssiThresholdBreached(int id, byte curRssi, int[] clients) {
+        if (sWifiRssiEventHandler != null) {
+            sWifiRssiEventHandler.onRssiThresholdBreached(curRssi, clients);
+        }
     }
 
-    private native static int startRssiMonitoringNative(int iface, int id,
-                                        byte maxRssi, byte minRssi);
-
-    private static int sRssiMonitorCmdId = 0;
+    private native static int setRssiThresholdsNative(int iface, int id, int client,
+                                        byte[] thresholds, byte curRssi);
 
-    synchronized public int startRssiMonitoring(byte maxRssi, byte minRssi,
-                                                WifiRssiEventHandler rssiEventHandler) {
-        Log.d(TAG, "startRssiMonitoring: maxRssi=" + maxRssi + " minRssi=" + minRssi);
+    /**
+     * Sets the RSSI thresholds client is to be told about, replacing the ones it had; null or
+     * empty removes the client. The firmware watches the narrowest window around curRssi
+     * that holds none of any client's thresholds, and a breach is reported with just the
+     * clients whose thresholds were crossed. Call rearmRssiMonitor once it was handled.
+     */
+    synchronized public int setRssiThresholds(int client, byte[] thresholds, byte curRssi,
+                                              WifiRssiEventHandler rssiEventHandler) {
+        Log.d(TAG, "setRssiThresholds: client=" + client + " curRssi=" + curRssi);
         sWifiRssiEventHandler = rssiEventHandler;
         synchronized (mLock) {
-            if (isHalStarted()) {
-                if (sRssiMonitorCmdId != 0) {
-                    stopRssiMonitoring();
-                }
+            if (isHalStarted() && hasHalCapability(HAL_CAPABILITY_RSSI_MONITOR)) {
+                return setRssiThresholdsNative(sWlan0Index, getNewCmdIdLocked(), client,
+                        thresholds, curRssi);
+            } else {
+                return -1;
+            }
+        }
+    }
 
-                sRssiMonitorCmdId = getNewCmdIdLocked();
-                Log.d(TAG, "sRssiMonitorCmdId = " + sRssiMonitorCmdId);
-                int ret = startRssiMonitoringNative(sWlan0Index, sRssiMonitorCmdId,
-                        maxRssi, minRssi);
-                if (ret != 0) { // if not success
-                    sRssiMonitorCmdId = 0;
-                }
-                return ret;
+    private native static int rearmRssiMonitorNative(int iface, int id, byte curRssi);
+
+    /** Points the RSSI monitor at the window around curRssi after a breach */
+    synchronized public int rearmRssiMonitor(byte curRssi) {
+        synchronized (mLock) {
+            if (isHalStarted() && hasHalCapability(HAL_CAPABILITY_RSSI_MONITOR)) {
+                return rearmRssiMonitorNative(sWlan0Index, getNewCmdIdLocked(), curRssi);
             } else {
                 return -1;
             }
         }
     }
 
-    private native static int stopRssiMonitoringNative(int iface, int idx);
+    private native static int stopRssiMonitoringNative(int iface);
 
+    /** Drops the thresholds of all clients and stops the RSSI monitor */
     synchronized public int stopRssiMonitoring() {
-        Log.d(TAG, "stopRssiMonitoring, cmdId " + sRssiMonitorCmdId);
+        Log.d(TAG, "stopRssiMonitoring");
         synchronized (mLock) {
-            if (isHalStarted()) {
-                int ret = 0;
-                if (sRssiMonitorCmdId != 0) {
-                    ret = stopRssiMonitoringNative(sWlan0Index, sRssiMonitorCmdId);
-                }
-                sRssiMonitorCmdId = 0;
-                return ret;
+            if (isHalStarted() && hasHalCapability(HAL_CAPABILITY_RSSI_MONITOR)) {
+                return stopRssiMonitoringNative(sWlan0Index);
             } else {
                 return -1;
             }
         }
     }
+
+    private static native boolean startHalTraceNative(String path, int bufferSize);
+    /**
+     * Records every HAL callback to a binary trace at path. Each callback thread buffers up
+     * to bufferSize bytes between background flushes; records that don't fit are dropped.
+     */
+    synchronized public static boolean startHalTrace(String path, int bufferSize) {
+        synchronized (mLock) {
+            return startHalTraceNative(path, bufferSize);
+        }
+    }
+
+    private static native void stopHalTraceNative();
+    synchronized public static void stopHalTrace() {
+        synchronized (mLock) {
+            stopHalTraceNative();
+        }
+    }
+
+    private static native long[] getHalTraceStatsNative();
+    /** returns the records written, records dropped and bytes written by the HAL trace */
+    synchronized public static long[] getHalTraceStats() {
+        synchronized (mLock) {
+            return getHalTraceStatsNative();
+        }
+    }
+
+    private static native int replayHalTraceNative(String path, int speedPercent);
+    /**
+     * Feeds a recorded HAL trace back through the callbacks, at speedPercent of the recorded
+     * pace, or as fast as possible if it is 0. Returns the number of records replayed, or -1.
+     * This is deliberately not synchronized, so callbacks can be delivered while it runs.
+     */
+    public static int replayHalTrace(String path, int speedPercent) {
+        return replayHalTraceNative(path, speedPercent);
+    }
+
+    private static native String getCallStatsNative();
+    /**
+     * Returns a table of call counts and latency percentiles for every JNI entry point and
+     * HAL function used so far. Not synchronized, so it can be dumped while a call is stuck.
+     */
+    public static String getCallStats() {
+        return getCallStatsNative();
+    }
+
+    private static native int[] indexAnqpPayloadNative(byte[] payload);
+    /**
+     * Indexes an ANQP response payload, see anqp/ANQPIndex; returns null if it is malformed.
+     * Needs no HAL, so it is neither synchronized nor checked against isHalStarted.
+     */
+    public static int[] indexAnqpPayload(byte[] payload) {
+        return indexAnqpPayloadNative(payload);
+    }
+
+    private static native boolean setPasspointNamesNative(String[] names, int[] providers,
+            int[] kinds, int numProviders);
+    /**
+     * Compiles the names of the configured home SPs for matchPasspointNames, see
+     * hotspot2/PasspointMatcher. Needs no HAL.
+     */
+    public static boolean setPasspointNames(String[] names, int[] providers, int[] kinds,
+            int numProviders) {
+        return setPasspointNamesNative(names, providers, kinds, numProviders);
+    }
+
+    private static native int[] matchPasspointNamesNative(int numAps, String[] names,
+            int[] aps, int[] kinds);
+    /**
+     * Matches the names advertised by numAps APs against the compiled home SP names; returns
+     * numAps * numProviders flags, or null on error. Needs no HAL.
+     */
+    public static int[] matchPasspointNames(int numAps, String[] names, int[] aps,
+            int[] kinds) {
+        return matchPasspointNamesNative(numAps, names, aps, kinds);
+    }
 }
@@ -294,5 +294,54 @@ public class WifiParser {
             return capabilities;
     }
 
+    /* 00-0F-AC AKM suite types, 802.11-2012 table 8-101 */
+    private static final String RSN_AKM_NAMES[] = {
+        null, "EAP", "PSK", "FT/EAP", "FT/PSK", "EAP-SHA256", "PSK-SHA256"
+    };
+    /* 00-50-F2 AKM suite types */
+    private static final String WPA_AKM_NAMES[] = { null, "EAP", "PSK" };
+
+    private static String akmString(String prefix, int akms, String names[]) {
+        if (akms == 0) {
+            return prefix + "-EAP]"; //default AKM
+        }
+        String security = prefix;
+        boolean found = false;
+        for (int type = 1; type < names.length; type++) {
+            if ((akms & (1 << type)) != 0) {
+                security += (found ? "+" : "-") + names[type];
+                found = true;
+            }
+        }
+        return security + "]";
+    }
+
+    /*
+     * Builds the same capabilities string as parse_akm, from the IE summary the native side
+     * made of a full scan result (see WifiNative.IE_SUMMARY_*) instead of from the IEs.
+     * {@hide}
+     */
+    static public String parse_akm(int summary[]) {
+        if (summary == null)
+            return null;
+
+        int flags = summary[WifiNative.IE_SUMMARY_FLAGS];
+        String capabilities = "";
+        if ((flags & WifiNative.IE_SUMMARY_HAS_RSN) != 0) {
+            capabilities += akmString("[WPA2", summary[WifiNative.IE_SUMMARY_RSN_AKMS],
+                    RSN_AKM_NAMES);
+        }
+        if ((flags & WifiNative.IE_SUMMARY_HAS_WPA) != 0) {
+            capabilities += akmString("[WPA", summary[WifiNative.IE_SUMMARY_WPA_AKMS],
+                    WPA_AKM_NAMES);
+        }
+        if ((flags & (WifiNative.IE_SUMMARY_HAS_RSN | WifiNative.IE_SUMMARY_HAS_WPA)) == 0
+                && (summary[WifiNative.IE_SUMMARY_CAPABILITY_INFO] & (1 << 4)) != 0) {
+            //private Beacon without an RSNE or WPA IE, hence WEP0
+            capabilities += "[WEP]";
+        }
+        return capabilities;
+    }
+
 
 }
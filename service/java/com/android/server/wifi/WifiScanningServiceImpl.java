@@ -306,15 +306,15 @@ public class WifiScanningServiceImpl extends IWifiScanner.Stub {
         }
 
         @Override
-        public void onHotlistApFound(ScanResult[] results) {
+        public void onHotlistApFound(int id, ScanResult[] results) {
             if (DBG) localLog("HotlistApFound event received");
-            sendMessage(CMD_HOTLIST_AP_FOUND, 0, 0, results);
+            sendMessage(CMD_HOTLIST_AP_FOUND, id, 0, results);
         }
 
         @Override
-        public void onHotlistApLost(ScanResult[] results) {
+        public void onHotlistApLost(int id, ScanResult[] results) {
             if (DBG) localLog("HotlistApLost event received");
-            sendMessage(CMD_HOTLIST_AP_LOST, 0, 0, results);
+            sendMessage(CMD_HOTLIST_AP_LOST, id, 0, results);
         }
 
         @Override
@@ -427,8 +427,11 @@ public class WifiScanningServiceImpl extends IWifiScanner.Stub {
                         removeScanRequest((ClientInfo) msg.obj, msg.arg2);
                         break;
                     case WifiScanner.CMD_SET_HOTLIST:
-                        setHotlist(ci, msg.arg2, (WifiScanner.HotlistSettings) msg.obj);
-                        replySucceeded(msg);
+                        if (setHotlist(ci, msg.arg2, (WifiScanner.HotlistSettings) msg.obj)) {
+                            replySucceeded(msg);
+                        } else {
+                            replyFailed(msg, WifiScanner.REASON_INVALID_REQUEST, "bad request");
+                        }
                         break;
                     case WifiScanner.CMD_RESET_HOTLIST:
                         resetHotlist(ci, msg.arg2);
@@ -444,7 +447,8 @@ public class WifiScanningServiceImpl extends IWifiScanner.Stub {
                         configureWifiChange((WifiScanner.WifiChangeSettings) msg.obj);
                         break;
                     case CMD_SCAN_RESULTS_AVAILABLE: {
-                            ScanData[] results = WifiNative.getScanResults(/* flush = */ true);
+                            ScanData[] results = WifiNative.getScanResults(/* flush = */ true,
+                                    mScanResultFilter);
                             Collection<ClientInfo> clients = mClients.values();
                             for (ClientInfo ci2 : clients) {
                                 ci2.reportScanResults(results);
@@ -464,18 +468,20 @@ public class WifiScanningServiceImpl extends IWifiScanner.Stub {
                     case CMD_HOTLIST_AP_FOUND: {
                             ScanResult[] results = (ScanResult[])msg.obj;
                             if (DBG) localLog("Found " + results.length + " results");
-                            Collection<ClientInfo> clients = mClients.values();
-                            for (ClientInfo ci2 : clients) {
-                                ci2.reportHotlistResults(WifiScanner.CMD_AP_FOUND, results);
+                            ClientInfo ci2 = mHotlistClients.get(msg.arg1);
+                            if (ci2 != null) {
+                                ci2.reportHotlistResults(WifiScanner.CMD_AP_FOUND, msg.arg1,
+                                        results);
                             }
                         }
                         break;
                     case CMD_HOTLIST_AP_LOST: {
                             ScanResult[] results = (ScanResult[])msg.obj;
                             if (DBG) localLog("Lost " + results.length + " results");
-                            Collection<ClientInfo> clients = mClients.values();
-                            for (ClientInfo ci2 : clients) {
-                                ci2.reportHotlistResults(WifiScanner.CMD_AP_LOST, results);
+                            ClientInfo ci2 = mHotlistClients.get(msg.arg1);
+                            if (ci2 != null) {
+                                ci2.reportHotlistResults(WifiScanner.CMD_AP_LOST, msg.arg1,
+                                        results);
                             }
                         }
                         break;
@@ -789,57 +795,43 @@ public class WifiScanningServiceImpl extends IWifiScanner.Stub {
 
         HashMap<Integer, WifiScanner.HotlistSettings> mHotlistSettings =
                 new HashMap<Integer, WifiScanner.HotlistSettings>();
+        /* handler of each hotlist request, by the id WifiNative installed it under */
+        HashMap<Integer, Integer> mHotlistHandlers = new HashMap<Integer, Integer>();
 
-        void addHostlistSettings(WifiScanner.HotlistSettings settings, int handler) {
+        void addHostlistSettings(WifiScanner.HotlistSettings settings, int handler, int id) {
             mHotlistSettings.put(handler, settings);
+            mHotlistHandlers.put(id, handler);
         }
 
-        void removeHostlistSettings(int handler) {
+        /* returns the id of the request installed for handler, or -1 */
+        int removeHostlistSettings(int handler) {
             mHotlistSettings.remove(handler);
-        }
-
-        Collection<WifiScanner.HotlistSettings> getHotlistSettings() {
-            return mHotlistSettings.values();
-        }
-
-        void reportHotlistResults(int what, ScanResult[] results) {
-            Iterator<Map.Entry<Integer, WifiScanner.HotlistSettings>> it =
-                    mHotlistSettings.entrySet().iterator();
+            Iterator<Map.Entry<Integer, Integer>> it = mHotlistHandlers.entrySet().iterator();
             while (it.hasNext()) {
-                Map.Entry<Integer, WifiScanner.HotlistSettings> entry = it.next();
-                int handler = entry.getKey();
-                WifiScanner.HotlistSettings settings = entry.getValue();
-                int num_results = 0;
-                for (ScanResult result : results) {
-                    for (BssidInfo BssidInfo : settings.bssidInfos) {
-                        if (result.BSSID.equalsIgnoreCase(BssidInfo.bssid)) {
-                            num_results++;
-                            break;
-                        }
-                    }
+                Map.Entry<Integer, Integer> entry = it.next();
+                if (entry.getValue() == handler) {
+                    it.remove();
+                    return entry.getKey();
                 }
+            }
+            return -1;
+        }
 
-                if (num_results == 0) {
-                    // nothing to report
-                    return;
-                }
+        Collection<Integer> getHotlistHandlers() {
+            return mHotlistSettings.keySet();
+        }
 
-                ScanResult results2[] = new ScanResult[num_results];
-                int index = 0;
-                for (ScanResult result : results) {
-                    for (BssidInfo BssidInfo : settings.bssidInfos) {
-                        if (result.BSSID.equalsIgnoreCase(BssidInfo.bssid)) {
-                            results2[index] = result;
-                            index++;
-                        }
-                    }
-                }
+        /* the native side only reports the BSSIDs the request with this id asked for */
+        void reportHotlistResults(int what, int id, ScanResult[] results) {
+            Integer handler = mHotlistHandlers.get(id);
+            if (handler == null) {
+                return;
+            }
 
-                WifiScanner.ParcelableScanResults parcelableScanResults =
-                        new WifiScanner.ParcelableScanResults(results2);
+            WifiScanner.ParcelableScanResults parcelableScanResults =
+                    new WifiScanner.ParcelableScanResults(results);
 
-                mChannel.sendMessage(what, 0, handler, parcelableScanResults);
-            }
+            mChannel.sendMessage(what, 0, handler, parcelableScanResults);
         }
 
         HashSet<Integer> mSignificantWifiHandlers = new HashSet<Integer>();
@@ -881,8 +873,9 @@ public class WifiScanningServiceImpl extends IWifiScanner.Stub {
             mScanSettings.clear();
             resetBuckets();
 
-            mHotlistSettings.clear();
-            resetHotlist();
+            for (Integer handler : new ArrayList<Integer>(getHotlistHandlers())) {
+                resetHotlist(this, handler);
+            }
 
             for (Integer handler :  mSignificantWifiHandlers) {
                 untrackWifiChanges(this, handler);
@@ -1160,6 +1153,34 @@ public class WifiScanningServiceImpl extends IWifiScanner.Stub {
         }
     }
 
+    /*
+     * Drops the results on bands no client scans before WifiNative makes any object for them;
+     * clients still pick out their own channels. Null while any band may be wanted.
+     */
+    private WifiNative.ScanFilter mScanResultFilter;
+
+    /* the bands of all clients' scans, or null if that isn't narrower than all of them */
+    private WifiNative.ScanFilter computeScanResultFilter() {
+        int band = WifiScanner.WIFI_BAND_UNSPECIFIED;
+        for (ClientInfo ci : mClients.values()) {
+            for (ScanSettings settings : ci.getScanSettings()) {
+                if (settings.band != WifiScanner.WIFI_BAND_UNSPECIFIED) {
+                    band |= settings.band;
+                } else if (settings.channels != null) {
+                    band |= getBandFromChannels(settings.channels);
+                }
+            }
+        }
+
+        if (band == WifiScanner.WIFI_BAND_UNSPECIFIED
+                || band == WifiScanner.WIFI_BAND_BOTH_WITH_DFS) {
+            return null;
+        }
+        WifiNative.ScanFilter filter = new WifiNative.ScanFilter();
+        filter.band = band;
+        return filter;
+    }
+
     boolean resetBuckets() {
         SettingsComputer c = new SettingsComputer();
         Collection<ClientInfo> clients = mClients.values();
@@ -1190,6 +1211,9 @@ public class WifiScanningServiceImpl extends IWifiScanner.Stub {
 
         c.compressBuckets();
 
+        mScanResultFilter = computeScanResultFilter();
+        WifiNative.setFullScanResultFilter(mScanResultFilter);
+
         WifiNative.ScanSettings s = c.getComputedSettings();
         if (s.num_buckets == 0) {
             if (DBG) localLog("Stopping scan because there are no buckets");
@@ -1313,7 +1337,7 @@ public class WifiScanningServiceImpl extends IWifiScanner.Stub {
     }
 
     boolean reportScanResults() {
-        ScanData results[] = WifiNative.getScanResults(/* flush = */ true);
+        ScanData results[] = WifiNative.getScanResults(/* flush = */ true, mScanResultFilter);
         Collection<ClientInfo> clients = mClients.values();
         for (ClientInfo ci2 : clients) {
             ci2.reportScanResults(results);
@@ -1322,46 +1346,26 @@ public class WifiScanningServiceImpl extends IWifiScanner.Stub {
         return true;
     }
 
-    void resetHotlist() {
-        Collection<ClientInfo> clients = mClients.values();
-        int num_hotlist_ap = 0;
+    /* client of each hotlist request, by the id WifiNative installed it under */
+    private final HashMap<Integer, ClientInfo> mHotlistClients = new HashMap<Integer, ClientInfo>();
 
-        for (ClientInfo ci : clients) {
-            Collection<WifiScanner.HotlistSettings> c = ci.getHotlistSettings();
-            for (WifiScanner.HotlistSettings s : c) {
-                num_hotlist_ap +=  s.bssidInfos.length;
-            }
-        }
-
-        if (num_hotlist_ap == 0) {
-            WifiNative.resetHotlist();
-        } else {
-            BssidInfo bssidInfos[] = new BssidInfo[num_hotlist_ap];
-            int index = 0;
-            for (ClientInfo ci : clients) {
-                Collection<WifiScanner.HotlistSettings> settings = ci.getHotlistSettings();
-                for (WifiScanner.HotlistSettings s : settings) {
-                    for (int i = 0; i < s.bssidInfos.length; i++, index++) {
-                        bssidInfos[index] = s.bssidInfos[i];
-                    }
-                }
-            }
-
-            WifiScanner.HotlistSettings settings = new WifiScanner.HotlistSettings();
-            settings.bssidInfos = bssidInfos;
-            settings.apLostThreshold = 3;
-            WifiNative.setHotlist(settings, mStateMachine);
+    boolean setHotlist(ClientInfo ci, int handler, WifiScanner.HotlistSettings settings) {
+        resetHotlist(ci, handler);
+        int id = WifiNative.setHotlist(settings, mStateMachine);
+        if (id == -1) {
+            return false;
         }
-    }
-
-    void setHotlist(ClientInfo ci, int handler, WifiScanner.HotlistSettings settings) {
-        ci.addHostlistSettings(settings, handler);
-        resetHotlist();
+        ci.addHostlistSettings(settings, handler, id);
+        mHotlistClients.put(id, ci);
+        return true;
     }
 
     void resetHotlist(ClientInfo ci, int handler) {
-        ci.removeHostlistSettings(handler);
-        resetHotlist();
+        int id = ci.removeHostlistSettings(handler);
+        if (id != -1) {
+            mHotlistClients.remove(id);
+            WifiNative.resetHotlist(id);
+        }
     }
 
     WifiChangeStateMachine mWifiChangeStateMachine;
@@ -1552,6 +1552,9 @@ public final class WifiServiceImpl extends IWifiManager.Stub {
         pw.println();
         mWifiStateMachine.dump(fd, pw, args);
         pw.println();
+
+        pw.println("Native call stats:");
+        pw.println(WifiNative.getCallStats());
     }
 
     private class WifiLock extends DeathRecipient {
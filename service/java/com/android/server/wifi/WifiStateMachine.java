@@ -103,6 +103,7 @@ import android.telephony.TelephonyManager;
 import android.text.TextUtils;
 import android.util.Log;
 import android.util.LruCache;
+import android.util.SparseArray;
 
 import com.android.internal.R;
 import com.android.internal.app.IBatteryStats;
@@ -273,35 +274,32 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
     }
 
     @Override
-    public void onRssiThresholdBreached(byte curRssi) {
+    public void onRssiThresholdBreached(byte curRssi, int[] clients) {
         if (DBG) {
-            Log.e(TAG, "onRssiThresholdBreach event. Cur Rssi = " + curRssi);
+            Log.e(TAG, "onRssiThresholdBreach event. Cur Rssi = " + curRssi
+                    + " clients = " + Arrays.toString(clients));
         }
-        sendMessage(CMD_RSSI_THRESHOLD_BREACH, curRssi);
+        sendMessage(CMD_RSSI_THRESHOLD_BREACH, curRssi, 0, clients);
     }
 
-    public void processRssiThreshold(byte curRssi, int reason) {
+    public void processRssiThresholdBreach(byte curRssi, int[] clients) {
         if (curRssi == Byte.MAX_VALUE || curRssi == Byte.MIN_VALUE) {
-            Log.wtf(TAG, "processRssiThreshold: Invalid rssi " + curRssi);
+            Log.wtf(TAG, "processRssiThresholdBreach: Invalid rssi " + curRssi);
             return;
         }
-        for (int i = 0; i < mRssiRanges.length; i++) {
-            if (curRssi < mRssiRanges[i]) {
-                // Assume sorted values(ascending order) for rssi,
-                // bounded by high(127) and low(-128) at extremeties
-                byte maxRssi = mRssiRanges[i];
-                byte minRssi = mRssiRanges[i-1];
-                // This value of hw has to be believed as this value is averaged and has breached
-                // the rssi thresholds and raised event to host. This would be eggregious if this
-                // value is invalid
-                mWifiInfo.setRssi((int) curRssi);
+        // This value of hw has to be believed as this value is averaged and has breached
+        // the rssi thresholds and raised event to host. This would be eggregious if this
+        // value is invalid
+        mWifiInfo.setRssi((int) curRssi);
+        // Only the clients whose thresholds were crossed need to hear about it
+        for (int client : clients) {
+            if (client == RSSI_MONITOR_CLIENT_NETWORK_AGENT) {
                 updateCapabilities(getCurrentWifiConfiguration());
-                int ret = startRssiMonitoringOffload(maxRssi, minRssi);
-                Log.d(TAG, "Re-program RSSI thresholds for " + smToString(reason) +
-                        ": [" + minRssi + ", " + maxRssi + "], curRssi=" + curRssi + " ret=" + ret);
-                break;
             }
         }
+        int ret = mWifiNative.rearmRssiMonitor(curRssi);
+        Log.d(TAG, "Re-arm RSSI monitor: curRssi=" + curRssi + " clients="
+                + Arrays.toString(clients) + " ret=" + ret);
     }
     public void registerNetworkDisabled(int netId) {
         // Restart legacy PNO and autojoin offload if needed
@@ -578,6 +576,14 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
 
     private byte[] mRssiRanges;
 
+    // Clients of the native RSSI monitor, each with its own thresholds
+    static final int RSSI_MONITOR_CLIENT_NETWORK_AGENT = 0;
+
+    // MPDUs per second to a peer at which a TDLS session is set up natively, and below which
+    // it is torn down again
+    private static final int TDLS_AUTO_SETUP_MPDU_RATE = 200;
+    private static final int TDLS_AUTO_TEARDOWN_MPDU_RATE = 50;
+
     // Keep track of various statistics, for retrieval by System Apps, i.e. under @SystemApi
     // We should really persist that into the networkHistory.txt file, and read it back when
     // WifiStateMachine starts up
@@ -1869,6 +1875,11 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
         }
     }
 
+    // Keepalives the firmware sends for the current connection, by slot; moved over to the new
+    // next hop after a roam, and stopped all at once on disconnect
+    private final SparseArray<WifiNative.OffloadedPacket> mOffloadedPackets =
+            new SparseArray<WifiNative.OffloadedPacket>();
+
     int startWifiIPPacketOffload(int slot, KeepalivePacketData packetData, int intervalSeconds) {
         int ret = mWifiNative.startSendingOffloadedPacket(slot, packetData, intervalSeconds * 1000);
         if (ret != 0) {
@@ -1876,11 +1887,19 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
                     "): hardware error " + ret);
             return ConnectivityManager.PacketKeepalive.ERROR_HARDWARE_ERROR;
         } else {
+            WifiNative.OffloadedPacket packet = new WifiNative.OffloadedPacket();
+            packet.slot = slot;
+            packet.dst_mac = packetData.dstMac;
+            packet.data = packetData.data;
+            packet.period_ms = intervalSeconds * 1000;
+            packet.dst_address = packetData.dstAddress;
+            mOffloadedPackets.put(slot, packet);
             return ConnectivityManager.PacketKeepalive.SUCCESS;
         }
     }
 
     int stopWifiIPPacketOffload(int slot) {
+        mOffloadedPackets.remove(slot);
         int ret = mWifiNative.stopSendingOffloadedPacket(slot);
         if (ret != 0) {
             loge("stopWifiIPPacketOffload(" + slot + "): hardware error " + ret);
@@ -1890,8 +1909,69 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
         }
     }
 
-    int startRssiMonitoringOffload(byte maxRssi, byte minRssi) {
-        return mWifiNative.startRssiMonitoring(maxRssi, minRssi, WifiStateMachine.this);
+    /** Returns the MAC address of the next hop to dstAddress, or null if it isn't known */
+    private byte[] nextHopMacAddress(InetAddress dstAddress) {
+        try {
+            InetAddress gateway = RouteInfo.selectBestRoute(
+                    mLinkProperties.getRoutes(), dstAddress).getGateway();
+            String dstMacStr = macAddressFromRoute(gateway.getHostAddress());
+            return macAddressFromString(dstMacStr);
+        } catch (NullPointerException|IllegalArgumentException e) {
+            loge("Can't find MAC address for next hop to " + dstAddress);
+            return null;
+        }
+    }
+
+    /**
+     * Points the offloaded keepalives at the next hop as it is after a roam. Only the ones
+     * whose next hop changed are programmed again; ones that can't be kept are reported.
+     */
+    private void reprogramPacketKeepalives() {
+        int count = mOffloadedPackets.size();
+        if (count == 0) {
+            return;
+        }
+
+        ArrayList<WifiNative.OffloadedPacket> packets = new ArrayList<>();
+        for (int i = count - 1; i >= 0; i--) {
+            WifiNative.OffloadedPacket packet = mOffloadedPackets.valueAt(i);
+            byte[] dstMac = nextHopMacAddress(packet.dst_address);
+            if (dstMac == null) {
+                mOffloadedPackets.removeAt(i);
+                if (mNetworkAgent != null) mNetworkAgent.onPacketKeepaliveEvent(packet.slot,
+                        ConnectivityManager.PacketKeepalive.ERROR_INVALID_IP_ADDRESS);
+                continue;
+            }
+            packet.dst_mac = dstMac;
+            packets.add(packet);
+        }
+
+        int[] results = mWifiNative.setOffloadedPackets(
+                packets.toArray(new WifiNative.OffloadedPacket[packets.size()]));
+        for (int i = 0; i < packets.size(); i++) {
+            if (results == null || results[i] != 0) {
+                int slot = packets.get(i).slot;
+                loge("reprogramPacketKeepalives: slot " + slot + " hardware error "
+                        + (results != null ? results[i] : -1));
+                mOffloadedPackets.remove(slot);
+                if (mNetworkAgent != null) mNetworkAgent.onPacketKeepaliveEvent(slot,
+                        ConnectivityManager.PacketKeepalive.ERROR_HARDWARE_ERROR);
+            }
+        }
+    }
+
+    /** Stops every offloaded keepalive at once, for when the link goes away */
+    private void stopPacketKeepalives() {
+        if (mOffloadedPackets.size() == 0) {
+            return;
+        }
+        mOffloadedPackets.clear();
+        mWifiNative.stopAllSendingOffloadedPackets();
+    }
+
+    int startRssiMonitoringOffload(byte[] thresholds, byte curRssi) {
+        return mWifiNative.setRssiThresholds(RSSI_MONITOR_CLIENT_NETWORK_AGENT, thresholds,
+                curRssi, WifiStateMachine.this);
     }
 
     int stopRssiMonitoringOffload() {
@@ -2634,6 +2714,13 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
         pw.println("mDriverSetCountryCode " + mDriverSetCountryCode);
         pw.println("mConnectedModeGScanOffloadStarted " + mConnectedModeGScanOffloadStarted);
         pw.println("mGScanPeriodMilli " + mGScanPeriodMilli);
+        int[] offloadStats = WifiNative.getOffloadedPacketStats();
+        if (offloadStats != null) {
+            pw.println("Packet keepalives: " + offloadStats[0] + " of " + offloadStats[1]
+                    + " slots in use, " + offloadStats[2] + " started, " + offloadStats[3]
+                    + " stopped, " + offloadStats[4] + " unchanged, " + offloadStats[5]
+                    + " refused");
+        }
         if (mWhiteListedSsids != null && mWhiteListedSsids.length > 0) {
             pw.println("SSID whitelist :" );
             for (int i=0; i < mWhiteListedSsids.length; i++) {
@@ -3297,11 +3384,8 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
         return true;
     }
 
-    // In associated more, lazy roam will be looking for 5GHz roam candidate
-    private boolean configureLazyRoam() {
-        boolean status;
-        if (!useHalBasedAutoJoinOffload()) return false;
-
+    // Lazy roam parameters, for the firmware and for ranking roam candidates natively
+    private WifiNative.WifiLazyRoamParams buildLazyRoamParams() {
         WifiNative.WifiLazyRoamParams params = mWifiNative.new WifiLazyRoamParams();
         params.A_band_boost_threshold = mWifiConfigStore.bandPreferenceBoostThreshold5.get();
         params.A_band_penalty_threshold = mWifiConfigStore.bandPreferencePenaltyThreshold5.get();
@@ -3310,6 +3394,15 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
         params.A_band_max_boost = 65;
         params.lazy_roam_hysteresis = 25;
         params.alert_roam_rssi_trigger = -75;
+        return params;
+    }
+
+    // In associated more, lazy roam will be looking for 5GHz roam candidate
+    private boolean configureLazyRoam() {
+        boolean status;
+        if (!useHalBasedAutoJoinOffload()) return false;
+
+        WifiNative.WifiLazyRoamParams params = buildLazyRoamParams();
 
         if (DBG) {
             Log.e(TAG, "configureLazyRoam " + params.toString());
@@ -3444,6 +3537,9 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
                 sb.append("[").append(network.SSID).append(" auth=").append(network.auth);
                 sb.append(" flags=");
                 sb.append(network.flags).append(" rssi").append(network.rssi_threshold);
+                if (network.dropped) {
+                    sb.append(" dropped");
+                }
                 sb.append("] ");
 
             }
@@ -3553,6 +3649,19 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
         return true;
     }
 
+    /*
+     * Auto TDLS decides from the link layer stats polled with the RSSI, so it only runs while
+     * the screen is on; turning it off tears down the sessions it set up, rather than leave
+     * them up with nothing to notice their traffic stopped.
+     */
+    private void updateTdlsAuto() {
+        if (mScreenOn && getCurrentState() == mConnectedState) {
+            WifiNative.setTdlsAuto(true, TDLS_AUTO_SETUP_MPDU_RATE, TDLS_AUTO_TEARDOWN_MPDU_RATE);
+        } else {
+            WifiNative.setTdlsAuto(false, 0, 0);
+        }
+    }
+
     private void handleScreenStateChanged(boolean screenOn) {
         mScreenOn = screenOn;
         if (PDBG) {
@@ -3562,6 +3671,9 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
                     + " suppState:" + mSupplicantStateTracker.getSupplicantStateName());
         }
         enableRssiPolling(screenOn);
+        if (getCurrentState() == mConnectedState) {
+            updateTdlsAuto();
+        }
         if (mUserWantsSuspendOpt.get()) {
             if (screenOn) {
                 sendMessage(CMD_SET_SUSPEND_OPT_ENABLED, 0, 0);
@@ -6034,6 +6146,10 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
                     maybeRegisterNetworkFactory(); // Make sure our NetworkFactory is registered
                     noteScanEnd();
                     setScanResults();
+                    synchronized (mScanResultCache) {
+                        // BSSIDs blacklisted on association rejection may be picked again
+                        mWifiConfigStore.expireBssidBlacklist();
+                    }
                     if (mIsFullScanOngoing || mSendScanResultsBroadcast) {
                         /* Just updated results from full scan, let apps know about this */
                         boolean scanSucceeded = message.what == WifiMonitor.SCAN_RESULTS_EVENT;
@@ -8048,9 +8164,8 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
                         mWifiInfo.getRssi());
                 return;
             }
-            int [] rssiVals = Arrays.copyOf(thresholds, thresholds.length + 2);
-            rssiVals[rssiVals.length - 2] = Byte.MIN_VALUE;
-            rssiVals[rssiVals.length - 1] = Byte.MAX_VALUE;
+            // The native RSSI monitor keeps the thresholds sorted and bounds them itself
+            int [] rssiVals = Arrays.copyOf(thresholds, thresholds.length);
             Arrays.sort(rssiVals);
             byte[] rssiRange = new byte[rssiVals.length];
             for (int i = 0; i < rssiVals.length; i++) {
@@ -8068,7 +8183,7 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
             // TODO: Do we quash rssi values in this sorted array which are very close?
             mRssiRanges = rssiRange;
             WifiStateMachine.this.sendMessage(CMD_START_RSSI_MONITORING_OFFLOAD,
-                    mWifiInfo.getRssi());
+                    mWifiInfo.getRssi(), 0, rssiRange);
         }
 
         @Override
@@ -8241,6 +8356,8 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
                 mIpReachabilityMonitor.stop();
                 mIpReachabilityMonitor = null;
             }
+            stopPacketKeepalives();
+            WifiNative.setTdlsAuto(false, 0, 0);
 
             // This is handled by receiving a NETWORK_DISCONNECTION_EVENT in ConnectModeState
             // Bug: 15347363
@@ -8576,10 +8693,15 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
                         sendNetworkStateChangeBroadcast(mLastBssid);
                     }
                     break;
-                case CMD_START_RSSI_MONITORING_OFFLOAD:
-                case CMD_RSSI_THRESHOLD_BREACH:
+                case CMD_START_RSSI_MONITORING_OFFLOAD: {
                     byte currRssi = (byte) message.arg1;
-                    processRssiThreshold(currRssi, message.what);
+                    int ret = startRssiMonitoringOffload((byte[]) message.obj, currRssi);
+                    Log.d(TAG, "Set RSSI thresholds " + Arrays.toString((byte[]) message.obj)
+                            + ", curRssi=" + currRssi + " ret=" + ret);
+                    break;
+                }
+                case CMD_RSSI_THRESHOLD_BREACH:
+                    processRssiThresholdBreach((byte) message.arg1, (int[]) message.obj);
                     break;
                 case CMD_STOP_RSSI_MONITORING_OFFLOAD:
                     stopRssiMonitoringOffload();
@@ -8943,6 +9065,13 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
                         + mWifiConfigStore.enableHalBasedPno.get()
                         + " mHalBasedPnoEnableInDevSettings " + mHalBasedPnoEnableInDevSettings);
             }
+            // Roam candidates are ranked natively by the same parameters with or without
+            // lazy roam offload
+            WifiNative.setRoamScorerParams(buildLazyRoamParams());
+            // After a roam, keepalives may have to go to a different next hop
+            reprogramPacketKeepalives();
+            // Peers on the new link get TDLS sessions by their traffic, as link stats are polled
+            updateTdlsAuto();
             if (mScreenOn
                     && getEnableAutoJoinWhenAssociated()) {
                 if (useHalBasedAutoJoinOffload()) {
@@ -9217,14 +9346,8 @@ public class WifiStateMachine extends StateMachine implements WifiNative.WifiPno
                         int slot = message.arg1;
                         int intervalSeconds = message.arg2;
                         KeepalivePacketData pkt = (KeepalivePacketData) message.obj;
-                        byte[] dstMac;
-                        try {
-                            InetAddress gateway = RouteInfo.selectBestRoute(
-                                    mLinkProperties.getRoutes(), pkt.dstAddress).getGateway();
-                            String dstMacStr = macAddressFromRoute(gateway.getHostAddress());
-                            dstMac = macAddressFromString(dstMacStr);
-                        } catch (NullPointerException|IllegalArgumentException e) {
-                            loge("Can't find MAC address for next hop to " + pkt.dstAddress);
+                        byte[] dstMac = nextHopMacAddress(pkt.dstAddress);
+                        if (dstMac == null) {
                             mNetworkAgent.onPacketKeepaliveEvent(slot,
                                     ConnectivityManager.PacketKeepalive.ERROR_INVALID_IP_ADDRESS);
                             break;
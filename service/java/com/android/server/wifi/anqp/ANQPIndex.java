@@ -0,0 +1,226 @@
+package com.android.server.wifi.anqp;
+
+import com.android.server.wifi.WifiNative;
+
+import java.net.ProtocolException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.Charset;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * An ANQP response payload indexed natively into a flat table of element and string
+ * offsets. Element objects are only built, by the same constructors ANQPFactory uses, when
+ * they are asked for; domain names, NAI realms, roaming consortium OIs and OSU servers are
+ * read straight out of the payload.
+ */
+public class ANQPIndex {
+    // Layout of the native index; keep these consistent with wifi_anqp.h
+    private static final int INDEX_ELEMENT_COUNT = 0;
+    private static final int INDEX_ENTRY_COUNT = 1;
+    private static final int INDEX_HEADER_LEN = 2;
+
+    private static final int ELEMENT_ID = 0;
+    private static final int ELEMENT_HS20_SUBTYPE = 1;
+    private static final int ELEMENT_OFFSET = 2;
+    private static final int ELEMENT_LENGTH = 3;
+    private static final int ELEMENT_FIRST_ENTRY = 4;
+    private static final int ELEMENT_ENTRY_COUNT = 5;
+    private static final int ELEMENT_RECORD_LEN = 6;
+
+    private static final int ENTRY_KIND = 0;
+    private static final int ENTRY_OFFSET = 1;
+    private static final int ENTRY_LENGTH = 2;
+    private static final int ENTRY_RECORD_LEN = 3;
+
+    private static final int ENTRY_DOMAIN = 1;
+    private static final int ENTRY_REALM = 2;
+    private static final int ENTRY_REALM_UTF8 = 3;
+    private static final int ENTRY_OI = 4;
+    private static final int ENTRY_NAME = 5;
+    private static final int ENTRY_OSU_SSID = 6;
+    private static final int ENTRY_OSU_PROVIDER = 7;
+    private static final int ENTRY_OSU_SERVER = 8;
+
+    private final byte[] mPayload;
+    private final int[] mIndex;
+    private final int mElementCount;
+    private final int mEntryBase;
+    private final ANQPElement[] mElements;
+    private final boolean[] mBuilt;
+
+    private ANQPIndex(byte[] payload, int[] index) {
+        mPayload = payload;
+        mIndex = index;
+        mElementCount = index[INDEX_ELEMENT_COUNT];
+        mEntryBase = INDEX_HEADER_LEN + mElementCount * ELEMENT_RECORD_LEN;
+        mElements = new ANQPElement[mElementCount];
+        mBuilt = new boolean[mElementCount];
+    }
+
+    /**
+     * Indexes a payload laid out as for ANQPFactory.parsePayload. The payload is kept, not
+     * copied, and must not be modified afterwards.
+     */
+    public static ANQPIndex parse(byte[] payload) throws ProtocolException {
+        int[] index = WifiNative.indexAnqpPayload(payload);
+        if (index == null) {
+            throw new ProtocolException("Malformed ANQP payload of " + payload.length + " octets");
+        }
+        return new ANQPIndex(payload, index);
+    }
+
+    public int getElementCount() {
+        return mElementCount;
+    }
+
+    public Constants.ANQPElementType getElementType(int n) {
+        int record = elementRecord(n);
+        int subtype = mIndex[record + ELEMENT_HS20_SUBTYPE];
+        return subtype >= 0 ? Constants.mapHS20Element(subtype) :
+                Constants.mapANQPElement(mIndex[record + ELEMENT_ID]);
+    }
+
+    /**
+     * Builds the nth element on first use. Like ANQPFactory, returns null for vendor specific
+     * elements that aren't HS2.0 ones.
+     */
+    public ANQPElement getElement(int n) throws ProtocolException {
+        if (!mBuilt[n]) {
+            int record = elementRecord(n);
+            int offset = mIndex[record + ELEMENT_OFFSET];
+            int length = mIndex[record + ELEMENT_LENGTH];
+            ByteBuffer payload = ByteBuffer.wrap(mPayload, offset, length)
+                    .order(ByteOrder.LITTLE_ENDIAN);
+            int subtype = mIndex[record + ELEMENT_HS20_SUBTYPE];
+            if (subtype >= 0) {
+                mElements[n] = ANQPFactory.buildHS20Element(
+                        Constants.mapHS20Element(subtype), payload);
+            } else {
+                mElements[n] = ANQPFactory.buildElement(payload,
+                        Constants.mapANQPElement(mIndex[record + ELEMENT_ID]), length);
+            }
+            mBuilt[n] = true;
+        }
+        return mElements[n];
+    }
+
+    /**
+     * Builds every element; the result is the same list ANQPFactory.parsePayload returns
+     * for the payload.
+     */
+    public List<ANQPElement> getElements() throws ProtocolException {
+        List<ANQPElement> elements = new ArrayList<ANQPElement>(mElementCount);
+        for (int n = 0; n < mElementCount; n++) {
+            elements.add(getElement(n));
+        }
+        return elements;
+    }
+
+    /** Domain names, as DomainNameElement.getDomains would return them. */
+    public List<String> getDomains() {
+        List<String> domains = new ArrayList<String>();
+        for (int e = mEntryBase; e < mIndex.length; e += ENTRY_RECORD_LEN) {
+            if (mIndex[e + ENTRY_KIND] == ENTRY_DOMAIN) {
+                domains.add(getString(e, 0, StandardCharsets.ISO_8859_1));
+            }
+        }
+        return domains;
+    }
+
+    /** Realms of all NAI realm data, in order, as NAIRealmData.getRealms would split them. */
+    public List<String> getRealms() {
+        List<String> realms = new ArrayList<String>();
+        for (int e = mEntryBase; e < mIndex.length; e += ENTRY_RECORD_LEN) {
+            int kind = mIndex[e + ENTRY_KIND];
+            if (kind == ENTRY_REALM) {
+                realms.add(getString(e, 0, StandardCharsets.US_ASCII));
+            } else if (kind == ENTRY_REALM_UTF8) {
+                realms.add(getString(e, 0, StandardCharsets.UTF_8));
+            }
+        }
+        return realms;
+    }
+
+    /** Roaming consortium OIs, as RoamingConsortiumElement.getOIs would return them. */
+    public List<Long> getRoamingConsortiums() {
+        List<Long> ois = new ArrayList<Long>();
+        for (int e = mEntryBase; e < mIndex.length; e += ENTRY_RECORD_LEN) {
+            if (mIndex[e + ENTRY_KIND] == ENTRY_OI) {
+                long value = 0;
+                int offset = mIndex[e + ENTRY_OFFSET];
+                for (int i = 0; i < mIndex[e + ENTRY_LENGTH]; i++) {
+                    value = (value << Byte.SIZE) | (mPayload[offset + i] & Constants.BYTE_MASK);
+                }
+                ois.add(value);
+            }
+        }
+        return ois;
+    }
+
+    /** Text of the venue or operator friendly names held by the nth element. */
+    public List<String> getNames(int n) {
+        int record = elementRecord(n);
+        int first = mIndex[record + ELEMENT_FIRST_ENTRY];
+        int count = mIndex[record + ELEMENT_ENTRY_COUNT];
+        List<String> names = new ArrayList<String>();
+        for (int i = first; i < first + count; i++) {
+            int e = mEntryBase + i * ENTRY_RECORD_LEN;
+            if (mIndex[e + ENTRY_KIND] == ENTRY_NAME) {
+                names.add(getString(e, 3, StandardCharsets.UTF_8));     // past the language
+            }
+        }
+        return names;
+    }
+
+    /** SSID of the OSU providers list, or null if there is none. */
+    public String getOsuSsid() {
+        for (int e = mEntryBase; e < mIndex.length; e += ENTRY_RECORD_LEN) {
+            if (mIndex[e + ENTRY_KIND] == ENTRY_OSU_SSID) {
+                return getString(e, 0, StandardCharsets.UTF_8);
+            }
+        }
+        return null;
+    }
+
+    /** Server URIs of the OSU providers, in order, as OSUProvider.getOSUServer returns them. */
+    public List<String> getOsuServerUris() {
+        List<String> uris = new ArrayList<String>();
+        for (int e = mEntryBase; e < mIndex.length; e += ENTRY_RECORD_LEN) {
+            if (mIndex[e + ENTRY_KIND] == ENTRY_OSU_SERVER) {
+                uris.add(getString(e, 0, StandardCharsets.UTF_8));
+            }
+        }
+        return uris;
+    }
+
+    /**
+     * The OSU providers, each built on its own out of its slice of the payload; the list is
+     * the one HSOsuProvidersElement.getProviders would return.
+     */
+    public List<OSUProvider> getOsuProviders() throws ProtocolException {
+        List<OSUProvider> providers = new ArrayList<OSUProvider>();
+        for (int e = mEntryBase; e < mIndex.length; e += ENTRY_RECORD_LEN) {
+            if (mIndex[e + ENTRY_KIND] == ENTRY_OSU_PROVIDER) {
+                providers.add(new OSUProvider(ByteBuffer.wrap(mPayload,
+                        mIndex[e + ENTRY_OFFSET], mIndex[e + ENTRY_LENGTH])
+                        .order(ByteOrder.LITTLE_ENDIAN)));
+            }
+        }
+        return providers;
+    }
+
+    private int elementRecord(int n) {
+        if (n < 0 || n >= mElementCount) {
+            throw new IndexOutOfBoundsException("No element " + n + " of " + mElementCount);
+        }
+        return INDEX_HEADER_LEN + n * ELEMENT_RECORD_LEN;
+    }
+
+    private String getString(int entry, int skip, Charset charset) {
+        return new String(mPayload, mIndex[entry + ENTRY_OFFSET] + skip,
+                mIndex[entry + ENTRY_LENGTH] - skip, charset);
+    }
+}
@@ -2,13 +2,18 @@ package com.android.server.wifi.anqp;
 
 import java.io.BufferedInputStream;
 import java.io.BufferedOutputStream;
+import java.io.DataInputStream;
 import java.io.EOFException;
+import java.io.File;
+import java.io.FileInputStream;
 import java.io.IOException;
 import java.io.InputStream;
 import java.net.InetAddress;
+import java.net.ProtocolException;
 import java.net.Socket;
 import java.nio.ByteBuffer;
 import java.nio.ByteOrder;
+import java.util.ArrayList;
 import java.util.Arrays;
 import java.util.HashSet;
 import java.util.List;
@@ -71,7 +76,10 @@ public class TestDriver {
         ByteBuffer payload = getResponse(in);
 
         HSOsuProvidersElement osuProvidersElement = null;
+        byte[] payloadOctets = new byte[payload.remaining()];
+        payload.duplicate().get(payloadOctets);
         List<ANQPElement> anqpResult = ANQPFactory.parsePayload(payload);
+        checkIndex(payloadOctets, anqpResult);
         for ( ANQPElement element : anqpResult ) {
             System.out.println( element );
             if (element.getID() == Constants.ANQPElementType.HSOSUProviders) {
@@ -134,6 +142,146 @@ public class TestDriver {
         System.out.println("Home realm query: " + anqpResult );
     }
 
+    /**
+     * The native index must produce exactly what ANQPFactory.parsePayload did for the payload.
+     */
+    private static void checkIndex(byte[] payload, List<ANQPElement> expected)
+            throws ProtocolException {
+        List<ANQPElement> indexed = ANQPIndex.parse(payload).getElements();
+        if (!expected.toString().equals(indexed.toString())) {
+            System.out.println(" ### ANQP index mismatch: " + indexed + " vs " + expected);
+        } else {
+            System.out.println(" ### ANQP index matches " + expected.size() + " elements");
+        }
+    }
+
+    /**
+     * Checks the native index against ANQPFactory.parsePayload for every payload in dir, such
+     * as service/tests/jni/corpus/anqp: both must reject a payload or build the same elements,
+     * and what the index reads straight out of the payload must be what the elements hold.
+     * Payloads in files named bad_* must be rejected. Returns the number that failed.
+     */
+    public static int checkCorpus(File dir) throws IOException {
+        File[] files = dir.listFiles();
+        if (files == null) {
+            throw new IOException("No corpus in " + dir);
+        }
+        Arrays.sort(files);
+
+        int failures = 0;
+        for (File file : files) {
+            byte[] payload = new byte[(int) file.length()];
+            DataInputStream in = new DataInputStream(new FileInputStream(file));
+            try {
+                in.readFully(payload);
+            } finally {
+                in.close();
+            }
+
+            List<ANQPElement> expected = null;
+            try {
+                expected = ANQPFactory.parsePayload(ByteBuffer.wrap(payload));
+            } catch (Exception e) {
+                // rejected
+            }
+            ANQPIndex index = null;
+            List<ANQPElement> indexed = null;
+            try {
+                index = ANQPIndex.parse(payload);
+                indexed = index.getElements();
+            } catch (Exception e) {
+                // rejected
+            }
+
+            String problem = null;
+            if ((expected == null) != (indexed == null)) {
+                problem = expected == null ? "only the index accepts it" :
+                        "only parsePayload accepts it";
+            } else if (expected != null && file.getName().startsWith("bad_")) {
+                problem = "accepted";
+            } else if (expected != null) {
+                problem = compareIndex(expected, index, indexed);
+            }
+
+            if (problem != null) {
+                System.out.println(" ### " + file.getName() + ": " + problem);
+                failures++;
+            } else {
+                System.out.println(" ### " + file.getName() + ": ok, " +
+                        (expected == null ? "rejected" : expected.size() + " elements"));
+            }
+        }
+        return failures;
+    }
+
+    private static String compareIndex(List<ANQPElement> expected, ANQPIndex index,
+            List<ANQPElement> indexed) throws ProtocolException {
+        if (!expected.toString().equals(indexed.toString())) {
+            return "elements " + indexed + " vs " + expected;
+        }
+
+        List<String> domains = new ArrayList<>();
+        List<String> realms = new ArrayList<>();
+        List<Long> ois = new ArrayList<>();
+        String osuSsid = null;
+        List<String> osuServers = new ArrayList<>();
+        List<OSUProvider> osuProviders = new ArrayList<>();
+        for (int n = 0; n < expected.size(); n++) {
+            ANQPElement element = expected.get(n);
+            List<I18Name> names = null;
+            if (element instanceof DomainNameElement) {
+                domains.addAll(((DomainNameElement) element).getDomains());
+            } else if (element instanceof NAIRealmElement) {
+                for (NAIRealmData data : ((NAIRealmElement) element).getRealmData()) {
+                    realms.addAll(data.getRealms());
+                }
+            } else if (element instanceof RoamingConsortiumElement) {
+                ois.addAll(((RoamingConsortiumElement) element).getOIs());
+            } else if (element instanceof HSOsuProvidersElement) {
+                HSOsuProvidersElement osu = (HSOsuProvidersElement) element;
+                osuSsid = osu.getSSID();
+                for (OSUProvider provider : osu.getProviders()) {
+                    osuServers.add(provider.getOSUServer());
+                    osuProviders.add(provider);
+                }
+            } else if (element instanceof VenueNameElement) {
+                names = ((VenueNameElement) element).getNames();
+            } else if (element instanceof HSFriendlyNameElement) {
+                names = ((HSFriendlyNameElement) element).getNames();
+            }
+
+            if (names != null) {
+                List<String> texts = new ArrayList<>();
+                for (I18Name name : names) {
+                    texts.add(name.getText());
+                }
+                if (!texts.equals(index.getNames(n))) {
+                    return "names of element " + n + " " + index.getNames(n) + " vs " + texts;
+                }
+            }
+        }
+
+        if (!domains.equals(index.getDomains())) {
+            return "domains " + index.getDomains() + " vs " + domains;
+        }
+        if (!realms.equals(index.getRealms())) {
+            return "realms " + index.getRealms() + " vs " + realms;
+        }
+        if (!ois.equals(index.getRoamingConsortiums())) {
+            return "OIs " + index.getRoamingConsortiums() + " vs " + ois;
+        }
+        if (osuSsid == null ? index.getOsuSsid() != null : !osuSsid.equals(index.getOsuSsid())) {
+            return "OSU SSID " + index.getOsuSsid() + " vs " + osuSsid;
+        }
+        if (!osuServers.equals(index.getOsuServerUris())) {
+            return "OSU servers " + index.getOsuServerUris() + " vs " + osuServers;
+        }
+        if (!osuProviders.toString().equals(index.getOsuProviders().toString())) {
+            return "OSU providers " + index.getOsuProviders() + " vs " + osuProviders;
+        }
+        return null;
+    }
+
     private static ByteBuffer getResponse(InputStream in) throws IOException {
         ByteBuffer lengthBuffer = read( in, 2 );
         int length = lengthBuffer.getShort() & Constants.SHORT_MASK;
@@ -163,6 +311,9 @@ public class TestDriver {
     }
 
     public static void main(String[] args) throws IOException {
+        if (args.length == 2 && args[0].equals("--check-corpus")) {
+            System.exit(checkCorpus(new File(args[1])) == 0 ? 0 : 1);
+        }
         runTest();
     }
 }
@@ -3,6 +3,7 @@ package com.android.server.wifi.hotspot2;
 import android.net.wifi.ScanResult;
 import android.util.Log;
 
+import com.android.server.wifi.WifiNative;
 import com.android.server.wifi.anqp.ANQPElement;
 import com.android.server.wifi.anqp.Constants;
 import com.android.server.wifi.anqp.VenueNameElement;
@@ -235,34 +236,7 @@ public class NetworkDetail {
                         break;
                     case EID_RoamingConsortium:
                         anqpOICount = data.get() & Constants.BYTE_MASK;
-
-                        int oi12Length = data.get() & Constants.BYTE_MASK;
-                        int oi1Length = oi12Length & Constants.NIBBLE_MASK;
-                        int oi2Length = (oi12Length >>> 4) & Constants.NIBBLE_MASK;
-                        int oi3Length = elementLength - 2 - oi1Length - oi2Length;
-                        int oiCount = 0;
-                        if (oi1Length > 0) {
-                            oiCount++;
-                            if (oi2Length > 0) {
-                                oiCount++;
-                                if (oi3Length > 0) {
-                                    oiCount++;
-                                }
-                            }
-                        }
-                        roamingConsortiums = new long[oiCount];
-                        if (oi1Length > 0 && roamingConsortiums.length > 0) {
-                            roamingConsortiums[0] =
-                                    getInteger(data, ByteOrder.BIG_ENDIAN, oi1Length);
-                        }
-                        if (oi2Length > 0 && roamingConsortiums.length > 1) {
-                            roamingConsortiums[1] =
-                                    getInteger(data, ByteOrder.BIG_ENDIAN, oi2Length);
-                        }
-                        if (oi3Length > 0 && roamingConsortiums.length > 2) {
-                            roamingConsortiums[2] =
-                                    getInteger(data, ByteOrder.BIG_ENDIAN, oi3Length);
-                        }
+                        roamingConsortiums = getRoamingConsortiums(data, elementLength);
                         break;
                     case EID_VSA:
                         element = getAndAdvancePayload(data, elementLength);
@@ -369,39 +343,184 @@ public class NetworkDetail {
         //set up channel info
         mPrimaryFreq = freq;
 
+        int[] channelInfo = getChannelInfo(freq, secondChanelOffset, channelMode,
+                centerFreqIndex1, centerFreqIndex2);
+        mChannelWidth = channelInfo[0];
+        mCenterfreq0 = channelInfo[1];
+        mCenterfreq1 = channelInfo[2];
+        m80211McRTTResponder = RTTResponder;
+        if (VDBG) {
+            Log.d(TAG, mSSID + "ChannelWidth is: " + mChannelWidth + " PrimaryFreq: " + mPrimaryFreq +
+                    " mCenterfreq0: " + mCenterfreq0 + " mCenterfreq1: " + mCenterfreq1 +
+                    (m80211McRTTResponder ? "Support RTT reponder" : "Do not support RTT responder"));
+        }
+    }
+
+    /**
+     * Builds the detail of a full scan result from the IE summary the native side made of its
+     * IEs (see WifiNative.IE_SUMMARY_*), instead of walking the IEs again. Only the elements
+     * the summary leaves out are read, straight from result.informationElements: the venue
+     * and HESSID of Interworking, Roaming Consortium and Extended Capabilities.
+     */
+    public NetworkDetail(ScanResult result, int summary[]) {
+        int flags = summary[WifiNative.IE_SUMMARY_FLAGS];
+
+        mSSID = result.SSID;
+        mBSSID = Utils.parseMac(result.BSSID);
+
+        mStationCount = summary[WifiNative.IE_SUMMARY_STATION_COUNT];
+        mChannelUtilization = summary[WifiNative.IE_SUMMARY_CHANNEL_UTILIZATION];
+        mCapacity = summary[WifiNative.IE_SUMMARY_AVAILABLE_CAPACITY];
+
+        if ((flags & WifiNative.IE_SUMMARY_HAS_INTERWORKING) != 0) {
+            mAnt = Ant.values()[summary[WifiNative.IE_SUMMARY_ACCESS_NETWORK_TYPE]];
+        } else {
+            mAnt = null;
+        }
+        mInternet = (flags & WifiNative.IE_SUMMARY_INTERNET) != 0;
+
+        if ((flags & WifiNative.IE_SUMMARY_HAS_HS20) != 0) {
+            switch (summary[WifiNative.IE_SUMMARY_HS20_RELEASE]) {
+                case 0:
+                    mHSRelease = HSRelease.R1;
+                    break;
+                case 1:
+                    mHSRelease = HSRelease.R2;
+                    break;
+                default:
+                    mHSRelease = HSRelease.Unknown;
+                    break;
+            }
+        } else {
+            mHSRelease = null;
+        }
+        mAnqpDomainID = summary[WifiNative.IE_SUMMARY_ANQP_DOMAIN_ID];
+
+        VenueNameElement.VenueGroup venueGroup = null;
+        VenueNameElement.VenueType venueType = null;
+        long hessid = 0L;
+        int anqpOICount = 0;
+        long[] roamingConsortiums = null;
+        Long extendedCapabilities = null;
+
+        ScanResult.InformationElement[] elements = result.informationElements;
+        for (int n = 0; elements != null && n < elements.length; n++) {
+            int elementLength = elements[n].bytes.length;
+            ByteBuffer data = ByteBuffer.wrap(elements[n].bytes).order(ByteOrder.LITTLE_ENDIAN);
+            try {
+                switch (elements[n].id) {
+                    case EID_Interworking:
+                        data.get();
+                        if (elementLength == 3 || elementLength == 9) {
+                            try {
+                                ByteBuffer vinfo = data.duplicate();
+                                vinfo.limit(vinfo.position() + 2);
+                                VenueNameElement vne = new VenueNameElement(
+                                        Constants.ANQPElementType.ANQPVenueName, vinfo);
+                                venueGroup = vne.getGroup();
+                                venueType = vne.getType();
+                                data.getShort();
+                            } catch (ProtocolException pe) {
+                                /*Cannot happen*/
+                            }
+                        }
+                        if (elementLength == 7 || elementLength == 9) {
+                            hessid = getInteger(data, ByteOrder.BIG_ENDIAN, 6);
+                        }
+                        break;
+                    case EID_RoamingConsortium:
+                        anqpOICount = data.get() & Constants.BYTE_MASK;
+                        roamingConsortiums = getRoamingConsortiums(data, elementLength);
+                        break;
+                    case EID_ExtendedCaps:
+                        extendedCapabilities =
+                                Constants.getInteger(data, ByteOrder.LITTLE_ENDIAN, elementLength);
+                        break;
+                }
+            } catch (IllegalArgumentException | BufferUnderflowException
+                    | ArrayIndexOutOfBoundsException e) {
+                Log.d(Utils.hs2LogTag(getClass()), "Caught " + e + " in element " +
+                        elements[n].id);
+            }
+        }
+
+        mVenueGroup = venueGroup;
+        mVenueType = venueType;
+        mHESSID = hessid;
+        mAnqpOICount = anqpOICount;
+        mRoamingConsortiums = roamingConsortiums;
+        mExtendedCapabilities = extendedCapabilities;
+        mANQPElements = null;
+
+        mPrimaryFreq = result.frequency;
+        int[] channelInfo = getChannelInfo(result.frequency,
+                summary[WifiNative.IE_SUMMARY_HT_SECONDARY_OFFSET],
+                summary[WifiNative.IE_SUMMARY_VHT_CHANNEL_WIDTH],
+                summary[WifiNative.IE_SUMMARY_VHT_CENTER_INDEX0],
+                summary[WifiNative.IE_SUMMARY_VHT_CENTER_INDEX1]);
+        mChannelWidth = channelInfo[0];
+        mCenterfreq0 = channelInfo[1];
+        mCenterfreq1 = channelInfo[2];
+        m80211McRTTResponder = (flags & WifiNative.IE_SUMMARY_RTT_RESPONDER) != 0;
+    }
+
+    /* data is past the ANQP OI count of a Roaming Consortium element of elementLength */
+    private static long[] getRoamingConsortiums(ByteBuffer data, int elementLength) {
+        int oi12Length = data.get() & Constants.BYTE_MASK;
+        int oi1Length = oi12Length & Constants.NIBBLE_MASK;
+        int oi2Length = (oi12Length >>> 4) & Constants.NIBBLE_MASK;
+        int oi3Length = elementLength - 2 - oi1Length - oi2Length;
+        int oiCount = 0;
+        if (oi1Length > 0) {
+            oiCount++;
+            if (oi2Length > 0) {
+                oiCount++;
+                if (oi3Length > 0) {
+                    oiCount++;
+                }
+            }
+        }
+        long[] roamingConsortiums = new long[oiCount];
+        if (oi1Length > 0 && roamingConsortiums.length > 0) {
+            roamingConsortiums[0] =
+                    getInteger(data, ByteOrder.BIG_ENDIAN, oi1Length);
+        }
+        if (oi2Length > 0 && roamingConsortiums.length > 1) {
+            roamingConsortiums[1] =
+                    getInteger(data, ByteOrder.BIG_ENDIAN, oi2Length);
+        }
+        if (oi3Length > 0 && roamingConsortiums.length > 2) {
+            roamingConsortiums[2] =
+                    getInteger(data, ByteOrder.BIG_ENDIAN, oi3Length);
+        }
+        return roamingConsortiums;
+    }
+
+    /* returns { channel width, center frequency 0, center frequency 1 } */
+    private static int[] getChannelInfo(int primaryFreq, int secondChanelOffset, int channelMode,
+            int centerFreqIndex1, int centerFreqIndex2) {
+        int[] info = new int[3];
         if (channelMode != 0) {
             // 80 or 160 MHz
-            mChannelWidth = channelMode + 1;
-            mCenterfreq0 = (centerFreqIndex1 - 36) * 5 + 5180;
+            info[0] = channelMode + 1;
+            info[1] = (centerFreqIndex1 - 36) * 5 + 5180;
             if(channelMode > 1) { //160MHz
-                mCenterfreq1 = (centerFreqIndex2 - 36) * 5 + 5180;
-            } else {
-                mCenterfreq1 = 0;
+                info[2] = (centerFreqIndex2 - 36) * 5 + 5180;
             }
         } else {
             //20 or 40 MHz
             if (secondChanelOffset != 0) {//40MHz
-                mChannelWidth = 1;
+                info[0] = 1;
                 if (secondChanelOffset == 1) {
-                    mCenterfreq0 = mPrimaryFreq + 20;
+                    info[1] = primaryFreq + 20;
                 } else if (secondChanelOffset == 3) {
-                    mCenterfreq0 = mPrimaryFreq - 20;
+                    info[1] = primaryFreq - 20;
                 } else {
-                    mCenterfreq0 = 0;
                     Log.e(TAG,"Error on secondChanelOffset");
                 }
-            } else {
-                mCenterfreq0 = 0;
-                mChannelWidth = 0;
             }
-            mCenterfreq1 = 0;
-        }
-        m80211McRTTResponder = RTTResponder;
-        if (VDBG) {
-            Log.d(TAG, mSSID + "ChannelWidth is: " + mChannelWidth + " PrimaryFreq: " + mPrimaryFreq +
-                    " mCenterfreq0: " + mCenterfreq0 + " mCenterfreq1: " + mCenterfreq1 +
-                    (m80211McRTTResponder ? "Support RTT reponder" : "Do not support RTT responder"));
         }
+        return info;
     }
 
     private static ByteBuffer getAndAdvancePayload(ByteBuffer data, int plLength) {
@@ -0,0 +1,138 @@
+package com.android.server.wifi.hotspot2;
+
+import com.android.server.wifi.WifiNative;
+import com.android.server.wifi.anqp.ANQPElement;
+import com.android.server.wifi.anqp.Constants;
+import com.android.server.wifi.anqp.DomainNameElement;
+import com.android.server.wifi.anqp.NAIRealmData;
+import com.android.server.wifi.anqp.NAIRealmElement;
+import com.android.server.wifi.hotspot2.pps.HomeSP;
+
+import java.util.ArrayList;
+import java.util.Collection;
+import java.util.List;
+import java.util.Map;
+
+/**
+ * Matches the domain names and NAI realms APs advertise over ANQP against every configured
+ * home SP at once. The FQDNs, other home partners and credential realms of the home SPs are
+ * compiled natively into a suffix trie, which is only rebuilt when the set of home SPs
+ * changes.
+ */
+public class PasspointMatcher {
+    // Keep these consistent with wifi_domain_trie.h
+    public static final int MATCH_PRIMARY = 1 << 0;     // the AP is in the home SP's FQDN
+    public static final int MATCH_SECONDARY = 1 << 1;   // ... in one of its other home partners
+    public static final int MATCH_REALM = 1 << 2;       // an AP realm is in its credential realm
+
+    public static final int MATCH_DOMAIN = MATCH_PRIMARY | MATCH_SECONDARY;
+
+    private final List<HomeSP> mProviders = new ArrayList<>();
+
+    /**
+     * Recompiles the trie if homeSPs is not the set of home SPs it was compiled from. HomeSPs
+     * are immutable, so an identity comparison is enough.
+     */
+    public void update(Collection<HomeSP> homeSPs) {
+        if (homeSPs.size() == mProviders.size()) {
+            int n = 0;
+            boolean same = true;
+            for (HomeSP homeSP : homeSPs) {
+                if (mProviders.get(n++) != homeSP) {
+                    same = false;
+                    break;
+                }
+            }
+            if (same) {
+                return;
+            }
+        }
+
+        mProviders.clear();
+        mProviders.addAll(homeSPs);
+
+        List<String> names = new ArrayList<>();
+        List<Integer> providers = new ArrayList<>();
+        List<Integer> kinds = new ArrayList<>();
+        for (int n = 0; n < mProviders.size(); n++) {
+            HomeSP homeSP = mProviders.get(n);
+            addName(names, providers, kinds, homeSP.getFQDN(), n, MATCH_PRIMARY);
+            for (String partner : homeSP.getOtherHomePartners()) {
+                addName(names, providers, kinds, partner, n, MATCH_SECONDARY);
+            }
+            if (homeSP.getCredential() != null) {
+                addName(names, providers, kinds, homeSP.getCredential().getRealm(), n,
+                        MATCH_REALM);
+            }
+        }
+        if (!WifiNative.setPasspointNames(names.toArray(new String[names.size()]),
+                toIntArray(providers), toIntArray(kinds), mProviders.size())) {
+            mProviders.clear();
+        }
+    }
+
+    public int getProviderIndex(HomeSP homeSP) {
+        for (int n = 0; n < mProviders.size(); n++) {
+            if (mProviders.get(n) == homeSP) {
+                return n;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * Matches the ANQP elements of a batch of APs in one native call. Returns MATCH_* flags
+     * indexed by ap * number of home SPs + getProviderIndex(homeSP), or null if nothing was
+     * compiled. A null element map contributes no names.
+     */
+    public int[] match(List<Map<Constants.ANQPElementType, ANQPElement>> anqpElementMaps) {
+        if (mProviders.isEmpty()) {
+            return null;
+        }
+
+        List<String> names = new ArrayList<>();
+        List<Integer> aps = new ArrayList<>();
+        List<Integer> kinds = new ArrayList<>();
+        for (int ap = 0; ap < anqpElementMaps.size(); ap++) {
+            Map<Constants.ANQPElementType, ANQPElement> anqpElements = anqpElementMaps.get(ap);
+            if (anqpElements == null) {
+                continue;
+            }
+            DomainNameElement domainNameElement =
+                    (DomainNameElement) anqpElements.get(Constants.ANQPElementType.ANQPDomName);
+            if (domainNameElement != null) {
+                for (String domain : domainNameElement.getDomains()) {
+                    addName(names, aps, kinds, domain, ap, MATCH_DOMAIN);
+                }
+            }
+            NAIRealmElement naiRealmElement =
+                    (NAIRealmElement) anqpElements.get(Constants.ANQPElementType.ANQPNAIRealm);
+            if (naiRealmElement != null) {
+                for (NAIRealmData realmData : naiRealmElement.getRealmData()) {
+                    for (String realm : realmData.getRealms()) {
+                        addName(names, aps, kinds, realm, ap, MATCH_REALM);
+                    }
+                }
+            }
+        }
+        return WifiNative.matchPasspointNames(anqpElementMaps.size(),
+                names.toArray(new String[names.size()]), toIntArray(aps), toIntArray(kinds));
+    }
+
+    private static void addName(List<String> names, List<Integer> owners, List<Integer> kinds,
+                                String name, int owner, int kind) {
+        if (name != null) {
+            names.add(name);
+            owners.add(owner);
+            kinds.add(kind);
+        }
+    }
+
+    private static int[] toIntArray(List<Integer> list) {
+        int[] array = new int[list.size()];
+        for (int n = 0; n < array.length; n++) {
+            array[n] = list.get(n);
+        }
+        return array;
+    }
+}
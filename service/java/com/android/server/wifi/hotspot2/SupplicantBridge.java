@@ -7,6 +7,7 @@ import com.android.server.wifi.WifiConfigStore;
 import com.android.server.wifi.WifiNative;
 import com.android.server.wifi.anqp.ANQPElement;
 import com.android.server.wifi.anqp.ANQPFactory;
+import com.android.server.wifi.anqp.ANQPIndex;
 import com.android.server.wifi.anqp.Constants;
 import com.android.server.wifi.anqp.eap.AuthParam;
 import com.android.server.wifi.anqp.eap.EAP;
@@ -14,12 +15,12 @@ import com.android.server.wifi.anqp.eap.EAPMethod;
 import com.android.server.wifi.hotspot2.pps.Credential;
 
 import java.io.BufferedReader;
+import java.io.ByteArrayOutputStream;
 import java.io.IOException;
 import java.io.StringReader;
 import java.net.ProtocolException;
 import java.nio.BufferUnderflowException;
 import java.nio.ByteBuffer;
-import java.nio.ByteOrder;
 import java.nio.CharBuffer;
 import java.nio.charset.CharacterCodingException;
 import java.nio.charset.StandardCharsets;
@@ -33,6 +34,9 @@ public class SupplicantBridge {
     private final WifiConfigStore mConfigStore;
     private final Map<Long, ScanDetail> mRequestMap = new HashMap<>();
 
+    // Leads an HS2.0 element inside a vendor specific ANQP element: OI, subtype and reserved
+    private static final int HS20_HEADER_LENGTH = 6;
+
     private static final Map<String, Constants.ANQPElementType> sWpsNames = new HashMap<>();
 
     static {
@@ -68,10 +72,9 @@ public class SupplicantBridge {
         Map<Constants.ANQPElementType, ANQPElement> elements = new HashMap<>(lines.size());
         for (String line : lines) {
             try {
-                ANQPElement element = buildElement(line);
-                if (element != null) {
-                    elements.put(element.getID(), element);
-                }
+                ByteArrayOutputStream framed = new ByteArrayOutputStream();
+                frameElement(line, framed);
+                addElements(framed, elements);
             }
             catch (ProtocolException pe) {
                 Log.e(Utils.hs2LogTag(SupplicantBridge.class), "Failed to parse ANQP: " + pe);
@@ -285,27 +288,32 @@ public class SupplicantBridge {
         if (bssInfo == null) {
             return elements;
         }
+        ByteArrayOutputStream framed = new ByteArrayOutputStream();
         BufferedReader lineReader = new BufferedReader(new StringReader(bssInfo));
         String line;
         while ((line=lineReader.readLine()) != null) {
-            ANQPElement element = buildElement(line);
-            if (element != null) {
-                elements.put(element.getID(), element);
-            }
+            frameElement(line, framed);
         }
+        addElements(framed, elements);
         return elements;
     }
 
-    private static ANQPElement buildElement(String text) throws ProtocolException {
+    /**
+     * Appends the element of a "name=hex" line of the supplicant's BSS output to framed, laid
+     * out as in an ANQP response, so that all of them go through one ANQPIndex. Lines that
+     * aren't ANQP elements add nothing.
+     */
+    private static void frameElement(String text, ByteArrayOutputStream framed)
+            throws ProtocolException {
         int separator = text.indexOf('=');
         if (separator < 0) {
-            return null;
+            return;
         }
 
         String elementName = text.substring(0, separator);
         Constants.ANQPElementType elementType = sWpsNames.get(elementName);
         if (elementType == null) {
-            return null;
+            return;
         }
 
         byte[] payload;
@@ -314,12 +322,42 @@ public class SupplicantBridge {
         }
         catch (NumberFormatException nfe) {
             Log.e(Utils.hs2LogTag(SupplicantBridge.class), "Failed to parse hex string");
-            return null;
+            return;
+        }
+
+        Integer infoID = Constants.getANQPElementID(elementType);
+        int length = payload.length + (infoID != null ? 0 : HS20_HEADER_LENGTH);
+        if (length > Constants.SHORT_MASK) {
+            throw new ProtocolException("Oversized " + elementName + ": " + payload.length);
+        }
+        putShort(framed, infoID != null ? infoID : Constants.ANQP_VENDOR_SPEC);
+        putShort(framed, length);
+        if (infoID == null) {
+            putShort(framed, Constants.HS20_PREFIX);
+            putShort(framed, Constants.HS20_PREFIX >>> Short.SIZE);
+            framed.write(Constants.getHS20ElementID(elementType));
+            framed.write(0);            // reserved
+        }
+        framed.write(payload, 0, payload.length);
+    }
+
+    private static void putShort(ByteArrayOutputStream out, int value) {
+        out.write(value & Constants.BYTE_MASK);
+        out.write((value >>> Byte.SIZE) & Constants.BYTE_MASK);
+    }
+
+    private static void addElements(ByteArrayOutputStream framed,
+            Map<Constants.ANQPElementType, ANQPElement> elements) throws ProtocolException {
+        if (framed.size() == 0) {
+            return;
+        }
+        ANQPIndex index = ANQPIndex.parse(framed.toByteArray());
+        for (int n = 0; n < index.getElementCount(); n++) {
+            ANQPElement element = index.getElement(n);
+            if (element != null) {
+                elements.put(element.getID(), element);
+            }
         }
-        return Constants.getANQPElementID(elementType) != null ?
-                ANQPFactory.buildElement(ByteBuffer.wrap(payload), elementType, payload.length) :
-                ANQPFactory.buildHS20Element(elementType,
-                        ByteBuffer.wrap(payload).order(ByteOrder.LITTLE_ENDIAN));
     }
 
     private static String mapEAPMethodName(EAP.EAPMethodID eapMethodID) {
@@ -12,6 +12,7 @@ import com.android.server.wifi.anqp.ThreeGPPNetworkElement;
 import com.android.server.wifi.hotspot2.AuthMatch;
 import com.android.server.wifi.hotspot2.NetworkDetail;
 import com.android.server.wifi.hotspot2.PasspointMatch;
+import com.android.server.wifi.hotspot2.PasspointMatcher;
 import com.android.server.wifi.hotspot2.Utils;
 
 import java.util.ArrayList;
@@ -85,10 +86,20 @@ public class HomeSP {
     public PasspointMatch match(NetworkDetail networkDetail,
                                 Map<ANQPElementType, ANQPElement> anqpElementMap,
                                 SIMAccessor simAccessor) {
+        return match(networkDetail, anqpElementMap, simAccessor, -1);
+    }
+
+    /**
+     * nameMatch are the PasspointMatcher flags of this SP for the AP, if they were already
+     * worked out natively, else -1.
+     */
+    public PasspointMatch match(NetworkDetail networkDetail,
+                                Map<ANQPElementType, ANQPElement> anqpElementMap,
+                                SIMAccessor simAccessor, int nameMatch) {
 
         List<String> imsis = simAccessor.getMatchingImsis(mCredential.getImsi());
 
-        PasspointMatch spMatch = matchSP(networkDetail, anqpElementMap, imsis);
+        PasspointMatch spMatch = matchSP(networkDetail, anqpElementMap, imsis, nameMatch);
 
         if (spMatch == PasspointMatch.Incomplete || spMatch == PasspointMatch.Declined) {
             return spMatch;
@@ -127,6 +138,12 @@ public class HomeSP {
     public PasspointMatch matchSP(NetworkDetail networkDetail,
                                 Map<ANQPElementType, ANQPElement> anqpElementMap,
                                 List<String> imsis) {
+        return matchSP(networkDetail, anqpElementMap, imsis, -1);
+    }
+
+    private PasspointMatch matchSP(NetworkDetail networkDetail,
+                                Map<ANQPElementType, ANQPElement> anqpElementMap,
+                                List<String> imsis, int nameMatch) {
 
         if (mSSIDs.containsKey(networkDetail.getSSID())) {
             Long hessid = mSSIDs.get(networkDetail.getSSID());
@@ -187,14 +204,19 @@ public class HomeSP {
             return PasspointMatch.Incomplete;
         }
 
+        if (nameMatch >= 0 && (nameMatch & PasspointMatcher.MATCH_DOMAIN) != 0) {
+            return PasspointMatch.HomeProvider;
+        }
+
         DomainNameElement domainNameElement =
                 (DomainNameElement) anqpElementMap.get(ANQPElementType.ANQPDomName);
 
-        if (domainNameElement != null) {
+        // With the domains matched natively only the IMSI check is left to do here.
+        if (domainNameElement != null && (nameMatch < 0 || imsis != null)) {
             for (String domain : domainNameElement.getDomains()) {
                 List<String> anLabels = Utils.splitDomain(domain);
-                DomainMatcher.Match match = mDomainMatcher.isSubDomain(anLabels);
-                if (match != DomainMatcher.Match.None) {
+                if (nameMatch < 0 &&
+                        mDomainMatcher.isSubDomain(anLabels) != DomainMatcher.Match.None) {
                     return PasspointMatch.HomeProvider;
                 }
 
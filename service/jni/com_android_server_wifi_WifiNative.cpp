@@ -18,20 +18,48 @@
 
 #include "jni.h"
 #include "JniConstants.h"
+#include "JNIHelp.h"
 #include <ScopedUtfChars.h>
 #include <ScopedBytes.h>
+#include <ScopedPrimitiveArray.h>
 #include <utils/misc.h>
 #include <android_runtime/AndroidRuntime.h>
 #include <utils/Log.h>
 #include <utils/String16.h>
+#include <utils/Timers.h>
+#include <utils/Mutex.h>
+#include <utils/Condition.h>
+#include <cutils/properties.h>
 #include <ctype.h>
 #include <sys/socket.h>
 #include <linux/if.h>
+#include <sched.h>
+#include <algorithm>
 #include "wifi.h"
 #include "wifi_hal.h"
 #include "jni_helper.h"
 #include "rtt.h"
 #include "wifi_hal_stub.h"
+#include "wifi_fw_dump.h"
+#include "wifi_ring_log.h"
+#include "wifi_ring_status.h"
+#include "wifi_epno.h"
+#include "wifi_hotlist.h"
+#include "wifi_significant_change.h"
+#include "wifi_gscan_emu.h"
+#include "wifi_hal_trace.h"
+#include "wifi_call_stats.h"
+#include "wifi_ie_summary.h"
+#include "wifi_anqp.h"
+#include "wifi_domain_trie.h"
+#include "wifi_scan_filter.h"
+#include "wifi_scan_cache.h"
+#include "wifi_roam_scorer.h"
+#include "wifi_blacklist.h"
+#include "wifi_ssid_table.h"
+#include "wifi_keepalive.h"
+#include "wifi_rssi_monitor.h"
+#include "wifi_tdls.h"
 #define REPLY_BUF_SIZE 4096 + 1         // wpa_supplicant's maximum size + 1 for nul
 #define EVENT_BUF_SIZE 2048
 
@@ -97,9 +125,142 @@ int init_wifi_hal_func_table(wifi_hal_fn *hal_fn) {
     hal_fn->wifi_set_bssid_blacklist = wifi_set_bssid_blacklist_stub;
     hal_fn->wifi_start_sending_offloaded_packet = wifi_start_sending_offloaded_packet_stub;
     hal_fn->wifi_stop_sending_offloaded_packet = wifi_stop_sending_offloaded_packet_stub;
+    hal_fn->wifi_start_rssi_monitoring = wifi_start_rssi_monitoring_stub;
+    hal_fn->wifi_stop_rssi_monitoring = wifi_stop_rssi_monitoring_stub;
     return 0;
 }
 
+/* what the vendor HAL implements; keep these consistent with WifiNative.java */
+enum {
+    HAL_CAPABILITY_GSCAN                = 1 << 0,
+    HAL_CAPABILITY_HOTLIST              = 1 << 1,
+    HAL_CAPABILITY_SIGNIFICANT_CHANGE   = 1 << 2,
+    HAL_CAPABILITY_LINK_STATS           = 1 << 3,
+    HAL_CAPABILITY_RTT                  = 1 << 4,
+    HAL_CAPABILITY_VALID_CHANNELS       = 1 << 5,
+    HAL_CAPABILITY_SCANNING_MAC_OUI     = 1 << 6,
+    HAL_CAPABILITY_COUNTRY_CODE         = 1 << 7,
+    HAL_CAPABILITY_NODFS                = 1 << 8,
+    HAL_CAPABILITY_TDLS                 = 1 << 9,
+    HAL_CAPABILITY_LOGGER               = 1 << 10,
+    HAL_CAPABILITY_FW_MEMORY_DUMP       = 1 << 11,
+    HAL_CAPABILITY_ALERT                = 1 << 12,
+    HAL_CAPABILITY_EPNO                 = 1 << 13,
+    HAL_CAPABILITY_SSID_WHITELIST       = 1 << 14,
+    HAL_CAPABILITY_ROAM_PARAMS          = 1 << 15,
+    HAL_CAPABILITY_LAZY_ROAM            = 1 << 16,
+    HAL_CAPABILITY_BSSID_BLACKLIST      = 1 << 17,
+    HAL_CAPABILITY_PACKET_OFFLOAD       = 1 << 18,
+    HAL_CAPABILITY_RSSI_MONITOR         = 1 << 19,
+    HAL_CAPABILITY_VERSION_INFO         = 1 << 20,
+};
+
+static jint sHalCapabilities;
+
+/* a function the vendor left as the stub, or empty, is one it doesn't implement */
+#define HAL_IMPLEMENTS(fn, name)    ((fn)->name != NULL && (fn)->name != name##_stub)
+
+/* must run before instrument_wifi_hal_func_table hides the vendor's function pointers */
+static jint probeHalCapabilities(const wifi_hal_fn *fn) {
+    jint caps = 0;
+    if (HAL_IMPLEMENTS(fn, wifi_start_gscan) && HAL_IMPLEMENTS(fn, wifi_stop_gscan)
+            && HAL_IMPLEMENTS(fn, wifi_get_cached_gscan_results)) {
+        caps |= HAL_CAPABILITY_GSCAN;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_set_bssid_hotlist) && HAL_IMPLEMENTS(fn, wifi_reset_bssid_hotlist)) {
+        caps |= HAL_CAPABILITY_HOTLIST;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_set_significant_change_handler)
+            && HAL_IMPLEMENTS(fn, wifi_reset_significant_change_handler)) {
+        caps |= HAL_CAPABILITY_SIGNIFICANT_CHANGE;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_set_link_stats) && HAL_IMPLEMENTS(fn, wifi_get_link_stats)) {
+        caps |= HAL_CAPABILITY_LINK_STATS;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_rtt_range_request) && HAL_IMPLEMENTS(fn, wifi_rtt_range_cancel)
+            && HAL_IMPLEMENTS(fn, wifi_get_rtt_capabilities)) {
+        caps |= HAL_CAPABILITY_RTT;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_get_valid_channels)) {
+        caps |= HAL_CAPABILITY_VALID_CHANNELS;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_set_scanning_mac_oui)) {
+        caps |= HAL_CAPABILITY_SCANNING_MAC_OUI;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_set_country_code)) {
+        caps |= HAL_CAPABILITY_COUNTRY_CODE;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_set_nodfs_flag)) {
+        caps |= HAL_CAPABILITY_NODFS;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_enable_tdls) && HAL_IMPLEMENTS(fn, wifi_disable_tdls)
+            && HAL_IMPLEMENTS(fn, wifi_get_tdls_status)) {
+        caps |= HAL_CAPABILITY_TDLS;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_start_logging) && HAL_IMPLEMENTS(fn, wifi_get_ring_buffers_status)
+            && HAL_IMPLEMENTS(fn, wifi_get_ring_data) && HAL_IMPLEMENTS(fn, wifi_set_log_handler)) {
+        caps |= HAL_CAPABILITY_LOGGER;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_get_firmware_memory_dump)) {
+        caps |= HAL_CAPABILITY_FW_MEMORY_DUMP;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_set_alert_handler)) {
+        caps |= HAL_CAPABILITY_ALERT;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_set_epno_list)) {
+        caps |= HAL_CAPABILITY_EPNO;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_set_ssid_white_list)) {
+        caps |= HAL_CAPABILITY_SSID_WHITELIST;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_set_gscan_roam_params)
+            && HAL_IMPLEMENTS(fn, wifi_set_bssid_preference)) {
+        caps |= HAL_CAPABILITY_ROAM_PARAMS;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_enable_lazy_roam)) {
+        caps |= HAL_CAPABILITY_LAZY_ROAM;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_set_bssid_blacklist)) {
+        caps |= HAL_CAPABILITY_BSSID_BLACKLIST;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_start_sending_offloaded_packet)
+            && HAL_IMPLEMENTS(fn, wifi_stop_sending_offloaded_packet)) {
+        caps |= HAL_CAPABILITY_PACKET_OFFLOAD;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_start_rssi_monitoring)
+            && HAL_IMPLEMENTS(fn, wifi_stop_rssi_monitoring)) {
+        caps |= HAL_CAPABILITY_RSSI_MONITOR;
+    }
+    if (HAL_IMPLEMENTS(fn, wifi_get_firmware_version)
+            && HAL_IMPLEMENTS(fn, wifi_get_driver_version)) {
+        caps |= HAL_CAPABILITY_VERSION_INFO;
+    }
+    return caps;
+}
+
+// The framework and the gscan emulation share the supplicant control connection.
+static Mutex sSupplicantLock;
+
+// Set once startHal falls back to the gscan emulation; it then watches framework scans.
+static volatile bool sGscanEmulated = false;
+
+static bool doSupplicantCommand(const char* command, char* reply, size_t reply_len) {
+    Mutex::Autolock _l(sSupplicantLock);
+
+    --reply_len; // Ensure we have room to add NUL termination.
+    if (::wifi_command(command, reply, &reply_len) != 0) {
+        return false;
+    }
+
+    // Strip off trailing newline.
+    if (reply_len > 0 && reply[reply_len-1] == '\n') {
+        reply[reply_len-1] = '\0';
+    } else {
+        reply[reply_len] = '\0';
+    }
+    return true;
+}
+
 static bool doCommand(JNIEnv* env, jstring javaCommand,
                       char* reply, size_t reply_len) {
     ScopedUtfChars command(env, javaCommand);
@@ -111,16 +272,11 @@ static bool doCommand(JNIEnv* env, jstring javaCommand,
         ALOGD("doCommand: %s", command.c_str());
     }
 
-    --reply_len; // Ensure we have room to add NUL termination.
-    if (::wifi_command(command.c_str(), reply, &reply_len) != 0) {
+    if (!doSupplicantCommand(command.c_str(), reply, reply_len)) {
         return false;
     }
-
-    // Strip off trailing newline.
-    if (reply_len > 0 && reply[reply_len-1] == '\n') {
-        reply[reply_len-1] = '\0';
-    } else {
-        reply[reply_len] = '\0';
+    if (sGscanEmulated) {
+        wifi_gscan_emu_on_command(command.c_str(), reply);
     }
     return true;
 }
@@ -157,44 +313,64 @@ static jstring doStringCommand(JNIEnv* env, jstring javaCommand) {
 
 static jboolean android_net_wifi_isDriverLoaded(JNIEnv* env, jobject)
 {
+    JNI_CALL_STATS();
+
     return (::is_wifi_driver_loaded() == 1);
 }
 
 static jboolean android_net_wifi_loadDriver(JNIEnv* env, jobject)
 {
+    JNI_CALL_STATS();
+
     return (::wifi_load_driver() == 0);
 }
 
 static jboolean android_net_wifi_unloadDriver(JNIEnv* env, jobject)
 {
+    JNI_CALL_STATS();
+
     return (::wifi_unload_driver() == 0);
 }
 
 static jboolean android_net_wifi_startSupplicant(JNIEnv* env, jobject, jboolean p2pSupported)
 {
+    JNI_CALL_STATS();
+
     return (::wifi_start_supplicant(p2pSupported) == 0);
 }
 
 static jboolean android_net_wifi_killSupplicant(JNIEnv* env, jobject, jboolean p2pSupported)
 {
+    JNI_CALL_STATS();
+
     return (::wifi_stop_supplicant(p2pSupported) == 0);
 }
 
 static jboolean android_net_wifi_connectToSupplicant(JNIEnv* env, jobject)
 {
+    JNI_CALL_STATS();
+
     return (::wifi_connect_to_supplicant() == 0);
 }
 
 static void android_net_wifi_closeSupplicantConnection(JNIEnv* env, jobject)
 {
+    JNI_CALL_STATS();
+
     ::wifi_close_supplicant_connection();
 }
 
 static jstring android_net_wifi_waitForEvent(JNIEnv* env, jobject)
 {
+    JNI_CALL_STATS();
+
     char buf[EVENT_BUF_SIZE];
     int nread = ::wifi_wait_for_event(buf, sizeof buf);
     if (nread > 0) {
+        JNI_CALL_BYTES(nread);
+        if (sGscanEmulated) {
+            wifi_gscan_emu_on_event(buf);
+        }
         return env->NewStringUTF(buf);
     } else {
         return NULL;
@@ -202,14 +378,20 @@ static jstring android_net_wifi_waitForEvent(JNIEnv* env, jobject)
 }
 
 static jboolean android_net_wifi_doBooleanCommand(JNIEnv* env, jobject, jstring javaCommand) {
+    JNI_CALL_STATS();
+
     return doBooleanCommand(env, javaCommand);
 }
 
 static jint android_net_wifi_doIntCommand(JNIEnv* env, jobject, jstring javaCommand) {
+    JNI_CALL_STATS();
+
     return doIntCommand(env, javaCommand);
 }
 
 static jstring android_net_wifi_doStringCommand(JNIEnv* env, jobject, jstring javaCommand) {
+    JNI_CALL_STATS();
+
     return doStringCommand(env,javaCommand);
 }
 
@@ -226,7 +408,20 @@ static wifi_handle getWifiHandle(JNIHelper &helper, jclass cls) {
     return (wifi_handle) helper.getStaticLongField(cls, WifiHandleVarName);
 }
 
+/*
+ * Interface handles, and what each interface supports, as of the last getInterfaces. Kept
+ * here so hot calls need not copy sWifiIfaceHandles out of Java; the count is published
+ * last, and cleared first, so readers never see a half written entry.
+ */
+#define MAX_IFACES 8
+static wifi_interface_handle sIfaceHandles[MAX_IFACES];
+static feature_set sIfaceFeatures[MAX_IFACES];
+static std::atomic<int> sNumIfaces(0);
+
 static wifi_interface_handle getIfaceHandle(JNIHelper &helper, jclass cls, jint index) {
+    if (index >= 0 && index < sNumIfaces.load(std::memory_order_acquire)) {
+        return sIfaceHandles[index];
+    }
     return (wifi_interface_handle) helper.getStaticLongArrayField(cls, WifiIfaceHandleVarName, index);
 }
 
@@ -329,10 +524,81 @@ int set_iface_flags(const char *ifname, int dev_up) {
 }
 
 static jboolean android_net_wifi_toggle_interface(JNIEnv* env, jclass cls, int toggle) {
+    JNI_CALL_STATS();
+
     return(set_iface_flags("wlan0", toggle) == 0);
 }
 
+/* kept current by on_ring_buffer_data; filled from the HAL when first asked for */
+static RingStatusTable sRingStatusTable;
+
+/* remembers what ePNO was last programmed with */
+static EpnoManager sEpnoManager;
+
+/* the keepalive packets offloaded to the firmware, by slot */
+static KeepaliveManager sKeepaliveManager;
+static Mutex sKeepaliveLock;
+/* logs every packet offloaded in full; follows verbose logging */
+static volatile bool sKeepaliveDump = false;
+
+/* the RSSI thresholds of every client, sharing the one HAL RSSI monitor */
+static RssiMonitorMux sRssiMonitorMux;
+static Mutex sRssiMonitorLock;
+
+/* TDLS sessions set up and torn down by per-peer traffic; fed by link layer stats polling */
+static TdlsSessionManager sTdlsManager;
+static Mutex sTdlsLock;
+
+/* SsidTable ids of the SSID whitelist last passed to the HAL; Java serializes setting it */
+static std::vector<int> sWhitelistSsids;
+static bool sWhitelistProgrammed = false;
+static wifi_request_id sWhitelistId = 0;
+
+/* shares the single HAL hotlist between the requesters Java installs */
+static HotlistMux sHotlistMux;
+
+/*
+ * Filter full scan results go through before any object is made for them. Callbacks read
+ * an immutable snapshot through the pointer, counted in sFullScanFilterReaders; a setter
+ * swaps in a new one and frees the old once no reader may still hold it. The lock only
+ * serializes setters.
+ */
+static std::atomic<ScanFilter *> sFullScanFilter(NULL);
+static std::atomic<int> sFullScanFilterReaders(0);
+static Mutex sFullScanFilterLock;
+
+/* the 5 GHz DFS channels the HAL lists, as of the last getInterfaces; published like sNumIfaces */
+#define MAX_DFS_CHANNELS 32
+static wifi_channel sDfsChannels[MAX_DFS_CHANNELS];
+static std::atomic<int> sNumDfsChannels(0);
+
+static void publishFullScanFilter(ScanFilter *filter) {
+    Mutex::Autolock _l(sFullScanFilterLock);
+    ScanFilter *old = sFullScanFilter.exchange(filter);
+    while (sFullScanFilterReaders.load() != 0) {
+        sched_yield();      /* a reader is inside matches(), which is short */
+    }
+    delete old;
+}
+
+/* ranks roam candidates from the newest gscan results as lazy roam would */
+static RoamScorer sRoamScorer;
+static WifiScanCache sRoamScan(1);
+static Mutex sRoamLock;
+
+/* BSSID blacklist with expiry, mirrored to the HAL and the roam scorer */
+static BssidBlacklist sBssidBlacklist;
+static wifi_request_id sBlacklistId = 0;       /* what the HAL was last programmed under */
+static Mutex sBlacklistLock;
+
+/* tracks significant changes from gscan results when the HAL cannot */
+static SignificantChangeEngine sSignificantChangeEngine;
+/* Java serializes the calls that feed it, but the HAL cleanup stops it from its own thread */
+static Mutex sSignificantChangeLock;
+
 static jboolean android_net_wifi_startHal(JNIEnv* env, jclass cls) {
+    JNI_CALL_STATS();
+
     JNIHelper helper(env);
     wifi_handle halHandle = getWifiHandle(helper, cls);
     if (halHandle == NULL) {
@@ -343,10 +609,18 @@ static jboolean android_net_wifi_startHal(JNIEnv* env, jclass cls) {
         }
 
         wifi_error res = init_wifi_vendor_hal_func_table(&hal_fn);
+        if (res == WIFI_ERROR_NOT_SUPPORTED && property_get_bool(GSCAN_EMU_PROPERTY, false)) {
+            ALOGD("No vendor HAL, emulating gscan over supplicant scans");
+            res = init_wifi_gscan_emu_func_table(&hal_fn, doSupplicantCommand);
+            sGscanEmulated = (res == WIFI_SUCCESS);
+        }
         if (res != WIFI_SUCCESS) {
             ALOGD("Can not initialize the vendor function pointer table");
 	    return false;
         }
+        sHalCapabilities = probeHalCapabilities(&hal_fn);
+        ALOGD("HAL capabilities = 0x%x", sHalCapabilities);
+        instrument_wifi_hal_func_table(&hal_fn);
 
         int ret = set_iface_flags("wlan0", 1);
         if(ret != 0) {
@@ -370,15 +644,53 @@ static jboolean android_net_wifi_startHal(JNIEnv* env, jclass cls) {
 void android_net_wifi_hal_cleaned_up_handler(wifi_handle handle) {
     ALOGD("In wifi cleaned up handler");
 
+    sNumIfaces.store(0, std::memory_order_release);
+
     JNIHelper helper(mVM);
     helper.setStaticLongField(mCls, WifiHandleVarName, 0);
 
     helper.deleteGlobalRef(mCls);
     mCls = NULL;
     mVM  = NULL;
+
+    sRingStatusTable.clear();
+    sEpnoManager.reset();
+    sWhitelistProgrammed = false;
+    sHotlistMux.clear();
+
+    {
+        Mutex::Autolock _l(sSignificantChangeLock);
+        sSignificantChangeEngine.stop();
+    }
+
+    publishFullScanFilter(NULL);
+    sNumDfsChannels.store(0, std::memory_order_release);
+    {
+        Mutex::Autolock _l(sRoamLock);
+        sRoamScan.clear();
+    }
+    {
+        Mutex::Autolock _l(sBlacklistLock);
+        sBssidBlacklist.resetProgrammed();
+    }
+    {
+        Mutex::Autolock _l(sKeepaliveLock);
+        sKeepaliveManager.reset();
+    }
+    {
+        Mutex::Autolock _l(sRssiMonitorLock);
+        sRssiMonitorMux.clear();
+        sRssiMonitorMux.resetProgrammed();
+    }
+    {
+        Mutex::Autolock _l(sTdlsLock);
+        sTdlsManager.clear();
+    }
 }
 
 static void android_net_wifi_stopHal(JNIEnv* env, jclass cls) {
+    JNI_CALL_STATS();
+
     ALOGD("In wifi stop Hal");
 
     JNIHelper helper(env);
@@ -391,6 +703,7 @@ static void android_net_wifi_stopHal(JNIEnv* env, jclass cls) {
 }
 
 static void android_net_wifi_waitForHalEvents(JNIEnv* env, jclass cls) {
+    JNI_CALL_STATS();
 
     ALOGD("waitForHalEvents called, vm = %p, obj = %p, env = %p", mVM, mCls, env);
 
@@ -401,6 +714,8 @@ static void android_net_wifi_waitForHalEvents(JNIEnv* env, jclass cls) {
 }
 
 static int android_net_wifi_getInterfaces(JNIEnv *env, jclass cls) {
+    JNI_CALL_STATS();
+
     int n = 0;
 
     JNIHelper helper(env);
@@ -422,7 +737,7 @@ static int android_net_wifi_getInterfaces(JNIEnv *env, jclass cls) {
        return 0;
     }
 
-    if (n > 8) {
+    if (n > MAX_IFACES) {
         THROW(helper,"Too many interfaces");
         return 0;
     }
@@ -433,7 +748,7 @@ static int android_net_wifi_getInterfaces(JNIEnv *env, jclass cls) {
         return 0;
     }
 
-    jlong elems[8];
+    jlong elems[MAX_IFACES];
     for (int i = 0; i < n; i++) {
         elems[i] = reinterpret_cast<jlong>(ifaceHandles[i]);
     }
@@ -441,17 +756,36 @@ static int android_net_wifi_getInterfaces(JNIEnv *env, jclass cls) {
     helper.setLongArrayRegion(array, 0, n, elems);
     helper.setStaticLongArrayField(cls, WifiIfaceHandleVarName, array);
 
+    /* the feature set is fixed while the HAL runs, so it is asked for only once */
+    sNumIfaces.store(0, std::memory_order_release);
+    for (int i = 0; i < n; i++) {
+        sIfaceHandles[i] = ifaceHandles[i];
+        if (hal_fn.wifi_get_supported_feature_set(ifaceHandles[i], &sIfaceFeatures[i])
+                != WIFI_SUCCESS) {
+            sIfaceFeatures[i] = 0;
+        }
+    }
+    sNumIfaces.store(n, std::memory_order_release);
+
+    /* so scan filters can tell DFS channels apart the way this HAL does */
+    int numDfs = 0;
+    sNumDfsChannels.store(0, std::memory_order_release);
+    if (n > 0 && hal_fn.wifi_get_valid_channels(ifaceHandles[0], WIFI_BAND_A_DFS,
+            MAX_DFS_CHANNELS, sDfsChannels, &numDfs) == WIFI_SUCCESS) {
+        sNumDfsChannels.store(std::min(numDfs, MAX_DFS_CHANNELS), std::memory_order_release);
+    }
+
     return (result < 0) ? result : n;
 }
 
 static jstring android_net_wifi_getInterfaceName(JNIEnv *env, jclass cls, jint i) {
+    JNI_CALL_STATS();
 
     char buf[EVENT_BUF_SIZE];
 
     JNIHelper helper(env);
 
-    jlong value = helper.getStaticLongArrayField(cls, WifiIfaceHandleVarName, i);
-    wifi_interface_handle handle = (wifi_interface_handle) value;
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, i);
     int result = hal_fn.wifi_get_iface_name(handle, buf, sizeof(buf));
     if (result < 0) {
         return NULL;
@@ -461,8 +795,15 @@ static jstring android_net_wifi_getInterfaceName(JNIEnv *env, jclass cls, jint i
     }
 }
 
+/* optional record of every HAL callback, see startHalTraceNative() */
+static HalTraceRecorder sHalTrace;
+
 
 static void onScanResultsAvailable(wifi_request_id id, unsigned num_results) {
+    HAL_CALLBACK_STATS();
+
+    sHalTrace.recordEvent(HAL_TRACE_SCAN_RESULTS_AVAILABLE, id, num_results);
+    traceCounter("wifi_scan_results_per_batch", num_results);
 
     JNIHelper helper(mVM);
 
@@ -472,6 +813,9 @@ static void onScanResultsAvailable(wifi_request_id id, unsigned num_results) {
 }
 
 static void onScanEvent(wifi_scan_event event, unsigned status) {
+    HAL_CALLBACK_STATS();
+
+    sHalTrace.recordEvent(HAL_TRACE_SCAN_EVENT, event, status);
 
     JNIHelper helper(mVM);
 
@@ -480,7 +824,140 @@ static void onScanEvent(wifi_scan_event event, unsigned status) {
     helper.reportEvent(mCls, "onScanStatus", "(I)V", event);
 }
 
+static byte parseHexChar(char ch) {
+    if (isdigit(ch))
+        return ch - '0';
+    else if ('A' <= ch && ch <= 'F')
+        return ch - 'A' + 10;
+    else if ('a' <= ch && ch <= 'f')
+        return ch - 'a' + 10;
+    else {
+        ALOGE("invalid character in bssid %c", ch);
+        return 0;
+    }
+}
+
+static byte parseHexByte(const char * &str) {
+    if (str[0] == '\0') {
+        ALOGE("Passed an empty string");
+        return 0;
+    }
+    byte b = parseHexChar(str[0]);
+    if (str[1] == '\0' || str[1] == ':') {
+        str ++;
+    } else {
+        b = b << 4 | parseHexChar(str[1]);
+        str += 2;
+    }
+
+    // Skip trailing delimiter if not at the end of the string.
+    if (str[0] != '\0') {
+        str++;
+    }
+    return b;
+}
+
+static void parseMacAddress(const char *str, mac_addr addr) {
+    addr[0] = parseHexByte(str);
+    addr[1] = parseHexByte(str);
+    addr[2] = parseHexByte(str);
+    addr[3] = parseHexByte(str);
+    addr[4] = parseHexByte(str);
+    addr[5] = parseHexByte(str);
+}
+
+/* wifi_scan_result timestamps are microseconds since boot */
+static wifi_timestamp scanFilterNow() {
+    return systemTime(SYSTEM_TIME_BOOTTIME) / 1000;
+}
+
+/*
+ * Compiles a WifiNative.ScanFilter; a null one passes everything. Returns false if it could
+ * not be read.
+ */
+static bool readScanFilter(JNIEnv *env, jobject object, ScanFilter *filter) {
+    filter->clear();
+    if (object == NULL) {
+        return true;
+    }
+
+    JNIHelper helper(env);
+    JNIObject<jobjectArray> ssids = helper.getArrayField(object, "ssids", "[Ljava/lang/String;");
+    if (ssids != NULL) {
+        int numSsids = helper.getArrayLength(ssids);
+        for (int i = 0; i < numSsids; i++) {
+            JNIObject<jobject> ssid = helper.getObjectArrayElement(ssids, i);
+            if (ssid == NULL) {
+                continue;
+            }
+            ScopedUtfChars chars(env, (jstring) ssid.get());
+            if (chars.c_str() == NULL) {
+                return false;
+            }
+            filter->addSsid((const uint8_t *) chars.c_str(), chars.size());
+        }
+    }
+
+    JNIObject<jobjectArray> bssids = helper.getArrayField(object, "bssids", "[Ljava/lang/String;");
+    if (bssids != NULL) {
+        int numBssids = helper.getArrayLength(bssids);
+        for (int i = 0; i < numBssids; i++) {
+            JNIObject<jobject> bssid = helper.getObjectArrayElement(bssids, i);
+            if (bssid == NULL) {
+                continue;
+            }
+            ScopedUtfChars chars(env, (jstring) bssid.get());
+            if (chars.c_str() == NULL) {
+                return false;
+            }
+            mac_addr addr;
+            parseMacAddress(chars.c_str(), addr);
+            filter->addBssid(addr);
+        }
+    }
+
+    filter->setBandMask(helper.getIntField(object, "band"));
+    filter->setMinRssi(helper.getIntField(object, "min_rssi"));
+    filter->setMaxAge((wifi_timestamp) helper.getIntField(object, "max_age_ms") * 1000);
+    filter->setDfsChannels(sDfsChannels, sNumDfsChannels.load(std::memory_order_acquire));
+    filter->commit();
+    return true;
+}
+
+static jboolean android_net_wifi_setFullScanResultFilter(JNIEnv *env, jclass cls, jobject object) {
+    JNI_CALL_STATS();
+
+    ScanFilter *filter = new ScanFilter();
+    if (!readScanFilter(env, object, filter)) {
+        delete filter;
+        return JNI_FALSE;
+    }
+    if (filter->isEmpty()) {
+        delete filter;
+        filter = NULL;
+    }
+
+    publishFullScanFilter(filter);
+    return JNI_TRUE;
+}
+
+/* whether a full scan result passes the filter Java set, without taking a lock */
+static bool passesFullScanFilter(const wifi_scan_result &result) {
+    sFullScanFilterReaders.fetch_add(1);
+    const ScanFilter *filter = sFullScanFilter.load();
+    bool passes = filter == NULL || filter->matches(result, scanFilterNow());
+    sFullScanFilterReaders.fetch_sub(1);
+    return passes;
+}
+
 static void onFullScanResult(wifi_request_id id, wifi_scan_result *result) {
+    HAL_CALLBACK_STATS();
+
+    sHalTrace.recordFullScanResult(id, result);
+
+    if (!passesFullScanFilter(*result)) {
+        return;
+    }
 
     JNIHelper helper(mVM);
 
@@ -501,14 +978,27 @@ static void onFullScanResult(wifi_request_id id, wifi_scan_result *result) {
     jbyte *bytes = (jbyte *)&(result->ie_data[0]);
     helper.setByteArrayRegion(elements, 0, result->ie_length, bytes);
 
+    /* parsed here once so that Java doesn't walk the IEs again for every result */
+    int32_t summary[IE_SUMMARY_LEN];
+    parse_ie_summary((const u8 *)result->ie_data, result->ie_length, summary);
+    summary[IE_SUMMARY_CAPABILITY_INFO] = result->capability;
+    JNIObject<jintArray> summaryArray = helper.newIntArray(IE_SUMMARY_LEN);
+    if (summaryArray == NULL) {
+        ALOGE("Error in allocating array");
+        return;
+    }
+    helper.setIntArrayRegion(summaryArray, 0, IE_SUMMARY_LEN, summary);
+    JNI_CALL_BYTES(sizeof(wifi_scan_result) + result->ie_length + sizeof(summary));
+
     // ALOGD("Returning result");
 
-    helper.reportEvent(mCls, "onFullScanResult", "(ILandroid/net/wifi/ScanResult;[B)V", id,
-            scanResult.get(), elements.get());
+    helper.reportEvent(mCls, "onFullScanResult", "(ILandroid/net/wifi/ScanResult;[B[I)V", id,
+            scanResult.get(), elements.get(), summaryArray.get());
 }
 
 static jboolean android_net_wifi_startScan(
         JNIEnv *env, jclass cls, jint iface, jint id, jobject settings) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -575,6 +1065,7 @@ static jboolean android_net_wifi_startScan(
 }
 
 static jboolean android_net_wifi_stopScan(JNIEnv *env, jclass cls, jint iface, jint id) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -590,9 +1081,14 @@ static int compare_scan_result_timestamp(const void *v1, const void *v2) {
 }
 
 static jobject android_net_wifi_getScanResults(
-        JNIEnv *env, jclass cls, jint iface, jboolean flush)  {
+        JNIEnv *env, jclass cls, jint iface, jboolean flush, jobject filterObject)  {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
+    ScanFilter filter;
+    if (!readScanFilter(env, filterObject, &filter)) {
+        return NULL;
+    }
     wifi_cached_scan_results scan_data[64];
     int num_scan_data = 64;
 
@@ -602,6 +1098,21 @@ static jobject android_net_wifi_getScanResults(
     byte b = flush ? 0xFF : 0;
     int result = hal_fn.wifi_get_cached_gscan_results(handle, b, num_scan_data, scan_data, &num_scan_data);
     if (result == WIFI_SUCCESS) {
+        {
+            Mutex::Autolock _l(sSignificantChangeLock);
+            if (sSignificantChangeEngine.isActive()) {
+                for (int i = 0; i < num_scan_data; i++) {
+                    sSignificantChangeEngine.onScanResults(scan_data[i].results,
+                            scan_data[i].num_results);
+                }
+            }
+        }
+
+        if (num_scan_data > 0) {
+            Mutex::Autolock _l(sRoamLock);
+            sRoamScan.addMerged(scan_data, num_scan_data);
+        }
+
         JNIObject<jobjectArray> scanData = helper.createObjectArray(
                 "android/net/wifi/WifiScanner$ScanData", num_scan_data);
         if (scanData == NULL) {
@@ -609,6 +1120,7 @@ static jobject android_net_wifi_getScanResults(
             return NULL;
         }
 
+        wifi_timestamp now = filter.isEmpty() ? 0 : scanFilterNow();
         for (int i = 0; i < num_scan_data; i++) {
 
             JNIObject<jobject> data = helper.createObject("android/net/wifi/WifiScanner$ScanData");
@@ -624,17 +1136,23 @@ static jobject android_net_wifi_getScanResults(
             qsort(scan_data[i].results, scan_data[i].num_results,
                     sizeof(wifi_scan_result), compare_scan_result_timestamp);
 
+            /* only the results that pass the filter get objects made for them */
+            wifi_scan_result *results = scan_data[i].results;
+            int selected[MAX_AP_CACHE_PER_SCAN];
+            int num_selected = filter.select(results, scan_data[i].num_results, now, selected);
+
             JNIObject<jobjectArray> scanResults = helper.createObjectArray(
-                    "android/net/wifi/ScanResult", scan_data[i].num_results);
+                    "android/net/wifi/ScanResult", num_selected);
             if (scanResults == NULL) {
                 ALOGE("Error in allocating scanResult array");
                 return NULL;
             }
 
-            wifi_scan_result *results = scan_data[i].results;
-            for (int j = 0; j < scan_data[i].num_results; j++) {
+            JNI_CALL_BYTES(num_selected * sizeof(wifi_scan_result));
+            traceCounter("wifi_scan_results_per_batch", scan_data[i].num_results);
+            for (int j = 0; j < num_selected; j++) {
 
-                JNIObject<jobject> scanResult = createScanResult(helper, &results[j]);
+                JNIObject<jobject> scanResult = createScanResult(helper, &results[selected[j]]);
                 if (scanResult == NULL) {
                     ALOGE("Error in creating scan result");
                     return NULL;
@@ -657,6 +1175,7 @@ static jobject android_net_wifi_getScanResults(
 
 static jboolean android_net_wifi_getScanCapabilities(
         JNIEnv *env, jclass cls, jint iface, jobject capabilities) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -683,48 +1202,6 @@ static jboolean android_net_wifi_getScanCapabilities(
 }
 
 
-static byte parseHexChar(char ch) {
-    if (isdigit(ch))
-        return ch - '0';
-    else if ('A' <= ch && ch <= 'F')
-        return ch - 'A' + 10;
-    else if ('a' <= ch && ch <= 'f')
-        return ch - 'a' + 10;
-    else {
-        ALOGE("invalid character in bssid %c", ch);
-        return 0;
-    }
-}
-
-static byte parseHexByte(const char * &str) {
-    if (str[0] == '\0') {
-        ALOGE("Passed an empty string");
-        return 0;
-    }
-    byte b = parseHexChar(str[0]);
-    if (str[1] == '\0' || str[1] == ':') {
-        str ++;
-    } else {
-        b = b << 4 | parseHexChar(str[1]);
-        str += 2;
-    }
-
-    // Skip trailing delimiter if not at the end of the string.
-    if (str[0] != '\0') {
-        str++;
-    }
-    return b;
-}
-
-static void parseMacAddress(const char *str, mac_addr addr) {
-    addr[0] = parseHexByte(str);
-    addr[1] = parseHexByte(str);
-    addr[2] = parseHexByte(str);
-    addr[3] = parseHexByte(str);
-    addr[4] = parseHexByte(str);
-    addr[5] = parseHexByte(str);
-}
-
 static bool parseMacAddress(JNIEnv *env, jobject obj, mac_addr addr) {
     JNIHelper helper(env);
     JNIObject<jstring> macAddrString = helper.getStringField(obj, "bssid");
@@ -744,89 +1221,130 @@ static bool parseMacAddress(JNIEnv *env, jobject obj, mac_addr addr) {
     return true;
 }
 
-static void onHotlistApFound(wifi_request_id id,
-        unsigned num_results, wifi_scan_result *results) {
-
-    JNIHelper helper(mVM);
-    ALOGD("onHotlistApFound called, vm = %p, obj = %p, num_results = %d", mVM, mCls, num_results);
+/* reports each requester the results for the BSSIDs it asked for, under its own id */
+static void reportHotlistResults(JNIHelper &helper, const char *event, bool lost,
+        wifi_request_id id, unsigned num_results, wifi_scan_result *results) {
 
-    JNIObject<jobjectArray> scanResults = helper.newObjectArray(num_results,
-            "android/net/wifi/ScanResult", NULL);
-    if (scanResults == NULL) {
-        ALOGE("Error in allocating array");
+    if (id != HotlistMux::kHalRequestId) {
+        ALOGD("dropping %s for stale hotlist [%d]", event, id);
         return;
     }
 
-    for (unsigned i = 0; i < num_results; i++) {
+    std::vector<HotlistMatch> matches;
+    sHotlistMux.match(lost, results, num_results, matches);
 
-        JNIObject<jobject> scanResult = createScanResult(helper, &results[i]);
-        if (scanResult == NULL) {
-            ALOGE("Error in creating scan result");
+    for (size_t r = 0; r < matches.size(); r++) {
+        const std::vector<unsigned> &match = matches[r].results;
+        JNIObject<jobjectArray> scanResults = helper.newObjectArray(match.size(),
+                "android/net/wifi/ScanResult", NULL);
+        if (scanResults == NULL) {
+            ALOGE("Error in allocating array");
             return;
         }
 
-        helper.setObjectArrayElement(scanResults, i, scanResult);
+        for (size_t i = 0; i < match.size(); i++) {
+            JNIObject<jobject> scanResult = createScanResult(helper, &results[match[i]]);
+            if (scanResult == NULL) {
+                ALOGE("Error in creating scan result");
+                return;
+            }
+
+            helper.setObjectArrayElement(scanResults, i, scanResult);
+        }
 
-        ALOGD("Found AP %32s", results[i].ssid);
+        helper.reportEvent(mCls, event, "(I[Landroid/net/wifi/ScanResult;)V",
+                matches[r].id, scanResults.get());
     }
+}
 
-    helper.reportEvent(mCls, "onHotlistApFound", "(I[Landroid/net/wifi/ScanResult;)V",
-        id, scanResults.get());
+static void onHotlistApFound(wifi_request_id id,
+        unsigned num_results, wifi_scan_result *results) {
+    HAL_CALLBACK_STATS();
+
+    sHalTrace.recordScanResults(HAL_TRACE_HOTLIST_AP_FOUND, id, num_results, results);
+
+    JNIHelper helper(mVM);
+    ALOGD("onHotlistApFound called, vm = %p, obj = %p, num_results = %d", mVM, mCls, num_results);
+
+    reportHotlistResults(helper, "onHotlistApFound", false, id, num_results, results);
 }
 
 static void onHotlistApLost(wifi_request_id id,
         unsigned num_results, wifi_scan_result *results) {
+    HAL_CALLBACK_STATS();
+
+    sHalTrace.recordScanResults(HAL_TRACE_HOTLIST_AP_LOST, id, num_results, results);
 
     JNIHelper helper(mVM);
     ALOGD("onHotlistApLost called, vm = %p, obj = %p, num_results = %d", mVM, mCls, num_results);
 
-    JNIObject<jobjectArray> scanResults = helper.newObjectArray(num_results,
-            "android/net/wifi/ScanResult", NULL);
-    if (scanResults == NULL) {
-        ALOGE("Error in allocating array");
-        return;
-    }
+    reportHotlistResults(helper, "onHotlistApLost", true, id, num_results, results);
+}
 
-    for (unsigned i = 0; i < num_results; i++) {
+/*
+ * Reprograms the HAL hotlist with the union of all requests, if that changed. The list is
+ * always installed under the mux's own request id; the one installed before is reset first
+ * so that the HAL does not keep it around.
+ */
+static bool updateHotlist(wifi_interface_handle handle) {
 
-        JNIObject<jobject> scanResult = createScanResult(helper, &results[i]);
-        if (scanResult == NULL) {
-            ALOGE("Error in creating scan result");
-            return;
+    wifi_request_id id = HotlistMux::kHalRequestId;
+    if (sHotlistMux.isEmpty()) {
+        if (!sHotlistMux.isProgrammed()) {
+            return true;
         }
+        sHotlistMux.resetProgrammed();
+        return hal_fn.wifi_reset_bssid_hotlist(id, handle) == WIFI_SUCCESS;
+    }
 
-        helper.setObjectArrayElement(scanResults, i, scanResult);
+    wifi_bssid_hotlist_params params;
+    sHotlistMux.build(&params);
+    if (sHotlistMux.isProgrammed(params)) {
+        ALOGD("hotlist of %d BSSIDs unchanged", params.num_bssid);
+        return true;
+    }
 
-        ALOGD("Lost AP %32s", results[i].ssid);
+    if (sHotlistMux.isProgrammed()) {
+        sHotlistMux.resetProgrammed();
+        hal_fn.wifi_reset_bssid_hotlist(id, handle);
     }
 
-    helper.reportEvent(mCls, "onHotlistApLost", "(I[Landroid/net/wifi/ScanResult;)V",
-        id, scanResults.get());
-}
+    wifi_hotlist_ap_found_handler handler;
+    memset(&handler, 0, sizeof(handler));
+
+    handler.on_hotlist_ap_found = &onHotlistApFound;
+    handler.on_hotlist_ap_lost  = &onHotlistApLost;
 
+    ALOGD("programming hotlist of %d BSSIDs [%d]", params.num_bssid, id);
+    if (hal_fn.wifi_set_bssid_hotlist(id, handle, params, handler) != WIFI_SUCCESS) {
+        return false;
+    }
+
+    sHotlistMux.setProgrammed(params);
+    return true;
+}
 
 static jboolean android_net_wifi_setHotlist(
         JNIEnv *env, jclass cls, jint iface, jint id, jobject ap)  {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
-    ALOGD("setting hotlist on interface[%d] = %p", iface, handle);
-
-    wifi_bssid_hotlist_params params;
-    memset(&params, 0, sizeof(params));
+    ALOGD("setting hotlist [%d] on interface[%d] = %p", id, iface, handle);
 
-    params.lost_ap_sample_size = helper.getIntField(ap, "apLostThreshold");
+    int lostApSampleSize = helper.getIntField(ap, "apLostThreshold");
 
     JNIObject<jobjectArray> array = helper.getArrayField(
             ap, "bssidInfos", "[Landroid/net/wifi/WifiScanner$BssidInfo;");
-    params.num_bssid = helper.getArrayLength(array);
+    int num_bssid = helper.getArrayLength(array);
 
-    if (params.num_bssid == 0) {
-        ALOGE("Error in accesing array");
+    if (num_bssid <= 0 || num_bssid > MAX_HOTLIST_APS) {
+        ALOGE("Error in hotlist size %d", num_bssid);
         return false;
     }
 
-    for (int i = 0; i < params.num_bssid; i++) {
+    std::vector<ap_threshold_param> aps(num_bssid);
+    for (int i = 0; i < num_bssid; i++) {
         JNIObject<jobject> objAp = helper.getObjectArrayElement(array, i);
 
         JNIObject<jstring> macAddrString = helper.getStringField(objAp, "bssid");
@@ -841,40 +1359,38 @@ static jboolean android_net_wifi_setHotlist(
             ALOGE("Error getting bssid");
             return false;
         }
-        parseMacAddress(bssid, params.ap[i].bssid);
-
-        mac_addr addr;
-        memcpy(addr, params.ap[i].bssid, sizeof(mac_addr));
-
-        char bssidOut[32];
-        sprintf(bssidOut, "%0x:%0x:%0x:%0x:%0x:%0x", addr[0], addr[1],
-            addr[2], addr[3], addr[4], addr[5]);
-
-        ALOGD("Added bssid %s", bssidOut);
+        parseMacAddress(bssid, aps[i].bssid);
 
-        params.ap[i].low = helper.getIntField(objAp, "low");
-        params.ap[i].high = helper.getIntField(objAp, "high");
+        aps[i].low = helper.getIntField(objAp, "low");
+        aps[i].high = helper.getIntField(objAp, "high");
     }
 
-    wifi_hotlist_ap_found_handler handler;
-    memset(&handler, 0, sizeof(handler));
-
-    handler.on_hotlist_ap_found = &onHotlistApFound;
-    handler.on_hotlist_ap_lost  = &onHotlistApLost;
-    return hal_fn.wifi_set_bssid_hotlist(id, handle, params, handler) == WIFI_SUCCESS;
+    sHotlistMux.set(id, lostApSampleSize, &aps[0], num_bssid);
+    if (!updateHotlist(handle)) {
+        /* put back what the other requesters had */
+        sHotlistMux.remove(id);
+        updateHotlist(handle);
+        return false;
+    }
+    return true;
 }
 
 static jboolean android_net_wifi_resetHotlist(JNIEnv *env, jclass cls, jint iface, jint id)  {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
-    ALOGD("resetting hotlist on interface[%d] = %p", iface, handle);
+    ALOGD("resetting hotlist [%d] on interface[%d] = %p", id, iface, handle);
 
-    return hal_fn.wifi_reset_bssid_hotlist(id, handle) == WIFI_SUCCESS;
+    sHotlistMux.remove(id);
+    return updateHotlist(handle);
 }
 
 void onSignificantWifiChange(wifi_request_id id,
         unsigned num_results, wifi_significant_change_result **results) {
+    HAL_CALLBACK_STATS();
+
+    sHalTrace.recordSignificantChange(id, num_results, results);
 
     JNIHelper helper(mVM);
 
@@ -919,6 +1435,7 @@ void onSignificantWifiChange(wifi_request_id id,
 
 static jboolean android_net_wifi_trackSignificantWifiChange(
         JNIEnv *env, jclass cls, jint iface, jint id, jobject settings)  {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -980,26 +1497,101 @@ static jboolean android_net_wifi_trackSignificantWifiChange(
     memset(&handler, 0, sizeof(handler));
 
     handler.on_significant_change = &onSignificantWifiChange;
-    return hal_fn.wifi_set_significant_change_handler(id, handle, params, handler) == WIFI_SUCCESS;
+    int result = WIFI_ERROR_NOT_SUPPORTED;
+    if (sHalCapabilities & HAL_CAPABILITY_SIGNIFICANT_CHANGE) {
+        result = hal_fn.wifi_set_significant_change_handler(id, handle, params, handler);
+    }
+    if (result == WIFI_SUCCESS) {
+        Mutex::Autolock _l(sSignificantChangeLock);
+        sSignificantChangeEngine.stop();
+        return true;
+    }
+
+    if (result == WIFI_ERROR_NOT_SUPPORTED) {
+        /* fed from getScanResults from here on */
+        Mutex::Autolock _l(sSignificantChangeLock);
+        return sSignificantChangeEngine.start(id, params, handler);
+    }
+
+    return false;
 }
 
 static jboolean android_net_wifi_untrackSignificantWifiChange(
         JNIEnv *env, jclass cls, jint iface, jint id)  {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
     ALOGD("resetting significant wifi change on interface[%d] = %p", iface, handle);
 
+    {
+        Mutex::Autolock _l(sSignificantChangeLock);
+        if (sSignificantChangeEngine.isActive() && sSignificantChangeEngine.id() == id) {
+            sSignificantChangeEngine.stop();
+            return true;
+        }
+    }
+
     return hal_fn.wifi_reset_significant_change_handler(id, handle) == WIFI_SUCCESS;
 }
 
 wifi_iface_stat link_stat;
 wifi_radio_stat radio_stat; // L release has support for only one radio
 
+/*
+ * The link layer stats callback carries no length, only the counts below, so the walk over
+ * the peers is bounded by caps on them; the stats of no real chip come close to either.
+ */
+#define MAX_LINK_STATS_PEERS 64
+#define MAX_PEER_RATE_STATS 128
+
+static void updateTdlsTraffic(const wifi_iface_stat *iface_stat)
+{
+    Mutex::Autolock _l(sTdlsLock);
+    if (!sTdlsManager.isEnabled()) {
+        return;
+    }
+
+    /* each peer is followed by its per-rate stats, so the entries vary in length */
+    std::vector<TdlsPeerTraffic> traffic;
+    if (iface_stat->num_peers > MAX_LINK_STATS_PEERS) {
+        /* a sample missing peers would read as those peers going idle */
+        ALOGE("link layer stats report %u peers; sample dropped", iface_stat->num_peers);
+        return;
+    }
+    const u8 *next = (const u8 *) iface_stat->peer_info;
+    for (u32 i = 0; i < iface_stat->num_peers; i++) {
+        const wifi_peer_info *peer = (const wifi_peer_info *) next;
+        if (peer->num_rate > MAX_PEER_RATE_STATS) {
+            /* the layout can't be trusted from here on; a partial sample would read as idle */
+            ALOGE("link layer stats peer %u has %u rates; sample dropped", i, peer->num_rate);
+            return;
+        }
+        next += sizeof(wifi_peer_info) + peer->num_rate * sizeof(wifi_rate_stat);
+        if (peer->type == WIFI_PEER_AP) {
+            continue;
+        }
+        TdlsPeerTraffic entry;
+        memcpy(entry.addr, peer->peer_mac_address, sizeof(mac_addr));
+        entry.mpdus = 0;
+        for (u32 j = 0; j < peer->num_rate; j++) {
+            entry.mpdus += peer->rate_stats[j].tx_mpdu + peer->rate_stats[j].rx_mpdu;
+        }
+        traffic.push_back(entry);
+    }
+    sTdlsManager.update(traffic.empty() ? NULL : &traffic[0], traffic.size(),
+            systemTime(SYSTEM_TIME_MONOTONIC));
+}
+
 void onLinkStatsResults(wifi_request_id id, wifi_iface_stat *iface_stat,
          int num_radios, wifi_radio_stat *radio_stats)
 {
+    HAL_CALLBACK_STATS();
+
+    sHalTrace.recordLinkStats(id, iface_stat, num_radios, radio_stats);
+
     if (iface_stat != 0) {
+        updateTdlsTraffic(iface_stat);
         memcpy(&link_stat, iface_stat, sizeof(wifi_iface_stat));
     } else {
         memset(&link_stat, 0, sizeof(wifi_iface_stat));
@@ -1012,7 +1604,64 @@ void onLinkStatsResults(wifi_request_id id, wifi_iface_stat *iface_stat,
     }
 }
 
+static void on_tdls_state_changed(mac_addr addr, wifi_tdls_status status) {
+    HAL_CALLBACK_STATS();
+
+    {
+        Mutex::Autolock _l(sTdlsLock);
+        sTdlsManager.onStateChanged(addr, status.state, systemTime(SYSTEM_TIME_MONOTONIC));
+    }
+
+    JNIHelper helper(mVM);
+
+    ALOGD("on_tdls_state_changed is called: vm = %p, obj = %p", mVM, mCls);
+
+    char mac[32];
+    sprintf(mac, "%02x:%02x:%02x:%02x:%02x:%02x", addr[0], addr[1], addr[2], addr[3], addr[4],
+            addr[5]);
+
+    JNIObject<jstring> mac_address = helper.newStringUTF(mac);
+    helper.reportEvent(mCls, "onTdlsStatus", "(Ljava/lang/String;II)V",
+        mac_address.get(), status.state, status.reason);
+
+}
+
+/* carries out what sTdlsManager decided while taking link layer stats, outside the callback */
+static void applyTdlsDecisions(wifi_interface_handle handle)
+{
+    std::vector<TdlsPeerAddr> setup;
+    std::vector<TdlsPeerAddr> teardown;
+    {
+        Mutex::Autolock _l(sTdlsLock);
+        sTdlsManager.takePending(setup, teardown);
+    }
+
+    for (size_t i = 0; i < teardown.size(); i++) {
+        wifi_error ret = hal_fn.wifi_disable_tdls(handle, teardown[i].addr);
+        const u8 *addr = teardown[i].addr;
+        ALOGD("auto TDLS teardown with %02x:%02x:%02x:%02x:%02x:%02x returned %d", addr[0],
+                addr[1], addr[2], addr[3], addr[4], addr[5], ret);
+    }
+
+    wifi_tdls_handler tdls_handler;
+    memset(&tdls_handler, 0, sizeof(tdls_handler));
+    tdls_handler.on_tdls_state_changed = &on_tdls_state_changed;
+    for (size_t i = 0; i < setup.size(); i++) {
+        wifi_error ret = hal_fn.wifi_enable_tdls(handle, setup[i].addr, NULL, tdls_handler);
+        const u8 *addr = setup[i].addr;
+        ALOGD("auto TDLS setup with %02x:%02x:%02x:%02x:%02x:%02x returned %d", addr[0],
+                addr[1], addr[2], addr[3], addr[4], addr[5], ret);
+        if (ret != WIFI_SUCCESS) {
+            Mutex::Autolock _l(sTdlsLock);
+            sTdlsManager.onStateChanged(setup[i].addr, WIFI_TDLS_FAILED,
+                    systemTime(SYSTEM_TIME_MONOTONIC));
+        }
+    }
+}
+
 static void android_net_wifi_setLinkLayerStats (JNIEnv *env, jclass cls, jint iface, int enable)  {
+    JNI_CALL_STATS();
+
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
 
@@ -1026,6 +1675,7 @@ static void android_net_wifi_setLinkLayerStats (JNIEnv *env, jclass cls, jint if
 }
 
 static jobject android_net_wifi_getLinkLayerStats (JNIEnv *env, jclass cls, jint iface)  {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_stats_result_handler handler;
@@ -1037,6 +1687,8 @@ static jobject android_net_wifi_getLinkLayerStats (JNIEnv *env, jclass cls, jint
         ALOGE("android_net_wifi_getLinkLayerStats: failed to get link statistics\n");
         return NULL;
     }
+    applyTdlsDecisions(handle);
+    JNI_CALL_BYTES(sizeof(link_stat));
 
     JNIObject<jobject> wifiLinkLayerStats = helper.createObject(
             "android/net/wifi/WifiLinkLayerStats");
@@ -1073,35 +1725,23 @@ static jobject android_net_wifi_getLinkLayerStats (JNIEnv *env, jclass cls, jint
 }
 
 static jint android_net_wifi_getSupportedFeatures(JNIEnv *env, jclass cls, jint iface) {
+    JNI_CALL_STATS();
 
-    JNIHelper helper(env);
-    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
-    feature_set set = 0;
-
-    wifi_error result = WIFI_SUCCESS;
     /*
-    set = WIFI_FEATURE_INFRA
-        | WIFI_FEATURE_INFRA_5G
-        | WIFI_FEATURE_HOTSPOT
-        | WIFI_FEATURE_P2P
-        | WIFI_FEATURE_SOFT_AP
-        | WIFI_FEATURE_GSCAN
-        | WIFI_FEATURE_PNO
-        | WIFI_FEATURE_TDLS
-        | WIFI_FEATURE_EPR;
-    */
-
-    result = hal_fn.wifi_get_supported_feature_set(handle, &set);
-    if (result == WIFI_SUCCESS) {
-        // ALOGD("wifi_get_supported_feature_set returned set = 0x%x", set);
-        return set;
-    } else {
-        ALOGE("wifi_get_supported_feature_set returned error = 0x%x", result);
-        return 0;
+     * registered as a fast native, so this must never call into the HAL; the feature sets
+     * are read once per interface by getInterfaces, and until then nothing is supported
+     */
+    if (iface >= 0 && iface < sNumIfaces.load(std::memory_order_acquire)) {
+        return sIfaceFeatures[iface];
     }
+    return 0;
 }
 
 static void onRttResults(wifi_request_id id, unsigned num_results, wifi_rtt_result* results[]) {
+    HAL_CALLBACK_STATS();
+
+    sHalTrace.recordRttResults(id, num_results, results);
+    JNI_CALL_BYTES(num_results * sizeof(wifi_rtt_result));
 
     JNIHelper helper(mVM);
 
@@ -1192,6 +1832,7 @@ const int MaxRttConfigs = 16;
 
 static jboolean android_net_wifi_requestRange(
         JNIEnv *env, jclass cls, jint iface, jint id, jobject params)  {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
 
@@ -1257,6 +1898,7 @@ static jboolean android_net_wifi_requestRange(
 
 static jboolean android_net_wifi_cancelRange(
         JNIEnv *env, jclass cls, jint iface, jint id, jobject params)  {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -1286,6 +1928,7 @@ static jboolean android_net_wifi_cancelRange(
 
 static jboolean android_net_wifi_setScanningMacOui(JNIEnv *env, jclass cls,
         jint iface, jbyteArray param)  {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -1309,11 +1952,18 @@ static jboolean android_net_wifi_setScanningMacOui(JNIEnv *env, jclass cls,
 }
 
 static jboolean android_net_wifi_is_get_channels_for_band_supported(JNIEnv *env, jclass cls){
-    return (hal_fn.wifi_get_valid_channels == wifi_get_valid_channels_stub);
+    JNI_CALL_STATS();
+
+    return (sHalCapabilities & HAL_CAPABILITY_VALID_CHANNELS) != 0;
+}
+
+static jint android_net_wifi_get_hal_capabilities(JNIEnv *env, jclass cls) {
+    return sHalCapabilities;
 }
 
 static jintArray android_net_wifi_getValidChannels(JNIEnv *env, jclass cls,
         jint iface, jint band)  {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -1341,6 +1991,7 @@ static jintArray android_net_wifi_getValidChannels(JNIEnv *env, jclass cls,
 }
 
 static jboolean android_net_wifi_setDfsFlag(JNIEnv *env, jclass cls, jint iface, jboolean dfs) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -1352,6 +2003,7 @@ static jboolean android_net_wifi_setDfsFlag(JNIEnv *env, jclass cls, jint iface,
 }
 
 static jobject android_net_wifi_get_rtt_capabilities(JNIEnv *env, jclass cls, jint iface) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_rtt_capabilities rtt_capabilities;
@@ -1391,6 +2043,7 @@ static jobject android_net_wifi_get_rtt_capabilities(JNIEnv *env, jclass cls, ji
 
 static jboolean android_net_wifi_set_Country_Code_Hal(JNIEnv *env,jclass cls, jint iface,
         jstring country_code) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -1405,6 +2058,7 @@ static jboolean android_net_wifi_set_Country_Code_Hal(JNIEnv *env,jclass cls, ji
 
 static jboolean android_net_wifi_enable_disable_tdls(JNIEnv *env,jclass cls, jint iface,
         jboolean enable, jstring addr) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -1412,32 +2066,58 @@ static jboolean android_net_wifi_enable_disable_tdls(JNIEnv *env,jclass cls, jin
     mac_addr address;
     parseMacAddress(env, addr, address);
     wifi_tdls_handler tdls_handler;
-    //tdls_handler.on_tdls_state_changed = &on_tdls_state_changed;
+    memset(&tdls_handler, 0, sizeof(tdls_handler));
+    tdls_handler.on_tdls_state_changed = &on_tdls_state_changed;
 
+    wifi_error ret;
     if(enable) {
-        return (hal_fn.wifi_enable_tdls(handle, address, NULL, tdls_handler) == WIFI_SUCCESS);
+        ret = hal_fn.wifi_enable_tdls(handle, address, NULL, tdls_handler);
     } else {
-        return (hal_fn.wifi_disable_tdls(handle, address) == WIFI_SUCCESS);
+        ret = hal_fn.wifi_disable_tdls(handle, address);
     }
+    if (ret == WIFI_SUCCESS) {
+        Mutex::Autolock _l(sTdlsLock);
+        sTdlsManager.setManual(address, enable, systemTime(SYSTEM_TIME_MONOTONIC));
+    }
+    return ret == WIFI_SUCCESS;
 }
 
-static void on_tdls_state_changed(mac_addr addr, wifi_tdls_status status) {
+static jboolean android_net_wifi_set_tdls_auto(JNIEnv *env, jclass cls, jint iface,
+        jboolean enable, jint setupRate, jint teardownRate) {
+    JNI_CALL_STATS();
 
-    JNIHelper helper(mVM);
+    JNIHelper helper(env);
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
 
-    ALOGD("on_tdls_state_changed is called: vm = %p, obj = %p", mVM, mCls);
+    if (!enable) {
+        {
+            Mutex::Autolock _l(sTdlsLock);
+            sTdlsManager.disable();
+        }
+        applyTdlsDecisions(handle);
+        return true;
+    }
 
-    char mac[32];
-    sprintf(mac, "%02x:%02x:%02x:%02x:%02x:%02x", addr[0], addr[1], addr[2], addr[3], addr[4],
-            addr[5]);
+    if (setupRate <= 0 || teardownRate < 0) {
+        return false;
+    }
 
-    JNIObject<jstring> mac_address = helper.newStringUTF(mac);
-    helper.reportEvent(mCls, "onTdlsStatus", "(Ljava/lang/StringII;)V",
-        mac_address.get(), status.state, status.reason);
+    wifi_tdls_capabilities capabilities;
+    memset(&capabilities, 0, sizeof(capabilities));
+    wifi_error ret = hal_fn.wifi_get_tdls_capabilities(handle, &capabilities);
+    if (ret != WIFI_SUCCESS || !capabilities.is_per_mac_tdls_supported
+            || capabilities.max_concurrent_tdls_session_num <= 0) {
+        ALOGD("auto TDLS not supported: %d", ret);
+        return false;
+    }
 
+    Mutex::Autolock _l(sTdlsLock);
+    sTdlsManager.enable(setupRate, teardownRate, capabilities.max_concurrent_tdls_session_num);
+    return true;
 }
 
 static jobject android_net_wifi_get_tdls_status(JNIEnv *env,jclass cls, jint iface,jstring addr) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -1464,6 +2144,7 @@ static jobject android_net_wifi_get_tdls_status(JNIEnv *env,jclass cls, jint ifa
 }
 
 static jobject android_net_wifi_get_tdls_capabilities(JNIEnv *env, jclass cls, jint iface) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_tdls_capabilities tdls_capabilities;
@@ -1501,6 +2182,8 @@ static jobject android_net_wifi_get_tdls_capabilities(JNIEnv *env, jclass cls, j
 // Debug framework
 // ----------------------------------------------------------------------------
 static jint android_net_wifi_get_supported_logger_feature(JNIEnv *env, jclass cls, jint iface){
+    JNI_CALL_STATS();
+
     //Not implemented yet
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -1508,6 +2191,8 @@ static jint android_net_wifi_get_supported_logger_feature(JNIEnv *env, jclass cl
 }
 
 static jobject android_net_wifi_get_driver_version(JNIEnv *env, jclass cls, jint iface) {
+    JNI_CALL_STATS();
+
      //Need to be fixed. The memory should be allocated from lower layer
     //char *buffer = NULL;
     JNIHelper helper(env);
@@ -1538,6 +2223,7 @@ static jobject android_net_wifi_get_driver_version(JNIEnv *env, jclass cls, jint
 }
 
 static jobject android_net_wifi_get_firmware_version(JNIEnv *env, jclass cls, jint iface) {
+    JNI_CALL_STATS();
 
     //char *buffer = NULL;
     JNIHelper helper(env);
@@ -1567,7 +2253,35 @@ static jobject android_net_wifi_get_firmware_version(JNIEnv *env, jclass cls, ji
     }
 }
 
+/* the HAL truncates the status to the number of rings it is given room for */
+static const u32 kInitialRingCount = 16;
+static const u32 kMaxRingCount = 256;
+
+static wifi_error refresh_ring_buffer_status(wifi_interface_handle handle) {
+
+    std::vector<wifi_ring_buffer_status> status;
+    u32 capacity = kInitialRingCount;
+    u32 num_rings;
+    while (true) {
+        status.assign(capacity, wifi_ring_buffer_status());
+        num_rings = capacity;
+        wifi_error result = hal_fn.wifi_get_ring_buffers_status(handle, &num_rings, &status[0]);
+        if (result != WIFI_SUCCESS) {
+            return result;
+        }
+
+        if (num_rings < capacity || capacity >= kMaxRingCount) {
+            break;
+        }
+        capacity *= 2;
+    }
+
+    sRingStatusTable.set(&status[0], num_rings < capacity ? num_rings : capacity);
+    return WIFI_SUCCESS;
+}
+
 static jobject android_net_wifi_get_ring_buffer_status (JNIEnv *env, jclass cls, jint iface) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -1578,59 +2292,59 @@ static jobject android_net_wifi_get_ring_buffer_status (JNIEnv *env, jclass cls,
         return NULL;
     }
 
-    //wifi_ring_buffer_status *status = NULL;
-    u32 num_rings = 10;
-    wifi_ring_buffer_status *status =
-        (wifi_ring_buffer_status *)malloc(sizeof(wifi_ring_buffer_status) * num_rings);
-    if (!status) return NULL;
-    memset(status, 0, sizeof(wifi_ring_buffer_status) * num_rings);
-    wifi_error result = hal_fn.wifi_get_ring_buffers_status(handle, &num_rings, status);
-    if (result == WIFI_SUCCESS) {
-        ALOGD("status is %p, number is %d", status, num_rings);
+    if (!sRingStatusTable.isQueried()) {
+        wifi_error result = refresh_ring_buffer_status(handle);
+        if (result != WIFI_SUCCESS) {
+            ALOGE("Fail to get ring buffer status: %d", result);
+            return NULL;
+        }
+    }
 
-        JNIObject<jobjectArray> ringBuffersStatus = helper.newObjectArray(
-            num_rings, "com/android/server/wifi/WifiNative$RingBufferStatus", NULL);
+    std::vector<wifi_ring_buffer_status> status;
+    sRingStatusTable.snapshot(status);
 
-        wifi_ring_buffer_status *tmp = status;
+    JNIObject<jobjectArray> ringBuffersStatus = helper.newObjectArray(
+        status.size(), "com/android/server/wifi/WifiNative$RingBufferStatus", NULL);
 
-        for(u32 i = 0; i < num_rings; i++, tmp++) {
+    for (size_t i = 0; i < status.size(); i++) {
 
-            JNIObject<jobject> ringStatus = helper.createObject(
-                    "com/android/server/wifi/WifiNative$RingBufferStatus");
+        JNIObject<jobject> ringStatus = helper.createObject(
+                "com/android/server/wifi/WifiNative$RingBufferStatus");
 
-            if (ringStatus == NULL) {
-                ALOGE("Error in creating ringBufferStatus");
-                free(status);
-                return NULL;
-            }
+        if (ringStatus == NULL) {
+            ALOGE("Error in creating ringBufferStatus");
+            return NULL;
+        }
 
-            char name[32];
-            for(int j = 0; j < 32; j++) {
-                name[j] = tmp->name[j];
-            }
+        /* the table keeps the names nul terminated */
+        helper.setStringField(ringStatus, "name", (const char *)status[i].name);
+        helper.setIntField(ringStatus, "flag", status[i].flags);
+        helper.setIntField(ringStatus, "ringBufferId", status[i].ring_id);
+        helper.setIntField(ringStatus, "ringBufferByteSize", status[i].ring_buffer_byte_size);
+        helper.setIntField(ringStatus, "verboseLevel", status[i].verbose_level);
+        helper.setIntField(ringStatus, "writtenBytes", status[i].written_bytes);
+        helper.setIntField(ringStatus, "readBytes", status[i].read_bytes);
+        helper.setIntField(ringStatus, "writtenRecords", status[i].written_records);
+
+        helper.setObjectArrayElement(ringBuffersStatus, i, ringStatus);
+    }
 
-            helper.setStringField(ringStatus, "name", name);
-            helper.setIntField(ringStatus, "flag", tmp->flags);
-            helper.setIntField(ringStatus, "ringBufferId", tmp->ring_id);
-            helper.setIntField(ringStatus, "ringBufferByteSize", tmp->ring_buffer_byte_size);
-            helper.setIntField(ringStatus, "verboseLevel", tmp->verbose_level);
-            helper.setIntField(ringStatus, "writtenBytes", tmp->written_bytes);
-            helper.setIntField(ringStatus, "readBytes", tmp->read_bytes);
-            helper.setIntField(ringStatus, "writtenRecords", tmp->written_records);
+    return ringBuffersStatus.detach();
+}
 
-            helper.setObjectArrayElement(ringBuffersStatus, i, ringStatus);
-        }
+static void android_net_wifi_set_ring_buffer_status_threshold(JNIEnv *env, jclass cls,
+        jint bytes) {
+    JNI_CALL_STATS();
 
-        free(status);
-        return ringBuffersStatus.detach();
-    } else {
-        free(status);
-        return NULL;
-    }
+    sRingStatusTable.setThreshold(bytes > 0 ? bytes : 0);
 }
 
+/* once enabled, ring buffer data is appended to per ring files instead of going up to Java */
+static RingLogSink *sRingLogSink = NULL;
+
 static void on_ring_buffer_data(char *ring_name, char *buffer, int buffer_size,
         wifi_ring_buffer_status *status) {
+    HAL_CALLBACK_STATS();
 
     if (!ring_name || !buffer || !status ||
             (unsigned int)buffer_size <= sizeof(wifi_ring_buffer_entry)) {
@@ -1638,8 +2352,31 @@ static void on_ring_buffer_data(char *ring_name, char *buffer, int buffer_size,
         return;
     }
 
+    sHalTrace.recordRingBufferData(ring_name, buffer, buffer_size, status);
 
     JNIHelper helper(mVM);
+
+    size_t written = 0;
+    bool wrapped = false;
+    if (sRingLogSink != NULL) {
+        written = sRingLogSink->append(ring_name, buffer, buffer_size, status, &wrapped);
+    }
+
+    RingStatusChange change;
+    if (sRingStatusTable.update(status, written, wrapped, &change)) {
+        helper.reportEvent(mCls, "onRingBufferStatusChanged", "(IIII)V", change.status.ring_id,
+                change.status.written_bytes, change.status.read_bytes,
+                change.status.written_records);
+        if (sRingLogSink != NULL) {
+            helper.reportEvent(mCls, "onRingBufferDataWritten", "(IIZ)V",
+                    change.status.ring_id, (jint)change.logBytes, (jboolean)change.logWrapped);
+        }
+    }
+
+    if (sRingLogSink != NULL) {
+        return;
+    }
+
     /* ALOGD("on_ring_buffer_data called, vm = %p, obj = %p, env = %p buffer size = %d", mVM,
             mCls, env, buffer_size); */
 
@@ -1661,6 +2398,7 @@ static void on_ring_buffer_data(char *ring_name, char *buffer, int buffer_size,
 
     JNIObject<jbyteArray> bytes = helper.newByteArray(buffer_size);
     helper.setByteArrayRegion(bytes, 0, buffer_size, (jbyte*)buffer);
+    JNI_CALL_BYTES(buffer_size);
 
     helper.reportEvent(mCls,"onRingBufferData",
             "(Lcom/android/server/wifi/WifiNative$RingBufferStatus;[B)V",
@@ -1668,6 +2406,9 @@ static void on_ring_buffer_data(char *ring_name, char *buffer, int buffer_size,
 }
 
 static void on_alert_data(wifi_request_id id, char *buffer, int buffer_size, int err_code){
+    HAL_CALLBACK_STATS();
+
+    sHalTrace.recordBuffer(HAL_TRACE_ALERT, id, err_code, buffer, buffer_size);
 
     JNIHelper helper(mVM);
     ALOGD("on_alert_data called, vm = %p, obj = %p, buffer_size = %d, error code = %d"
@@ -1677,6 +2418,7 @@ static void on_alert_data(wifi_request_id id, char *buffer, int buffer_size, int
         JNIObject<jbyteArray> records = helper.newByteArray(buffer_size);
         jbyte *bytes = (jbyte *) buffer;
         helper.setByteArrayRegion(records, 0,buffer_size, bytes);
+        JNI_CALL_BYTES(buffer_size);
         helper.reportEvent(mCls,"onWifiAlert","([BI)V", records.get(), err_code);
     } else {
         helper.reportEvent(mCls,"onWifiAlert","([BI)V", NULL, err_code);
@@ -1686,6 +2428,7 @@ static void on_alert_data(wifi_request_id id, char *buffer, int buffer_size, int
 
 static jboolean android_net_wifi_start_logging_ring_buffer(JNIEnv *env, jclass cls, jint iface,
         jint verbose_level,jint flags, jint max_interval,jint min_data_size, jstring ring_name) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -1712,6 +2455,7 @@ static jboolean android_net_wifi_start_logging_ring_buffer(JNIEnv *env, jclass c
 
 static jboolean android_net_wifi_get_ring_buffer_data(JNIEnv *env, jclass cls, jint iface,
         jstring ring_name) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -1724,66 +2468,279 @@ static jboolean android_net_wifi_get_ring_buffer_data(JNIEnv *env, jclass cls, j
 }
 
 
-void on_firmware_memory_dump(char *buffer, int buffer_size) {
-
-    JNIHelper helper(mVM);
-    /* ALOGD("on_firmware_memory_dump called, vm = %p, obj = %p, env = %p buffer_size = %d"
-            , mVM, mCls, env, buffer_size); */
+static jboolean android_net_wifi_enable_ring_buffer_log_sink(JNIEnv *env, jclass cls,
+        jstring dir, jint bytes_per_ring) {
+    JNI_CALL_STATS();
 
-    if (buffer_size > 0) {
-        JNIObject<jbyteArray> dump = helper.newByteArray(buffer_size);
-        jbyte *bytes = (jbyte *) (buffer);
-        helper.setByteArrayRegion(dump, 0, buffer_size, bytes);
-        helper.reportEvent(mCls,"onWifiFwMemoryAvailable","([B)V", dump.get());
+    if (sRingLogSink != NULL) {
+        /* the HAL thread may be writing to it; it stays for the life of the process */
+        return true;
     }
-}
-
-static jboolean android_net_wifi_get_fw_memory_dump(JNIEnv *env, jclass cls, jint iface){
 
-    JNIHelper helper(env);
-    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
-    // ALOGD("android_net_wifi_get_fw_memory_dump = %p", handle);
+    if (bytes_per_ring <= 0) {
+        ALOGE("Invalid ring log size %d", bytes_per_ring);
+        return false;
+    }
 
-    if (handle == NULL) {
-        ALOGE("Can not get wifi_interface_handle");
+    ScopedUtfChars chars(env, dir);
+    if (chars.c_str() == NULL) {
         return false;
     }
 
-    wifi_firmware_memory_dump_handler fw_dump_handle;
-    fw_dump_handle.on_firmware_memory_dump = on_firmware_memory_dump;
-    int result = hal_fn.wifi_get_firmware_memory_dump(handle, fw_dump_handle);
-    return result == WIFI_SUCCESS;
+    ALOGD("logging ring buffers to %s, %d bytes per ring", chars.c_str(), bytes_per_ring);
+    sRingLogSink = new RingLogSink(chars.c_str(), bytes_per_ring);
+    return true;
+}
+
+static jbyteArray createRingLogByteArray(JNIHelper &helper, const std::vector<char> &records) {
+
+    JNIObject<jbyteArray> bytes = helper.newByteArray(records.size());
+    if (bytes == NULL) {
+        ALOGE("Error in allocating ring log of %zu bytes", records.size());
+        return NULL;
+    }
 
+    if (records.size() > 0) {
+        helper.setByteArrayRegion(bytes, 0, records.size(), (jbyte *)&records[0]);
+    }
+    return bytes.detach();
 }
 
-static jboolean android_net_wifi_set_log_handler(JNIEnv *env, jclass cls, jint iface, jint id) {
+static jbyteArray android_net_wifi_read_ring_buffer_log(JNIEnv *env, jclass cls,
+        jstring ring_name) {
+    JNI_CALL_STATS();
 
-    JNIHelper helper(env);
-    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
-    ALOGD("android_net_wifi_set_log_handler = %p", handle);
+    if (sRingLogSink == NULL) {
+        return NULL;
+    }
 
-    //initialize the handler on first time
-    wifi_ring_buffer_data_handler handler;
-    handler.on_ring_buffer_data = &on_ring_buffer_data;
-    int result = hal_fn.wifi_set_log_handler(id, handle, handler);
-    if (result != WIFI_SUCCESS) {
-        ALOGE("Fail to set logging handler");
-        return false;
+    JNIHelper helper(env);
+    ScopedUtfChars chars(env, ring_name);
+    if (chars.c_str() == NULL) {
+        return NULL;
     }
 
-    //set alter handler This will start alert too
-    wifi_alert_handler alert_handler;
-    alert_handler.on_alert = &on_alert_data;
-    result = hal_fn.wifi_set_alert_handler(id, handle, alert_handler);
-    if (result != WIFI_SUCCESS) {
-        ALOGE(" Fail to set alert handler");
-        return false;
+    std::vector<char> records;
+    if (!sRingLogSink->read(chars.c_str(), records)) {
+        return NULL;
     }
 
-    return true;
+    JNI_CALL_BYTES(records.size());
+    return createRingLogByteArray(helper, records);
 }
 
-static jboolean android_net_wifi_reset_log_handler(JNIEnv *env, jclass cls, jint iface, jint id) {
+static jbyteArray android_net_wifi_query_ring_buffer_log(JNIEnv *env, jclass cls,
+        jstring ring_name, jint type_mask, jlong start, jlong end) {
+    JNI_CALL_STATS();
+
+    if (sRingLogSink == NULL) {
+        return NULL;
+    }
+
+    JNIHelper helper(env);
+    ScopedUtfChars chars(env, ring_name);
+    if (chars.c_str() == NULL) {
+        return NULL;
+    }
+
+    std::vector<char> records;
+    if (!sRingLogSink->query(chars.c_str(), type_mask, start, end, records)) {
+        return NULL;
+    }
+
+    JNI_CALL_BYTES(records.size());
+    return createRingLogByteArray(helper, records);
+}
+
+
+/* how long getFwMemoryDumpToFdNative waits for a HAL that delivers the dump after returning */
+#define FW_DUMP_CALLBACK_TIMEOUT_MS 5000
+
+/*
+ * set while getFwMemoryDumpToFdNative is waiting on the HAL; the dump is streamed into it.
+ * sFwDumpAbandoned is set when a streamed dump timed out, so that the late callback is
+ * dropped instead of being reported as a byte[] dump.
+ */
+static Mutex sFwDumpLock;
+static Condition sFwDumpCondition;
+static FwDumpWriter *sFwDumpWriter = NULL;
+static bool sFwDumpDelivered = false;
+static bool sFwDumpAbandoned = false;
+
+void on_firmware_memory_dump(char *buffer, int buffer_size) {
+    HAL_CALLBACK_STATS();
+
+    sHalTrace.recordBuffer(HAL_TRACE_FIRMWARE_MEMORY_DUMP, 0, buffer_size, buffer, buffer_size);
+
+    /* ALOGD("on_firmware_memory_dump called, vm = %p, obj = %p, env = %p buffer_size = %d"
+            , mVM, mCls, env, buffer_size); */
+
+    {
+        Mutex::Autolock _l(sFwDumpLock);
+        if (sFwDumpWriter != NULL) {
+            if (buffer_size > 0 && !sFwDumpWriter->append(buffer, buffer_size)) {
+                ALOGE("Fail to stream firmware memory dump");
+            }
+            sFwDumpDelivered = true;
+            sFwDumpCondition.signal();
+            return;
+        }
+        if (sFwDumpAbandoned) {
+            ALOGE("Dropping firmware memory dump delivered after its request timed out");
+            sFwDumpAbandoned = false;
+            return;
+        }
+    }
+
+    JNIHelper helper(mVM);
+    if (buffer_size > 0) {
+        JNIObject<jbyteArray> dump = helper.newByteArray(buffer_size);
+        jbyte *bytes = (jbyte *) (buffer);
+        helper.setByteArrayRegion(dump, 0, buffer_size, bytes);
+        JNI_CALL_BYTES(buffer_size);
+        helper.reportEvent(mCls,"onWifiFwMemoryAvailable","([B)V", dump.get());
+    }
+}
+
+static jboolean android_net_wifi_get_fw_memory_dump(JNIEnv *env, jclass cls, jint iface){
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
+    // ALOGD("android_net_wifi_get_fw_memory_dump = %p", handle);
+
+    if (handle == NULL) {
+        ALOGE("Can not get wifi_interface_handle");
+        return false;
+    }
+
+    {
+        Mutex::Autolock _l(sFwDumpLock);
+        sFwDumpAbandoned = false;
+    }
+
+    wifi_firmware_memory_dump_handler fw_dump_handle;
+    fw_dump_handle.on_firmware_memory_dump = on_firmware_memory_dump;
+    int result = hal_fn.wifi_get_firmware_memory_dump(handle, fw_dump_handle);
+    return result == WIFI_SUCCESS;
+
+}
+
+static jobject android_net_wifi_get_fw_memory_dump_to_fd(JNIEnv *env, jclass cls, jint iface,
+        jobject fileDescriptor, jboolean compress) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
+
+    if (handle == NULL) {
+        ALOGE("Can not get wifi_interface_handle");
+        return NULL;
+    }
+
+    int fd = jniGetFDFromFileDescriptor(env, fileDescriptor);
+    if (fd < 0) {
+        ALOGE("Invalid file descriptor for firmware memory dump");
+        return NULL;
+    }
+
+    FwDumpWriter writer(fd, compress);
+    if (writer.hasError()) {
+        return NULL;
+    }
+
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    wifi_firmware_memory_dump_handler fw_dump_handle;
+    fw_dump_handle.on_firmware_memory_dump = on_firmware_memory_dump;
+
+    {
+        Mutex::Autolock _l(sFwDumpLock);
+        sFwDumpWriter = &writer;
+        sFwDumpDelivered = false;
+        sFwDumpAbandoned = false;
+    }
+
+    /* most HALs deliver the dump from within this call; wait for the ones that don't */
+    int result = hal_fn.wifi_get_firmware_memory_dump(handle, fw_dump_handle);
+
+    bool delivered;
+    {
+        Mutex::Autolock _l(sFwDumpLock);
+        nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + ms2ns(FW_DUMP_CALLBACK_TIMEOUT_MS);
+        while (result == WIFI_SUCCESS && !sFwDumpDelivered) {
+            nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+            if (now >= deadline) {
+                break;
+            }
+            sFwDumpCondition.waitRelative(sFwDumpLock, deadline - now);
+        }
+        delivered = sFwDumpDelivered;
+        sFwDumpWriter = NULL;
+        sFwDumpAbandoned = result == WIFI_SUCCESS && !delivered;
+    }
+
+    if (result == WIFI_SUCCESS && !delivered) {
+        ALOGE("Firmware memory dump not delivered within %d ms", FW_DUMP_CALLBACK_TIMEOUT_MS);
+        return NULL;
+    }
+
+    bool finished = writer.finish();
+    nsecs_t duration = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    if (result != WIFI_SUCCESS || !finished) {
+        ALOGE("Fail to get firmware memory dump: %d", result);
+        return NULL;
+    }
+
+    ALOGD("firmware memory dump: %zu bytes, %zu written, crc %08x, %lld us", writer.rawBytes(),
+            writer.writtenBytes(), writer.checksum(), (long long)ns2us(duration));
+
+    JNIObject<jobject> info = helper.createObject(
+            "com/android/server/wifi/WifiNative$FwMemoryDumpInfo");
+    if (info == NULL) {
+        ALOGE("Error in creating FwMemoryDumpInfo");
+        return NULL;
+    }
+
+    helper.setLongField(info, "size", writer.rawBytes());
+    helper.setLongField(info, "writtenBytes", writer.writtenBytes());
+    helper.setLongField(info, "checksum", writer.checksum());
+    helper.setLongField(info, "durationNs", duration);
+    helper.setBooleanField(info, "compressed", writer.isCompressed());
+    return info.detach();
+}
+
+static jboolean android_net_wifi_set_log_handler(JNIEnv *env, jclass cls, jint iface, jint id) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
+    ALOGD("android_net_wifi_set_log_handler = %p", handle);
+
+    //initialize the handler on first time
+    wifi_ring_buffer_data_handler handler;
+    handler.on_ring_buffer_data = &on_ring_buffer_data;
+    int result = hal_fn.wifi_set_log_handler(id, handle, handler);
+    if (result != WIFI_SUCCESS) {
+        ALOGE("Fail to set logging handler");
+        return false;
+    }
+
+    //set alter handler This will start alert too
+    wifi_alert_handler alert_handler;
+    alert_handler.on_alert = &on_alert_data;
+    result = hal_fn.wifi_set_alert_handler(id, handle, alert_handler);
+    if (result != WIFI_SUCCESS) {
+        ALOGE(" Fail to set alert handler");
+        return false;
+    }
+
+    return true;
+}
+
+static jboolean android_net_wifi_reset_log_handler(JNIEnv *env, jclass cls, jint iface, jint id) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
@@ -1814,6 +2771,9 @@ static jboolean android_net_wifi_reset_log_handler(JNIEnv *env, jclass cls, jint
 
 static void onPnoNetworkFound(wifi_request_id id,
                                           unsigned num_results, wifi_scan_result *results) {
+    HAL_CALLBACK_STATS();
+
+    sHalTrace.recordScanResults(HAL_TRACE_PNO_NETWORK_FOUND, id, num_results, results);
 
     JNIHelper helper(mVM);
 
@@ -1870,8 +2830,29 @@ static void onPnoNetworkFound(wifi_request_id id,
         ALOGD("free ref");
 }
 
-static jboolean android_net_wifi_setPnoListNative(
+/* number of networks the firmware can hold; queried from the HAL once */
+static size_t sEpnoCapacity = 0;
+
+static size_t get_epno_capacity(wifi_interface_handle handle) {
+
+    if (sEpnoCapacity == 0) {
+        wifi_gscan_capabilities c;
+        memset(&c, 0, sizeof(c));
+        int result = hal_fn.wifi_get_gscan_capabilities(handle, &c);
+        if (result == WIFI_SUCCESS && c.max_number_epno_networks > 0) {
+            sEpnoCapacity = c.max_number_epno_networks;
+        } else {
+            return MAX_PNO_SSID;
+        }
+    }
+
+    return sEpnoCapacity < (size_t)MAX_PNO_SSID ? sEpnoCapacity : MAX_PNO_SSID;
+}
+
+/* returns the request id ePNO is programmed under, or -1 */
+static jint android_net_wifi_setPnoListNative(
         JNIEnv *env, jclass cls, jint iface, jint id, jobject list)  {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_epno_handler handler;
@@ -1881,19 +2862,20 @@ static jboolean android_net_wifi_setPnoListNative(
     ALOGD("configure ePno list request [%d] = %p", id, handle);
 
     if (list == NULL) {
-        // stop pno
+        // stop pno, under the id it was started with
+        if (sEpnoManager.isProgrammed()) {
+            id = sEpnoManager.getProgrammedId();
+        }
+        sEpnoManager.reset();
         int result = hal_fn.wifi_set_epno_list(id, handle, 0, NULL, handler);
-        ALOGE(" setPnoListNative: STOP result = %d", result);
-        return result >= 0;
+        ALOGD(" setPnoListNative: STOP [%d] result = %d", id, result);
+        return result >= 0 ? id : -1;
     }
 
-    wifi_epno_network net_list[MAX_PNO_SSID];
-    memset(&net_list, 0, sizeof(net_list));
-
     size_t len = helper.getArrayLength((jobjectArray)list);
-    if (len > (size_t)MAX_PNO_SSID) {
-        return false;
-    }
+    std::vector<EpnoCandidate> desired;
+    std::vector<int> dropped;
+    desired.reserve(len);
 
     for (unsigned int i = 0; i < len; i++) {
 
@@ -1906,52 +2888,83 @@ static jboolean android_net_wifi_setPnoListNative(
         JNIObject<jstring> sssid = helper.getStringField(pno_net, "SSID");
         if (sssid == NULL) {
               ALOGE("Error setPnoListNative: getting ssid field");
-              return false;
+              return -1;
         }
 
         ScopedUtfChars chars(env, (jstring)sssid.get());
         const char *ssid = chars.c_str();
         if (ssid == NULL) {
              ALOGE("Error setPnoListNative: getting ssid");
-             return false;
-        }
-        int ssid_len = strnlen((const char*)ssid, 33);
-        if (ssid_len > 32) {
-           ALOGE("Error setPnoListNative: long ssid %u", strnlen((const char*)ssid, 256));
-           return false;
+             return -1;
         }
-
-        if (ssid_len > 1 && ssid[0] == '"' && ssid[ssid_len-1])
-        {
-            // strip leading and trailing '"'
-            ssid++;
-            ssid_len-=2;
+        uint8_t ssid_bytes[SsidTable::kMaxSsidLength];
+        int ssid_len = parse_java_ssid(ssid, true, ssid_bytes);
+        if (ssid_len < 0) {
+           ALOGE("Error setPnoListNative: long ssid %zu", strnlen((const char*)ssid, 256));
+           return -1;
         }
         if (ssid_len == 0) {
-            ALOGE("Error setPnoListNative: zero length ssid, skip it");
+            ALOGD("setPnoListNative: zero length ssid, skip it");
+            dropped.push_back(i);
             continue;
         }
-        memcpy(net_list[i].ssid, ssid, ssid_len);
 
-        int rssit = helper.getIntField(pno_net, "rssi_threshold");
-        net_list[i].rssi_threshold = (byte)rssit;
-        int a = helper.getIntField(pno_net, "auth");
-        net_list[i].auth_bit_field = a;
-        int f = helper.getIntField(pno_net, "flags");
-        net_list[i].flags = f;
-        ALOGE(" setPnoListNative: idx %u rssi %d/%d auth %x/%x flags %x/%x [%s]", i,
-                (signed)net_list[i].rssi_threshold, net_list[i].rssi_threshold,
-                net_list[i].auth_bit_field, a, net_list[i].flags, f, net_list[i].ssid);
+        EpnoCandidate candidate;
+        memset(&candidate, 0, sizeof(candidate));
+        memcpy(candidate.network.ssid, ssid_bytes, ssid_len);
+        candidate.network.rssi_threshold = (byte)helper.getIntField(pno_net, "rssi_threshold");
+        candidate.network.auth_bit_field = helper.getIntField(pno_net, "auth");
+        candidate.network.flags = helper.getIntField(pno_net, "flags");
+        candidate.priority = helper.getIntField(pno_net, "priority");
+        candidate.score = helper.getIntField(pno_net, "score");
+        candidate.index = i;
+        desired.push_back(candidate);
+    }
+
+    std::vector<wifi_epno_network> selected;
+    sEpnoManager.select(desired, get_epno_capacity(handle), selected, dropped);
+
+    std::vector<bool> isDropped(len, false);
+    for (size_t i = 0; i < dropped.size(); i++) {
+        isDropped[dropped[i]] = true;
+    }
+
+    for (unsigned int i = 0; i < len; i++) {
+        JNIObject<jobject> pno_net = helper.getObjectArrayElement((jobjectArray)list, i);
+        if (pno_net != NULL) {
+            helper.setBooleanField(pno_net, "dropped", isDropped[i]);
+        }
+    }
+
+    for (size_t i = 0; i < selected.size(); i++) {
+        ALOGD(" setPnoListNative: idx %zu rssi %d auth %x flags %x [%s]", i,
+                (signed)selected[i].rssi_threshold, selected[i].auth_bit_field,
+                selected[i].flags, selected[i].ssid);
     }
 
-    int result = hal_fn.wifi_set_epno_list(id, handle, len, net_list, handler);
-    ALOGE(" setPnoListNative: result %d", result);
+    if (sEpnoManager.isProgrammed(selected)) {
+        /* avoid waking up the firmware to reprogram the same networks; they keep their id */
+        ALOGD(" setPnoListNative: %zu networks unchanged under [%d], %zu dropped",
+                selected.size(), sEpnoManager.getProgrammedId(), dropped.size());
+        return sEpnoManager.getProgrammedId();
+    }
+
+    int result = hal_fn.wifi_set_epno_list(id, handle, selected.size(),
+            selected.empty() ? NULL : &selected[0], handler);
+    ALOGD(" setPnoListNative: %zu networks, %zu dropped, result %d", selected.size(),
+            dropped.size(), result);
 
-    return result >= 0;
+    if (result >= 0) {
+        sEpnoManager.setProgrammed(selected, id);
+        return id;
+    }
+    sEpnoManager.reset();
+    return -1;
 }
 
 static jboolean android_net_wifi_setLazyRoam(
         JNIEnv *env, jclass cls, jint iface, jint id, jboolean enabled, jobject roam_param)  {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
     wifi_error status = WIFI_SUCCESS;
@@ -1981,22 +2994,55 @@ static jboolean android_net_wifi_setLazyRoam(
     return status >= 0;
 }
 
-static jboolean android_net_wifi_setBssidBlacklist(
-        JNIEnv *env, jclass cls, jint iface, jint id, jobject list)  {
+/*
+ * Hands the roam scorer the blacklist, and programs the HAL with it under id if program is
+ * set and it changed since the HAL was last programmed. Returns the id the HAL is programmed
+ * under, which is id only if the HAL was called, or -1 if it isn't programmed. Called with
+ * sBlacklistLock held.
+ */
+static jint syncBssidBlacklistLocked(JNIHelper &helper, jclass cls, jint iface, jint id,
+        bool program) {
+    wifi_bssid_params params;
+    sBssidBlacklist.build(&params);
+
+    {
+        Mutex::Autolock _l(sRoamLock);
+        sRoamScorer.setBlacklist(params.bssids, params.num_bssid);
+    }
+
+    if (!program) {
+        return -1;
+    }
+    if (sBssidBlacklist.isProgrammed(params)) {
+        return sBlacklistId;
+    }
 
-    JNIHelper helper(env);
     wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
-    ALOGD("configure BSSID black list request [%d] = %p", id, handle);
+    ALOGD("configure BSSID black list request [%d] = %p, %d bssids", id, handle,
+            params.num_bssid);
+    if (hal_fn.wifi_set_bssid_blacklist(id, handle, params) == WIFI_SUCCESS) {
+        sBssidBlacklist.setProgrammed(params);
+        sBlacklistId = id;
+        return id;
+    } else {
+        sBssidBlacklist.resetProgrammed();
+        return -1;
+    }
+}
 
-    wifi_bssid_params params;
-    memset(&params, 0, sizeof(params));
+/* replaces the blacklist with list, none of which expire */
+static jint android_net_wifi_setBssidBlacklist(
+        JNIEnv *env, jclass cls, jint iface, jint id, jobject list, jboolean program)  {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
 
+    Mutex::Autolock _l(sBlacklistLock);
+    sBssidBlacklist.clear();
     if (list != NULL) {
-        size_t len = helper.getArrayLength((jobjectArray)list);
-        if (len > (size_t)MAX_BLACKLIST_BSSID) {
-            return false;
-        }
-        for (unsigned int i = 0; i < len; i++) {
+        int len = helper.getArrayLength((jobjectArray)list);
+        for (int i = 0; i < len; i++) {
 
             JNIObject<jobject> jbssid = helper.getObjectArrayElement(list, i);
             if (jbssid == NULL) {
@@ -2008,162 +3054,959 @@ static jboolean android_net_wifi_setBssidBlacklist(
             const char *bssid = chars.c_str();
             if (bssid == NULL) {
                 ALOGE("Error getting bssid");
-                return false;
+                return -1;
             }
 
             mac_addr addr;
             parseMacAddress(bssid, addr);
-            memcpy(params.bssids[i], addr, sizeof(mac_addr));
-
-            char bssidOut[32];
-            sprintf(bssidOut, "%0x:%0x:%0x:%0x:%0x:%0x", addr[0], addr[1],
-                addr[2], addr[3], addr[4], addr[5]);
-
-            ALOGD("BSSID blacklist: added bssid %s", bssidOut);
-
-            params.num_bssid++;
+            sBssidBlacklist.add(addr, 0, 0, now);
         }
     }
 
-    ALOGD("Added %d bssids", params.num_bssid);
-    return hal_fn.wifi_set_bssid_blacklist(id, handle, params) == WIFI_SUCCESS;
+    ALOGD("Blacklisted %zu bssids", sBssidBlacklist.size());
+    return syncBssidBlacklistLocked(helper, cls, iface, id, program);
 }
 
-static jboolean android_net_wifi_setSsidWhitelist(
-        JNIEnv *env, jclass cls, jint iface, jint id, jobject list)  {
+static jint android_net_wifi_blacklistBssid(JNIEnv *env, jclass cls, jint iface, jint id,
+        jstring bssid, jint reason, jint durationMs, jboolean program) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
-    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
-    ALOGD("configure SSID white list request [%d] = %p", id, handle);
-    wifi_ssid *ssids = NULL;
-    int num_ssids = 0;
-    if (list != NULL) {
-        size_t len = helper.getArrayLength((jobjectArray)list);
-        if (len > 0) {
-            ssids = (wifi_ssid *)malloc(len * sizeof (wifi_ssid));
-            if (!ssids) return false;
-            memset(ssids, 0, len * sizeof (wifi_ssid));
-            for (unsigned int i = 0; i < len; i++) {
-
-                JNIObject<jobject> jssid = helper.getObjectArrayElement(list, i);
-                if (jssid == NULL) {
-                    ALOGD("configure SSID whitelist: could not get element %d", i);
-                    free(ssids);
-                   return false;
-                }
-
-                ScopedUtfChars chars(env, (jstring)jssid.get());
-                const char *utf = chars.c_str();
-                if (utf == NULL) {
-                    ALOGE("Error getting sssid");
-                    free(ssids);
-                    return false;
-                }
-
-                int slen = strnlen(utf, 33);
-                if (slen <= 0 || slen > 32) {
-                    ALOGE("Error wrong ssid length %d", slen);
-                    free(ssids);
-                    return false;
-                }
-
-                memcpy(ssids[i].ssid, utf, slen);
-                num_ssids++;
-                ALOGD("SSID white list: added ssid %s", utf);
-            }
-        }
+    ScopedUtfChars chars(env, bssid);
+    if (chars.c_str() == NULL) {
+        ALOGE("Error getting bssid");
+        return -1;
     }
+    mac_addr addr;
+    parseMacAddress(chars.c_str(), addr);
 
-    ALOGD("android_net_wifi_setSsidWhitelist Added %d sssids", num_ssids);
-    return hal_fn.wifi_set_ssid_white_list(id, handle, num_ssids, ssids) == WIFI_SUCCESS;
+    Mutex::Autolock _l(sBlacklistLock);
+    sBssidBlacklist.add(addr, reason, ms2ns(durationMs), systemTime(SYSTEM_TIME_MONOTONIC));
+    return syncBssidBlacklistLocked(helper, cls, iface, id, program);
 }
 
-static jint android_net_wifi_start_sending_offloaded_packet(JNIEnv *env, jclass cls, jint iface,
-                    jint idx, jbyteArray srcMac, jbyteArray dstMac, jbyteArray pkt, jint period)  {
+static jint android_net_wifi_unblacklistBssid(JNIEnv *env, jclass cls, jint iface, jint id,
+        jstring bssid, jboolean program) {
+    JNI_CALL_STATS();
+
     JNIHelper helper(env);
-    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
-    ALOGD("Start packet offload [%d] = %p", idx, handle);
-    wifi_error ret;
-    wifi_request_id id = idx;
-    
-    ScopedBytesRO pktBytes(env, pkt), srcMacBytes(env, srcMac), dstMacBytes(env, dstMac);
+    ScopedUtfChars chars(env, bssid);
+    if (chars.c_str() == NULL) {
+        ALOGE("Error getting bssid");
+        return -1;
+    }
+    mac_addr addr;
+    parseMacAddress(chars.c_str(), addr);
 
-    byte * pkt_data = (byte*) pktBytes.get();
-    unsigned short pkt_len = env->GetArrayLength(pkt);
-    byte* src_mac_addr = (byte*) srcMacBytes.get();
-    byte* dst_mac_addr = (byte*) dstMacBytes.get();
-    int i;
-    char macAddr[32];
-    sprintf(macAddr, "%0x:%0x:%0x:%0x:%0x:%0x", src_mac_addr[0], src_mac_addr[1],
-            src_mac_addr[2], src_mac_addr[3], src_mac_addr[4], src_mac_addr[5]);
-    ALOGD("src_mac_addr %s", macAddr);
-    sprintf(macAddr, "%0x:%0x:%0x:%0x:%0x:%0x", dst_mac_addr[0], dst_mac_addr[1],
-            dst_mac_addr[2], dst_mac_addr[3], dst_mac_addr[4], dst_mac_addr[5]);
-    ALOGD("dst_mac_addr %s", macAddr);
-    ALOGD("pkt_len %d\n", pkt_len);
-    ALOGD("Pkt data : ");
-    for(i = 0; i < pkt_len; i++) {
-        ALOGD(" %x ", pkt_data[i]);
-    }
-    ALOGD("\n");
-    ret =  hal_fn.wifi_start_sending_offloaded_packet(id, handle, pkt_data, pkt_len,
-                src_mac_addr, dst_mac_addr, period);
-    ALOGD("ret= %d\n", ret);
-    return ret;
+    Mutex::Autolock _l(sBlacklistLock);
+    sBssidBlacklist.expire(systemTime(SYSTEM_TIME_MONOTONIC));
+    sBssidBlacklist.remove(addr);
+    return syncBssidBlacklistLocked(helper, cls, iface, id, program);
 }
 
-static jint android_net_wifi_stop_sending_offloaded_packet(JNIEnv *env, jclass cls,
-                    jint iface, jint idx) {
-    int ret;
-    JNIHelper helper(env);
-    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
-    ALOGD("Stop packet offload [%d] = %p", idx, handle);
-    ret =  hal_fn.wifi_stop_sending_offloaded_packet(idx, handle);
-    ALOGD("ret= %d\n", ret);
-    return ret;
-}
+/*
+ * Drops the BSSIDs whose time is up, syncs the HAL under id if that changed the blacklist,
+ * and returns the ones that expired since the last call, each as bssid << 16 | reason &
+ * 0xffff. They follow the id syncBssidBlacklistLocked returned, or -1 if nothing expired.
+ */
+static jlongArray android_net_wifi_getExpiredBssids(JNIEnv *env, jclass cls, jint iface,
+        jint id, jboolean program) {
+    JNI_CALL_STATS();
 
-static void onRssiThresholdbreached(wifi_request_id id, u8 *cur_bssid, s8 cur_rssi) {
+    JNIHelper helper(env);
+    std::vector<BlacklistExpiry> expired;
+    jlong programmedId = -1;
+    {
+        Mutex::Autolock _l(sBlacklistLock);
+        if (sBssidBlacklist.expire(systemTime(SYSTEM_TIME_MONOTONIC))) {
+            programmedId = syncBssidBlacklistLocked(helper, cls, iface, id, program);
+        }
+        sBssidBlacklist.takeExpired(expired);
+    }
 
-    ALOGD("RSSI threshold breached, cur RSSI - %d!!\n", cur_rssi);
-    ALOGD("BSSID %02x:%02x:%02x:%02x:%02x:%02x\n",
-            cur_bssid[0], cur_bssid[1], cur_bssid[2],
-            cur_bssid[3], cur_bssid[4], cur_bssid[5]);
-    JNIHelper helper(mVM);
-    //ALOGD("onRssiThresholdbreached called, vm = %p, obj = %p, env = %p", mVM, mCls, env);
-    helper.reportEvent(mCls, "onRssiThresholdBreached", "(IB)V", id, cur_rssi);
+    JNIObject<jlongArray> result = helper.newLongArray(expired.size() + 1);
+    if (result == NULL) {
+        ALOGE("Error in allocating array");
+        return NULL;
+    }
+    helper.setLongArrayRegion(result, 0, 1, &programmedId);
+    for (size_t i = 0; i < expired.size(); i++) {
+        jlong value = 0;
+        for (int j = 0; j < 6; j++) {
+            value = (value << 8) | expired[i].bssid[j];
+        }
+        value = (value << 16) | (expired[i].reason & 0xffff);
+        helper.setLongArrayRegion(result, i + 1, 1, &value);
+    }
+    return result.detach();
 }
 
-static jint android_net_wifi_start_rssi_monitoring_native(JNIEnv *env, jclass cls, jint iface,
-        jint idx, jbyte maxRssi, jbyte minRssi) {
+static void android_net_wifi_setRoamScorerParams(JNIEnv *env, jclass cls, jobject roam_param) {
+    JNI_CALL_STATS();
 
     JNIHelper helper(env);
-    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
-    ALOGD("Start Rssi monitoring = %p", handle);
-    ALOGD("MinRssi %d MaxRssi %d", minRssi, maxRssi);
-    wifi_error ret;
-    wifi_request_id id = idx;
-    wifi_rssi_event_handler eh;
-    eh.on_rssi_threshold_breached = onRssiThresholdbreached;
-    ret = hal_fn.wifi_start_rssi_monitoring(id, handle, maxRssi, minRssi, eh);
-    return ret;
-}
+    wifi_roam_params params;
+    memset(&params, 0, sizeof(params));
 
-static jint android_net_wifi_stop_rssi_monitoring_native(JNIEnv *env, jclass cls,
-        jint iface, jint idx) {
-    JNIHelper helper(env);
-    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
-    ALOGD("Stop Rssi monitoring = %p", handle);
-    wifi_error ret;
-    wifi_request_id id = idx;
-    ret = hal_fn.wifi_stop_rssi_monitoring(id, handle);
-    return ret;
-}
+    if (roam_param != NULL) {
+        params.A_band_boost_threshold  = helper.getIntField(roam_param, "A_band_boost_threshold");
+        params.A_band_penalty_threshold  = helper.getIntField(roam_param, "A_band_penalty_threshold");
+        params.A_band_boost_factor = helper.getIntField(roam_param, "A_band_boost_factor");
+        params.A_band_penalty_factor  = helper.getIntField(roam_param, "A_band_penalty_factor");
+        params.A_band_max_boost  = helper.getIntField(roam_param, "A_band_max_boost");
+        params.lazy_roam_hysteresis = helper.getIntField(roam_param, "lazy_roam_hysteresis");
+        params.alert_roam_rssi_trigger = helper.getIntField(roam_param, "alert_roam_rssi_trigger");
+    }
 
-// ----------------------------------------------------------------------------
+    Mutex::Autolock _l(sRoamLock);
+    sRoamScorer.setParams(params);
+}
 
 /*
- * JNI registration.
+ * Hands the roam scorer the BSSID preferences, and the firmware as well if program is set;
+ * the scorer takes them even if the firmware doesn't.
+ */
+static jboolean android_net_wifi_setBssidPreference(JNIEnv *env, jclass cls, jint iface,
+        jint id, jobjectArray list, jintArray modifiers, jboolean program) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    std::vector<wifi_bssid_preference> prefs;
+
+    if (list != NULL && modifiers != NULL) {
+        int len = helper.getArrayLength(list);
+        ScopedIntArrayRO rssiModifiers(env, modifiers);
+        if (rssiModifiers.get() == NULL || (int) rssiModifiers.size() != len) {
+            return false;
+        }
+        for (int i = 0; i < len; i++) {
+            JNIObject<jobject> jbssid = helper.getObjectArrayElement(list, i);
+            if (jbssid == NULL) {
+                continue;
+            }
+
+            ScopedUtfChars chars(env, (jstring)jbssid.get());
+            const char *bssid = chars.c_str();
+            if (bssid == NULL) {
+                ALOGE("Error getting bssid");
+                return false;
+            }
+            wifi_bssid_preference pref;
+            parseMacAddress(bssid, pref.bssid);
+            pref.rssi_modifier = rssiModifiers[i];
+            prefs.push_back(pref);
+        }
+    }
+
+    {
+        Mutex::Autolock _l(sRoamLock);
+        sRoamScorer.setPreferences(prefs.empty() ? NULL : &prefs[0], prefs.size());
+    }
+
+    if (!program) {
+        return true;
+    }
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
+    ALOGD("configure BSSID preference request [%d] = %p", id, handle);
+    return hal_fn.wifi_set_bssid_preference(id, handle, prefs.size(),
+            prefs.empty() ? NULL : &prefs[0]) == WIFI_SUCCESS;
+}
+
+static jobjectArray android_net_wifi_rankRoamCandidates(JNIEnv *env, jclass cls, jstring ssid,
+        jstring currentBssid, jint maxCandidates, jint maxAgeMs) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    RoamCandidate candidates[MAX_AP_CACHE_PER_SCAN];
+    int num_candidates = 0;
+    int max = maxCandidates < MAX_AP_CACHE_PER_SCAN ? maxCandidates : MAX_AP_CACHE_PER_SCAN;
+
+    char ssidBuf[32 + 1];
+    const char *ssidArg = NULL;
+    if (ssid != NULL) {
+        ScopedUtfChars chars(env, ssid);
+        if (chars.c_str() == NULL) {
+            return NULL;
+        }
+        strlcpy(ssidBuf, chars.c_str(), sizeof(ssidBuf));
+        ssidArg = ssidBuf;
+    }
+
+    mac_addr current;
+    bool has_current = false;
+    if (currentBssid != NULL) {
+        ScopedUtfChars chars(env, currentBssid);
+        if (chars.c_str() == NULL) {
+            return NULL;
+        }
+        parseMacAddress(chars.c_str(), current);
+        has_current = true;
+    }
+
+    {
+        Mutex::Autolock _l(sRoamLock);
+        const wifi_cached_scan_results *scan = sRoamScan.newest();
+        if (scan != NULL) {
+            /* rank only what was seen recently enough to roam on */
+            wifi_scan_result results[MAX_AP_CACHE_PER_SCAN];
+            int num_results = 0;
+            wifi_timestamp oldest = scanFilterNow() - (wifi_timestamp) maxAgeMs * 1000;
+            for (int i = 0; i < scan->num_results; i++) {
+                if (maxAgeMs <= 0 || scan->results[i].ts >= oldest) {
+                    memcpy(&results[num_results++], &scan->results[i], sizeof(results[0]));
+                }
+            }
+            num_candidates = sRoamScorer.rank(results, num_results, ssidArg,
+                    has_current ? current : NULL, max, candidates);
+        }
+    }
+
+    JNIObject<jobjectArray> result = helper.createObjectArray(
+            "com/android/server/wifi/WifiNative$RoamCandidate", num_candidates);
+    if (result == NULL) {
+        ALOGE("Error in allocating array");
+        return NULL;
+    }
+
+    for (int i = 0; i < num_candidates; i++) {
+        JNIObject<jobject> candidate =
+                helper.createObject("com/android/server/wifi/WifiNative$RoamCandidate");
+        if (candidate == NULL) {
+            ALOGE("Error in creating roam candidate");
+            return NULL;
+        }
+
+        char bssid[32];
+        sprintf(bssid, "%02x:%02x:%02x:%02x:%02x:%02x", candidates[i].bssid[0],
+                candidates[i].bssid[1], candidates[i].bssid[2], candidates[i].bssid[3],
+                candidates[i].bssid[4], candidates[i].bssid[5]);
+        helper.setStringField(candidate, "bssid", bssid);
+        helper.setIntField(candidate, "frequency", candidates[i].channel);
+        helper.setIntField(candidate, "rssi", candidates[i].rssi);
+        helper.setIntField(candidate, "hysteresis_boost", candidates[i].hysteresis);
+        helper.setIntField(candidate, "band_boost", candidates[i].bandBoost);
+        helper.setIntField(candidate, "preference_boost", candidates[i].preference);
+        helper.setIntField(candidate, "score", candidates[i].score);
+        helper.setObjectArrayElement(result, i, candidate);
+    }
+    return result.detach();
+}
+
+static void releaseSsids(const std::vector<int> &ids) {
+    SsidTable &table = SsidTable::getInstance();
+    for (size_t i = 0; i < ids.size(); i++) {
+        table.release(ids[i]);
+    }
+}
+
+/* returns the request id the whitelist is programmed under, or -1 */
+static jint android_net_wifi_setSsidWhitelist(
+        JNIEnv *env, jclass cls, jint iface, jint id, jobject list)  {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
+    ALOGD("configure SSID white list request [%d] = %p", id, handle);
+    wifi_ssid ssids[MAX_WHITELIST_SSID];
+    memset(ssids, 0, sizeof(ssids));
+    int num_ssids = 0;
+    if (list != NULL) {
+        size_t len = helper.getArrayLength((jobjectArray)list);
+        if (len > MAX_WHITELIST_SSID) {
+            ALOGE("too many ssids %zu, keeping the first %d", len, MAX_WHITELIST_SSID);
+            len = MAX_WHITELIST_SSID;
+        }
+        for (unsigned int i = 0; i < len; i++) {
+
+            JNIObject<jobject> jssid = helper.getObjectArrayElement(list, i);
+            if (jssid == NULL) {
+                ALOGD("configure SSID whitelist: could not get element %d", i);
+                return -1;
+            }
+
+            ScopedUtfChars chars(env, (jstring)jssid.get());
+            const char *utf = chars.c_str();
+            if (utf == NULL) {
+                ALOGE("Error getting sssid");
+                return -1;
+            }
+
+            int slen = parse_java_ssid(utf, false, (uint8_t *)ssids[i].ssid);
+            if (slen <= 0) {
+                ALOGE("Error wrong ssid length %zu", strnlen(utf, 256));
+                return -1;
+            }
+
+            num_ssids++;
+            ALOGD("SSID white list: added ssid %s", utf);
+        }
+    }
+
+    /*
+     * The whitelist holds its SSIDs by id. An unchanged list is not programmed again and
+     * stays under the request id it was programmed with.
+     */
+    SsidTable &table = SsidTable::getInstance();
+    std::vector<int> ids;
+    for (int i = 0; i < num_ssids; i++) {
+        ids.push_back(table.acquire((const uint8_t *)ssids[i].ssid,
+                strnlen(ssids[i].ssid, SsidTable::kMaxSsidLength)));
+    }
+    if (sWhitelistProgrammed && ids == sWhitelistSsids) {
+        releaseSsids(ids);
+        ALOGD("android_net_wifi_setSsidWhitelist %d sssids unchanged under [%d]", num_ssids,
+                sWhitelistId);
+        return sWhitelistId;
+    }
+
+    ALOGD("android_net_wifi_setSsidWhitelist Added %d sssids", num_ssids);
+    bool result = hal_fn.wifi_set_ssid_white_list(id, handle, num_ssids,
+            num_ssids > 0 ? ssids : NULL) == WIFI_SUCCESS;
+    releaseSsids(sWhitelistSsids);
+    sWhitelistSsids.swap(ids);
+    sWhitelistProgrammed = result;
+    sWhitelistId = id;
+    return result ? id : -1;
+}
+
+/* logs each packet as it is offloaded, sixteen bytes a line */
+static void dumpKeepalivePacket(const KeepalivePacket &packet) {
+    ALOGD("offload [%d] %02x:%02x:%02x:%02x:%02x:%02x -> %02x:%02x:%02x:%02x:%02x:%02x"
+            " every %u ms, %zu bytes", packet.slot,
+            packet.srcMac[0], packet.srcMac[1], packet.srcMac[2],
+            packet.srcMac[3], packet.srcMac[4], packet.srcMac[5],
+            packet.dstMac[0], packet.dstMac[1], packet.dstMac[2],
+            packet.dstMac[3], packet.dstMac[4], packet.dstMac[5],
+            packet.periodMs, packet.data.size());
+    for (size_t i = 0; i < packet.data.size(); i += 16) {
+        char line[16 * 3 + 1];
+        size_t n = 0;
+        for (size_t j = i; j < i + 16 && j < packet.data.size(); j++) {
+            n += snprintf(line + n, sizeof(line) - n, " %02x", packet.data[j]);
+        }
+        ALOGD("offload [%d] %04zx:%s", packet.slot, i, line);
+    }
+}
+
+static bool readKeepalivePacket(JNIEnv *env, int slot, jbyteArray srcMac, jbyteArray dstMac,
+        jbyteArray pkt, jint period, KeepalivePacket *packet) {
+    if (srcMac == NULL || dstMac == NULL || pkt == NULL
+            || env->GetArrayLength(srcMac) != sizeof(mac_addr)
+            || env->GetArrayLength(dstMac) != sizeof(mac_addr) || period <= 0) {
+        sKeepaliveManager.countRejected();
+        return false;
+    }
+
+    ScopedBytesRO pktBytes(env, pkt), srcMacBytes(env, srcMac), dstMacBytes(env, dstMac);
+    if (pktBytes.get() == NULL || srcMacBytes.get() == NULL || dstMacBytes.get() == NULL) {
+        return false;
+    }
+    size_t len = env->GetArrayLength(pkt);
+
+    Mutex::Autolock _l(sKeepaliveLock);
+    return sKeepaliveManager.prepare(slot, (const uint8_t *) pktBytes.get(), len,
+            (const uint8_t *) srcMacBytes.get(), (const uint8_t *) dstMacBytes.get(), period,
+            packet);
+}
+
+static wifi_error stopKeepaliveLocked(wifi_interface_handle handle, int slot) {
+    wifi_error ret = hal_fn.wifi_stop_sending_offloaded_packet(slot, handle);
+    /* whatever the firmware said, it is not going to be told about this slot again */
+    sKeepaliveManager.setStopped(slot);
+    return ret;
+}
+
+/* programs packet unless its slot already sends it, replacing what the slot sent before */
+static wifi_error startKeepaliveLocked(wifi_interface_handle handle,
+        const KeepalivePacket &packet) {
+    if (sKeepaliveManager.isProgrammed(packet)) {
+        sKeepaliveManager.countUnchanged();
+        return WIFI_SUCCESS;
+    }
+    if (!sKeepaliveManager.hasRoom(packet.slot)) {
+        ALOGE("offload [%d]: all %zu slots in use", packet.slot, KeepaliveManager::kMaxSlots);
+        sKeepaliveManager.countRejected();
+        return WIFI_ERROR_TOO_MANY_REQUESTS;
+    }
+    if (sKeepaliveManager.isRunning(packet.slot)) {
+        stopKeepaliveLocked(handle, packet.slot);
+    }
+    if (sKeepaliveDump) {
+        dumpKeepalivePacket(packet);
+    }
+
+    wifi_error ret = hal_fn.wifi_start_sending_offloaded_packet(packet.slot, handle,
+            (u8 *) &packet.data[0], packet.data.size(), (u8 *) packet.srcMac,
+            (u8 *) packet.dstMac, packet.periodMs);
+    if (ret == WIFI_SUCCESS) {
+        sKeepaliveManager.setProgrammed(packet);
+    }
+    return ret;
+}
+
+static jint android_net_wifi_start_sending_offloaded_packet(JNIEnv *env, jclass cls, jint iface,
+                    jint idx, jbyteArray srcMac, jbyteArray dstMac, jbyteArray pkt, jint period)  {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
+
+    KeepalivePacket packet;
+    if (!readKeepalivePacket(env, idx, srcMac, dstMac, pkt, period, &packet)) {
+        ALOGE("Start packet offload [%d]: invalid packet", idx);
+        return WIFI_ERROR_INVALID_ARGS;
+    }
+    JNI_CALL_BYTES(packet.data.size());
+
+    Mutex::Autolock _l(sKeepaliveLock);
+    wifi_error ret = startKeepaliveLocked(handle, packet);
+    ALOGD("Start packet offload [%d] = %p, %zu bytes, ret = %d", idx, handle,
+            packet.data.size(), ret);
+    return ret;
+}
+
+static jint android_net_wifi_stop_sending_offloaded_packet(JNIEnv *env, jclass cls,
+                    jint iface, jint idx) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
+
+    Mutex::Autolock _l(sKeepaliveLock);
+    wifi_error ret = stopKeepaliveLocked(handle, idx);
+    ALOGD("Stop packet offload [%d] = %p, ret = %d", idx, handle, ret);
+    return ret;
+}
+
+/*
+ * Makes packets the whole set of keepalives the firmware sends: running slots that aren't
+ * among them are stopped, then the new and changed ones are programmed, leaving the rest
+ * alone. Returns a HAL result per packet.
+ */
+static jintArray android_net_wifi_set_offloaded_packets(JNIEnv *env, jclass cls, jint iface,
+        jbyteArray srcMac, jobjectArray packets) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
+    int numPackets = packets != NULL ? helper.getArrayLength(packets) : 0;
+
+    std::vector<KeepalivePacket> desired(numPackets);
+    std::vector<jint> results(numPackets, WIFI_ERROR_INVALID_ARGS);
+    std::vector<bool> valid(numPackets, false);
+    std::vector<int> slots;
+    for (int i = 0; i < numPackets; i++) {
+        JNIObject<jobject> packet = helper.getObjectArrayElement(packets, i);
+        if (packet == NULL) {
+            continue;
+        }
+        int slot = helper.getIntField(packet, "slot");
+        JNIObject<jobject> dstMac = helper.getObjectField(packet, "dst_mac", "[B");
+        JNIObject<jobject> data = helper.getObjectField(packet, "data", "[B");
+        valid[i] = readKeepalivePacket(env, slot, srcMac, (jbyteArray) dstMac.get(),
+                (jbyteArray) data.get(), helper.getIntField(packet, "period_ms"), &desired[i]);
+        if (valid[i]) {
+            JNI_CALL_BYTES(desired[i].data.size());
+        } else {
+            ALOGE("Set packet offloads: invalid packet for slot %d", slot);
+        }
+        slots.push_back(slot);
+    }
+
+    {
+        Mutex::Autolock _l(sKeepaliveLock);
+        std::vector<int> running;
+        sKeepaliveManager.getRunning(running);
+        for (size_t i = 0; i < running.size(); i++) {
+            if (std::find(slots.begin(), slots.end(), running[i]) == slots.end()) {
+                stopKeepaliveLocked(handle, running[i]);
+            }
+        }
+
+        int programmed = 0;
+        for (int i = 0; i < numPackets; i++) {
+            if (valid[i]) {
+                int started = sKeepaliveManager.isProgrammed(desired[i]) ? 0 : 1;
+                results[i] = startKeepaliveLocked(handle, desired[i]);
+                programmed += results[i] == WIFI_SUCCESS ? started : 0;
+            }
+        }
+        ALOGD("Set packet offloads [%p]: %d packets, %d programmed", handle, numPackets,
+                programmed);
+    }
+
+    JNIObject<jintArray> array = helper.newIntArray(numPackets);
+    if (array == NULL) {
+        return NULL;
+    }
+    if (numPackets > 0) {
+        helper.setIntArrayRegion(array, 0, numPackets, &results[0]);
+    }
+    return array.detach();
+}
+
+/* stops every keepalive the firmware sends, for when the link goes; returns how many */
+static jint android_net_wifi_stop_all_offloaded_packets(JNIEnv *env, jclass cls, jint iface) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
+
+    Mutex::Autolock _l(sKeepaliveLock);
+    std::vector<int> running;
+    sKeepaliveManager.getRunning(running);
+    for (size_t i = 0; i < running.size(); i++) {
+        stopKeepaliveLocked(handle, running[i]);
+    }
+    ALOGD("Stop all packet offloads [%p]: %zu stopped", handle, running.size());
+    return running.size();
+}
+
+static jintArray android_net_wifi_get_offloaded_packet_stats(JNIEnv *env, jclass cls) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    jint stats[KEEPALIVE_STATS_NUM];
+    /* no sKeepaliveLock: it is held across HAL calls, and this is a "!" method */
+    sKeepaliveManager.getStats(stats);
+
+    JNIObject<jintArray> array = helper.newIntArray(KEEPALIVE_STATS_NUM);
+    if (array == NULL) {
+        return NULL;
+    }
+    helper.setIntArrayRegion(array, 0, KEEPALIVE_STATS_NUM, stats);
+    return array.detach();
+}
+
+static void android_net_wifi_set_offloaded_packet_dump(JNIEnv *env, jclass cls,
+        jboolean enable) {
+    JNI_CALL_STATS();
+
+    sKeepaliveDump = enable;
+}
+
+static void onRssiThresholdbreached(wifi_request_id id, u8 *cur_bssid, s8 cur_rssi) {
+    HAL_CALLBACK_STATS();
+
+    sHalTrace.recordRssiBreached(id, cur_bssid, cur_rssi);
+
+    std::vector<int> crossed;
+    {
+        Mutex::Autolock _l(sRssiMonitorLock);
+        /* one from a monitor since stopped or replaced was meant for another window */
+        if (!sRssiMonitorMux.isProgrammed() || id != sRssiMonitorMux.getProgrammedId()) {
+            ALOGD("RSSI threshold breached [%d], stale: not the monitor that is running", id);
+            return;
+        }
+        sRssiMonitorMux.update(cur_rssi, crossed);
+    }
+    ALOGD("RSSI threshold breached [%d], cur RSSI %d, BSSID %02x:%02x:%02x:%02x:%02x:%02x,"
+            " %zu clients", id, cur_rssi, cur_bssid[0], cur_bssid[1], cur_bssid[2],
+            cur_bssid[3], cur_bssid[4], cur_bssid[5], crossed.size());
+
+    JNIHelper helper(mVM);
+    JNIObject<jintArray> clients = helper.newIntArray(crossed.size());
+    if (clients == NULL) {
+        return;
+    }
+    if (!crossed.empty()) {
+        helper.setIntArrayRegion(clients, 0, crossed.size(), &crossed[0]);
+    }
+    helper.reportEvent(mCls, "onRssiThresholdBreached", "(IB[I)V", id, cur_rssi,
+            clients.get());
+}
+
+/*
+ * Points the HAL monitor at the window around rssi, unless it is watching that already, and
+ * stops it once no client has thresholds left. Not called from onRssiThresholdbreached:
+ * the HAL is not to be called back into from its own event thread, so Java re-arms it.
+ */
+static wifi_error armRssiMonitorLocked(wifi_interface_handle handle, wifi_request_id id,
+        s8 rssi) {
+    wifi_request_id programmedId = sRssiMonitorMux.getProgrammedId();
+    if (sRssiMonitorMux.isEmpty()) {
+        wifi_error ret = WIFI_SUCCESS;
+        if (sRssiMonitorMux.isProgrammed()) {
+            ret = hal_fn.wifi_stop_rssi_monitoring(programmedId, handle);
+            sRssiMonitorMux.resetProgrammed();
+        }
+        ALOGD("Stop Rssi monitoring [%d] = %p, ret = %d", programmedId, handle, ret);
+        return ret;
+    }
+
+    s8 minRssi, maxRssi;
+    sRssiMonitorMux.getWindow(rssi, &minRssi, &maxRssi);
+    if (sRssiMonitorMux.isProgrammed(minRssi, maxRssi)) {
+        return WIFI_SUCCESS;
+    }
+    if (sRssiMonitorMux.isProgrammed()) {
+        hal_fn.wifi_stop_rssi_monitoring(programmedId, handle);
+        sRssiMonitorMux.resetProgrammed();
+    }
+
+    wifi_rssi_event_handler eh;
+    eh.on_rssi_threshold_breached = onRssiThresholdbreached;
+    wifi_error ret = hal_fn.wifi_start_rssi_monitoring(id, handle, maxRssi, minRssi, eh);
+    if (ret == WIFI_SUCCESS) {
+        sRssiMonitorMux.setProgrammed(id, minRssi, maxRssi);
+    }
+    ALOGD("Start Rssi monitoring [%d] = %p, RSSI %d in [%d, %d], ret = %d", id, handle, rssi,
+            minRssi, maxRssi, ret);
+    return ret;
+}
+
+static jint android_net_wifi_set_rssi_thresholds(JNIEnv *env, jclass cls, jint iface,
+        jint id, jint client, jbyteArray thresholds, jbyte curRssi) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
+
+    Mutex::Autolock _l(sRssiMonitorLock);
+    if (thresholds != NULL) {
+        ScopedBytesRO bytes(env, thresholds);
+        if (bytes.get() == NULL) {
+            return WIFI_ERROR_OUT_OF_MEMORY;
+        }
+        sRssiMonitorMux.setThresholds(client, (const s8 *) bytes.get(),
+                env->GetArrayLength(thresholds));
+    } else {
+        sRssiMonitorMux.setThresholds(client, NULL, 0);
+    }
+    sRssiMonitorMux.setRssi(curRssi);
+    return armRssiMonitorLocked(handle, id, curRssi);
+}
+
+static jint android_net_wifi_rearm_rssi_monitor(JNIEnv *env, jclass cls, jint iface, jint id,
+        jbyte curRssi) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
+
+    Mutex::Autolock _l(sRssiMonitorLock);
+    return armRssiMonitorLocked(handle, id, curRssi);
+}
+
+/* drops the thresholds of every client and stops the HAL monitor */
+static jint android_net_wifi_stop_rssi_monitoring_native(JNIEnv *env, jclass cls,
+        jint iface) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    wifi_interface_handle handle = getIfaceHandle(helper, cls, iface);
+
+    Mutex::Autolock _l(sRssiMonitorLock);
+    sRssiMonitorMux.clear();
+    return armRssiMonitorLocked(handle, 0, 0);
+}
+
+static jboolean android_net_wifi_start_hal_trace(JNIEnv *env, jclass cls, jstring path,
+        jint bufferSize) {
+    JNI_CALL_STATS();
+
+    ScopedUtfChars chars(env, path);
+    if (chars.c_str() == NULL || bufferSize < 0) {
+        return JNI_FALSE;
+    }
+    return sHalTrace.start(chars.c_str(), bufferSize);
+}
+
+static void android_net_wifi_stop_hal_trace(JNIEnv *env, jclass cls) {
+    JNI_CALL_STATS();
+
+    sHalTrace.stop();
+}
+
+static jlongArray android_net_wifi_get_hal_trace_stats(JNIEnv *env, jclass cls) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    uint64_t records, dropped, bytes;
+    sHalTrace.getStats(&records, &dropped, &bytes);
+
+    jlong stats[3] = { (jlong) records, (jlong) dropped, (jlong) bytes };
+    JNIObject<jlongArray> array = helper.newLongArray(3);
+    if (array == NULL) {
+        return NULL;
+    }
+    helper.setLongArrayRegion(array, 0, 3, stats);
+    return array.detach();
+}
+
+/* feeds one recorded record back through the callback that recorded it */
+static bool replayHalTraceRecord(const HalTraceRecordHeader &header, uint8_t *payload) {
+    switch (header.type) {
+        case HAL_TRACE_SCAN_RESULTS_AVAILABLE:
+            onScanResultsAvailable(header.id, header.arg);
+            return true;
+        case HAL_TRACE_SCAN_EVENT:
+            onScanEvent((wifi_scan_event) header.id, header.arg);
+            return true;
+        case HAL_TRACE_FULL_SCAN_RESULT:
+            if (!HalTraceReader::checkFullScanResult(header, payload)) {
+                return false;
+            }
+            onFullScanResult(header.id, (wifi_scan_result *) payload);
+            return true;
+        case HAL_TRACE_HOTLIST_AP_FOUND:
+        case HAL_TRACE_HOTLIST_AP_LOST:
+        case HAL_TRACE_PNO_NETWORK_FOUND:
+            if (!HalTraceReader::checkScanResults(header, payload)) {
+                return false;
+            }
+            if (header.type == HAL_TRACE_HOTLIST_AP_FOUND) {
+                onHotlistApFound(header.id, header.arg, (wifi_scan_result *) payload);
+            } else if (header.type == HAL_TRACE_HOTLIST_AP_LOST) {
+                onHotlistApLost(header.id, header.arg, (wifi_scan_result *) payload);
+            } else {
+                onPnoNetworkFound(header.id, header.arg, (wifi_scan_result *) payload);
+            }
+            return true;
+        case HAL_TRACE_SIGNIFICANT_CHANGE: {
+            std::vector<wifi_significant_change_result *> results;
+            if (!HalTraceReader::decodeSignificantChange(header, payload, results)) {
+                return false;
+            }
+            onSignificantWifiChange(header.id, results.size(),
+                    results.empty() ? NULL : &results[0]);
+            return true;
+        }
+        case HAL_TRACE_LINK_STATS:
+            if (header.arg < 0 || header.length != sizeof(wifi_iface_stat)
+                    + header.arg * sizeof(wifi_radio_stat)) {
+                return false;
+            }
+            onLinkStatsResults(header.id, (wifi_iface_stat *) payload, header.arg,
+                    (wifi_radio_stat *) (payload + sizeof(wifi_iface_stat)));
+            return true;
+        case HAL_TRACE_RTT_RESULTS: {
+            std::vector<wifi_rtt_result *> results;
+            if (!HalTraceReader::decodeRttResults(header, payload, results)) {
+                return false;
+            }
+            onRttResults(header.id, results.size(), results.empty() ? NULL : &results[0]);
+            return true;
+        }
+        case HAL_TRACE_RING_BUFFER_DATA: {
+            size_t prefix = sizeof(wifi_ring_buffer_status) + HAL_TRACE_RING_NAME_LEN;
+            if (header.arg < 0 || header.length != prefix + header.arg) {
+                return false;
+            }
+            char *name = (char *) payload + sizeof(wifi_ring_buffer_status);
+            name[HAL_TRACE_RING_NAME_LEN - 1] = 0;
+            on_ring_buffer_data(name, (char *) payload + prefix, header.arg,
+                    (wifi_ring_buffer_status *) payload);
+            return true;
+        }
+        case HAL_TRACE_ALERT:
+            on_alert_data(header.id, (char *) payload, header.length, header.arg);
+            return true;
+        case HAL_TRACE_FIRMWARE_MEMORY_DUMP:
+            on_firmware_memory_dump((char *) payload, header.length);
+            return true;
+        case HAL_TRACE_RSSI_THRESHOLD_BREACHED:
+            if (header.length != sizeof(mac_addr)) {
+                return false;
+            }
+            onRssiThresholdbreached(header.id, payload, header.arg);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Replays a recorded trace through the real callbacks; speed is a percentage of the
+ * original pace, and 0 replays as fast as possible. Returns the records replayed.
+ */
+static jint android_net_wifi_replay_hal_trace(JNIEnv *env, jclass cls, jstring path,
+        jint speed) {
+    JNI_CALL_STATS();
+
+    ScopedUtfChars chars(env, path);
+    if (chars.c_str() == NULL || mCls == NULL || speed < 0) {
+        return -1;
+    }
+
+    HalTraceReader reader;
+    if (!reader.open(chars.c_str())) {
+        return -1;
+    }
+
+    /* replayed callbacks must not be recorded again */
+    sHalTrace.setThreadMuted(true);
+
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    int replayed = 0;
+    for (size_t i = 0; i < reader.size(); i++) {
+        const HalTraceRecordHeader &header = reader.header(i);
+        if (speed > 0) {
+            nsecs_t due = start
+                    + (header.timestamp - reader.header(0).timestamp) * 100 / speed;
+            nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+            if (due > now) {
+                usleep(ns2us(due - now));
+            }
+        }
+        if (replayHalTraceRecord(header, reader.payload(i))) {
+            replayed++;
+        } else {
+            ALOGE("Skipping malformed HAL trace record of type %d", header.type);
+        }
+    }
+
+    sHalTrace.setThreadMuted(false);
+    ALOGD("Replayed %d of %zu HAL trace records", replayed, reader.size());
+    return replayed;
+}
+
+/* enough for the responses of most venues without going to the heap */
+#define ANQP_INDEX_STACK_INTS   512
+
+static jintArray android_net_wifi_index_anqp_payload(JNIEnv *env, jclass cls, jbyteArray payload) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    int len = helper.getArrayLength(payload);
+    ScopedBytesRO payloadBytes(env, payload);
+    const uint8_t *bytes = (const uint8_t *)payloadBytes.get();
+    if (bytes == NULL) {
+        ALOGE("failed to get array");
+        return NULL;
+    }
+
+    int32_t stackIndex[ANQP_INDEX_STACK_INTS];
+    int32_t *index = stackIndex;
+    int n = index_anqp_payload(bytes, len, index, ANQP_INDEX_STACK_INTS);
+    if (n > ANQP_INDEX_STACK_INTS) {
+        index = (int32_t *)malloc(n * sizeof(int32_t));
+        if (index == NULL) {
+            ALOGE("Error in allocating ANQP index");
+            return NULL;
+        }
+        n = index_anqp_payload(bytes, len, index, n);
+    }
+
+    if (n < 0) {
+        ALOGD("malformed ANQP payload of %d bytes", len);
+        if (index != stackIndex) {
+            free(index);
+        }
+        return NULL;
+    }
+
+    JNIObject<jintArray> result = helper.newIntArray(n);
+    if (result != NULL) {
+        helper.setIntArrayRegion(result, 0, n, index);
+        JNI_CALL_BYTES(n * sizeof(int32_t));
+    }
+    if (index != stackIndex) {
+        free(index);
+    }
+    return result.detach();
+}
+
+/* FQDNs, partner domains and realms of the configured Passpoint providers */
+static DomainTrie sPasspointTrie;
+static Mutex sPasspointLock;
+
+static jboolean android_net_wifi_set_passpoint_names(JNIEnv *env, jclass cls,
+        jobjectArray names, jintArray providers, jintArray kinds, jint numProviders) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    int num = helper.getArrayLength(names);
+    if (helper.getArrayLength(providers) != num || helper.getArrayLength(kinds) != num
+            || numProviders < 0) {
+        ALOGE("mismatched passpoint name arrays");
+        return false;
+    }
+    ScopedIntArrayRO providerInts(env, providers), kindInts(env, kinds);
+    if (providerInts.get() == NULL || kindInts.get() == NULL) {
+        ALOGE("failed to get array");
+        return false;
+    }
+
+    std::vector<DomainTrieName> entries(num);
+    for (int i = 0; i < num; i++) {
+        if (providerInts[i] < 0 || providerInts[i] >= numProviders) {
+            ALOGE("passpoint provider %d out of range", providerInts[i]);
+            return false;
+        }
+        JNIObject<jobject> name = helper.getObjectArrayElement(names, i);
+        if (name == NULL) {
+            continue;
+        }
+        ScopedUtfChars chars(env, (jstring)name.get());
+        if (chars.c_str() == NULL) {
+            return false;
+        }
+        entries[i].name = chars.c_str();
+        entries[i].provider = providerInts[i];
+        entries[i].kind = kindInts[i];
+    }
+
+    Mutex::Autolock _l(sPasspointLock);
+    sPasspointTrie.build(entries, numProviders);
+    return true;
+}
+
+static jintArray android_net_wifi_match_passpoint_names(JNIEnv *env, jclass cls, jint numAps,
+        jobjectArray names, jintArray aps, jintArray kinds) {
+    JNI_CALL_STATS();
+
+    JNIHelper helper(env);
+    int num = helper.getArrayLength(names);
+    if (helper.getArrayLength(aps) != num || helper.getArrayLength(kinds) != num
+            || numAps < 0) {
+        ALOGE("mismatched passpoint name arrays");
+        return NULL;
+    }
+    ScopedIntArrayRO apInts(env, aps), kindInts(env, kinds);
+    if (apInts.get() == NULL || kindInts.get() == NULL) {
+        ALOGE("failed to get array");
+        return NULL;
+    }
+
+    Mutex::Autolock _l(sPasspointLock);
+    int numProviders = sPasspointTrie.numProviders();
+    std::vector<jint> flags((size_t)numAps * numProviders);
+    for (int i = 0; i < num && numProviders > 0; i++) {
+        if (apInts[i] < 0 || apInts[i] >= numAps) {
+            continue;
+        }
+        JNIObject<jobject> name = helper.getObjectArrayElement(names, i);
+        if (name == NULL) {
+            continue;
+        }
+        ScopedUtfChars chars(env, (jstring)name.get());
+        if (chars.c_str() == NULL) {
+            return NULL;
+        }
+        sPasspointTrie.match(chars.c_str(), chars.size(), kindInts[i],
+                &flags[(size_t)apInts[i] * numProviders]);
+    }
+
+    JNIObject<jintArray> result = helper.newIntArray(flags.size());
+    if (result != NULL && !flags.empty()) {
+        helper.setIntArrayRegion(result, 0, flags.size(), &flags[0]);
+        JNI_CALL_BYTES(flags.size() * sizeof(jint));
+    }
+    return result.detach();
+}
+
+/* not timed itself, so that dumping doesn't show up in what it dumps */
+static jstring android_net_wifi_get_call_stats(JNIEnv *env, jclass cls) {
+    std::string stats;
+    CallStats::dumpAll(stats);
+    return env->NewStringUTF(stats.c_str());
+}
+
+// ----------------------------------------------------------------------------
+
+/*
+ * JNI registration.
  */
 static JNINativeMethod gWifiMethods[] = {
     /* name, signature, funcPtr */
@@ -2191,8 +4034,10 @@ static JNINativeMethod gWifiMethods[] = {
     { "startScanNative", "(IILcom/android/server/wifi/WifiNative$ScanSettings;)Z",
             (void*) android_net_wifi_startScan},
     { "stopScanNative", "(II)Z", (void*) android_net_wifi_stopScan},
-    { "getScanResultsNative", "(IZ)[Landroid/net/wifi/WifiScanner$ScanData;",
-            (void *) android_net_wifi_getScanResults},
+    { "getScanResultsNative", "(IZLcom/android/server/wifi/WifiNative$ScanFilter;)"
+            "[Landroid/net/wifi/WifiScanner$ScanData;", (void *) android_net_wifi_getScanResults},
+    { "setFullScanResultFilterNative", "(Lcom/android/server/wifi/WifiNative$ScanFilter;)Z",
+            (void *) android_net_wifi_setFullScanResultFilter},
     { "setHotlistNative", "(IILandroid/net/wifi/WifiScanner$HotlistSettings;)Z",
             (void*) android_net_wifi_setHotlist},
     { "resetHotlistNative", "(II)Z", (void*) android_net_wifi_resetHotlist},
@@ -2204,8 +4049,6 @@ static JNINativeMethod gWifiMethods[] = {
             (void*) android_net_wifi_getLinkLayerStats},
     { "setWifiLinkLayerStatsNative", "(II)V",
             (void*) android_net_wifi_setLinkLayerStats},
-    { "getSupportedFeatureSetNative", "(I)I",
-            (void*) android_net_wifi_getSupportedFeatures},
     { "requestRangeNative", "(II[Landroid/net/wifi/RttManager$RttParams;)Z",
             (void*) android_net_wifi_requestRange},
     { "cancelRangeRequestNative", "(II[Landroid/net/wifi/RttManager$RttParams;)Z",
@@ -2218,10 +4061,11 @@ static JNINativeMethod gWifiMethods[] = {
             (void*) android_net_wifi_get_rtt_capabilities},
     {"setCountryCodeHalNative", "(ILjava/lang/String;)Z",
             (void*) android_net_wifi_set_Country_Code_Hal},
-    { "setPnoListNative", "(II[Lcom/android/server/wifi/WifiNative$WifiPnoNetwork;)Z",
+    { "setPnoListNative", "(II[Lcom/android/server/wifi/WifiNative$WifiPnoNetwork;)I",
             (void*) android_net_wifi_setPnoListNative},
     {"enableDisableTdlsNative", "(IZLjava/lang/String;)Z",
             (void*) android_net_wifi_enable_disable_tdls},
+    {"setTdlsAutoNative", "(IZII)Z", (void*) android_net_wifi_set_tdls_auto},
     {"getTdlsStatusNative", "(ILjava/lang/String;)Lcom/android/server/wifi/WifiNative$TdlsStatus;",
             (void*) android_net_wifi_get_tdls_status},
     {"getTdlsCapabilitiesNative", "(I)Lcom/android/server/wifi/WifiNative$TdlsCapabilities;",
@@ -2234,16 +4078,40 @@ static JNINativeMethod gWifiMethods[] = {
             (void*) android_net_wifi_get_firmware_version},
     {"getRingBufferStatusNative", "(I)[Lcom/android/server/wifi/WifiNative$RingBufferStatus;",
             (void*) android_net_wifi_get_ring_buffer_status},
+    {"setRingBufferStatusThresholdNative", "(I)V",
+            (void*) android_net_wifi_set_ring_buffer_status_threshold},
     {"startLoggingRingBufferNative", "(IIIIILjava/lang/String;)Z",
             (void*) android_net_wifi_start_logging_ring_buffer},
     {"getRingBufferDataNative", "(ILjava/lang/String;)Z",
             (void*) android_net_wifi_get_ring_buffer_data},
     {"getFwMemoryDumpNative","(I)Z", (void*) android_net_wifi_get_fw_memory_dump},
+    {"getFwMemoryDumpToFdNative",
+            "(ILjava/io/FileDescriptor;Z)Lcom/android/server/wifi/WifiNative$FwMemoryDumpInfo;",
+            (void*) android_net_wifi_get_fw_memory_dump_to_fd},
+    {"enableRingBufferLogSinkNative", "(Ljava/lang/String;I)Z",
+            (void*) android_net_wifi_enable_ring_buffer_log_sink},
+    {"readRingBufferLogNative", "(Ljava/lang/String;)[B",
+            (void*) android_net_wifi_read_ring_buffer_log},
+    {"queryRingBufferLogNative", "(Ljava/lang/String;IJJ)[B",
+            (void*) android_net_wifi_query_ring_buffer_log},
     { "setLazyRoamNative", "(IIZLcom/android/server/wifi/WifiNative$WifiLazyRoamParams;)Z",
             (void*) android_net_wifi_setLazyRoam},
-    { "setBssidBlacklistNative", "(II[Ljava/lang/String;)Z",
+    { "setBssidBlacklistNative", "(II[Ljava/lang/String;Z)I",
             (void*)android_net_wifi_setBssidBlacklist},
-    { "setSsidWhitelistNative", "(II[Ljava/lang/String;)Z",
+    { "blacklistBssidNative", "(IILjava/lang/String;IIZ)I",
+            (void*)android_net_wifi_blacklistBssid},
+    { "unblacklistBssidNative", "(IILjava/lang/String;Z)I",
+            (void*)android_net_wifi_unblacklistBssid},
+    { "getExpiredBssidsNative", "(IIZ)[J",
+            (void*)android_net_wifi_getExpiredBssids},
+    { "setRoamScorerParamsNative", "(Lcom/android/server/wifi/WifiNative$WifiLazyRoamParams;)V",
+            (void*)android_net_wifi_setRoamScorerParams},
+    { "setBssidPreferenceNative", "(II[Ljava/lang/String;[IZ)Z",
+            (void*)android_net_wifi_setBssidPreference},
+    { "rankRoamCandidatesNative",
+            "(Ljava/lang/String;Ljava/lang/String;II)[Lcom/android/server/wifi/WifiNative$RoamCandidate;",
+            (void*)android_net_wifi_rankRoamCandidates},
+    { "setSsidWhitelistNative", "(II[Ljava/lang/String;)I",
             (void*)android_net_wifi_setSsidWhitelist},
     {"setLoggingEventHandlerNative", "(II)Z", (void *) android_net_wifi_set_log_handler},
     {"resetLogHandlerNative", "(II)Z", (void *) android_net_wifi_reset_log_handler},
@@ -2251,25 +4119,60 @@ static JNINativeMethod gWifiMethods[] = {
              (void*)android_net_wifi_start_sending_offloaded_packet},
     { "stopSendingOffloadedPacketNative", "(II)I",
              (void*)android_net_wifi_stop_sending_offloaded_packet},
-    {"startRssiMonitoringNative", "(IIBB)I",
-            (void*)android_net_wifi_start_rssi_monitoring_native},
-    {"stopRssiMonitoringNative", "(II)I",
+    { "setOffloadedPacketsNative",
+            "(I[B[Lcom/android/server/wifi/WifiNative$OffloadedPacket;)[I",
+            (void*)android_net_wifi_set_offloaded_packets},
+    { "stopAllSendingOffloadedPacketsNative", "(I)I",
+            (void*)android_net_wifi_stop_all_offloaded_packets},
+    {"setRssiThresholdsNative", "(III[BB)I", (void*)android_net_wifi_set_rssi_thresholds},
+    {"rearmRssiMonitorNative", "(IIB)I", (void*)android_net_wifi_rearm_rssi_monitor},
+    {"stopRssiMonitoringNative", "(I)I",
             (void*)android_net_wifi_stop_rssi_monitoring_native},
-    {"isGetChannelsForBandSupportedNative", "()Z",
-            (void*)android_net_wifi_is_get_channels_for_band_supported}
+    {"startHalTraceNative", "(Ljava/lang/String;I)Z", (void*)android_net_wifi_start_hal_trace},
+    {"stopHalTraceNative", "()V", (void*)android_net_wifi_stop_hal_trace},
+    {"replayHalTraceNative", "(Ljava/lang/String;I)I", (void*)android_net_wifi_replay_hal_trace},
+    {"getCallStatsNative", "()Ljava/lang/String;", (void*)android_net_wifi_get_call_stats},
+    {"indexAnqpPayloadNative", "([B)[I", (void*)android_net_wifi_index_anqp_payload},
+    {"setPasspointNamesNative", "([Ljava/lang/String;[I[II)Z",
+            (void*)android_net_wifi_set_passpoint_names},
+    {"matchPasspointNamesNative", "(I[Ljava/lang/String;[I[I)[I",
+            (void*)android_net_wifi_match_passpoint_names}
+};
+
+/*
+ * Natives that only read state kept on the native side, and so never block, are registered
+ * as fast natives ("!" signatures): the thread stays runnable across the call, skipping the
+ * state transitions regular JNI makes. Anything that talks to the HAL or supplicant must
+ * stay in gWifiMethods, since it would hold off GC while it waits.
+ */
+static JNINativeMethod gWifiFastMethods[] = {
+    /* name, signature, funcPtr */
+    { "getSupportedFeatureSetNative", "!(I)I",
+            (void*) android_net_wifi_getSupportedFeatures},
+    {"isGetChannelsForBandSupportedNative", "!()Z",
+            (void*)android_net_wifi_is_get_channels_for_band_supported},
+    {"getHalTraceStatsNative", "!()[J", (void*)android_net_wifi_get_hal_trace_stats},
+    {"getHalCapabilitiesNative", "!()I", (void*)android_net_wifi_get_hal_capabilities},
+    {"getOffloadedPacketStatsNative", "!()[I",
+            (void*)android_net_wifi_get_offloaded_packet_stats},
+    {"setOffloadedPacketDumpNative", "!(Z)V", (void*)android_net_wifi_set_offloaded_packet_dump}
 };
 
 int register_android_net_wifi_WifiNative(JNIEnv* env) {
-    return AndroidRuntime::registerNativeMethods(env,
+    int result = AndroidRuntime::registerNativeMethods(env,
             "com/android/server/wifi/WifiNative", gWifiMethods, NELEM(gWifiMethods));
+    if (result < 0) {
+        return result;
+    }
+    return AndroidRuntime::registerNativeMethods(env,
+            "com/android/server/wifi/WifiNative", gWifiFastMethods, NELEM(gWifiFastMethods));
 }
 
 
 /* User to register native functions */
 extern "C"
 jint Java_com_android_server_wifi_WifiNative_registerNatives(JNIEnv* env, jclass clazz) {
-    return AndroidRuntime::registerNativeMethods(env,
-            "com/android/server/wifi/WifiNative", gWifiMethods, NELEM(gWifiMethods));
+    return register_android_net_wifi_WifiNative(env);
 }
 
 }; // namespace android
@@ -22,6 +22,8 @@
 #include <android_runtime/AndroidRuntime.h>
 #include <utils/Log.h>
 #include <utils/String16.h>
+#include <utils/Mutex.h>
+#include <map>
 
 #include "wifi.h"
 #include "wifi_hal.h"
@@ -31,6 +33,153 @@ namespace android {
 
 /* JNI Helpers for wifi_hal implementation */
 
+/*
+ * Class, field and method IDs stay valid for as long as their class is loaded, so they are
+ * looked up once per process rather than on every field access. Entries are keyed by a hash
+ * of kind, name and signature, and hold a global ref to the class they were resolved in.
+ */
+enum {
+    MEMBER_CLASS,
+    MEMBER_FIELD,
+    MEMBER_STATIC_FIELD,
+    MEMBER_METHOD,
+    MEMBER_STATIC_METHOD,
+};
+
+struct CachedMember {
+    int kind;
+    jclass cls;
+    char *name;
+    char *signature;
+    void *id;
+};
+
+static Mutex sMemberLock;
+static std::multimap<uint32_t, CachedMember> sMembers;
+
+static uint32_t memberHash(int kind, const char *name, const char *signature) {
+    uint32_t hash = 2166136261u ^ kind;
+    for (const char *p = name; *p; p++) {
+        hash = (hash ^ (uint8_t) *p) * 16777619u;
+    }
+    hash = (hash ^ '/') * 16777619u;
+    for (const char *p = signature; *p; p++) {
+        hash = (hash ^ (uint8_t) *p) * 16777619u;
+    }
+    return hash;
+}
+
+/* sMemberLock must be held */
+static bool findMemberLocked(JNIEnv *env, uint32_t hash, int kind, jclass cls, const char *name,
+        const char *signature, void **id) {
+    std::multimap<uint32_t, CachedMember>::iterator it = sMembers.lower_bound(hash);
+    for (; it != sMembers.end() && it->first == hash; ++it) {
+        const CachedMember &member = it->second;
+        if (member.kind == kind && strcmp(member.name, name) == 0
+                && strcmp(member.signature, signature) == 0
+                && (cls == NULL || env->IsSameObject(member.cls, cls))) {
+            *id = member.id;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool findMember(JNIEnv *env, uint32_t hash, int kind, jclass cls, const char *name,
+        const char *signature, void **id) {
+    Mutex::Autolock _l(sMemberLock);
+    return findMemberLocked(env, hash, kind, cls, name, signature, id);
+}
+
+/* returns the cached id, which is an earlier one if another thread raced us to it */
+static void *addMember(JNIEnv *env, uint32_t hash, int kind, jclass cls, const char *name,
+        const char *signature, void *id) {
+    Mutex::Autolock _l(sMemberLock);
+    void *existing;
+    if (findMemberLocked(env, hash, kind, cls, name, signature, &existing)) {
+        return existing;
+    }
+
+    CachedMember member;
+    member.kind = kind;
+    member.cls = cls != NULL ? (jclass) env->NewGlobalRef(cls) : NULL;
+    member.name = strdup(name);
+    member.signature = strdup(signature);
+    member.id = id;
+    sMembers.insert(std::make_pair(hash, member));
+    return id;
+}
+
+jclass JNIHelper::findClass(const char *className)
+{
+    uint32_t hash = memberHash(MEMBER_CLASS, className, "");
+    void *id;
+    if (findMember(mEnv, hash, MEMBER_CLASS, NULL, className, "", &id)) {
+        return (jclass) id;
+    }
+
+    JNIObject<jclass> cls(*this, mEnv->FindClass(className));
+    if (cls == NULL) {
+        return NULL;
+    }
+
+    jclass global = (jclass) mEnv->NewGlobalRef(cls);
+    id = addMember(mEnv, hash, MEMBER_CLASS, NULL, className, "", global);
+    if (id != global) {
+        mEnv->DeleteGlobalRef(global);
+    }
+    return (jclass) id;
+}
+
+void *JNIHelper::getMemberID(int kind, jclass cls, const char *name, const char *signature)
+{
+    uint32_t hash = memberHash(kind, name, signature);
+    void *id;
+    if (findMember(mEnv, hash, kind, cls, name, signature, &id)) {
+        return id;
+    }
+
+    switch (kind) {
+        case MEMBER_FIELD:
+            id = mEnv->GetFieldID(cls, name, signature);
+            break;
+        case MEMBER_STATIC_FIELD:
+            id = mEnv->GetStaticFieldID(cls, name, signature);
+            break;
+        case MEMBER_METHOD:
+            id = mEnv->GetMethodID(cls, name, signature);
+            break;
+        default:
+            id = mEnv->GetStaticMethodID(cls, name, signature);
+            break;
+    }
+
+    if (id != NULL) {
+        id = addMember(mEnv, hash, kind, cls, name, signature, id);
+    }
+    return id;
+}
+
+jfieldID JNIHelper::getFieldID(jclass cls, const char *name, const char *signature)
+{
+    return (jfieldID) getMemberID(MEMBER_FIELD, cls, name, signature);
+}
+
+jfieldID JNIHelper::getStaticFieldID(jclass cls, const char *name, const char *signature)
+{
+    return (jfieldID) getMemberID(MEMBER_STATIC_FIELD, cls, name, signature);
+}
+
+jmethodID JNIHelper::getMethodID(jclass cls, const char *name, const char *signature)
+{
+    return (jmethodID) getMemberID(MEMBER_METHOD, cls, name, signature);
+}
+
+jmethodID JNIHelper::getStaticMethodID(jclass cls, const char *name, const char *signature)
+{
+    return (jmethodID) getMemberID(MEMBER_STATIC_METHOD, cls, name, signature);
+}
+
 JNIHelper::JNIHelper(JavaVM *vm)
 {
     vm->AttachCurrentThread(&mEnv, NULL);
@@ -87,7 +236,7 @@ void JNIHelper::throwException(const char *message, int line)
 jboolean JNIHelper::getBoolField(jobject obj, const char *name)
 {
     JNIObject<jclass> cls(*this, mEnv->GetObjectClass(obj));
-    jfieldID field = mEnv->GetFieldID(cls, name, "Z");
+    jfieldID field = getFieldID(cls, name, "Z");
     if (field == 0) {
         THROW(*this, "Error in accessing field");
         return 0;
@@ -99,7 +248,7 @@ jboolean JNIHelper::getBoolField(jobject obj, const char *name)
 jint JNIHelper::getIntField(jobject obj, const char *name)
 {
     JNIObject<jclass> cls(*this, mEnv->GetObjectClass(obj));
-    jfieldID field = mEnv->GetFieldID(cls, name, "I");
+    jfieldID field = getFieldID(cls, name, "I");
     if (field == 0) {
         THROW(*this, "Error in accessing field");
         return 0;
@@ -111,7 +260,7 @@ jint JNIHelper::getIntField(jobject obj, const char *name)
 jbyte JNIHelper::getByteField(jobject obj, const char *name)
 {
     JNIObject<jclass> cls(*this, mEnv->GetObjectClass(obj));
-    jfieldID field = mEnv->GetFieldID(cls, name, "B");
+    jfieldID field = getFieldID(cls, name, "B");
     if (field == 0) {
         THROW(*this, "Error in accessing field");
         return 0;
@@ -123,7 +272,7 @@ jbyte JNIHelper::getByteField(jobject obj, const char *name)
 jlong JNIHelper::getLongField(jobject obj, const char *name)
 {
     JNIObject<jclass> cls(*this, mEnv->GetObjectClass(obj));
-    jfieldID field = mEnv->GetFieldID(cls, name, "J");
+    jfieldID field = getFieldID(cls, name, "J");
     if (field == 0) {
         THROW(*this, "Error in accessing field");
         return 0;
@@ -146,7 +295,7 @@ JNIObject<jstring> JNIHelper::getStringField(jobject obj, const char *name)
 bool JNIHelper::getStringFieldValue(jobject obj, const char *name, char *buf, int size)
 {
     JNIObject<jclass> cls(*this, mEnv->GetObjectClass(obj));
-    jfieldID field = mEnv->GetFieldID(cls, name, "Ljava/lang/String;");
+    jfieldID field = getFieldID(cls, name, "Ljava/lang/String;");
     if (field == 0) {
         THROW(*this, "Error in accessing field");
         return 0;
@@ -182,7 +331,7 @@ jlong JNIHelper::getStaticLongField(jobject obj, const char *name)
 
 jlong JNIHelper::getStaticLongField(jclass cls, const char *name)
 {
-    jfieldID field = mEnv->GetStaticFieldID(cls, name, "J");
+    jfieldID field = getStaticFieldID(cls, name, "J");
     if (field == 0) {
         THROW(*this, "Error in accessing field");
         return 0;
@@ -194,7 +343,7 @@ jlong JNIHelper::getStaticLongField(jclass cls, const char *name)
 JNIObject<jobject> JNIHelper::getObjectField(jobject obj, const char *name, const char *type)
 {
     JNIObject<jclass> cls(*this, mEnv->GetObjectClass(obj));
-    jfieldID field = mEnv->GetFieldID(cls, name, type);
+    jfieldID field = getFieldID(cls, name, type);
     if (field == 0) {
         THROW(*this, "Error in accessing field");
         return JNIObject<jobject>(*this, NULL);
@@ -206,7 +355,7 @@ JNIObject<jobject> JNIHelper::getObjectField(jobject obj, const char *name, cons
 JNIObject<jobjectArray> JNIHelper::getArrayField(jobject obj, const char *name, const char *type)
 {
     JNIObject<jclass> cls(*this, mEnv->GetObjectClass(obj));
-    jfieldID field = mEnv->GetFieldID(cls, name, type);
+    jfieldID field = getFieldID(cls, name, type);
     if (field == 0) {
         THROW(*this, "Error in accessing field");
         return JNIObject<jobjectArray>(*this, NULL);
@@ -218,7 +367,7 @@ JNIObject<jobjectArray> JNIHelper::getArrayField(jobject obj, const char *name,
 jlong JNIHelper::getLongArrayField(jobject obj, const char *name, int index)
 {
     JNIObject<jclass> cls(*this, mEnv->GetObjectClass(obj));
-    jfieldID field = mEnv->GetFieldID(cls, name, "[J");
+    jfieldID field = getFieldID(cls, name, "[J");
     if (field == 0) {
         THROW(*this, "Error in accessing field definition");
         return 0;
@@ -249,7 +398,7 @@ jlong JNIHelper::getStaticLongArrayField(jobject obj, const char *name, int inde
 
 jlong JNIHelper::getStaticLongArrayField(jclass cls, const char *name, int index)
 {
-    jfieldID field = mEnv->GetStaticFieldID(cls, name, "[J");
+    jfieldID field = getStaticFieldID(cls, name, "[J");
     if (field == 0) {
         THROW(*this, "Error in accessing field definition");
         return 0;
@@ -271,7 +420,7 @@ JNIObject<jobject> JNIHelper::getObjectArrayField(jobject obj, const char *name,
 int index)
 {
     JNIObject<jclass> cls(*this, mEnv->GetObjectClass(obj));
-    jfieldID field = mEnv->GetFieldID(cls, name, type);
+    jfieldID field = getFieldID(cls, name, type);
     if (field == 0) {
         THROW(*this, "Error in accessing field definition");
         return JNIObject<jobject>(*this, NULL);
@@ -294,7 +443,7 @@ void JNIHelper::setIntField(jobject obj, const char *name, jint value)
         return;
     }
 
-    jfieldID field = mEnv->GetFieldID(cls, name, "I");
+    jfieldID field = getFieldID(cls, name, "I");
     if (field == NULL) {
         THROW(*this, "Error in accessing field");
         return;
@@ -311,7 +460,7 @@ void JNIHelper::setByteField(jobject obj, const char *name, jbyte value)
         return;
     }
 
-    jfieldID field = mEnv->GetFieldID(cls, name, "B");
+    jfieldID field = getFieldID(cls, name, "B");
     if (field == NULL) {
         THROW(*this, "Error in accessing field");
         return;
@@ -328,7 +477,7 @@ void JNIHelper::setBooleanField(jobject obj, const char *name, jboolean value)
         return;
     }
 
-    jfieldID field = mEnv->GetFieldID(cls, name, "Z");
+    jfieldID field = getFieldID(cls, name, "Z");
     if (field == NULL) {
         THROW(*this, "Error in accessing field");
         return;
@@ -345,7 +494,7 @@ void JNIHelper::setLongField(jobject obj, const char *name, jlong value)
         return;
     }
 
-    jfieldID field = mEnv->GetFieldID(cls, name, "J");
+    jfieldID field = getFieldID(cls, name, "J");
     if (field == NULL) {
         THROW(*this, "Error in accessing field");
         return;
@@ -367,7 +516,7 @@ void JNIHelper::setStaticLongField(jobject obj, const char *name, jlong value)
 
 void JNIHelper::setStaticLongField(jclass cls, const char *name, jlong value)
 {
-    jfieldID field = mEnv->GetStaticFieldID(cls, name, "J");
+    jfieldID field = getStaticFieldID(cls, name, "J");
     if (field == NULL) {
         THROW(*this, "Error in accessing field");
         return;
@@ -384,7 +533,7 @@ void JNIHelper::setLongArrayField(jobject obj, const char *name, jlongArray valu
         return;
     }
 
-    jfieldID field = mEnv->GetFieldID(cls, name, "[J");
+    jfieldID field = getFieldID(cls, name, "[J");
     if (field == NULL) {
         THROW(*this, "Error in accessing field");
         return;
@@ -406,7 +555,7 @@ void JNIHelper::setStaticLongArrayField(jobject obj, const char *name, jlongArra
 
 void JNIHelper::setStaticLongArrayField(jclass cls, const char *name, jlongArray value)
 {
-    jfieldID field = mEnv->GetStaticFieldID(cls, name, "[J");
+    jfieldID field = getStaticFieldID(cls, name, "[J");
     if (field == NULL) {
         THROW(*this, "Error in accessing field");
         return;
@@ -424,7 +573,7 @@ void JNIHelper::setLongArrayElement(jobject obj, const char *name, int index, jl
         return;
     }
 
-    jfieldID field = mEnv->GetFieldID(cls, name, "[J");
+    jfieldID field = getFieldID(cls, name, "[J");
     if (field == NULL) {
         THROW(*this, "Error in accessing field");
         return;
@@ -454,7 +603,7 @@ void JNIHelper::setObjectField(jobject obj, const char *name, const char *type,
         return;
     }
 
-    jfieldID field = mEnv->GetFieldID(cls, name, type);
+    jfieldID field = getFieldID(cls, name, type);
     if (field == NULL) {
         THROW(*this, "Error in accessing field");
         return;
@@ -487,7 +636,7 @@ void JNIHelper::reportEvent(jclass cls, const char *method, const char *signatur
     va_list params;
     va_start(params, signature);
 
-    jmethodID methodID = mEnv->GetStaticMethodID(cls, method, signature);
+    jmethodID methodID = getStaticMethodID(cls, method, signature);
     if (methodID == 0) {
         ALOGE("Error in getting method ID");
         return;
@@ -507,7 +656,7 @@ jboolean JNIHelper::callStaticMethod(jclass cls, const char *method, const char
     va_list params;
     va_start(params, signature);
 
-    jmethodID methodID = mEnv->GetStaticMethodID(cls, method, signature);
+    jmethodID methodID = getStaticMethodID(cls, method, signature);
     if (methodID == 0) {
         ALOGE("Error in getting method ID");
         return false;
@@ -526,13 +675,13 @@ jboolean JNIHelper::callStaticMethod(jclass cls, const char *method, const char
 
 JNIObject<jobject> JNIHelper::createObject(const char *className)
 {
-    JNIObject<jclass> cls(*this, mEnv->FindClass(className));
+    jclass cls = findClass(className);
     if (cls == NULL) {
         ALOGE("Error in finding class %s", className);
         return JNIObject<jobject>(*this, NULL);
     }
 
-    jmethodID constructor = mEnv->GetMethodID(cls, "<init>", "()V");
+    jmethodID constructor = getMethodID(cls, "<init>", "()V");
     if (constructor == 0) {
         ALOGE("Error in constructor ID for %s", className);
         return JNIObject<jobject>(*this, NULL);
@@ -549,13 +698,13 @@ JNIObject<jobject> JNIHelper::createObject(const char *className)
 
 JNIObject<jobjectArray> JNIHelper::createObjectArray(const char *className, int num)
 {
-    JNIObject<jclass> cls(*this, mEnv->FindClass(className));
+    jclass cls = findClass(className);
     if (cls == NULL) {
         ALOGE("Error in finding class %s", className);
         return JNIObject<jobjectArray>(*this, NULL);
     }
 
-    JNIObject<jobject> array(*this, mEnv->NewObjectArray(num, cls.get(), NULL));
+    JNIObject<jobject> array(*this, mEnv->NewObjectArray(num, cls, NULL));
     if (array.get() == NULL) {
         ALOGE("Error in creating array of class %s", className);
         return JNIObject<jobjectArray>(*this, NULL);
@@ -579,7 +728,7 @@ int JNIHelper::getArrayLength(jarray array) {
 }
 
 JNIObject<jobjectArray> JNIHelper::newObjectArray(int num, const char *className, jobject val) {
-    JNIObject<jclass> cls(*this, mEnv->FindClass(className));
+    jclass cls = findClass(className);
     if (cls == NULL) {
         ALOGE("Error in finding class %s", className);
         return JNIObject<jobjectArray>(*this, NULL);
@@ -121,6 +121,14 @@ private:
     friend class JNIObject<jintArray>;
     jobject newLocalRef(jobject obj);
     void deleteLocalRef(jobject obj);
+
+    /* cached lookups; the returned class is a global ref and must not be deleted */
+    jclass findClass(const char *className);
+    void *getMemberID(int kind, jclass cls, const char *name, const char *signature);
+    jfieldID getFieldID(jclass cls, const char *name, const char *signature);
+    jfieldID getStaticFieldID(jclass cls, const char *name, const char *signature);
+    jmethodID getMethodID(jclass cls, const char *name, const char *signature);
+    jmethodID getStaticMethodID(jclass cls, const char *name, const char *signature);
 };
 
 template<typename T>
@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wifi_anqp.h"
+
+namespace android {
+
+/* ANQP info IDs, 802.11-2012 table 8-184 */
+static const int ANQP_CAPABILITY_LIST = 257;
+static const int ANQP_VENUE_NAME = 258;
+static const int ANQP_ROAMING_CONSORTIUM = 261;
+static const int ANQP_NAI_REALM = 263;
+static const int ANQP_DOM_NAME = 268;
+static const int ANQP_NEIGHBOR_REPORT = 272;
+static const int ANQP_VENDOR_SPEC = 56797;
+
+static const uint8_t HS20_PREFIX[4] = { 0x50, 0x6f, 0x9a, 0x11 };
+static const int HS20_HEADER_LEN = 6;       /* prefix, subtype and a reserved octet */
+static const int HS_FRIENDLY_NAME = 3;
+static const int HS_OSU_PROVIDERS = 8;
+
+static const size_t OSU_PROVIDER_MIN_LEN = 11;
+
+static const int LANG_CODE_LENGTH = 3;
+
+static bool isKnownHs20Subtype(int subtype)
+{
+    return (subtype >= 1 && subtype <= 8) || subtype == 10 || subtype == 11;
+}
+
+/* keeps counting once out is full, so the caller learns how much room the index needs */
+struct IndexWriter {
+    int32_t *out;
+    size_t cap;
+    size_t entryBase;
+    int numEntries;
+
+    void put(size_t pos, int32_t value) {
+        if (pos < cap) {
+            out[pos] = value;
+        }
+    }
+
+    void addEntry(int kind, size_t offset, size_t length) {
+        size_t pos = entryBase + (size_t)numEntries * ANQP_ENTRY_RECORD_LEN;
+        put(pos + ANQP_ENTRY_KIND, kind);
+        put(pos + ANQP_ENTRY_OFFSET, offset);
+        put(pos + ANQP_ENTRY_LENGTH, length);
+        numEntries++;
+    }
+};
+
+static int le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/* a list of one octet length prefixed strings, as in the Domain Name element */
+static bool indexPrefixedStrings(const uint8_t *payload, size_t pos, size_t end, int kind,
+        IndexWriter &w)
+{
+    while (pos < end) {
+        size_t n = payload[pos++];
+        if (n > end - pos) {
+            return false;
+        }
+        w.addEntry(kind, pos, n);
+        pos += n;
+    }
+    return true;
+}
+
+/* a list of I18Names, as in the Venue Name and Operator Friendly Name elements */
+static bool indexNames(const uint8_t *payload, size_t pos, size_t end, IndexWriter &w)
+{
+    while (pos < end) {
+        if (end - pos < 4) {
+            return false;
+        }
+        size_t n = payload[pos++];
+        if (n < LANG_CODE_LENGTH || n > end - pos) {
+            return false;
+        }
+        w.addEntry(ANQP_ENTRY_NAME, pos, n);
+        pos += n;
+    }
+    return true;
+}
+
+/* I18Names packed into [pos, end), checked the way I18Name parses them */
+static bool checkNames(const uint8_t *payload, size_t pos, size_t end)
+{
+    while (pos < end) {
+        if (end - pos < 4) {
+            return false;
+        }
+        size_t n = payload[pos++];
+        if (n < LANG_CODE_LENGTH || n > end - pos) {
+            return false;
+        }
+        pos += n;
+    }
+    return true;
+}
+
+/* skips a field of a one or two octet length, then that many octets */
+static bool skipPrefixed(const uint8_t *payload, size_t *pos, size_t end, int lengthLength)
+{
+    if (end - *pos < (size_t)lengthLength) {
+        return false;
+    }
+    size_t n = lengthLength == 1 ? payload[*pos] : le16(payload + *pos);
+    *pos += lengthLength;
+    if (n > end - *pos) {
+        return false;
+    }
+    *pos += n;
+    return true;
+}
+
+/*
+ * An OSU providers list: the OSU SSID, then each provider laid out as OSUProvider reads it.
+ * Icons are left to IconInfo; the names are checked since they are what a provider is shown
+ * by.
+ */
+static bool indexOsuProviders(const uint8_t *payload, size_t pos, size_t end, IndexWriter &w)
+{
+    size_t ssid = pos + 1;
+    if (!skipPrefixed(payload, &pos, end, 1)) {
+        return false;
+    }
+    w.addEntry(ANQP_ENTRY_OSU_SSID, ssid, pos - ssid);
+    if (pos == end) {
+        return false;
+    }
+    int count = payload[pos++];
+
+    while (count-- > 0) {
+        size_t start = pos;
+        if (end - pos < OSU_PROVIDER_MIN_LEN) {
+            return false;
+        }
+        pos += 2;                       /* the provider length, which OSUProvider ignores */
+        size_t names = pos + 2;
+        if (!skipPrefixed(payload, &pos, end, 2) || !checkNames(payload, names, pos)) {
+            return false;
+        }
+        size_t server = pos + 1;
+        if (!skipPrefixed(payload, &pos, end, 1)) {
+            return false;
+        }
+        size_t serverLength = pos - server;
+        if (!skipPrefixed(payload, &pos, end, 1)           /* methods */
+                || !skipPrefixed(payload, &pos, end, 2)    /* icons */
+                || !skipPrefixed(payload, &pos, end, 1)) { /* NAI */
+            return false;
+        }
+        size_t descriptions = pos + 2;
+        if (!skipPrefixed(payload, &pos, end, 2) || !checkNames(payload, descriptions, pos)) {
+            return false;
+        }
+        w.addEntry(ANQP_ENTRY_OSU_PROVIDER, start, pos - start);
+        w.addEntry(ANQP_ENTRY_OSU_SERVER, server, serverLength);
+    }
+    return true;
+}
+
+/*
+ * NAI realm data is walked the way NAIRealmData reads it: its data length is only checked,
+ * and the record ends after its last EAP method.
+ */
+static bool indexRealms(const uint8_t *payload, size_t pos, size_t end, IndexWriter &w)
+{
+    if (pos == end) {
+        return true;
+    }
+    if (end - pos < 2) {
+        return false;
+    }
+    int count = le16(payload + pos);
+    pos += 2;
+    while (count-- > 0) {
+        if (end - pos < 5) {
+            return false;
+        }
+        size_t dataLength = le16(payload + pos);
+        pos += 2;
+        if (dataLength > end - pos) {
+            return false;
+        }
+        int kind = (payload[pos++] & 1) ? ANQP_ENTRY_REALM_UTF8 : ANQP_ENTRY_REALM;
+        size_t n = payload[pos++];
+        if (n > end - pos) {
+            return false;
+        }
+        /* one entry per realm in the ';' separated list, empty ones left out */
+        size_t start = pos;
+        for (size_t i = pos; i <= pos + n; i++) {
+            if (i == pos + n || payload[i] == ';') {
+                if (i > start) {
+                    w.addEntry(kind, start, i - start);
+                }
+                start = i + 1;
+            }
+        }
+        pos += n;
+
+        /* the EAP methods are left to EAPMethod, past their length */
+        if (pos == end) {
+            return false;
+        }
+        int methods = payload[pos++];
+        while (methods-- > 0) {
+            if (end - pos < 3) {
+                return false;
+            }
+            size_t length = payload[pos];
+            if (length < 2 || length - 2 > end - pos - 3) {
+                return false;
+            }
+            pos += 1 + length;
+        }
+    }
+    return true;
+}
+
+static bool indexElement(const uint8_t *payload, int id, int subtype, size_t pos, size_t end,
+        IndexWriter &w)
+{
+    if (subtype == HS_FRIENDLY_NAME) {
+        return indexNames(payload, pos, end, w);
+    }
+    if (subtype == HS_OSU_PROVIDERS) {
+        return indexOsuProviders(payload, pos, end, w);
+    }
+    switch (id) {
+        case ANQP_VENUE_NAME:
+            if (end - pos < 2) {
+                return false;
+            }
+            return indexNames(payload, pos + 2, end, w);
+        case ANQP_ROAMING_CONSORTIUM:
+            return indexPrefixedStrings(payload, pos, end, ANQP_ENTRY_OI, w);
+        case ANQP_NAI_REALM:
+            return indexRealms(payload, pos, end, w);
+        case ANQP_DOM_NAME:
+            return indexPrefixedStrings(payload, pos, end, ANQP_ENTRY_DOMAIN, w);
+        default:
+            return true;
+    }
+}
+
+/*
+ * Walks the element framing once; with w set, also writes the element records and the
+ * string table. Returns the number of elements, or -1.
+ */
+static int walkElements(const uint8_t *payload, size_t len, IndexWriter *w)
+{
+    size_t pos = 0;
+    int count = 0;
+    while (pos < len) {
+        if (len - pos < 4) {
+            return -1;
+        }
+        int id = le16(payload + pos);
+        size_t length = le16(payload + pos + 2);
+        pos += 4;
+        if (length > len - pos) {
+            return -1;
+        }
+        if ((id < ANQP_CAPABILITY_LIST || id > ANQP_NEIGHBOR_REPORT) && id != ANQP_VENDOR_SPEC) {
+            return -1;
+        }
+
+        int subtype = -1;
+        size_t start = pos;
+        size_t end = pos + length;
+        /* anything else vendor specific is left as is; Java knows what to make of it */
+        if (id == ANQP_VENDOR_SPEC && length > 5
+                && payload[pos] == HS20_PREFIX[0] && payload[pos + 1] == HS20_PREFIX[1]
+                && payload[pos + 2] == HS20_PREFIX[2] && payload[pos + 3] == HS20_PREFIX[3]) {
+            subtype = payload[pos + 4];
+            if (!isKnownHs20Subtype(subtype)) {
+                return -1;
+            }
+            start = pos + HS20_HEADER_LEN;
+        }
+
+        if (w != NULL) {
+            size_t rec = ANQP_INDEX_HEADER_LEN + (size_t)count * ANQP_ELEMENT_RECORD_LEN;
+            int firstEntry = w->numEntries;
+            if (!indexElement(payload, id, subtype, start, end, *w)) {
+                return -1;
+            }
+            w->put(rec + ANQP_ELEMENT_ID, id);
+            w->put(rec + ANQP_ELEMENT_HS20_SUBTYPE, subtype);
+            w->put(rec + ANQP_ELEMENT_OFFSET, start);
+            w->put(rec + ANQP_ELEMENT_LENGTH, end - start);
+            w->put(rec + ANQP_ELEMENT_FIRST_ENTRY, firstEntry);
+            w->put(rec + ANQP_ELEMENT_ENTRY_COUNT, w->numEntries - firstEntry);
+        }
+        count++;
+        pos = end;
+    }
+    return count;
+}
+
+int index_anqp_payload(const uint8_t *payload, size_t len, int32_t *out, size_t cap)
+{
+    int numElements = walkElements(payload, len, NULL);
+    if (numElements < 0) {
+        return -1;
+    }
+
+    IndexWriter w;
+    w.out = out;
+    w.cap = cap;
+    w.entryBase = ANQP_INDEX_HEADER_LEN + (size_t)numElements * ANQP_ELEMENT_RECORD_LEN;
+    w.numEntries = 0;
+    if (walkElements(payload, len, &w) < 0) {
+        return -1;
+    }
+    w.put(ANQP_INDEX_ELEMENT_COUNT, numElements);
+    w.put(ANQP_INDEX_ENTRY_COUNT, w.numEntries);
+    return w.entryBase + (size_t)w.numEntries * ANQP_ENTRY_RECORD_LEN;
+}
+
+}; // namespace android
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_ANQP_H__
+#define __WIFI_ANQP_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace android {
+
+/*
+ * Flat index of an ANQP response payload; keep these consistent with anqp/ANQPIndex.java.
+ *
+ * The index is an int array: a header, one record per element, then one record per string
+ * table entry. Offsets are into the payload that was indexed, which Java keeps, so nothing
+ * is copied out of it until an element or string is asked for.
+ */
+enum {
+    ANQP_INDEX_ELEMENT_COUNT = 0,
+    ANQP_INDEX_ENTRY_COUNT,
+    ANQP_INDEX_HEADER_LEN
+};
+
+/* element record */
+enum {
+    ANQP_ELEMENT_ID = 0,            /* ANQP info ID */
+    ANQP_ELEMENT_HS20_SUBTYPE,      /* for HS2.0 vendor specific elements, else -1 */
+    ANQP_ELEMENT_OFFSET,            /* of what the Java element constructor parses */
+    ANQP_ELEMENT_LENGTH,
+    ANQP_ELEMENT_FIRST_ENTRY,       /* string table entries that came out of this element */
+    ANQP_ELEMENT_ENTRY_COUNT,
+    ANQP_ELEMENT_RECORD_LEN
+};
+
+/* string table entry record */
+enum {
+    ANQP_ENTRY_KIND = 0,
+    ANQP_ENTRY_OFFSET,
+    ANQP_ENTRY_LENGTH,
+    ANQP_ENTRY_RECORD_LEN
+};
+
+/* string table entry kinds */
+enum {
+    ANQP_ENTRY_DOMAIN = 1,          /* domain name, latin-1 */
+    ANQP_ENTRY_REALM,               /* one ';' separated NAI realm, US-ASCII */
+    ANQP_ENTRY_REALM_UTF8,          /* same, UTF-8 */
+    ANQP_ENTRY_OI,                  /* roaming consortium OI, big endian */
+    ANQP_ENTRY_NAME,                /* venue or operator name: 3 byte language, then UTF-8 */
+    ANQP_ENTRY_OSU_SSID,            /* SSID of an OSU providers list, UTF-8 */
+    ANQP_ENTRY_OSU_PROVIDER,        /* one OSU provider, as OSUProvider parses it */
+    ANQP_ENTRY_OSU_SERVER,          /* server URI of the OSU provider before it, UTF-8 */
+};
+
+/*
+ * Indexes an ANQP payload into out, writing at most cap ints. Returns the number of ints
+ * the complete index takes, which is more than cap if out was too small; -1 if the payload
+ * is malformed. Framing is rejected wherever ANQPFactory.parsePayload would throw; the
+ * elements that feed the string table are also bounds checked, the others are only checked
+ * by their Java constructors once they are asked for. Never allocates.
+ */
+int index_anqp_payload(const uint8_t *payload, size_t len, int32_t *out, size_t cap);
+
+}
+
+#endif //__WIFI_ANQP_H__
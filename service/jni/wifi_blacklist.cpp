@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "wifi_blacklist.h"
+
+namespace android {
+
+static uint64_t bssidKey(const mac_addr bssid)
+{
+    uint64_t key = 0;
+    for (int i = 0; i < 6; i++) {
+        key = (key << 8) | bssid[i];
+    }
+    return key;
+}
+
+static void bssidFromKey(uint64_t key, mac_addr bssid)
+{
+    for (int i = 5; i >= 0; i--) {
+        bssid[i] = key & 0xff;
+        key >>= 8;
+    }
+}
+
+BssidBlacklist::BssidBlacklist()
+    : mNextId(0), mNextSequence(0), mWheel(kTick, kSlots), mIsProgrammed(false)
+{
+    memset(&mProgrammed, 0, sizeof(mProgrammed));
+}
+
+void BssidBlacklist::removeEntry(int id)
+{
+    std::map<int, Entry>::iterator it = mEntries.find(id);
+    if (it != mEntries.end()) {
+        mIds.erase(it->second.bssid);
+        mEntries.erase(it);
+    }
+    mWheel.cancel(id);
+}
+
+bool BssidBlacklist::add(const mac_addr bssid, int reason, nsecs_t duration, nsecs_t now)
+{
+    expire(now);
+
+    uint64_t key = bssidKey(bssid);
+    bool changed = false;
+    int id;
+    std::map<uint64_t, int>::iterator it = mIds.find(key);
+    if (it != mIds.end()) {
+        id = it->second;
+    } else {
+        if (mIds.size() >= (size_t) MAX_BLACKLIST_BSSID) {
+            int oldest = mEntries.begin()->first;
+            for (std::map<int, Entry>::iterator e = mEntries.begin(); e != mEntries.end(); ++e) {
+                if (e->second.sequence < mEntries[oldest].sequence) {
+                    oldest = e->first;
+                }
+            }
+            removeEntry(oldest);
+        }
+
+        do {
+            id = mNextId;
+            mNextId = mNextId < INT32_MAX ? mNextId + 1 : 0;
+        } while (mEntries.find(id) != mEntries.end());
+
+        Entry entry;
+        entry.bssid = key;
+        entry.sequence = mNextSequence++;
+        mEntries[id] = entry;
+        mIds[key] = id;
+        changed = true;
+    }
+
+    mEntries[id].reason = reason;
+    if (duration > 0) {
+        mWheel.schedule(id, now + duration);
+    } else {
+        mWheel.cancel(id);
+    }
+    return changed;
+}
+
+bool BssidBlacklist::remove(const mac_addr bssid)
+{
+    std::map<uint64_t, int>::iterator it = mIds.find(bssidKey(bssid));
+    if (it == mIds.end()) {
+        return false;
+    }
+    removeEntry(it->second);
+    return true;
+}
+
+bool BssidBlacklist::clear()
+{
+    bool changed = !mIds.empty();
+    mEntries.clear();
+    mIds.clear();
+    mWheel.cancelAll();
+    return changed;
+}
+
+bool BssidBlacklist::expire(nsecs_t now)
+{
+    std::vector<int> expired;
+    mWheel.advance(now, expired);
+
+    for (size_t i = 0; i < expired.size(); i++) {
+        std::map<int, Entry>::iterator it = mEntries.find(expired[i]);
+        if (it == mEntries.end()) {
+            continue;
+        }
+
+        if (mExpired.size() >= kMaxExpired) {
+            mExpired.erase(mExpired.begin());
+        }
+        BlacklistExpiry expiry;
+        bssidFromKey(it->second.bssid, expiry.bssid);
+        expiry.reason = it->second.reason;
+        mExpired.push_back(expiry);
+
+        mIds.erase(it->second.bssid);
+        mEntries.erase(it);
+    }
+    return !expired.empty();
+}
+
+void BssidBlacklist::takeExpired(std::vector<BlacklistExpiry> &expired)
+{
+    expired.insert(expired.end(), mExpired.begin(), mExpired.end());
+    mExpired.clear();
+}
+
+void BssidBlacklist::build(wifi_bssid_params *params) const
+{
+    memset(params, 0, sizeof(*params));
+    /* mIds is ordered by BSSID */
+    for (std::map<uint64_t, int>::const_iterator it = mIds.begin(); it != mIds.end(); ++it) {
+        bssidFromKey(it->first, params->bssids[params->num_bssid++]);
+    }
+}
+
+bool BssidBlacklist::isProgrammed(const wifi_bssid_params &params) const
+{
+    return mIsProgrammed && params.num_bssid == mProgrammed.num_bssid
+            && memcmp(params.bssids, mProgrammed.bssids,
+                    params.num_bssid * sizeof(mac_addr)) == 0;
+}
+
+void BssidBlacklist::setProgrammed(const wifi_bssid_params &params)
+{
+    mProgrammed = params;
+    mIsProgrammed = true;
+}
+
+void BssidBlacklist::resetProgrammed()
+{
+    mIsProgrammed = false;
+}
+
+}; // namespace android
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_BLACKLIST_H__
+#define __WIFI_BLACKLIST_H__
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <utils/Timers.h>
+
+#include "wifi_hal.h"
+#include "gscan.h"
+#include "wifi_timer_wheel.h"
+
+namespace android {
+
+struct BlacklistExpiry {
+    mac_addr bssid;
+    int reason;
+};
+
+/*
+ * The BSSID blacklist, with a reason and optional deadline per BSSID. Deadlines are kept in
+ * a timer wheel and acted on whenever the blacklist is touched; expired BSSIDs are queued
+ * until they are taken. Once MAX_BLACKLIST_BSSID BSSIDs are blacklisted, the one added
+ * longest ago makes room for a new one. What the HAL was last programmed with is remembered,
+ * so that it is only programmed again when the set of BSSIDs changed. Not thread safe;
+ * callers hold their own lock.
+ */
+class BssidBlacklist {
+public:
+    static const nsecs_t kTick = 1000000000LL;          /* 1s */
+    static const size_t kSlots = 256;
+    static const size_t kMaxExpired = 64;               /* oldest are dropped if not taken */
+
+    BssidBlacklist();
+
+    /*
+     * Blacklists bssid for duration, or until removed if duration is 0. Blacklisting a BSSID
+     * again replaces its reason and deadline. Returns true if the set of BSSIDs changed.
+     */
+    bool add(const mac_addr bssid, int reason, nsecs_t duration, nsecs_t now);
+    bool remove(const mac_addr bssid);
+    bool clear();
+
+    /* drops the BSSIDs whose deadline passed; returns true if there were any */
+    bool expire(nsecs_t now);
+
+    /* appends the BSSIDs that expired since the last call, in expiry order, and forgets them */
+    void takeExpired(std::vector<BlacklistExpiry> &expired);
+
+    /* the BSSIDs blacklisted now, sorted */
+    void build(wifi_bssid_params *params) const;
+
+    bool isProgrammed(const wifi_bssid_params &params) const;
+    void setProgrammed(const wifi_bssid_params &params);
+    void resetProgrammed();
+
+    size_t size() const {
+        return mIds.size();
+    }
+
+private:
+    struct Entry {
+        uint64_t bssid;
+        int reason;
+        uint64_t sequence;          /* order of addition, for eviction */
+    };
+
+    void removeEntry(int id);
+
+    std::map<int, Entry> mEntries;          /* by timer id */
+    std::map<uint64_t, int> mIds;           /* timer id by BSSID */
+    int mNextId;
+    uint64_t mNextSequence;
+    TimerWheel mWheel;
+    std::vector<BlacklistExpiry> mExpired;
+    wifi_bssid_params mProgrammed;
+    bool mIsProgrammed;
+};
+
+}
+
+#endif //__WIFI_BLACKLIST_H__
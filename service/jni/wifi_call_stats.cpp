@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "wifi_call_stats.h"
+
+namespace android {
+
+std::atomic<CallStats *> CallStats::sHead(NULL);
+std::atomic<int64_t> CallStats::sBytesTraced(0);
+std::atomic<int32_t> CallbackScope::sInFlight(0);
+
+CallStats::CallStats(const char *group, const char *name)
+    : mGroup(group), mName(name), mCalls(0), mErrors(0), mBytes(0), mTotalNs(0), mMaxNs(0)
+{
+    for (int i = 0; i < CALL_STATS_BUCKETS; i++) {
+        mBuckets[i].store(0, std::memory_order_relaxed);
+    }
+
+    mNext = sHead.load();
+    while (!sHead.compare_exchange_weak(mNext, this)) {
+    }
+}
+
+int CallStats::bucketFor(uint64_t latency)
+{
+    if (latency < (1ULL << CALL_STATS_MIN_SHIFT)) {
+        return 0;
+    }
+    int log = 63 - __builtin_clzll(latency);
+    int sub = (latency >> (log - CALL_STATS_SUB_BUCKET_BITS)) & ((1 << CALL_STATS_SUB_BUCKET_BITS) - 1);
+    int bucket = ((log - CALL_STATS_MIN_SHIFT) << CALL_STATS_SUB_BUCKET_BITS) + sub + 1;
+    return bucket < CALL_STATS_BUCKETS ? bucket : CALL_STATS_BUCKETS - 1;
+}
+
+/* the smallest latency that is above every latency in bucket */
+uint64_t CallStats::bucketLimit(int bucket)
+{
+    if (bucket == 0) {
+        return 1ULL << CALL_STATS_MIN_SHIFT;
+    }
+    int log = ((bucket - 1) >> CALL_STATS_SUB_BUCKET_BITS) + CALL_STATS_MIN_SHIFT;
+    int sub = (bucket - 1) & ((1 << CALL_STATS_SUB_BUCKET_BITS) - 1);
+    return (uint64_t) ((1 << CALL_STATS_SUB_BUCKET_BITS) + sub + 1)
+            << (log - CALL_STATS_SUB_BUCKET_BITS);
+}
+
+void CallStats::record(nsecs_t latency, bool error, size_t bytes)
+{
+    uint64_t ns = latency > 0 ? latency : 0;
+
+    mCalls.fetch_add(1, std::memory_order_relaxed);
+    mTotalNs.fetch_add(ns, std::memory_order_relaxed);
+    mBuckets[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+    if (error) {
+        mErrors.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (bytes != 0) {
+        mBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    uint64_t max = mMaxNs.load(std::memory_order_relaxed);
+    while (ns > max && !mMaxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void CallStats::traceBytes(size_t bytes)
+{
+    int64_t total = sBytesTraced.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    atrace_int64(WIFI_TRACE_TAG, "wifi_bytes_to_java", total);
+}
+
+uint64_t CallStats::percentile(const uint32_t *buckets, uint64_t count, int percent) const
+{
+    uint64_t rank = (count * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < CALL_STATS_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t limit = bucketLimit(i);
+            uint64_t max = mMaxNs.load(std::memory_order_relaxed);
+            return limit < max ? limit : max;
+        }
+    }
+    return mMaxNs.load(std::memory_order_relaxed);
+}
+
+void CallStats::dumpAll(std::string &out)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "%-4s %-48s %10s %8s %12s %10s %10s %10s %10s %10s\n",
+            "", "name", "calls", "errors", "bytes", "avg(us)", "p50(us)", "p90(us)",
+            "p99(us)", "max(us)");
+    out.append(line);
+
+    for (CallStats *stats = sHead.load(); stats != NULL; stats = stats->mNext) {
+        /* percentiles come from a snapshot, which may be a few calls behind the counters */
+        uint32_t buckets[CALL_STATS_BUCKETS];
+        uint64_t count = 0;
+        for (int i = 0; i < CALL_STATS_BUCKETS; i++) {
+            buckets[i] = stats->mBuckets[i].load(std::memory_order_relaxed);
+            count += buckets[i];
+        }
+        if (count == 0) {
+            continue;
+        }
+
+        uint64_t calls = stats->mCalls.load(std::memory_order_relaxed);
+        snprintf(line, sizeof(line),
+                "%-4s %-48s %10llu %8llu %12llu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                stats->mGroup, stats->mName, (unsigned long long) calls,
+                (unsigned long long) stats->mErrors.load(std::memory_order_relaxed),
+                (unsigned long long) stats->mBytes.load(std::memory_order_relaxed),
+                stats->mTotalNs.load(std::memory_order_relaxed) / 1000.0 / (calls ? calls : 1),
+                stats->percentile(buckets, count, 50) / 1000.0,
+                stats->percentile(buckets, count, 90) / 1000.0,
+                stats->percentile(buckets, count, 99) / 1000.0,
+                stats->mMaxNs.load(std::memory_order_relaxed) / 1000.0);
+        out.append(line);
+    }
+}
+
+/* the functions the vendor table held before it was instrumented */
+static wifi_hal_fn sHalTarget;
+
+template<typename F, F wifi_hal_fn::*Member>
+struct HalCall;
+
+template<typename... Args, wifi_error (*wifi_hal_fn::*Member)(Args...)>
+struct HalCall<wifi_error (*)(Args...), Member> {
+    static CallStats *sStats;
+
+    static wifi_error call(Args... args) {
+        CallTimer timer(*sStats);
+        wifi_error result = (sHalTarget.*Member)(args...);
+        if (result != WIFI_SUCCESS) {
+            timer.setError();
+        }
+        return result;
+    }
+};
+
+template<typename... Args, wifi_error (*wifi_hal_fn::*Member)(Args...)>
+CallStats *HalCall<wifi_error (*)(Args...), Member>::sStats;
+
+#define INSTRUMENT_HAL_FN(fn, name) \
+    do { \
+        static CallStats stats("hal", #name); \
+        typedef HalCall<decltype(fn->name), &wifi_hal_fn::name> Call; \
+        if (fn->name != NULL) { \
+            Call::sStats = &stats; \
+            fn->name = Call::call; \
+        } \
+    } while (0)
+
+/*
+ * wifi_event_loop runs for the life of the HAL, and the void functions never fail. Slots
+ * the vendor left empty stay empty.
+ */
+void instrument_wifi_hal_func_table(wifi_hal_fn *fn)
+{
+    sHalTarget = *fn;
+
+    INSTRUMENT_HAL_FN(fn, wifi_initialize);
+    INSTRUMENT_HAL_FN(fn, wifi_get_supported_feature_set);
+    INSTRUMENT_HAL_FN(fn, wifi_get_concurrency_matrix);
+    INSTRUMENT_HAL_FN(fn, wifi_set_scanning_mac_oui);
+    INSTRUMENT_HAL_FN(fn, wifi_get_supported_channels);
+    INSTRUMENT_HAL_FN(fn, wifi_is_epr_supported);
+    INSTRUMENT_HAL_FN(fn, wifi_get_ifaces);
+    INSTRUMENT_HAL_FN(fn, wifi_get_iface_name);
+    INSTRUMENT_HAL_FN(fn, wifi_reset_iface_event_handler);
+    INSTRUMENT_HAL_FN(fn, wifi_start_gscan);
+    INSTRUMENT_HAL_FN(fn, wifi_stop_gscan);
+    INSTRUMENT_HAL_FN(fn, wifi_get_cached_gscan_results);
+    INSTRUMENT_HAL_FN(fn, wifi_set_bssid_hotlist);
+    INSTRUMENT_HAL_FN(fn, wifi_reset_bssid_hotlist);
+    INSTRUMENT_HAL_FN(fn, wifi_set_significant_change_handler);
+    INSTRUMENT_HAL_FN(fn, wifi_reset_significant_change_handler);
+    INSTRUMENT_HAL_FN(fn, wifi_get_gscan_capabilities);
+    INSTRUMENT_HAL_FN(fn, wifi_set_link_stats);
+    INSTRUMENT_HAL_FN(fn, wifi_get_link_stats);
+    INSTRUMENT_HAL_FN(fn, wifi_clear_link_stats);
+    INSTRUMENT_HAL_FN(fn, wifi_get_valid_channels);
+    INSTRUMENT_HAL_FN(fn, wifi_rtt_range_request);
+    INSTRUMENT_HAL_FN(fn, wifi_rtt_range_cancel);
+    INSTRUMENT_HAL_FN(fn, wifi_get_rtt_capabilities);
+    INSTRUMENT_HAL_FN(fn, wifi_start_logging);
+    INSTRUMENT_HAL_FN(fn, wifi_set_epno_list);
+    INSTRUMENT_HAL_FN(fn, wifi_set_country_code);
+    INSTRUMENT_HAL_FN(fn, wifi_get_firmware_memory_dump);
+    INSTRUMENT_HAL_FN(fn, wifi_set_log_handler);
+    INSTRUMENT_HAL_FN(fn, wifi_reset_log_handler);
+    INSTRUMENT_HAL_FN(fn, wifi_set_alert_handler);
+    INSTRUMENT_HAL_FN(fn, wifi_reset_alert_handler);
+    INSTRUMENT_HAL_FN(fn, wifi_get_firmware_version);
+    INSTRUMENT_HAL_FN(fn, wifi_get_ring_buffers_status);
+    INSTRUMENT_HAL_FN(fn, wifi_get_logger_supported_feature_set);
+    INSTRUMENT_HAL_FN(fn, wifi_get_ring_data);
+    INSTRUMENT_HAL_FN(fn, wifi_enable_tdls);
+    INSTRUMENT_HAL_FN(fn, wifi_disable_tdls);
+    INSTRUMENT_HAL_FN(fn, wifi_get_tdls_status);
+    INSTRUMENT_HAL_FN(fn, wifi_get_tdls_capabilities);
+    INSTRUMENT_HAL_FN(fn, wifi_get_driver_version);
+    INSTRUMENT_HAL_FN(fn, wifi_set_nodfs_flag);
+    INSTRUMENT_HAL_FN(fn, wifi_set_ssid_white_list);
+    INSTRUMENT_HAL_FN(fn, wifi_set_gscan_roam_params);
+    INSTRUMENT_HAL_FN(fn, wifi_set_bssid_preference);
+    INSTRUMENT_HAL_FN(fn, wifi_set_bssid_blacklist);
+    INSTRUMENT_HAL_FN(fn, wifi_enable_lazy_roam);
+    INSTRUMENT_HAL_FN(fn, wifi_start_sending_offloaded_packet);
+    INSTRUMENT_HAL_FN(fn, wifi_stop_sending_offloaded_packet);
+    INSTRUMENT_HAL_FN(fn, wifi_start_rssi_monitoring);
+    INSTRUMENT_HAL_FN(fn, wifi_stop_rssi_monitoring);
+}
+
+}; // namespace android
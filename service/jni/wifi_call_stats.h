@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_CALL_STATS_H__
+#define __WIFI_CALL_STATS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+#include <cutils/trace.h>
+#include <utils/Timers.h>
+
+#include "wifi_hal.h"
+
+namespace android {
+
+/*
+ * Latencies are kept in log-linear buckets: four linear steps per power of two, starting at
+ * 64ns, so every bucket is within 25% of the latencies it holds. Bucket 0 holds anything
+ * under 64ns, and the last bucket anything over ~18 minutes.
+ */
+#define CALL_STATS_MIN_SHIFT            6
+#define CALL_STATS_SUB_BUCKET_BITS      2
+#define CALL_STATS_BUCKETS              (((40 - CALL_STATS_MIN_SHIFT) << CALL_STATS_SUB_BUCKET_BITS) + 1)
+
+/*
+ * Timed calls also show up as trace sections, along with a few counters, whenever the HAL
+ * category is being traced ('atrace hal' or systrace). Otherwise tracing costs one check.
+ */
+#define WIFI_TRACE_TAG                  ATRACE_TAG_HAL
+
+static inline bool isTracing() {
+    return atrace_is_tag_enabled(WIFI_TRACE_TAG) != 0;
+}
+
+static inline void traceCounter(const char *name, int32_t value) {
+    if (isTracing()) {
+        atrace_int(WIFI_TRACE_TAG, name, value);
+    }
+}
+
+/*
+ * Call, error and byte counters plus a latency histogram for one JNI entry point or HAL
+ * function. All updates are relaxed atomics, so recording never takes a lock; instances
+ * register themselves on construction and live for the life of the process.
+ */
+class CallStats {
+public:
+    CallStats(const char *group, const char *name);
+
+    void record(nsecs_t latency, bool error, size_t bytes);
+
+    const char *name() const {
+        return mName;
+    }
+
+    /* adds to the running total of bytes handed to Java, which is traced as a counter */
+    static void traceBytes(size_t bytes);
+
+    /* appends a table of every instance that has been called to out */
+    static void dumpAll(std::string &out);
+
+private:
+    static int bucketFor(uint64_t latency);
+    static uint64_t bucketLimit(int bucket);
+    uint64_t percentile(const uint32_t *buckets, uint64_t count, int percent) const;
+
+    const char *mGroup;
+    const char *mName;
+    std::atomic<uint64_t> mCalls;
+    std::atomic<uint64_t> mErrors;
+    std::atomic<uint64_t> mBytes;
+    std::atomic<uint64_t> mTotalNs;
+    std::atomic<uint64_t> mMaxNs;
+    std::atomic<uint32_t> mBuckets[CALL_STATS_BUCKETS];
+    CallStats *mNext;
+
+    static std::atomic<CallStats *> sHead;
+    static std::atomic<int64_t> sBytesTraced;
+};
+
+/* times the scope it lives in and records into stats when it ends */
+class CallTimer {
+public:
+    CallTimer(CallStats &stats)
+        : mStats(stats), mStart(systemTime(SYSTEM_TIME_MONOTONIC)), mError(false), mBytes(0),
+          mTraced(isTracing()) {
+        if (mTraced) {
+            atrace_begin(WIFI_TRACE_TAG, stats.name());
+        }
+    }
+    ~CallTimer() {
+        if (mTraced) {
+            if (mBytes != 0) {
+                CallStats::traceBytes(mBytes);
+            }
+            atrace_end(WIFI_TRACE_TAG);
+        }
+        mStats.record(systemTime(SYSTEM_TIME_MONOTONIC) - mStart, mError, mBytes);
+    }
+    void setError() {
+        mError = true;
+    }
+    void addBytes(size_t bytes) {
+        mBytes += bytes;
+    }
+
+private:
+    CallStats &mStats;
+    nsecs_t mStart;
+    bool mError;
+    size_t mBytes;
+    bool mTraced;
+};
+
+/* counts the HAL callbacks running at once, traced as the callback queue depth */
+class CallbackScope {
+public:
+    CallbackScope() {
+        traceCounter("wifi_callbacks_in_flight", sInFlight.fetch_add(1) + 1);
+    }
+    ~CallbackScope() {
+        traceCounter("wifi_callbacks_in_flight", sInFlight.fetch_sub(1) - 1);
+    }
+
+private:
+    static std::atomic<int32_t> sInFlight;
+};
+
+/* put at the top of a JNI entry point; JNI_CALL_BYTES counts what it marshals */
+#define JNI_CALL_STATS() \
+    static CallStats sJniCallStats("jni", __func__); \
+    CallTimer jniCallTimer(sJniCallStats)
+
+/* the same for a HAL callback; JNI_CALL_BYTES works in callbacks too */
+#define HAL_CALLBACK_STATS() \
+    static CallStats sJniCallStats("cb", __func__); \
+    CallbackScope halCallbackScope; \
+    CallTimer jniCallTimer(sJniCallStats)
+
+#define JNI_CALL_BYTES(bytes)   jniCallTimer.addBytes(bytes)
+
+/*
+ * Routes every HAL function the bridge calls through a timing trampoline. Call once the
+ * table is fully populated; the functions it held are called through a private copy.
+ */
+void instrument_wifi_hal_func_table(wifi_hal_fn *fn);
+
+}
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <map>
+#include <string.h>
+
+#include "wifi_domain_trie.h"
+
+namespace android {
+
+static inline char lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+/* narrows name down to the part splitDomain would split into labels */
+static void domainPart(const char *name, size_t len, size_t *start, size_t *end)
+{
+    const char *at = (const char *)memchr(name, '@', len);
+    *start = at != NULL ? at - name + 1 : 0;
+    *end = len;
+    while (*end > *start && name[*end - 1] == '.') {
+        (*end)--;
+    }
+}
+
+/*
+ * Walks the labels of a name, top level domain first. Empty labels (as in "a..b") are
+ * returned, as String.split would produce them.
+ */
+class LabelIterator {
+public:
+    LabelIterator(const char *name, size_t len) : mName(name), mDone(false) {
+        domainPart(name, len, &mStart, &mEnd);
+    }
+
+    bool next(const char **label, size_t *len) {
+        if (mDone) {
+            return false;
+        }
+        size_t s = mEnd;
+        while (s > mStart && mName[s - 1] != '.') {
+            s--;
+        }
+        *label = mName + s;
+        *len = mEnd - s;
+        if (s == mStart) {
+            mDone = true;
+        } else {
+            mEnd = s - 1;
+        }
+        return true;
+    }
+
+private:
+    const char *mName;
+    size_t mStart;
+    size_t mEnd;
+    bool mDone;
+};
+
+/* compares an input label, case insensitively, against a stored lower case one */
+static int compareLabel(const char *a, size_t alen, const char *b, size_t blen)
+{
+    size_t n = alen < blen ? alen : blen;
+    for (size_t i = 0; i < n; i++) {
+        int d = (unsigned char)lower(a[i]) - (unsigned char)b[i];
+        if (d != 0) {
+            return d;
+        }
+    }
+    return alen < blen ? -1 : (alen > blen ? 1 : 0);
+}
+
+void DomainTrie::clear()
+{
+    mNodes.clear();
+    mTerminals.clear();
+    mLabels.clear();
+    mNumProviders = 0;
+}
+
+void DomainTrie::build(const std::vector<DomainTrieName> &names, int numProviders)
+{
+    /* a throwaway pointer trie first; std::map keeps the children sorted for the flat one */
+    struct BuildNode {
+        std::map<std::string, int> children;
+        std::vector<Terminal> terminals;
+    };
+    std::vector<BuildNode> tree(1);
+
+    for (size_t i = 0; i < names.size(); i++) {
+        const std::string &name = names[i].name;
+        int node = 0;
+        LabelIterator labels(name.data(), name.size());
+        const char *label;
+        size_t len;
+        while (labels.next(&label, &len)) {
+            std::string key(label, len);
+            for (size_t c = 0; c < key.size(); c++) {
+                key[c] = lower(key[c]);
+            }
+            std::map<std::string, int>::iterator it = tree[node].children.find(key);
+            if (it != tree[node].children.end()) {
+                node = it->second;
+            } else {
+                int child = tree.size();
+                tree[node].children[key] = child;
+                tree.push_back(BuildNode());
+                node = child;
+            }
+        }
+        Terminal terminal = { names[i].provider, names[i].kind };
+        tree[node].terminals.push_back(terminal);
+    }
+
+    /* breadth first, so that the children of every node are contiguous */
+    clear();
+    mNumProviders = numProviders;
+    mNodes.resize(tree.size());
+    std::vector<std::pair<int, std::string> > order;
+    order.push_back(std::make_pair(0, std::string()));
+    for (size_t n = 0; n < order.size(); n++) {
+        const BuildNode &from = tree[order[n].first];
+        Node &to = mNodes[n];
+        to.label = mLabels.size();
+        to.labelLength = order[n].second.size();
+        mLabels += order[n].second;
+        to.firstTerminal = mTerminals.size();
+        to.numTerminals = from.terminals.size();
+        mTerminals.insert(mTerminals.end(), from.terminals.begin(), from.terminals.end());
+        to.firstChild = order.size();
+        to.numChildren = from.children.size();
+        for (std::map<std::string, int>::const_iterator it = from.children.begin();
+                it != from.children.end(); ++it) {
+            order.push_back(std::make_pair(it->second, it->first));
+        }
+    }
+}
+
+int DomainTrie::findChild(const Node &node, const char *label, size_t len) const
+{
+    int lo = node.firstChild;
+    int hi = node.firstChild + node.numChildren - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const Node &child = mNodes[mid];
+        int d = compareLabel(label, len, mLabels.data() + child.label, child.labelLength);
+        if (d == 0) {
+            return mid;
+        } else if (d < 0) {
+            hi = mid - 1;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return -1;
+}
+
+void DomainTrie::match(const char *name, size_t len, int kindMask, int32_t *flags) const
+{
+    if (mNodes.empty()) {
+        return;
+    }
+    int node = 0;
+    LabelIterator labels(name, len);
+    const char *label;
+    size_t labelLength;
+    while (labels.next(&label, &labelLength)) {
+        node = findChild(mNodes[node], label, labelLength);
+        if (node < 0) {
+            return;
+        }
+        const Node &n = mNodes[node];
+        for (uint32_t t = n.firstTerminal; t < n.firstTerminal + n.numTerminals; t++) {
+            flags[mTerminals[t].provider] |= mTerminals[t].kind & kindMask;
+        }
+    }
+}
+
+}; // namespace android
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_DOMAIN_TRIE_H__
+#define __WIFI_DOMAIN_TRIE_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace android {
+
+/* what a configured name is to its provider; keep these consistent with PasspointMatcher.java */
+enum {
+    DOMAIN_MATCH_PRIMARY    = 1 << 0,   /* the home SP's FQDN */
+    DOMAIN_MATCH_SECONDARY  = 1 << 1,   /* one of its other home partners */
+    DOMAIN_MATCH_REALM      = 1 << 2,   /* its credential's NAI realm */
+};
+
+struct DomainTrieName {
+    std::string name;
+    int provider;
+    int kind;                   /* one DOMAIN_MATCH_* bit */
+};
+
+/*
+ * The domain names and realms of all configured Passpoint providers, compiled into a trie
+ * keyed on labels from the top level domain down, so that finding every configured name
+ * another name equals or is a subdomain of is one walk down the trie. Names are normalised
+ * the way hotspot2 Utils.splitDomain does it: anything up to an '@' and trailing dots are
+ * dropped, and labels are lower cased.
+ *
+ * Nodes live in one array with each node's children next to each other and sorted, and the
+ * labels in one string pool, so matching doesn't allocate. Not thread safe; the bridge
+ * serializes rebuilding against matching.
+ */
+class DomainTrie {
+public:
+    DomainTrie() : mNumProviders(0) {
+    }
+
+    void build(const std::vector<DomainTrieName> &names, int numProviders);
+    void clear();
+
+    int numProviders() const {
+        return mNumProviders;
+    }
+
+    /*
+     * ORs into flags[provider] the kind of every configured name that name equals or is a
+     * subdomain of, counting only kinds in kindMask. flags has numProviders() slots.
+     */
+    void match(const char *name, size_t len, int kindMask, int32_t *flags) const;
+
+private:
+    struct Node {
+        uint32_t label;         /* offset into mLabels */
+        uint32_t labelLength;
+        uint32_t numChildren;
+        uint32_t firstChild;
+        uint32_t firstTerminal;
+        uint32_t numTerminals;
+    };
+
+    struct Terminal {
+        int32_t provider;
+        int32_t kind;
+    };
+
+    int findChild(const Node &node, const char *label, size_t len) const;
+
+    std::vector<Node> mNodes;
+    std::vector<Terminal> mTerminals;
+    std::string mLabels;
+    int mNumProviders;
+};
+
+}
+
+#endif //__WIFI_DOMAIN_TRIE_H__
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <string.h>
+
+#include "wifi_epno.h"
+#include "wifi_ssid_table.h"
+
+namespace android {
+
+bool EpnoManager::compare(const EpnoCandidate &a, const EpnoCandidate &b)
+{
+    if (a.priority != b.priority) {
+        return a.priority > b.priority;
+    }
+    if (a.score != b.score) {
+        return a.score > b.score;
+    }
+    return a.index < b.index;
+}
+
+void EpnoManager::releaseSsids()
+{
+    SsidTable &table = SsidTable::getInstance();
+    for (size_t i = 0; i < mSsids.size(); i++) {
+        table.release(mSsids[i]);
+    }
+    mSsids.clear();
+}
+
+void EpnoManager::select(std::vector<EpnoCandidate> &desired, size_t capacity,
+        std::vector<wifi_epno_network> &selected, std::vector<int> &dropped)
+{
+    /* intern the new SSIDs before letting go of the old, so the ones still wanted keep ids */
+    SsidTable &table = SsidTable::getInstance();
+    std::vector<int> ssids;
+    ssids.reserve(desired.size());
+    for (size_t i = 0; i < desired.size(); i++) {
+        wifi_epno_network &network = desired[i].network;
+        desired[i].ssidId = table.acquire((const uint8_t *) network.ssid,
+                strnlen(network.ssid, SsidTable::kMaxSsidLength));
+        ssids.push_back(desired[i].ssidId);
+    }
+    releaseSsids();
+    mSsids.swap(ssids);
+
+    std::sort(desired.begin(), desired.end(), compare);
+
+    /* SSID ids and auth of the networks kept so far */
+    std::vector<std::pair<int, unsigned> > kept;
+    selected.clear();
+    for (size_t i = 0; i < desired.size(); i++) {
+        std::pair<int, unsigned> key(desired[i].ssidId, desired[i].network.auth_bit_field);
+        bool repeated = std::find(kept.begin(), kept.end(), key) != kept.end();
+
+        if (repeated || selected.size() >= capacity) {
+            dropped.push_back(desired[i].index);
+        } else {
+            selected.push_back(desired[i].network);
+            kept.push_back(key);
+        }
+    }
+}
+
+bool EpnoManager::isProgrammed(const std::vector<wifi_epno_network> &selected) const
+{
+    if (!mProgrammed || selected.size() != mList.size()) {
+        return false;
+    }
+
+    /* networks are zero filled before they are populated, so they compare bytewise */
+    return selected.empty()
+            || memcmp(&selected[0], &mList[0], selected.size() * sizeof(wifi_epno_network)) == 0;
+}
+
+void EpnoManager::setProgrammed(const std::vector<wifi_epno_network> &selected,
+        wifi_request_id id)
+{
+    mList = selected;
+    mProgrammed = true;
+    mProgrammedId = id;
+}
+
+void EpnoManager::reset()
+{
+    releaseSsids();
+    mList.clear();
+    mProgrammed = false;
+}
+
+}; // namespace android
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_EPNO_H__
+#define __WIFI_EPNO_H__
+
+#include <vector>
+
+#include "wifi_hal.h"
+#include "gscan.h"
+
+namespace android {
+
+/* a network Java would like ePNO to look for */
+struct EpnoCandidate {
+    wifi_epno_network network;
+    int priority;
+    int score;
+    int index;                  /* position in the list Java passed in */
+    int ssidId;                 /* SsidTable id of network.ssid, set by select */
+};
+
+/*
+ * Decides which of the desired ePNO networks are programmed into the firmware, and remembers
+ * what was programmed last so that an unchanged list is not sent again. Firmware can only
+ * hold so many networks; the rest are reported back as dropped. The SSIDs of the last desired
+ * list stay interned until the next one, so a network keeps its SSID id across updates.
+ * Only used from setPnoListNative, which Java serializes.
+ */
+class EpnoManager {
+public:
+    EpnoManager() : mProgrammed(false), mProgrammedId(0) {
+    }
+
+    /*
+     * Orders desired by descending priority, then score, then list position, and keeps the
+     * first capacity networks, ignoring repeats of an SSID and auth combination already
+     * kept. The indexes of the networks left out are appended to dropped.
+     */
+    void select(std::vector<EpnoCandidate> &desired, size_t capacity,
+            std::vector<wifi_epno_network> &selected, std::vector<int> &dropped);
+
+    /* true if selected is exactly what the firmware was last programmed with */
+    bool isProgrammed(const std::vector<wifi_epno_network> &selected) const;
+    void setProgrammed(const std::vector<wifi_epno_network> &selected, wifi_request_id id);
+
+    /*
+     * The request id the firmware was last programmed under; an unchanged list keeps it,
+     * since the HAL reports networks found under that id. Only valid while programmed.
+     */
+    bool isProgrammed() const {
+        return mProgrammed;
+    }
+    wifi_request_id getProgrammedId() const {
+        return mProgrammedId;
+    }
+
+    /* to be called once ePNO was stopped, or programming it failed */
+    void reset();
+
+private:
+    static bool compare(const EpnoCandidate &a, const EpnoCandidate &b);
+    void releaseSsids();
+
+    bool mProgrammed;
+    wifi_request_id mProgrammedId;
+    std::vector<wifi_epno_network> mList;
+    std::vector<int> mSsids;            /* ids interned for the last desired list */
+};
+
+}
+
+#endif //__WIFI_EPNO_H__
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "wifi"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include "wifi_fw_dump.h"
+
+namespace android {
+
+FwDumpWriter::FwDumpWriter(int fd, bool compress)
+    : mFd(fd), mCompress(compress), mError(false), mFinished(false),
+      mRawBytes(0), mWrittenBytes(0), mOut(NULL)
+{
+    mChecksum = crc32(0L, Z_NULL, 0);
+    memset(&mStream, 0, sizeof(mStream));
+
+    if (mFd < 0) {
+        ALOGE("invalid fd for firmware memory dump");
+        mError = true;
+        return;
+    }
+
+    if (mCompress) {
+        mOut = (unsigned char *)malloc(kChunkSize);
+        if (mOut == NULL) {
+            ALOGE("could not allocate compression buffer");
+            mError = true;
+            return;
+        }
+
+        /* zlib framing, so the output matches java.util.zip.Deflater */
+        if (deflateInit(&mStream, Z_BEST_COMPRESSION) != Z_OK) {
+            ALOGE("could not initialize deflater");
+            free(mOut);
+            mOut = NULL;
+            mError = true;
+        }
+    }
+}
+
+FwDumpWriter::~FwDumpWriter()
+{
+    if (mOut != NULL) {
+        deflateEnd(&mStream);
+        free(mOut);
+        mOut = NULL;
+    }
+}
+
+bool FwDumpWriter::writeFully(const unsigned char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = TEMP_FAILURE_RETRY(write(mFd, data, size));
+        if (n <= 0) {
+            ALOGE("error writing firmware memory dump: %s", strerror(errno));
+            mError = true;
+            return false;
+        }
+        data += n;
+        size -= n;
+        mWrittenBytes += n;
+    }
+    return true;
+}
+
+bool FwDumpWriter::deflateChunk(const unsigned char *data, size_t size, int flush)
+{
+    mStream.next_in = const_cast<unsigned char *>(data);
+    mStream.avail_in = size;
+
+    do {
+        mStream.next_out = mOut;
+        mStream.avail_out = kChunkSize;
+
+        int ret = deflate(&mStream, flush);
+        if (ret == Z_STREAM_ERROR) {
+            ALOGE("deflate failed");
+            mError = true;
+            return false;
+        }
+
+        if (!writeFully(mOut, kChunkSize - mStream.avail_out)) {
+            return false;
+        }
+    } while (mStream.avail_out == 0);
+
+    return true;
+}
+
+bool FwDumpWriter::append(const char *buffer, size_t size)
+{
+    if (mError || mFinished) {
+        return false;
+    }
+
+    /* feed the dump in bounded chunks so neither side ever holds more than kChunkSize */
+    const unsigned char *data = (const unsigned char *)buffer;
+    while (size > 0) {
+        size_t chunk = size < kChunkSize ? size : kChunkSize;
+
+        mChecksum = crc32(mChecksum, data, chunk);
+        mRawBytes += chunk;
+
+        bool ok = mCompress ? deflateChunk(data, chunk, Z_NO_FLUSH) : writeFully(data, chunk);
+        if (!ok) {
+            return false;
+        }
+
+        data += chunk;
+        size -= chunk;
+    }
+
+    return true;
+}
+
+bool FwDumpWriter::finish()
+{
+    if (mError || mFinished) {
+        return !mError;
+    }
+
+    mFinished = true;
+    if (mCompress && !deflateChunk(NULL, 0, Z_FINISH)) {
+        return false;
+    }
+
+    return !mError;
+}
+
+}; // namespace android
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_FW_DUMP_H__
+#define __WIFI_FW_DUMP_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <zlib.h>
+
+namespace android {
+
+/*
+ * Streams a firmware memory dump into a file descriptor, chunk by chunk, optionally
+ * deflating it on the way. The dump is never copied into the Java heap; only its size,
+ * CRC32 and the number of bytes that actually hit the descriptor are reported back.
+ */
+class FwDumpWriter {
+public:
+    static const size_t kChunkSize = 64 * 1024;
+
+    FwDumpWriter(int fd, bool compress);
+    ~FwDumpWriter();
+
+    /* may be called several times if the HAL delivers the dump in pieces */
+    bool append(const char *buffer, size_t size);
+
+    /* flushes the compressor; must be called once all data has been appended */
+    bool finish();
+
+    bool isCompressed() const {
+        return mCompress;
+    }
+    bool hasError() const {
+        return mError;
+    }
+    size_t rawBytes() const {
+        return mRawBytes;
+    }
+    size_t writtenBytes() const {
+        return mWrittenBytes;
+    }
+    uint32_t checksum() const {
+        return (uint32_t)mChecksum;
+    }
+
+private:
+    bool writeFully(const unsigned char *data, size_t size);
+    bool deflateChunk(const unsigned char *data, size_t size, int flush);
+
+    int mFd;
+    bool mCompress;
+    bool mError;
+    bool mFinished;
+    size_t mRawBytes;
+    size_t mWrittenBytes;
+    uLong mChecksum;
+    z_stream mStream;
+    unsigned char *mOut;
+
+    FwDumpWriter(const FwDumpWriter&);
+    FwDumpWriter& operator = (const FwDumpWriter&);
+};
+
+}
+
+#endif //__WIFI_FW_DUMP_H__
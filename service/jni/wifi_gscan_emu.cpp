@@ -0,0 +1,781 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "wifi"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utils/Log.h>
+#include <utils/Mutex.h>
+#include <utils/Condition.h>
+#include <utils/Timers.h>
+#include <algorithm>
+#include <vector>
+
+#include "wifi_gscan_emu.h"
+#include "wifi_timer_wheel.h"
+#include "wifi_scan_cache.h"
+
+#define GSCAN_EMU_IFACE                 "wlan0"
+#define GSCAN_EMU_TICK_MS               100
+#define GSCAN_EMU_WHEEL_SLOTS           512
+#define GSCAN_EMU_CACHED_SCANS          16
+#define GSCAN_EMU_MIN_PERIOD_MS         5000
+#define GSCAN_EMU_RESULTS_TIMEOUT_MS    10000
+#define GSCAN_EMU_RETRY_DELAY_MS        1000
+#define GSCAN_EMU_FRAMEWORK_SCAN_MS     10000
+#define GSCAN_EMU_REPLY_SIZE            (4096 + 1)
+#define GSCAN_EMU_MAX_PAGES             64
+
+/* BSS entries carry id, bssid, freq, level, flags and ssid, each closed by a "====" line */
+#define GSCAN_EMU_BSS_MASK              "0x21887"
+#define GSCAN_EMU_BSS_DELIM             "===="
+
+/* timer ids; bucket timers use the bucket index, 0 .. MAX_BUCKETS - 1 */
+#define GSCAN_EMU_TIMER_RESULTS         100
+#define GSCAN_EMU_TIMER_RETRY           101
+#define GSCAN_EMU_TIMER_FRAMEWORK_SCAN  102
+
+namespace android {
+
+/* the emulation has exactly one wifi handle and one interface handle */
+static int sEmuWifiHandle;
+static int sEmuIfaceHandle;
+
+static bool compareRssi(const wifi_scan_result &a, const wifi_scan_result &b) {
+    return a.rssi > b.rssi;
+}
+
+static bool bandHasFrequency(wifi_band band, int freq) {
+    if (freq < 3000) {
+        return (band & WIFI_BAND_BG) != 0;
+    } else {
+        return (band & WIFI_BAND_A_WITH_DFS) != 0;
+    }
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* undoes supplicant's printf style escaping of SSIDs */
+static void decodeSsid(const char *in, char *out, size_t out_len) {
+    size_t n = 0;
+    while (*in != '\0' && n + 1 < out_len) {
+        char c = *in++;
+        if (c == '\\' && *in != '\0') {
+            c = *in++;
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'e': c = '\033'; break;
+                case 'x':
+                    if (hexValue(in[0]) >= 0 && hexValue(in[1]) >= 0) {
+                        c = (char)(hexValue(in[0]) << 4 | hexValue(in[1]));
+                        in += 2;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        out[n++] = c;
+    }
+    out[n] = '\0';
+}
+
+/* skips the "IFNAME=<iface> " prefix of commands and events; NULL if it names another iface */
+static const char *stripIface(const char *s) {
+    static const char prefix[] = "IFNAME=" GSCAN_EMU_IFACE " ";
+    if (strncmp(s, "IFNAME=", 7) != 0) {
+        return s;
+    }
+    if (strncmp(s, prefix, sizeof(prefix) - 1) != 0) {
+        return NULL;
+    }
+    return s + sizeof(prefix) - 1;
+}
+
+class GscanEmulator {
+public:
+    GscanEmulator();
+
+    void setCommand(supplicant_command_fn command) {
+        mCommand = command;
+    }
+
+    void run();
+    void requestExit(wifi_cleaned_up_handler handler);
+
+    wifi_error start(wifi_request_id id, const wifi_scan_cmd_params &params,
+            const wifi_scan_result_handler &handler);
+    wifi_error stop(wifi_request_id id);
+    wifi_error getCached(bool flush, int max, wifi_cached_scan_results *results, int *num);
+    void getCapabilities(wifi_gscan_capabilities *capabilities);
+
+    void onFrameworkCommand(const char *command, const char *reply);
+    void onSupplicantEvent(const char *event);
+
+private:
+    struct Bucket {
+        wifi_scan_bucket_spec spec;
+        nsecs_t period;
+        int scansAtPeriod;
+    };
+
+    void scheduleBucket(int i, nsecs_t now);
+    bool inBuckets(int freq, unsigned buckets) const;
+    unsigned reportThreshold() const;
+    void startScan(nsecs_t now);
+    void collectResults();
+    int parseBssPage(char *reply, unsigned buckets, int *nextId);
+    int finishResults();
+    bool runCommand(const char *command, char *reply, size_t reply_len);
+
+    Mutex mLock;
+    Condition mCondition;
+    TimerWheel mWheel;
+    WifiScanCache mCache;
+    supplicant_command_fn mCommand;
+    bool mExit;
+    wifi_cleaned_up_handler mCleanedUpHandler;
+
+    bool mStarted;
+    unsigned mGeneration;       /* bumped by start / stop to spot stale work */
+    wifi_request_id mId;
+    wifi_scan_cmd_params mParams;
+    wifi_scan_result_handler mHandler;
+    Bucket mBuckets[MAX_BUCKETS];
+    unsigned mDue;              /* buckets waiting for a scan */
+    unsigned mScanning;         /* buckets covered by the scan in flight */
+    bool mResultsReady;         /* supplicant reported the end of a scan while ours was in flight */
+    bool mFrameworkScan;        /* the framework has a scan of its own outstanding */
+    int mScanId;
+    unsigned mScansSinceReport;
+
+    /* only touched by the event loop */
+    char mReply[GSCAN_EMU_REPLY_SIZE];
+    std::vector<wifi_scan_result> mParsed;
+    wifi_cached_scan_results mScan;
+};
+
+GscanEmulator::GscanEmulator()
+    : mWheel(ms2ns(GSCAN_EMU_TICK_MS), GSCAN_EMU_WHEEL_SLOTS), mCache(GSCAN_EMU_CACHED_SCANS),
+      mCommand(NULL), mExit(false), mCleanedUpHandler(NULL), mStarted(false), mGeneration(0),
+      mId(0), mDue(0), mScanning(0), mResultsReady(false), mFrameworkScan(false), mScanId(0),
+      mScansSinceReport(0)
+{
+    memset(&mParams, 0, sizeof(mParams));
+    memset(&mHandler, 0, sizeof(mHandler));
+    memset(mBuckets, 0, sizeof(mBuckets));
+    mParsed.reserve(MAX_AP_CACHE_PER_SCAN * 4);
+}
+
+/* runs a supplicant command with mLock dropped; callers must recheck mGeneration */
+bool GscanEmulator::runCommand(const char *command, char *reply, size_t reply_len)
+{
+    mLock.unlock();
+    bool ok = mCommand != NULL && mCommand(command, reply, reply_len);
+    mLock.lock();
+    return ok;
+}
+
+void GscanEmulator::run()
+{
+    std::vector<int> expired;
+
+    mLock.lock();
+    while (!mExit) {
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        unsigned generation = mGeneration;
+
+        expired.clear();
+        mWheel.advance(now, expired);
+        for (size_t i = 0; i < expired.size() && generation == mGeneration && !mExit; i++) {
+            int id = expired[i];
+            if (id == GSCAN_EMU_TIMER_RESULTS) {
+                ALOGD("gscan emulation: no scan results event, reading results anyway");
+                mResultsReady = true;
+            } else if (id == GSCAN_EMU_TIMER_FRAMEWORK_SCAN) {
+                mFrameworkScan = false;
+            } else if (id >= 0 && id < MAX_BUCKETS) {
+                mDue |= 1 << id;
+                scheduleBucket(id, now);
+            }
+            /* GSCAN_EMU_TIMER_RETRY only has to expire for the scan below to go out */
+        }
+
+        if (mResultsReady && generation == mGeneration && !mExit) {
+            mResultsReady = false;
+            mWheel.cancel(GSCAN_EMU_TIMER_RESULTS);
+            if (mScanning != 0) {
+                collectResults();
+            }
+        }
+
+        /* never compete with a framework scan; its results event lets ours go out */
+        if (mStarted && mDue != 0 && mScanning == 0 && !mFrameworkScan && !mExit
+                && !mWheel.isScheduled(GSCAN_EMU_TIMER_RETRY)) {
+            startScan(now);
+        }
+
+        nsecs_t next = mWheel.nextExpiry();
+        if (mExit) {
+            break;
+        } else if (next < 0) {
+            mCondition.wait(mLock);
+        } else {
+            now = systemTime(SYSTEM_TIME_MONOTONIC);
+            mCondition.waitRelative(mLock, std::max(next - now, mWheel.tick()));
+        }
+    }
+
+    mWheel.cancelAll();
+    mCache.clear();
+    mStarted = false;
+    mGeneration++;
+    mDue = 0;
+    mScanning = 0;
+    mResultsReady = false;
+    mFrameworkScan = false;
+    mExit = false;
+
+    wifi_cleaned_up_handler handler = mCleanedUpHandler;
+    mCleanedUpHandler = NULL;
+    mLock.unlock();
+
+    ALOGD("gscan emulation event loop exited");
+    if (handler != NULL) {
+        handler((wifi_handle) &sEmuWifiHandle);
+    }
+}
+
+void GscanEmulator::requestExit(wifi_cleaned_up_handler handler)
+{
+    Mutex::Autolock _l(mLock);
+    mCleanedUpHandler = handler;
+    mExit = true;
+    mCondition.signal();
+}
+
+void GscanEmulator::scheduleBucket(int i, nsecs_t now)
+{
+    Bucket &bucket = mBuckets[i];
+    mWheel.schedule(i, now + bucket.period);
+
+    /* exponential backoff buckets grow by 'exponent' every 'step_count' scans */
+    const wifi_scan_bucket_spec &spec = bucket.spec;
+    if (spec.max_period > 0 && spec.exponent > 1 && spec.step_count > 0
+            && ++bucket.scansAtPeriod >= spec.step_count) {
+        bucket.scansAtPeriod = 0;
+        bucket.period = std::min(bucket.period * spec.exponent, ms2ns(spec.max_period));
+    }
+}
+
+bool GscanEmulator::inBuckets(int freq, unsigned buckets) const
+{
+    for (int i = 0; i < mParams.num_buckets; i++) {
+        if ((buckets & (1 << i)) == 0) {
+            continue;
+        }
+
+        const wifi_scan_bucket_spec &spec = mBuckets[i].spec;
+        if (spec.num_channels == 0) {
+            if (bandHasFrequency(spec.band, freq)) {
+                return true;
+            }
+            continue;
+        }
+
+        for (int j = 0; j < spec.num_channels; j++) {
+            if (spec.channels[j].channel == freq) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* number of batched scans after which the framework is told to fetch them */
+unsigned GscanEmulator::reportThreshold() const
+{
+    unsigned threshold = mCache.capacity();
+
+    if (mParams.report_threshold_num_scans > 0) {
+        threshold = std::min(threshold, (unsigned) mParams.report_threshold_num_scans);
+    }
+    if (mParams.report_threshold_percent > 0) {
+        unsigned scans = (mCache.capacity() * mParams.report_threshold_percent + 99) / 100;
+        threshold = std::min(threshold, std::max(scans, 1u));
+    }
+    return threshold;
+}
+
+void GscanEmulator::startScan(nsecs_t now)
+{
+    char command[64 + MAX_BUCKETS * MAX_CHANNELS * 6];
+    int len = snprintf(command, sizeof(command), "IFNAME=%s SCAN", GSCAN_EMU_IFACE);
+
+    /* only narrow the scan when every due bucket names its channels */
+    bool channels = true;
+    for (int i = 0; i < mParams.num_buckets; i++) {
+        if ((mDue & (1 << i)) != 0 && mBuckets[i].spec.num_channels == 0) {
+            channels = false;
+        }
+    }
+
+    if (channels) {
+        std::vector<int> freqs;
+        for (int i = 0; i < mParams.num_buckets; i++) {
+            if ((mDue & (1 << i)) == 0) {
+                continue;
+            }
+            const wifi_scan_bucket_spec &spec = mBuckets[i].spec;
+            for (int j = 0; j < spec.num_channels; j++) {
+                freqs.push_back(spec.channels[j].channel);
+            }
+        }
+        std::sort(freqs.begin(), freqs.end());
+        freqs.erase(std::unique(freqs.begin(), freqs.end()), freqs.end());
+
+        for (size_t i = 0; i < freqs.size(); i++) {
+            len += snprintf(command + len, sizeof(command) - len, "%s%d",
+                    i == 0 ? " freq=" : ",", freqs[i]);
+        }
+    }
+
+    unsigned scanning = mDue;
+    unsigned generation = mGeneration;
+    mDue = 0;
+    mScanning = scanning;
+
+    bool ok = runCommand(command, mReply, sizeof(mReply)) && strncmp(mReply, "OK", 2) == 0;
+    if (generation != mGeneration) {
+        return;
+    }
+
+    if (!ok) {
+        /* most likely FAIL-BUSY because the framework is scanning; try again shortly */
+        ALOGD("gscan emulation: '%s' failed, retrying", command);
+        mDue |= scanning;
+        mScanning = 0;
+        mWheel.schedule(GSCAN_EMU_TIMER_RETRY, now + ms2ns(GSCAN_EMU_RETRY_DELAY_MS));
+        return;
+    }
+
+    /*
+     * results are read when the framework's monitor passes on CTRL-EVENT-SCAN-RESULTS; the
+     * timeout only keeps the buckets going if that event is lost
+     */
+    mWheel.schedule(GSCAN_EMU_TIMER_RESULTS,
+            systemTime(SYSTEM_TIME_MONOTONIC) + ms2ns(GSCAN_EMU_RESULTS_TIMEOUT_MS));
+}
+
+/*
+ * parses one page of "BSS RANGE=<id>- MASK=..." output into mParsed, keeping the BSSs seen on
+ * the given buckets. Only entries closed by their delimiter count; supplicant drops whatever
+ * does not fit the reply, so the next page starts after the last complete one. Returns the
+ * number of complete entries.
+ */
+int GscanEmulator::parseBssPage(char *reply, unsigned buckets, int *nextId)
+{
+    wifi_timestamp ts = systemTime(SYSTEM_TIME_BOOTTIME) / 1000;
+    int entries = 0;
+
+    wifi_scan_result result;
+    memset(&result, 0, sizeof(result));
+    bool hasBssid = false;
+    int id = -1;
+
+    char *saveptr = NULL;
+    for (char *line = strtok_r(reply, "\n", &saveptr); line != NULL;
+            line = strtok_r(NULL, "\n", &saveptr)) {
+        if (strcmp(line, GSCAN_EMU_BSS_DELIM) == 0) {
+            entries++;
+            if (id >= 0) {
+                *nextId = std::max(*nextId, id + 1);
+            }
+            if (hasBssid && inBuckets(result.channel, buckets)) {
+                result.ts = ts;
+                mParsed.push_back(result);
+            }
+            memset(&result, 0, sizeof(result));
+            hasBssid = false;
+            id = -1;
+            continue;
+        }
+
+        char *value = strchr(line, '=');
+        if (value == NULL) {
+            continue;
+        }
+        *value++ = '\0';
+
+        if (strcmp(line, "id") == 0) {
+            id = atoi(value);
+        } else if (strcmp(line, "bssid") == 0) {
+            unsigned int mac[6];
+            if (sscanf(value, "%02x:%02x:%02x:%02x:%02x:%02x",
+                    &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5]) == 6) {
+                for (int i = 0; i < 6; i++) {
+                    result.bssid[i] = (byte) mac[i];
+                }
+                hasBssid = true;
+            }
+        } else if (strcmp(line, "freq") == 0) {
+            result.channel = atoi(value);
+        } else if (strcmp(line, "level") == 0) {
+            result.rssi = atoi(value);
+        } else if (strcmp(line, "flags") == 0) {
+            if (strstr(value, "[ESS]") != NULL) {
+                result.capability |= 0x0001;
+            }
+            if (strstr(value, "[IBSS]") != NULL) {
+                result.capability |= 0x0002;
+            }
+            if (strstr(value, "[WEP]") != NULL || strstr(value, "[WPA") != NULL
+                    || strstr(value, "[RSN") != NULL) {
+                result.capability |= 0x0010;
+            }
+        } else if (strcmp(line, "ssid") == 0) {
+            decodeSsid(value, result.ssid, sizeof(result.ssid));
+        }
+    }
+    return entries;
+}
+
+/* keeps the strongest of the parsed BSSs as the next scan in mScan */
+int GscanEmulator::finishResults()
+{
+    int max = MAX_AP_CACHE_PER_SCAN;
+    if (mParams.max_ap_per_scan > 0 && mParams.max_ap_per_scan < max) {
+        max = mParams.max_ap_per_scan;
+    }
+    if (mParsed.size() > (size_t) max) {
+        std::partial_sort(mParsed.begin(), mParsed.begin() + max, mParsed.end(), compareRssi);
+        mParsed.resize(max);
+    }
+
+    memset(&mScan, 0, sizeof(mScan));
+    mScan.scan_id = mScanId++;
+    mScan.num_results = mParsed.size();
+    for (size_t i = 0; i < mParsed.size(); i++) {
+        mScan.results[i] = mParsed[i];
+    }
+    return mScan.num_results;
+}
+
+void GscanEmulator::collectResults()
+{
+    unsigned scanning = mScanning;
+    unsigned generation = mGeneration;
+    mScanning = 0;
+
+    /* a busy environment does not fit one reply, so the BSS table is read a page at a time */
+    mParsed.clear();
+    int nextId = 0;
+    for (int page = 0; page < GSCAN_EMU_MAX_PAGES; page++) {
+        char command[64];
+        snprintf(command, sizeof(command), "IFNAME=%s BSS RANGE=%d- MASK=" GSCAN_EMU_BSS_MASK,
+                GSCAN_EMU_IFACE, nextId);
+        bool ok = runCommand(command, mReply, sizeof(mReply));
+        if (generation != mGeneration) {
+            return;
+        }
+        if (!ok) {
+            ALOGD("gscan emulation: could not read scan results");
+            return;
+        }
+
+        int firstId = nextId;
+        if (parseBssPage(mReply, scanning, &nextId) == 0 || nextId == firstId) {
+            break;
+        }
+    }
+
+    int num = finishResults();
+
+    unsigned full = 0;
+    bool each = false, batch = false;
+    for (int i = 0; i < mParams.num_buckets; i++) {
+        if ((scanning & (1 << i)) == 0) {
+            continue;
+        }
+        byte events = mBuckets[i].spec.report_events;
+        if ((events & REPORT_EVENTS_FULL_RESULTS) != 0) {
+            full |= 1 << i;
+        }
+        each = each || (events & REPORT_EVENTS_EACH_SCAN) != 0;
+        batch = batch || (events & REPORT_EVENTS_NO_BATCH) == 0;
+    }
+
+    bool report = false;
+    if (batch) {
+        memcpy(mCache.add(), &mScan, sizeof(mScan));
+        mScansSinceReport++;
+        report = each || mScansSinceReport >= reportThreshold();
+        if (report) {
+            mScansSinceReport = 0;
+        }
+    }
+
+    wifi_request_id id = mId;
+    wifi_scan_result_handler handler = mHandler;
+    unsigned cached = mCache.size();
+
+    /* full results only for the channels of buckets that asked for them */
+    std::vector<bool> fullResult(num, false);
+    for (int i = 0; i < num && full != 0; i++) {
+        fullResult[i] = inBuckets(mScan.results[i].channel, full);
+    }
+
+    mLock.unlock();
+    if (handler.on_full_scan_result != NULL) {
+        for (int i = 0; i < num; i++) {
+            if (fullResult[i]) {
+                handler.on_full_scan_result(id, &mScan.results[i]);
+            }
+        }
+    }
+    if (report && handler.on_scan_results_available != NULL) {
+        handler.on_scan_results_available(id, cached);
+    }
+    mLock.lock();
+}
+
+wifi_error GscanEmulator::start(wifi_request_id id, const wifi_scan_cmd_params &params,
+        const wifi_scan_result_handler &handler)
+{
+    if (params.num_buckets <= 0 || params.num_buckets > MAX_BUCKETS) {
+        return WIFI_ERROR_INVALID_ARGS;
+    }
+
+    Mutex::Autolock _l(mLock);
+
+    for (int i = 0; i < MAX_BUCKETS; i++) {
+        mWheel.cancel(i);
+    }
+    mWheel.cancel(GSCAN_EMU_TIMER_RESULTS);
+    mWheel.cancel(GSCAN_EMU_TIMER_RETRY);
+    mCache.clear();
+
+    mStarted = true;
+    mGeneration++;
+    mId = id;
+    mParams = params;
+    mHandler = handler;
+    mDue = 0;
+    mScanning = 0;
+    mResultsReady = false;
+    mScansSinceReport = 0;
+
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int i = 0; i < params.num_buckets; i++) {
+        Bucket &bucket = mBuckets[i];
+        bucket.spec = params.buckets[i];
+        bucket.scansAtPeriod = 0;
+
+        int period = bucket.spec.period > 0 ? bucket.spec.period : params.base_period;
+        bucket.period = ms2ns(std::max(period, GSCAN_EMU_MIN_PERIOD_MS));
+
+        /* every bucket gets scanned once right away */
+        mDue |= 1 << i;
+        scheduleBucket(i, now);
+    }
+
+    ALOGD("gscan emulation started, id = %d, buckets = %d", id, params.num_buckets);
+    mCondition.signal();
+    return WIFI_SUCCESS;
+}
+
+wifi_error GscanEmulator::stop(wifi_request_id id)
+{
+    Mutex::Autolock _l(mLock);
+    if (!mStarted || id != mId) {
+        return WIFI_ERROR_INVALID_REQUEST_ID;
+    }
+
+    mWheel.cancelAll();
+    mStarted = false;
+    mGeneration++;
+    mDue = 0;
+    mScanning = 0;
+    mResultsReady = false;
+    mFrameworkScan = false;
+
+    ALOGD("gscan emulation stopped, id = %d", id);
+    return WIFI_SUCCESS;
+}
+
+wifi_error GscanEmulator::getCached(bool flush, int max, wifi_cached_scan_results *results,
+        int *num)
+{
+    Mutex::Autolock _l(mLock);
+    *num = mCache.get(flush, max, results);
+    return WIFI_SUCCESS;
+}
+
+void GscanEmulator::getCapabilities(wifi_gscan_capabilities *capabilities)
+{
+    memset(capabilities, 0, sizeof(*capabilities));
+    capabilities->max_scan_cache_size = mCache.capacity() * MAX_AP_CACHE_PER_SCAN;
+    capabilities->max_scan_buckets = MAX_BUCKETS;
+    capabilities->max_ap_cache_per_scan = MAX_AP_CACHE_PER_SCAN;
+    capabilities->max_scan_reporting_threshold = 100;
+}
+
+/* a framework SCAN that supplicant accepted holds off emulated scans until it completes */
+void GscanEmulator::onFrameworkCommand(const char *command, const char *reply)
+{
+    command = stripIface(command);
+    if (command == NULL || strncmp(command, "SCAN", 4) != 0
+            || (command[4] != '\0' && command[4] != ' ') || strncmp(reply, "OK", 2) != 0) {
+        return;
+    }
+
+    Mutex::Autolock _l(mLock);
+    if (!mStarted) {
+        return;
+    }
+    mFrameworkScan = true;
+    mWheel.schedule(GSCAN_EMU_TIMER_FRAMEWORK_SCAN,
+            systemTime(SYSTEM_TIME_MONOTONIC) + ms2ns(GSCAN_EMU_FRAMEWORK_SCAN_MS));
+    mCondition.signal();
+}
+
+/* the end of any scan frees the radio; if ours was in flight its results are now readable */
+void GscanEmulator::onSupplicantEvent(const char *event)
+{
+    event = stripIface(event);
+    if (event == NULL) {
+        return;
+    }
+
+    bool results = strstr(event, "CTRL-EVENT-SCAN-RESULTS") != NULL;
+    if (!results && strstr(event, "CTRL-EVENT-SCAN-FAILED") == NULL) {
+        return;
+    }
+
+    Mutex::Autolock _l(mLock);
+    if (!mStarted) {
+        return;
+    }
+    mFrameworkScan = false;
+    mWheel.cancel(GSCAN_EMU_TIMER_FRAMEWORK_SCAN);
+    if (mScanning != 0) {
+        if (results) {
+            mResultsReady = true;
+        } else {
+            /* scan again once the retry delay has passed */
+            mDue |= mScanning;
+            mScanning = 0;
+            mWheel.cancel(GSCAN_EMU_TIMER_RESULTS);
+            mWheel.schedule(GSCAN_EMU_TIMER_RETRY,
+                    systemTime(SYSTEM_TIME_MONOTONIC) + ms2ns(GSCAN_EMU_RETRY_DELAY_MS));
+        }
+    }
+    mCondition.signal();
+}
+
+static GscanEmulator sGscanEmulator;
+
+static wifi_error wifi_initialize_emu(wifi_handle *handle) {
+    *handle = (wifi_handle) &sEmuWifiHandle;
+    return WIFI_SUCCESS;
+}
+
+static void wifi_cleanup_emu(wifi_handle handle, wifi_cleaned_up_handler handler) {
+    sGscanEmulator.requestExit(handler);
+}
+
+static void wifi_event_loop_emu(wifi_handle handle) {
+    sGscanEmulator.run();
+}
+
+static wifi_error wifi_get_ifaces_emu(wifi_handle handle, int *num,
+        wifi_interface_handle **ifaces) {
+    static wifi_interface_handle iface = (wifi_interface_handle) &sEmuIfaceHandle;
+    *num = 1;
+    *ifaces = &iface;
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_iface_name_emu(wifi_interface_handle iface, char *name,
+        size_t size) {
+    strlcpy(name, GSCAN_EMU_IFACE, size);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_supported_feature_set_emu(wifi_interface_handle iface,
+        feature_set *set) {
+    *set = WIFI_FEATURE_INFRA | WIFI_FEATURE_GSCAN;
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_gscan_capabilities_emu(wifi_interface_handle iface,
+        wifi_gscan_capabilities *capabilities) {
+    sGscanEmulator.getCapabilities(capabilities);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_start_gscan_emu(wifi_request_id id, wifi_interface_handle iface,
+        wifi_scan_cmd_params params, wifi_scan_result_handler handler) {
+    return sGscanEmulator.start(id, params, handler);
+}
+
+static wifi_error wifi_stop_gscan_emu(wifi_request_id id, wifi_interface_handle iface) {
+    return sGscanEmulator.stop(id);
+}
+
+static wifi_error wifi_get_cached_gscan_results_emu(wifi_interface_handle iface, byte flush,
+        int max, wifi_cached_scan_results *results, int *num) {
+    return sGscanEmulator.getCached(flush != 0, max, results, num);
+}
+
+wifi_error init_wifi_gscan_emu_func_table(wifi_hal_fn *fn, supplicant_command_fn command) {
+    if (fn == NULL || command == NULL) {
+        return WIFI_ERROR_INVALID_ARGS;
+    }
+
+    sGscanEmulator.setCommand(command);
+
+    fn->wifi_initialize = wifi_initialize_emu;
+    fn->wifi_cleanup = wifi_cleanup_emu;
+    fn->wifi_event_loop = wifi_event_loop_emu;
+    fn->wifi_get_ifaces = wifi_get_ifaces_emu;
+    fn->wifi_get_iface_name = wifi_get_iface_name_emu;
+    fn->wifi_get_supported_feature_set = wifi_get_supported_feature_set_emu;
+    fn->wifi_get_gscan_capabilities = wifi_get_gscan_capabilities_emu;
+    fn->wifi_start_gscan = wifi_start_gscan_emu;
+    fn->wifi_stop_gscan = wifi_stop_gscan_emu;
+    fn->wifi_get_cached_gscan_results = wifi_get_cached_gscan_results_emu;
+    return WIFI_SUCCESS;
+}
+
+void wifi_gscan_emu_on_command(const char *command, const char *reply) {
+    sGscanEmulator.onFrameworkCommand(command, reply);
+}
+
+void wifi_gscan_emu_on_event(const char *event) {
+    sGscanEmulator.onSupplicantEvent(event);
+}
+
+}; // namespace android
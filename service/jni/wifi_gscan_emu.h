@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_GSCAN_EMU_H__
+#define __WIFI_GSCAN_EMU_H__
+
+#include "wifi_hal.h"
+#include "gscan.h"
+
+namespace android {
+
+/* sends a command to wpa_supplicant, returning the NUL terminated reply */
+typedef bool (*supplicant_command_fn)(const char *command, char *reply, size_t reply_len);
+
+/* set to true to emulate gscan on boards whose vendor HAL is the no-op libwifi-hal */
+#define GSCAN_EMU_PROPERTY      "persist.wifi.gscan_emulation"
+
+/*
+ * Fills in the HAL entry points needed for background scanning with an emulation that
+ * drives supplicant SCAN / BSS from its own event loop. Meant for boards whose vendor HAL
+ * is the no-op libwifi-hal; every other slot keeps whatever it had (the stubs).
+ */
+wifi_error init_wifi_gscan_emu_func_table(wifi_hal_fn *fn, supplicant_command_fn command);
+
+/* a command the framework sent to supplicant and its reply; spots framework scans */
+void wifi_gscan_emu_on_command(const char *command, const char *reply);
+
+/* a supplicant event read by the framework's monitor; spots the end of scans */
+void wifi_gscan_emu_on_event(const char *event);
+
+}
+
+#endif //__WIFI_GSCAN_EMU_H__
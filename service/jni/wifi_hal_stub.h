@@ -112,6 +112,9 @@ wifi_error wifi_start_sending_offloaded_packet_stub(wifi_request_id id,
         wifi_interface_handle iface, u8 *ip_packet, u16 ip_packet_len,
         u8 *src_mac_addr, u8 *dst_mac_addr, u32 period_msec);
 wifi_error wifi_stop_sending_offloaded_packet_stub(wifi_request_id id, wifi_interface_handle iface);
+wifi_error wifi_start_rssi_monitoring_stub(wifi_request_id id, wifi_interface_handle iface,
+        s8 max_rssi, s8 min_rssi, wifi_rssi_event_handler eh);
+wifi_error wifi_stop_rssi_monitoring_stub(wifi_request_id id, wifi_interface_handle iface);
 #ifdef __cplusplus
 }
 #endif
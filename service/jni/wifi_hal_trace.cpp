@@ -0,0 +1,637 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "wifi"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <utils/Log.h>
+#include <utils/Timers.h>
+
+#include "wifi_hal_trace.h"
+
+#define HAL_TRACE_FLUSH_INTERVAL_MS     1000
+#define HAL_TRACE_MIN_BUFFER            (16 * 1024)
+#define HAL_TRACE_MAX_REPLAY_BYTES      (64 * 1024 * 1024)
+
+namespace android {
+
+static size_t alignRecord(size_t length) {
+    return (length + 7) & ~(size_t) 7;
+}
+
+static bool writeFully(int fd, const uint8_t *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = TEMP_FAILURE_RETRY(write(fd, data, length));
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+HalTraceRecorder::HalTraceRecorder()
+    : mRecording(false), mWriters(0), mRecords(0), mDropped(0), mBytes(0), mBufferBytes(0),
+      mFd(-1), mFlushing(false), mStopping(false)
+{
+    pthread_key_create(&mKey, threadExited);
+}
+
+HalTraceRecorder::ThreadBuffer *HalTraceRecorder::threadBuffer()
+{
+    ThreadBuffer *buffer = (ThreadBuffer *) pthread_getspecific(mKey);
+    if (buffer == NULL) {
+        buffer = new ThreadBuffer();
+        buffer->owner = this;
+        buffer->head.store(0);
+        buffer->tail.store(0);
+        buffer->cursor = 0;
+        buffer->muted = false;
+        buffer->dead = false;
+        pthread_setspecific(mKey, buffer);
+
+        Mutex::Autolock _l(mLock);
+        if (mFlushing) {
+            buffer->data.resize(mBufferBytes);
+        }
+        mBuffers.push_back(buffer);
+    }
+    return buffer;
+}
+
+void HalTraceRecorder::threadExited(void *arg)
+{
+    ThreadBuffer *buffer = (ThreadBuffer *) arg;
+    HalTraceRecorder *self = buffer->owner;
+
+    Mutex::Autolock _l(self->mLock);
+    if (self->mFlushing) {
+        buffer->dead = true;        /* the flush thread frees it once drained */
+        return;
+    }
+    self->mBuffers.erase(std::find(self->mBuffers.begin(), self->mBuffers.end(), buffer));
+    delete buffer;
+}
+
+void HalTraceRecorder::setThreadMuted(bool muted)
+{
+    threadBuffer()->muted = muted;
+}
+
+void HalTraceRecorder::getStats(uint64_t *records, uint64_t *dropped, uint64_t *bytes)
+{
+    *records = mRecords.load();
+    *dropped = mDropped.load();
+    *bytes = mBytes.load();
+}
+
+/* reserves room for a record in the calling thread's ring, or returns NULL to drop it */
+HalTraceRecorder::ThreadBuffer *HalTraceRecorder::begin(int type, wifi_request_id id, int arg,
+        size_t length)
+{
+    /* stop() waits for mWriters to drain after clearing mRecording */
+    mWriters.fetch_add(1);
+    if (!mRecording.load()) {
+        mWriters.fetch_sub(1);
+        return NULL;
+    }
+
+    ThreadBuffer *buffer = threadBuffer();
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    uint64_t tail = buffer->tail.load(std::memory_order_acquire);
+    size_t total = sizeof(HalTraceRecordHeader) + alignRecord(length);
+
+    if (buffer->muted || total > buffer->data.size() - (head - tail)) {
+        if (!buffer->muted) {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        mWriters.fetch_sub(1);
+        return NULL;
+    }
+
+    HalTraceRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = type;
+    header.length = length;
+    header.timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+    header.id = id;
+    header.arg = arg;
+
+    buffer->cursor = head;
+    append(buffer, &header, sizeof(header));
+    return buffer;
+}
+
+void HalTraceRecorder::append(ThreadBuffer *buffer, const void *data, size_t length)
+{
+    if (length == 0) {
+        return;
+    }
+    size_t size = buffer->data.size();
+    size_t pos = buffer->cursor & (size - 1);
+    size_t first = std::min(length, size - pos);
+
+    memcpy(&buffer->data[pos], data, first);
+    memcpy(&buffer->data[0], (const uint8_t *) data + first, length - first);
+    buffer->cursor += length;
+}
+
+void HalTraceRecorder::commit(ThreadBuffer *buffer)
+{
+    uint64_t head = alignRecord(buffer->cursor);
+    uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+    uint64_t half = buffer->data.size() / 2;
+    bool wake = head - tail >= half && buffer->head.load(std::memory_order_relaxed) - tail < half;
+
+    buffer->head.store(head, std::memory_order_release);
+    mRecords.fetch_add(1, std::memory_order_relaxed);
+    mWriters.fetch_sub(1);
+
+    if (wake) {
+        mCondition.signal();
+    }
+}
+
+void HalTraceRecorder::drain(ThreadBuffer *buffer)
+{
+    uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+    uint64_t head = buffer->head.load(std::memory_order_acquire);
+    if (head == tail) {
+        return;
+    }
+
+    size_t size = buffer->data.size();
+    size_t pos = tail & (size - 1);
+    size_t length = head - tail;
+    size_t first = std::min(length, size - pos);
+
+    if (!writeFully(mFd, &buffer->data[pos], first)
+            || !writeFully(mFd, &buffer->data[0], length - first)) {
+        ALOGE("Failed to write HAL trace: %s", strerror(errno));
+    } else {
+        mBytes.fetch_add(length, std::memory_order_relaxed);
+    }
+    buffer->tail.store(head, std::memory_order_release);
+}
+
+void HalTraceRecorder::flushAll()
+{
+    std::vector<ThreadBuffer *> buffers;
+    {
+        Mutex::Autolock _l(mLock);
+        buffers = mBuffers;
+    }
+
+    /* only this thread writes the file or frees buffers while recording */
+    for (size_t i = 0; i < buffers.size(); i++) {
+        drain(buffers[i]);
+    }
+
+    Mutex::Autolock _l(mLock);
+    for (size_t i = 0; i < mBuffers.size(); ) {
+        if (mBuffers[i]->dead) {
+            drain(mBuffers[i]);
+            delete mBuffers[i];
+            mBuffers.erase(mBuffers.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+void HalTraceRecorder::flushLoop()
+{
+    mLock.lock();
+    while (!mStopping) {
+        mCondition.waitRelative(mLock, ms2ns(HAL_TRACE_FLUSH_INTERVAL_MS));
+        mLock.unlock();
+        flushAll();
+        mLock.lock();
+    }
+    mLock.unlock();
+}
+
+void *HalTraceRecorder::flushThread(void *arg)
+{
+    ((HalTraceRecorder *) arg)->flushLoop();
+    return NULL;
+}
+
+bool HalTraceRecorder::start(const char *path, size_t threadBufferBytes)
+{
+    Mutex::Autolock _l(mLock);
+    if (mFlushing) {
+        ALOGE("HAL trace is already being recorded");
+        return false;
+    }
+
+    size_t size = HAL_TRACE_MIN_BUFFER;
+    while (size < threadBufferBytes) {
+        size <<= 1;
+    }
+
+    int fd = TEMP_FAILURE_RETRY(open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660));
+    if (fd < 0) {
+        ALOGE("Failed to open HAL trace %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    HalTraceFileHeader header;
+    header.magic = HAL_TRACE_MAGIC;
+    header.version = HAL_TRACE_VERSION;
+    if (!writeFully(fd, (const uint8_t *) &header, sizeof(header))) {
+        ALOGE("Failed to write HAL trace %s: %s", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    /* no thread touches its ring while mRecording is clear */
+    for (size_t i = 0; i < mBuffers.size(); i++) {
+        mBuffers[i]->data.resize(size);
+        mBuffers[i]->head.store(0);
+        mBuffers[i]->tail.store(0);
+    }
+
+    mFd = fd;
+    mBufferBytes = size;
+    mRecords.store(0);
+    mDropped.store(0);
+    mBytes.store(0);
+    mStopping = false;
+
+    if (pthread_create(&mThread, NULL, flushThread, this) != 0) {
+        ALOGE("Failed to start the HAL trace flush thread");
+        close(fd);
+        mFd = -1;
+        return false;
+    }
+
+    mFlushing = true;
+    mRecording.store(true);
+    ALOGD("Recording HAL trace to %s, %zu bytes per thread", path, size);
+    return true;
+}
+
+void HalTraceRecorder::stop()
+{
+    {
+        Mutex::Autolock _l(mLock);
+        if (!mFlushing) {
+            return;
+        }
+    }
+
+    /* writers never block, so this only waits for records already being copied */
+    mRecording.store(false);
+    while (mWriters.load() != 0) {
+        usleep(100);
+    }
+
+    {
+        Mutex::Autolock _l(mLock);
+        mStopping = true;
+        mCondition.signal();
+    }
+    pthread_join(mThread, NULL);
+    flushAll();
+
+    Mutex::Autolock _l(mLock);
+    close(mFd);
+    mFd = -1;
+    mFlushing = false;
+    for (size_t i = 0; i < mBuffers.size(); i++) {
+        std::vector<uint8_t>().swap(mBuffers[i]->data);
+    }
+
+    ALOGD("HAL trace stopped: %llu records, %llu dropped, %llu bytes",
+            (unsigned long long) mRecords.load(), (unsigned long long) mDropped.load(),
+            (unsigned long long) mBytes.load());
+}
+
+void HalTraceRecorder::recordEvent(int type, wifi_request_id id, int arg)
+{
+    if (!isRecording()) {
+        return;
+    }
+    ThreadBuffer *buffer = begin(type, id, arg, 0);
+    if (buffer != NULL) {
+        commit(buffer);
+    }
+}
+
+/* only the IEs the result carries are kept, so a result is no longer than the HAL made it */
+void HalTraceRecorder::recordFullScanResult(wifi_request_id id, const wifi_scan_result *result)
+{
+    if (!isRecording()) {
+        return;
+    }
+    size_t length = offsetof(wifi_scan_result, ie_data) + result->ie_length;
+    ThreadBuffer *buffer = begin(HAL_TRACE_FULL_SCAN_RESULT, id, 0, length);
+    if (buffer != NULL) {
+        append(buffer, result, length);
+        commit(buffer);
+    }
+}
+
+void HalTraceRecorder::recordScanResults(int type, wifi_request_id id, unsigned num,
+        const wifi_scan_result *results)
+{
+    if (!isRecording()) {
+        return;
+    }
+    size_t length = num * sizeof(wifi_scan_result);
+    ThreadBuffer *buffer = begin(type, id, num, length);
+    if (buffer != NULL) {
+        append(buffer, results, length);
+        commit(buffer);
+    }
+}
+
+void HalTraceRecorder::recordSignificantChange(wifi_request_id id, unsigned num,
+        wifi_significant_change_result **results)
+{
+    if (!isRecording()) {
+        return;
+    }
+    size_t length = 0;
+    for (unsigned i = 0; i < num; i++) {
+        length += sizeof(wifi_significant_change_result) + results[i]->num_rssi * sizeof(wifi_rssi);
+    }
+    ThreadBuffer *buffer = begin(HAL_TRACE_SIGNIFICANT_CHANGE, id, num, length);
+    if (buffer != NULL) {
+        for (unsigned i = 0; i < num; i++) {
+            append(buffer, results[i], sizeof(wifi_significant_change_result)
+                    + results[i]->num_rssi * sizeof(wifi_rssi));
+        }
+        commit(buffer);
+    }
+}
+
+void HalTraceRecorder::recordLinkStats(wifi_request_id id, const wifi_iface_stat *iface,
+        int num_radios, const wifi_radio_stat *radios)
+{
+    if (!isRecording()) {
+        return;
+    }
+    if (iface == NULL || radios == NULL || num_radios < 0) {
+        num_radios = 0;
+    }
+    size_t length = sizeof(wifi_iface_stat) + num_radios * sizeof(wifi_radio_stat);
+    ThreadBuffer *buffer = begin(HAL_TRACE_LINK_STATS, id, num_radios, length);
+    if (buffer != NULL) {
+        /* the per-peer stats that follow the interface stats are not recorded */
+        wifi_iface_stat stat;
+        if (iface != NULL) {
+            memcpy(&stat, iface, sizeof(stat));
+        } else {
+            memset(&stat, 0, sizeof(stat));
+        }
+        stat.num_peers = 0;
+        append(buffer, &stat, sizeof(wifi_iface_stat));
+        append(buffer, radios, num_radios * sizeof(wifi_radio_stat));
+        commit(buffer);
+    }
+}
+
+static size_t elementLength(const wifi_information_element *ie) {
+    return ie != NULL ? offsetof(wifi_information_element, data) + ie->len : 0;
+}
+
+/* each result is followed by its LCI and LCR elements, if any, and padded to 8 bytes */
+void HalTraceRecorder::recordRttResults(wifi_request_id id, unsigned num,
+        wifi_rtt_result *results[])
+{
+    if (!isRecording()) {
+        return;
+    }
+    size_t length = 0;
+    for (unsigned i = 0; i < num; i++) {
+        length += alignRecord(sizeof(wifi_rtt_result) + elementLength(results[i]->LCI)
+                + elementLength(results[i]->LCR));
+    }
+    ThreadBuffer *buffer = begin(HAL_TRACE_RTT_RESULTS, id, num, length);
+    if (buffer != NULL) {
+        static const uint8_t padding[8] = { 0 };
+        for (unsigned i = 0; i < num; i++) {
+            size_t lci = elementLength(results[i]->LCI);
+            size_t lcr = elementLength(results[i]->LCR);
+            size_t used = sizeof(wifi_rtt_result) + lci + lcr;
+            append(buffer, results[i], sizeof(wifi_rtt_result));
+            append(buffer, results[i]->LCI, lci);
+            append(buffer, results[i]->LCR, lcr);
+            append(buffer, padding, alignRecord(used) - used);
+        }
+        commit(buffer);
+    }
+}
+
+void HalTraceRecorder::recordRingBufferData(const char *name, const char *data, int size,
+        const wifi_ring_buffer_status *status)
+{
+    if (!isRecording()) {
+        return;
+    }
+    if (size < 0) {
+        size = 0;
+    }
+    size_t length = sizeof(wifi_ring_buffer_status) + HAL_TRACE_RING_NAME_LEN + size;
+    ThreadBuffer *buffer = begin(HAL_TRACE_RING_BUFFER_DATA, 0, size, length);
+    if (buffer != NULL) {
+        char ringName[HAL_TRACE_RING_NAME_LEN];
+        memset(ringName, 0, sizeof(ringName));
+        strncpy(ringName, name, sizeof(ringName) - 1);
+
+        append(buffer, status, sizeof(wifi_ring_buffer_status));
+        append(buffer, ringName, sizeof(ringName));
+        append(buffer, data, size);
+        commit(buffer);
+    }
+}
+
+void HalTraceRecorder::recordBuffer(int type, wifi_request_id id, int arg, const char *data,
+        int size)
+{
+    if (!isRecording()) {
+        return;
+    }
+    if (data == NULL || size < 0) {
+        size = 0;
+    }
+    ThreadBuffer *buffer = begin(type, id, arg, size);
+    if (buffer != NULL) {
+        append(buffer, data, size);
+        commit(buffer);
+    }
+}
+
+void HalTraceRecorder::recordRssiBreached(wifi_request_id id, const u8 *bssid, s8 rssi)
+{
+    if (!isRecording()) {
+        return;
+    }
+    ThreadBuffer *buffer = begin(HAL_TRACE_RSSI_THRESHOLD_BREACHED, id, rssi, sizeof(mac_addr));
+    if (buffer != NULL) {
+        append(buffer, bssid, sizeof(mac_addr));
+        commit(buffer);
+    }
+}
+
+struct CompareTimestamp {
+    const uint8_t *data;
+    bool operator()(size_t a, size_t b) const {
+        return ((const HalTraceRecordHeader *) &data[a])->timestamp
+                < ((const HalTraceRecordHeader *) &data[b])->timestamp;
+    }
+};
+
+bool HalTraceReader::open(const char *path)
+{
+    int fd = TEMP_FAILURE_RETRY(::open(path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        ALOGE("Failed to open HAL trace %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(HalTraceFileHeader)
+            || st.st_size > HAL_TRACE_MAX_REPLAY_BYTES) {
+        ALOGE("HAL trace %s is empty or too large", path);
+        close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    mStorage.assign(size / sizeof(uint64_t) + 1, 0);
+    mData = (uint8_t *) &mStorage[0];
+
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = TEMP_FAILURE_RETRY(read(fd, mData + done, size - done));
+        if (n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    close(fd);
+
+    const HalTraceFileHeader *header = (const HalTraceFileHeader *) mData;
+    if (done != size || header->magic != HAL_TRACE_MAGIC
+            || header->version != HAL_TRACE_VERSION) {
+        ALOGE("%s is not a HAL trace", path);
+        return false;
+    }
+
+    /* a trace cut short by a crash simply ends at its last whole record */
+    mRecords.clear();
+    size_t offset = sizeof(HalTraceFileHeader);
+    while (offset + sizeof(HalTraceRecordHeader) <= size) {
+        const HalTraceRecordHeader *record = (const HalTraceRecordHeader *) &mData[offset];
+        size_t next = offset + sizeof(HalTraceRecordHeader) + alignRecord(record->length);
+        if (next > size || next < offset) {
+            break;
+        }
+        mRecords.push_back(offset);
+        offset = next;
+    }
+
+    CompareTimestamp compare;
+    compare.data = mData;
+    std::stable_sort(mRecords.begin(), mRecords.end(), compare);
+    return true;
+}
+
+bool HalTraceReader::checkFullScanResult(const HalTraceRecordHeader &header, uint8_t *payload)
+{
+    const wifi_scan_result *result = (const wifi_scan_result *) payload;
+    return header.length >= offsetof(wifi_scan_result, ie_data)
+            && result->ie_length <= header.length - offsetof(wifi_scan_result, ie_data);
+}
+
+bool HalTraceReader::checkScanResults(const HalTraceRecordHeader &header, uint8_t *payload)
+{
+    return header.arg >= 0 && header.length == header.arg * sizeof(wifi_scan_result);
+}
+
+bool HalTraceReader::decodeSignificantChange(const HalTraceRecordHeader &header,
+        uint8_t *payload, std::vector<wifi_significant_change_result *> &results)
+{
+    results.clear();
+    size_t offset = 0;
+    for (int i = 0; i < header.arg; i++) {
+        if (header.length - offset < sizeof(wifi_significant_change_result)) {
+            return false;
+        }
+        wifi_significant_change_result *result =
+                (wifi_significant_change_result *) &payload[offset];
+        offset += sizeof(wifi_significant_change_result);
+        if (result->num_rssi < 0
+                || (header.length - offset) / sizeof(wifi_rssi) < (size_t) result->num_rssi) {
+            return false;
+        }
+        offset += result->num_rssi * sizeof(wifi_rssi);
+        results.push_back(result);
+    }
+    return offset == header.length;
+}
+
+static bool decodeElement(uint8_t *payload, size_t length, size_t *offset,
+        wifi_information_element **ie) {
+    if (*ie == NULL) {
+        return true;
+    }
+    size_t header = offsetof(wifi_information_element, data);
+    if (length - *offset < header) {
+        return false;
+    }
+    *ie = (wifi_information_element *) &payload[*offset];
+    if (length - *offset - header < (*ie)->len) {
+        return false;
+    }
+    *offset += header + (*ie)->len;
+    return true;
+}
+
+bool HalTraceReader::decodeRttResults(const HalTraceRecordHeader &header, uint8_t *payload,
+        std::vector<wifi_rtt_result *> &results)
+{
+    results.clear();
+    size_t offset = 0;
+    for (int i = 0; i < header.arg; i++) {
+        if (header.length - offset < sizeof(wifi_rtt_result)) {
+            return false;
+        }
+        wifi_rtt_result *result = (wifi_rtt_result *) &payload[offset];
+        offset += sizeof(wifi_rtt_result);
+
+        /* the recorded pointers only say whether an element follows */
+        if (!decodeElement(payload, header.length, &offset, &result->LCI)
+                || !decodeElement(payload, header.length, &offset, &result->LCR)) {
+            return false;
+        }
+        offset = std::min(alignRecord(offset), (size_t) header.length);
+        results.push_back(result);
+    }
+    return offset == header.length;
+}
+
+}; // namespace android
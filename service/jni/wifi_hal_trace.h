@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_TRACE_H__
+#define __WIFI_HAL_TRACE_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <utils/Mutex.h>
+#include <utils/Condition.h>
+
+#include "wifi_hal.h"
+
+namespace android {
+
+/* callback types in a HAL trace; values are part of the file format */
+enum {
+    HAL_TRACE_SCAN_RESULTS_AVAILABLE    = 1,
+    HAL_TRACE_SCAN_EVENT                = 2,
+    HAL_TRACE_FULL_SCAN_RESULT          = 3,
+    HAL_TRACE_HOTLIST_AP_FOUND          = 4,
+    HAL_TRACE_HOTLIST_AP_LOST           = 5,
+    HAL_TRACE_SIGNIFICANT_CHANGE        = 6,
+    HAL_TRACE_LINK_STATS                = 7,
+    HAL_TRACE_RTT_RESULTS               = 8,
+    HAL_TRACE_RING_BUFFER_DATA          = 9,
+    HAL_TRACE_ALERT                     = 10,
+    HAL_TRACE_FIRMWARE_MEMORY_DUMP      = 11,
+    HAL_TRACE_PNO_NETWORK_FOUND         = 12,
+    HAL_TRACE_RSSI_THRESHOLD_BREACHED   = 13,
+};
+
+#define HAL_TRACE_MAGIC                 0x52544857      /* "WHTR" */
+#define HAL_TRACE_VERSION               1
+#define HAL_TRACE_RING_NAME_LEN         32              /* ring name stored before ring data */
+
+/*
+ * A trace is a HalTraceFileHeader followed by records, each a HalTraceRecordHeader and
+ * 'length' bytes of payload padded to 8 bytes. Everything is in host byte order and holds
+ * the HAL structs as the HAL delivered them. Records of different threads are flushed in
+ * chunks, so a trace is only ordered by timestamp within a thread.
+ */
+struct HalTraceFileHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+struct HalTraceRecordHeader {
+    uint16_t type;
+    uint16_t reserved;
+    uint32_t length;
+    int64_t timestamp;          /* CLOCK_MONOTONIC nanoseconds */
+    int32_t id;                 /* request id; the event for HAL_TRACE_SCAN_EVENT */
+    int32_t arg;                /* result count, status, error code or buffer size */
+};
+
+/*
+ * Appends HAL callbacks to a trace file. Each calling thread writes into its own single
+ * producer ring, without locks; a background thread drains the rings to the file. When a
+ * ring is full the record is dropped and counted rather than blocking the HAL.
+ */
+class HalTraceRecorder {
+public:
+    HalTraceRecorder();
+
+    bool start(const char *path, size_t threadBufferBytes);
+    void stop();
+
+    bool isRecording() const {
+        return mRecording.load(std::memory_order_relaxed);
+    }
+
+    /* keeps the calling thread's callbacks out of the trace, e.g. while replaying one */
+    void setThreadMuted(bool muted);
+
+    void getStats(uint64_t *records, uint64_t *dropped, uint64_t *bytes);
+
+    void recordEvent(int type, wifi_request_id id, int arg);
+    void recordFullScanResult(wifi_request_id id, const wifi_scan_result *result);
+    void recordScanResults(int type, wifi_request_id id, unsigned num,
+            const wifi_scan_result *results);
+    void recordSignificantChange(wifi_request_id id, unsigned num,
+            wifi_significant_change_result **results);
+    void recordLinkStats(wifi_request_id id, const wifi_iface_stat *iface,
+            int num_radios, const wifi_radio_stat *radios);
+    void recordRttResults(wifi_request_id id, unsigned num, wifi_rtt_result *results[]);
+    void recordRingBufferData(const char *name, const char *buffer, int size,
+            const wifi_ring_buffer_status *status);
+    void recordBuffer(int type, wifi_request_id id, int arg, const char *buffer, int size);
+    void recordRssiBreached(wifi_request_id id, const u8 *bssid, s8 rssi);
+
+private:
+    struct ThreadBuffer {
+        HalTraceRecorder *owner;
+        std::vector<uint8_t> data;          /* power of two sized */
+        std::atomic<uint64_t> head;         /* advanced by the owning thread */
+        std::atomic<uint64_t> tail;         /* advanced by the flush thread */
+        uint64_t cursor;                    /* owner's write position while recording */
+        bool muted;
+        bool dead;                          /* owning thread exited */
+    };
+
+    ThreadBuffer *threadBuffer();
+    ThreadBuffer *begin(int type, wifi_request_id id, int arg, size_t length);
+    void append(ThreadBuffer *buffer, const void *data, size_t length);
+    void commit(ThreadBuffer *buffer);
+    void drain(ThreadBuffer *buffer);
+    void flushAll();
+    void flushLoop();
+
+    static void *flushThread(void *arg);
+    static void threadExited(void *arg);
+
+    pthread_key_t mKey;
+    std::atomic<bool> mRecording;
+    std::atomic<int> mWriters;
+    std::atomic<uint64_t> mRecords;
+    std::atomic<uint64_t> mDropped;
+    std::atomic<uint64_t> mBytes;           /* advanced by the flush thread */
+
+    Mutex mLock;                            /* guards the members below */
+    Condition mCondition;
+    std::vector<ThreadBuffer *> mBuffers;
+    size_t mBufferBytes;
+    int mFd;
+    bool mFlushing;                         /* the flush thread is running */
+    bool mStopping;
+    pthread_t mThread;
+};
+
+/*
+ * Loads a trace for replay. Records are sorted by timestamp, and the payloads are kept in
+ * memory so the decode helpers can point the HAL structs at them.
+ */
+class HalTraceReader {
+public:
+    bool open(const char *path);
+
+    size_t size() const {
+        return mRecords.size();
+    }
+    const HalTraceRecordHeader &header(size_t i) const {
+        return *(const HalTraceRecordHeader *) &mData[mRecords[i]];
+    }
+    uint8_t *payload(size_t i) {
+        return &mData[mRecords[i] + sizeof(HalTraceRecordHeader)];
+    }
+
+    /* validate a payload against its header; the pointer arrays point into the payload */
+    static bool checkFullScanResult(const HalTraceRecordHeader &header, uint8_t *payload);
+    static bool checkScanResults(const HalTraceRecordHeader &header, uint8_t *payload);
+    static bool decodeSignificantChange(const HalTraceRecordHeader &header, uint8_t *payload,
+            std::vector<wifi_significant_change_result *> &results);
+    static bool decodeRttResults(const HalTraceRecordHeader &header, uint8_t *payload,
+            std::vector<wifi_rtt_result *> &results);
+
+private:
+    std::vector<uint64_t> mStorage;         /* 8 byte aligned backing store of mData */
+    uint8_t *mData;
+    std::vector<size_t> mRecords;           /* offsets of the record headers */
+};
+
+}
+
+#endif //__WIFI_HAL_TRACE_H__
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "wifi"
+
+#include <algorithm>
+#include <string.h>
+#include <utils/Log.h>
+
+#include "wifi_hotlist.h"
+
+namespace android {
+
+HotlistMux::Request *HotlistMux::findLocked(int id)
+{
+    for (size_t i = 0; i < mRequests.size(); i++) {
+        if (mRequests[i].id == id) {
+            return &mRequests[i];
+        }
+    }
+    return NULL;
+}
+
+void HotlistMux::set(int id, int lostApSampleSize, const ap_threshold_param *aps, int numAps)
+{
+    Mutex::Autolock lock(mLock);
+
+    Request *request = findLocked(id);
+    if (request == NULL) {
+        mRequests.push_back(Request());
+        request = &mRequests.back();
+        request->id = id;
+    }
+
+    /* BSSIDs the requester keeps watching stay found */
+    std::vector<bool> found(numAps, false);
+    for (int i = 0; i < numAps; i++) {
+        for (size_t j = 0; j < request->aps.size(); j++) {
+            if (memcmp(request->aps[j].bssid, aps[i].bssid, sizeof(mac_addr)) == 0) {
+                found[i] = request->found[j];
+                break;
+            }
+        }
+    }
+
+    request->lostApSampleSize = lostApSampleSize;
+    request->aps.assign(aps, aps + numAps);
+    request->found.swap(found);
+}
+
+void HotlistMux::remove(int id)
+{
+    Mutex::Autolock lock(mLock);
+
+    for (size_t i = 0; i < mRequests.size(); i++) {
+        if (mRequests[i].id == id) {
+            mRequests.erase(mRequests.begin() + i);
+            return;
+        }
+    }
+}
+
+bool HotlistMux::isEmpty()
+{
+    Mutex::Autolock lock(mLock);
+    return mRequests.empty();
+}
+
+void HotlistMux::clear()
+{
+    Mutex::Autolock lock(mLock);
+    mRequests.clear();
+    mProgrammed = false;
+}
+
+bool HotlistMux::compareBssid(const MergedAp &a, const MergedAp &b)
+{
+    return memcmp(a.ap.bssid, b.ap.bssid, sizeof(mac_addr)) < 0;
+}
+
+bool HotlistMux::compareRefs(const MergedAp &a, const MergedAp &b)
+{
+    return a.refs > b.refs;
+}
+
+void HotlistMux::build(wifi_bssid_hotlist_params *params)
+{
+    Mutex::Autolock lock(mLock);
+
+    std::vector<MergedAp> all;
+    int lostApSampleSize = 0;
+    for (size_t i = 0; i < mRequests.size(); i++) {
+        const Request &request = mRequests[i];
+        if (request.lostApSampleSize > 0 && (lostApSampleSize == 0
+                || request.lostApSampleSize < lostApSampleSize)) {
+            lostApSampleSize = request.lostApSampleSize;
+        }
+
+        for (size_t j = 0; j < request.aps.size(); j++) {
+            MergedAp merged;
+            merged.ap = request.aps[j];
+            merged.refs = 1;
+            all.push_back(merged);
+        }
+    }
+
+    std::sort(all.begin(), all.end(), compareBssid);
+
+    std::vector<MergedAp> merged;
+    for (size_t i = 0; i < all.size(); i++) {
+        if (merged.empty() || compareBssid(merged.back(), all[i])) {
+            merged.push_back(all[i]);
+            continue;
+        }
+
+        MergedAp &last = merged.back();
+        last.refs++;
+        if (all[i].ap.low < last.ap.low) {
+            last.ap.low = all[i].ap.low;
+        }
+        if (all[i].ap.high > last.ap.high) {
+            last.ap.high = all[i].ap.high;
+        }
+    }
+
+    if (merged.size() > MAX_HOTLIST_APS) {
+        ALOGE("hotlist holds %zu BSSIDs, dropping %zu", merged.size(),
+                merged.size() - MAX_HOTLIST_APS);
+        std::stable_sort(merged.begin(), merged.end(), compareRefs);
+        merged.resize(MAX_HOTLIST_APS);
+        std::sort(merged.begin(), merged.end(), compareBssid);
+    }
+
+    memset(params, 0, sizeof(*params));
+    params->lost_ap_sample_size =
+            lostApSampleSize > 0 ? lostApSampleSize : kDefaultLostApSampleSize;
+    params->num_bssid = merged.size();
+    for (size_t i = 0; i < merged.size(); i++) {
+        params->ap[i] = merged[i].ap;
+    }
+}
+
+bool HotlistMux::isProgrammed(const wifi_bssid_hotlist_params &params)
+{
+    Mutex::Autolock lock(mLock);
+
+    if (!mProgrammed || params.num_bssid != mParams.num_bssid
+            || params.lost_ap_sample_size != mParams.lost_ap_sample_size) {
+        return false;
+    }
+
+    return memcmp(params.ap, mParams.ap, params.num_bssid * sizeof(ap_threshold_param)) == 0;
+}
+
+void HotlistMux::setProgrammed(const wifi_bssid_hotlist_params &params)
+{
+    Mutex::Autolock lock(mLock);
+    mParams = params;
+    mProgrammed = true;
+}
+
+void HotlistMux::resetProgrammed()
+{
+    Mutex::Autolock lock(mLock);
+    mProgrammed = false;
+}
+
+bool HotlistMux::isProgrammed()
+{
+    Mutex::Autolock lock(mLock);
+    return mProgrammed;
+}
+
+void HotlistMux::match(bool lost, const wifi_scan_result *results, unsigned numResults,
+        std::vector<HotlistMatch> &matches)
+{
+    Mutex::Autolock lock(mLock);
+
+    matches.clear();
+    for (size_t r = 0; r < mRequests.size(); r++) {
+        Request &request = mRequests[r];
+        HotlistMatch match;
+        match.id = request.id;
+
+        for (unsigned i = 0; i < numResults; i++) {
+            for (size_t j = 0; j < request.aps.size(); j++) {
+                if (memcmp(request.aps[j].bssid, results[i].bssid, sizeof(mac_addr)) != 0) {
+                    continue;
+                }
+                if (lost ? !request.found[j]
+                        : request.found[j] || results[i].rssi < request.aps[j].low) {
+                    continue;
+                }
+                request.found[j] = !lost;
+                match.results.push_back(i);
+                break;
+            }
+        }
+
+        if (!match.results.empty()) {
+            matches.push_back(match);
+        }
+    }
+}
+
+}; // namespace android
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HOTLIST_H__
+#define __WIFI_HOTLIST_H__
+
+#include <vector>
+#include <utils/Mutex.h>
+
+#include "wifi_hal.h"
+#include "gscan.h"
+
+namespace android {
+
+/* the results of a hotlist event that are to be reported to one requester */
+struct HotlistMatch {
+    int id;
+    std::vector<unsigned> results;
+};
+
+/*
+ * The HAL holds a single BSSID hotlist. HotlistMux lets several requesters share it: it keeps
+ * the BSSIDs each of them asked for, merges them into one list, and tells which requesters a
+ * found or lost BSSID has to be reported to. The merged list is installed under a request id
+ * of its own, so it outlives whichever requester caused it to be programmed. Requests are
+ * made from Java, which serializes them, while the HAL callbacks look up requesters from the
+ * event thread.
+ */
+class HotlistMux {
+public:
+    static const int kDefaultLostApSampleSize = 3;
+
+    /* WifiNative hands out request ids counting up from 0; this one stays out of their way */
+    static const wifi_request_id kHalRequestId = 0x7fff4854;
+
+    HotlistMux() : mProgrammed(false) {
+    }
+
+    /* installs or replaces the BSSIDs watched by requester id */
+    void set(int id, int lostApSampleSize, const ap_threshold_param *aps, int numAps);
+    void remove(int id);
+    bool isEmpty();
+
+    /* forgets all requests, for when the HAL went away */
+    void clear();
+
+    /*
+     * Builds the list to program: each BSSID once, sorted, with the lowest low and highest
+     * high threshold any of its requesters asked for, so that the firmware reports whatever
+     * one of them would want reported. The smallest lost AP sample size is used. Should the
+     * union not fit, BSSIDs watched by more requesters are kept first.
+     */
+    void build(wifi_bssid_hotlist_params *params);
+
+    /* true if params is what the HAL was last programmed with */
+    bool isProgrammed(const wifi_bssid_hotlist_params &params);
+    void setProgrammed(const wifi_bssid_hotlist_params &params);
+    void resetProgrammed();
+
+    /* true while a list is installed under kHalRequestId */
+    bool isProgrammed();
+
+    /*
+     * Picks, for each requester, the results of a found or lost event it is to be told
+     * about. Since the merged list carries the loosest thresholds, a found BSSID is only
+     * reported to requesters it is at or above the own low threshold of, and a lost one only
+     * to requesters that were told it was found.
+     */
+    void match(bool lost, const wifi_scan_result *results, unsigned numResults,
+            std::vector<HotlistMatch> &matches);
+
+private:
+    struct Request {
+        int id;
+        int lostApSampleSize;
+        std::vector<ap_threshold_param> aps;
+        std::vector<bool> found;        /* whether the requester was told aps[i] was found */
+    };
+
+    struct MergedAp {
+        ap_threshold_param ap;
+        int refs;
+    };
+
+    Request *findLocked(int id);
+    static bool compareBssid(const MergedAp &a, const MergedAp &b);
+    static bool compareRefs(const MergedAp &a, const MergedAp &b);
+
+    Mutex mLock;
+    std::vector<Request> mRequests;
+    bool mProgrammed;
+    wifi_bssid_hotlist_params mParams;
+};
+
+}
+
+#endif //__WIFI_HOTLIST_H__
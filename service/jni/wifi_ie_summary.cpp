@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "wifi_ie_summary.h"
+
+namespace android {
+
+static const u8 EID_BSS_LOAD = 11;
+static const u8 EID_HT_CAPABILITIES = 45;
+static const u8 EID_RSN = 48;
+static const u8 EID_HT_OPERATION = 61;
+static const u8 EID_INTERWORKING = 107;
+static const u8 EID_EXTENDED_CAPS = 127;
+static const u8 EID_VHT_CAPABILITIES = 191;
+static const u8 EID_VHT_OPERATION = 192;
+static const u8 EID_VENDOR_SPECIFIC = 221;
+
+static const int RTT_RESP_ENABLE_BIT = 70;
+static const u8 HS20_ANQP_DOMAIN_ID_BIT = 0x04;
+
+static const u8 RSN_OUI[3] = { 0x00, 0x0f, 0xac };
+static const u8 WPA_OUI[3] = { 0x00, 0x50, 0xf2 };
+static const u8 WPA_OUI_TYPE = 0x01;
+static const u8 WFA_OUI[3] = { 0x50, 0x6f, 0x9a };
+static const u8 HS20_OUI_TYPE = 0x10;
+
+/* suites defaulted to when an RSN element stops short of listing them, see 802.11-2012 8.4.2.27 */
+static const int RSN_CIPHER_CCMP = 4;
+static const int RSN_AKM_8021X = 1;
+
+/* read position inside one element's payload */
+struct IeReader {
+    const u8 *p;
+    size_t left;
+
+    bool has(size_t n) const {
+        return left >= n;
+    }
+    void skip(size_t n) {
+        p += n;
+        left -= n;
+    }
+    int u8At(size_t i) const {
+        return p[i];
+    }
+    int le16At(size_t i) const {
+        return p[i] | (p[i + 1] << 8);
+    }
+    uint32_t le32At(size_t i) const {
+        return p[i] | (p[i + 1] << 8) | (p[i + 2] << 16) | ((uint32_t)p[i + 3] << 24);
+    }
+};
+
+/*
+ * Reads a suite selector with the given OUI; anything from another OUI (vendor specific
+ * suites) yields -1. Suite types that don't fit a mask bit are dropped the same way.
+ */
+static int suiteType(const u8 *suite, const u8 oui[3])
+{
+    if (memcmp(suite, oui, 3) != 0 || suite[3] >= 32) {
+        return -1;
+    }
+    return suite[3];
+}
+
+/*
+ * Parses what RSN and WPA elements have in common once the version is consumed: group cipher,
+ * pairwise cipher list and AKM list, each optional as long as everything after it is missing
+ * too. Returns false if a list claims more suites than the element holds.
+ */
+static bool parseSuites(IeReader &r, const u8 oui[3], int32_t *group, int32_t *pairwise,
+        int32_t *akms)
+{
+    *group = RSN_CIPHER_CCMP;
+    *pairwise = 1 << RSN_CIPHER_CCMP;
+    *akms = 1 << RSN_AKM_8021X;
+
+    if (!r.has(4)) {
+        return r.left == 0;
+    }
+    int type = suiteType(r.p, oui);
+    *group = type < 0 ? 0 : type;
+    r.skip(4);
+
+    int32_t *lists[2] = { pairwise, akms };
+    for (int l = 0; l < 2; l++) {
+        if (!r.has(2)) {
+            return r.left == 0;
+        }
+        size_t count = r.le16At(0);
+        r.skip(2);
+        if (count > r.left / 4) {
+            return false;
+        }
+        int32_t mask = 0;
+        for (size_t i = 0; i < count; i++) {
+            type = suiteType(r.p, oui);
+            if (type >= 0) {
+                mask |= 1 << type;
+            }
+            r.skip(4);
+        }
+        *lists[l] = mask;
+    }
+    return true;
+}
+
+static void parseRsn(IeReader r, int32_t summary[IE_SUMMARY_LEN])
+{
+    if (!r.has(2) || r.le16At(0) != 1) {
+        return;
+    }
+    r.skip(2);
+    int32_t group, pairwise, akms;
+    if (!parseSuites(r, RSN_OUI, &group, &pairwise, &akms)) {
+        return;
+    }
+    summary[IE_SUMMARY_RSN_GROUP_CIPHER] = group;
+    summary[IE_SUMMARY_RSN_PAIRWISE_CIPHERS] = pairwise;
+    summary[IE_SUMMARY_RSN_AKMS] = akms;
+    summary[IE_SUMMARY_RSN_CAPABILITIES] = r.has(2) ? r.le16At(0) : 0;
+    summary[IE_SUMMARY_FLAGS] |= IE_SUMMARY_HAS_RSN;
+}
+
+/* r starts after the OUI and type */
+static void parseWpa(IeReader r, int32_t summary[IE_SUMMARY_LEN])
+{
+    if (!r.has(2) || r.le16At(0) != 1) {
+        return;
+    }
+    r.skip(2);
+    int32_t group, pairwise, akms;
+    if (!parseSuites(r, WPA_OUI, &group, &pairwise, &akms)) {
+        return;
+    }
+    summary[IE_SUMMARY_WPA_GROUP_CIPHER] = group;
+    summary[IE_SUMMARY_WPA_PAIRWISE_CIPHERS] = pairwise;
+    summary[IE_SUMMARY_WPA_AKMS] = akms;
+    summary[IE_SUMMARY_FLAGS] |= IE_SUMMARY_HAS_WPA;
+}
+
+/* r starts after the OUI and type */
+static void parseHs20(IeReader r, int32_t summary[IE_SUMMARY_LEN])
+{
+    if (!r.has(1)) {
+        return;
+    }
+    int conf = r.u8At(0);
+    summary[IE_SUMMARY_HS20_RELEASE] = (conf >> 4) & 0x0f;
+    summary[IE_SUMMARY_FLAGS] |= IE_SUMMARY_HAS_HS20;
+    if ((conf & HS20_ANQP_DOMAIN_ID_BIT) && r.has(3)) {
+        summary[IE_SUMMARY_ANQP_DOMAIN_ID] = r.le16At(1);
+        summary[IE_SUMMARY_FLAGS] |= IE_SUMMARY_HAS_ANQP_DOMAIN_ID;
+    } else {
+        summary[IE_SUMMARY_ANQP_DOMAIN_ID] = 0;
+        summary[IE_SUMMARY_FLAGS] &= ~IE_SUMMARY_HAS_ANQP_DOMAIN_ID;
+    }
+}
+
+static void parseVendor(IeReader r, int32_t summary[IE_SUMMARY_LEN])
+{
+    if (!r.has(4)) {
+        return;
+    }
+    const u8 *oui = r.p;
+    int type = r.u8At(3);
+    r.skip(4);
+    if (memcmp(oui, WPA_OUI, 3) == 0 && type == WPA_OUI_TYPE) {
+        parseWpa(r, summary);
+    } else if (memcmp(oui, WFA_OUI, 3) == 0 && type == HS20_OUI_TYPE) {
+        parseHs20(r, summary);
+    }
+}
+
+/* returns false if the element is too short for the channel information it carries */
+static bool parseElement(int eid, IeReader r, int32_t summary[IE_SUMMARY_LEN])
+{
+    int32_t &flags = summary[IE_SUMMARY_FLAGS];
+
+    switch (eid) {
+        case EID_BSS_LOAD:
+            if (r.left == 5) {
+                summary[IE_SUMMARY_STATION_COUNT] = r.le16At(0);
+                summary[IE_SUMMARY_CHANNEL_UTILIZATION] = r.u8At(2);
+                summary[IE_SUMMARY_AVAILABLE_CAPACITY] = r.le16At(3);
+                flags |= IE_SUMMARY_HAS_BSS_LOAD;
+            }
+            return true;
+        case EID_HT_CAPABILITIES:
+            if (r.has(2)) {
+                summary[IE_SUMMARY_HT_CAPABILITIES] = r.le16At(0);
+                flags |= IE_SUMMARY_HAS_HT;
+            }
+            return true;
+        case EID_RSN:
+            parseRsn(r, summary);
+            return true;
+        case EID_HT_OPERATION:
+            if (!r.has(2)) {
+                return false;
+            }
+            summary[IE_SUMMARY_HT_SECONDARY_OFFSET] = r.u8At(1) & 0x3;
+            flags |= IE_SUMMARY_HAS_HT_OPERATION;
+            return true;
+        case EID_INTERWORKING:
+            if (r.has(1)) {
+                summary[IE_SUMMARY_ACCESS_NETWORK_TYPE] = r.u8At(0) & 0x0f;
+                flags |= IE_SUMMARY_HAS_INTERWORKING;
+                if (r.u8At(0) & 0x10) {
+                    flags |= IE_SUMMARY_INTERNET;
+                } else {
+                    flags &= ~IE_SUMMARY_INTERNET;
+                }
+            }
+            return true;
+        case EID_EXTENDED_CAPS:
+            if (r.has(RTT_RESP_ENABLE_BIT / 8 + 1)
+                    && (r.u8At(RTT_RESP_ENABLE_BIT / 8) & (1 << (RTT_RESP_ENABLE_BIT % 8)))) {
+                flags |= IE_SUMMARY_RTT_RESPONDER;
+            } else {
+                flags &= ~IE_SUMMARY_RTT_RESPONDER;
+            }
+            return true;
+        case EID_VHT_CAPABILITIES:
+            if (r.has(4)) {
+                summary[IE_SUMMARY_VHT_CAPABILITIES] = r.le32At(0);
+                flags |= IE_SUMMARY_HAS_VHT;
+            }
+            return true;
+        case EID_VHT_OPERATION:
+            if (!r.has(3)) {
+                return false;
+            }
+            summary[IE_SUMMARY_VHT_CHANNEL_WIDTH] = r.u8At(0);
+            summary[IE_SUMMARY_VHT_CENTER_INDEX0] = r.u8At(1);
+            summary[IE_SUMMARY_VHT_CENTER_INDEX1] = r.u8At(2);
+            flags |= IE_SUMMARY_HAS_VHT_OPERATION;
+            return true;
+        case EID_VENDOR_SPECIFIC:
+            parseVendor(r, summary);
+            return true;
+        default:
+            return true;
+    }
+}
+
+void parse_ie_summary(const u8 *ies, size_t len, int32_t summary[IE_SUMMARY_LEN])
+{
+    memset(summary, 0, sizeof(int32_t) * IE_SUMMARY_LEN);
+    if (ies == NULL) {
+        return;
+    }
+
+    size_t i = 0;
+    int count = 0;
+    while (i + 1 < len) {
+        int eid = ies[i];
+        size_t elen = ies[i + 1];
+        IeReader r = { ies + i + 2, elen };
+        if (elen > len - i - 2 || !parseElement(eid, r, summary)) {
+            summary[IE_SUMMARY_FLAGS] |= IE_SUMMARY_MALFORMED;
+            break;
+        }
+        count++;
+        i += elen + 2;
+    }
+    summary[IE_SUMMARY_ELEMENT_COUNT] = count;
+}
+
+}; // namespace android
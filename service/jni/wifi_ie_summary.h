@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_IE_SUMMARY_H__
+#define __WIFI_IE_SUMMARY_H__
+
+#include <stdint.h>
+
+#include "wifi_hal.h"
+
+namespace android {
+
+/*
+ * Layout of the int[] handed to Java next to the raw IEs of a full scan result; keep these
+ * consistent with WifiNative.java. Absent elements leave their slots at 0.
+ */
+enum {
+    IE_SUMMARY_FLAGS = 0,
+    IE_SUMMARY_ELEMENT_COUNT,           /* well formed IEs before the first one that isn't */
+    IE_SUMMARY_HT_SECONDARY_OFFSET,     /* 0 none, 1 above, 3 below */
+    IE_SUMMARY_VHT_CHANNEL_WIDTH,       /* 0 20/40, 1 80, 2 160, 3 80+80 */
+    IE_SUMMARY_VHT_CENTER_INDEX0,
+    IE_SUMMARY_VHT_CENTER_INDEX1,
+    IE_SUMMARY_RSN_GROUP_CIPHER,        /* 00-0F-AC suite type */
+    IE_SUMMARY_RSN_PAIRWISE_CIPHERS,    /* bit n set for 00-0F-AC suite type n */
+    IE_SUMMARY_RSN_AKMS,                /* bit n set for 00-0F-AC suite type n */
+    IE_SUMMARY_RSN_CAPABILITIES,
+    IE_SUMMARY_WPA_GROUP_CIPHER,        /* 00-50-F2 suite type */
+    IE_SUMMARY_WPA_PAIRWISE_CIPHERS,    /* bit n set for 00-50-F2 suite type n */
+    IE_SUMMARY_WPA_AKMS,                /* bit n set for 00-50-F2 suite type n */
+    IE_SUMMARY_HT_CAPABILITIES,         /* HT capability info field */
+    IE_SUMMARY_VHT_CAPABILITIES,        /* VHT capability info field */
+    IE_SUMMARY_STATION_COUNT,           /* from BSS Load */
+    IE_SUMMARY_CHANNEL_UTILIZATION,
+    IE_SUMMARY_AVAILABLE_CAPACITY,
+    IE_SUMMARY_ACCESS_NETWORK_TYPE,     /* from Interworking */
+    IE_SUMMARY_HS20_RELEASE,            /* 0 for release 1, 1 for release 2 */
+    IE_SUMMARY_ANQP_DOMAIN_ID,
+    IE_SUMMARY_CAPABILITY_INFO,         /* the frame's capability field; set by the caller */
+    IE_SUMMARY_LEN
+};
+
+/* bits of IE_SUMMARY_FLAGS */
+enum {
+    IE_SUMMARY_HAS_HT_OPERATION     = 1 << 0,
+    IE_SUMMARY_HAS_VHT_OPERATION    = 1 << 1,
+    IE_SUMMARY_RTT_RESPONDER        = 1 << 2,
+    IE_SUMMARY_MALFORMED            = 1 << 3,  /* an element overran the buffer, or was short */
+    IE_SUMMARY_HAS_RSN              = 1 << 4,
+    IE_SUMMARY_HAS_WPA              = 1 << 5,
+    IE_SUMMARY_HAS_HT               = 1 << 6,
+    IE_SUMMARY_HAS_VHT              = 1 << 7,
+    IE_SUMMARY_HAS_BSS_LOAD         = 1 << 8,
+    IE_SUMMARY_HAS_INTERWORKING     = 1 << 9,
+    IE_SUMMARY_INTERNET             = 1 << 10,
+    IE_SUMMARY_HAS_HS20             = 1 << 11,
+    IE_SUMMARY_HAS_ANQP_DOMAIN_ID   = 1 << 12,
+};
+
+/*
+ * Walks the IEs of a beacon or probe response once and fills summary with the fields the
+ * framework looks at. Never reads outside ies[0, len) and never allocates. The walk stops at
+ * the first element that overruns the buffer or whose channel information is too short, and
+ * flags it; the count and the fields only cover the elements before it, which are the ones
+ * Java gets. Any other element that doesn't parse only leaves its own fields unset.
+ * IE_SUMMARY_CAPABILITY_INFO is left at 0.
+ */
+void parse_ie_summary(const u8 *ies, size_t len, int32_t summary[IE_SUMMARY_LEN]);
+
+}
+
+#endif //__WIFI_IE_SUMMARY_H__
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "wifi_keepalive.h"
+
+namespace android {
+
+static const size_t kIpv4HeaderLength = 20;
+static const size_t kIpv6HeaderLength = 40;
+
+/* FNV-1a, continuing from hash */
+static uint32_t fnv1a(uint32_t hash, const uint8_t *bytes, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static inline uint16_t readBe16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+KeepaliveManager::KeepaliveManager()
+    : mActive(0), mStarted(0), mStopped(0), mUnchanged(0), mRejected(0)
+{
+}
+
+bool KeepaliveManager::validatePacket(const uint8_t *data, size_t len)
+{
+    if (len == 0 || len > kMaxPacketLength) {
+        return false;
+    }
+
+    switch (data[0] >> 4) {
+        case 4: {
+            if (len < kIpv4HeaderLength) {
+                return false;
+            }
+            size_t headerLength = (data[0] & 0x0f) * 4;
+            if (headerLength < kIpv4HeaderLength || headerLength > len
+                    || readBe16(data + 2) != len) {
+                return false;
+            }
+            /* the ones' complement sum over a header with a correct checksum is all ones */
+            uint32_t sum = 0;
+            for (size_t i = 0; i < headerLength; i += 2) {
+                sum += readBe16(data + i);
+            }
+            while (sum >> 16) {
+                sum = (sum & 0xffff) + (sum >> 16);
+            }
+            return sum == 0xffff;
+        }
+        case 6:
+            return len >= kIpv6HeaderLength && readBe16(data + 4) + kIpv6HeaderLength == len;
+        default:
+            return false;
+    }
+}
+
+bool KeepaliveManager::prepare(int slot, const uint8_t *data, size_t len,
+        const mac_addr srcMac, const mac_addr dstMac, uint32_t periodMs,
+        KeepalivePacket *packet)
+{
+    if (!validatePacket(data, len)) {
+        mRejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    packet->slot = slot;
+    packet->data.assign(data, data + len);
+    memcpy(packet->srcMac, srcMac, sizeof(mac_addr));
+    memcpy(packet->dstMac, dstMac, sizeof(mac_addr));
+    packet->periodMs = periodMs;
+
+    uint32_t hash = fnv1a(2166136261u, data, len);
+    hash = fnv1a(hash, srcMac, sizeof(mac_addr));
+    hash = fnv1a(hash, dstMac, sizeof(mac_addr));
+    packet->fingerprint = fnv1a(hash, (const uint8_t *) &periodMs, sizeof(periodMs));
+    return true;
+}
+
+bool KeepaliveManager::isProgrammed(const KeepalivePacket &packet) const
+{
+    std::map<int, KeepalivePacket>::const_iterator it = mRunning.find(packet.slot);
+    if (it == mRunning.end()) {
+        return false;
+    }
+    const KeepalivePacket &running = it->second;
+    return running.fingerprint == packet.fingerprint
+            && running.periodMs == packet.periodMs
+            && memcmp(running.srcMac, packet.srcMac, sizeof(mac_addr)) == 0
+            && memcmp(running.dstMac, packet.dstMac, sizeof(mac_addr)) == 0
+            && running.data == packet.data;
+}
+
+bool KeepaliveManager::isRunning(int slot) const
+{
+    return mRunning.find(slot) != mRunning.end();
+}
+
+bool KeepaliveManager::hasRoom(int slot) const
+{
+    return isRunning(slot) || mRunning.size() < kMaxSlots;
+}
+
+void KeepaliveManager::setProgrammed(const KeepalivePacket &packet)
+{
+    mRunning[packet.slot] = packet;
+    mActive.store(mRunning.size(), std::memory_order_relaxed);
+    mStarted.fetch_add(1, std::memory_order_relaxed);
+}
+
+void KeepaliveManager::setStopped(int slot)
+{
+    if (mRunning.erase(slot) > 0) {
+        mActive.store(mRunning.size(), std::memory_order_relaxed);
+        mStopped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void KeepaliveManager::countUnchanged()
+{
+    mUnchanged.fetch_add(1, std::memory_order_relaxed);
+}
+
+void KeepaliveManager::countRejected()
+{
+    mRejected.fetch_add(1, std::memory_order_relaxed);
+}
+
+void KeepaliveManager::getRunning(std::vector<int> &slots) const
+{
+    slots.clear();
+    for (std::map<int, KeepalivePacket>::const_iterator it = mRunning.begin();
+            it != mRunning.end(); ++it) {
+        slots.push_back(it->first);
+    }
+}
+
+void KeepaliveManager::getStats(int stats[KEEPALIVE_STATS_NUM]) const
+{
+    stats[KEEPALIVE_STATS_ACTIVE] = mActive.load(std::memory_order_relaxed);
+    stats[KEEPALIVE_STATS_CAPACITY] = kMaxSlots;
+    stats[KEEPALIVE_STATS_STARTED] = mStarted.load(std::memory_order_relaxed);
+    stats[KEEPALIVE_STATS_STOPPED] = mStopped.load(std::memory_order_relaxed);
+    stats[KEEPALIVE_STATS_UNCHANGED] = mUnchanged.load(std::memory_order_relaxed);
+    stats[KEEPALIVE_STATS_REJECTED] = mRejected.load(std::memory_order_relaxed);
+}
+
+void KeepaliveManager::reset()
+{
+    mRunning.clear();
+    mActive.store(0, std::memory_order_relaxed);
+}
+
+}; // namespace android
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_KEEPALIVE_H__
+#define __WIFI_KEEPALIVE_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <vector>
+
+#include "wifi_hal.h"
+#include "gscan.h"
+
+namespace android {
+
+/* a keepalive packet checked and laid out the way the HAL takes it */
+struct KeepalivePacket {
+    int slot;
+    std::vector<uint8_t> data;          /* the IP packet */
+    mac_addr srcMac;
+    mac_addr dstMac;
+    uint32_t periodMs;
+    uint32_t fingerprint;               /* of all of the above, to spot changes cheaply */
+};
+
+/* indices into the array getStats fills */
+enum {
+    KEEPALIVE_STATS_ACTIVE,             /* slots the firmware is sending now */
+    KEEPALIVE_STATS_CAPACITY,
+    KEEPALIVE_STATS_STARTED,            /* times a slot was programmed */
+    KEEPALIVE_STATS_STOPPED,
+    KEEPALIVE_STATS_UNCHANGED,          /* starts skipped as the slot already sent that */
+    KEEPALIVE_STATS_REJECTED,           /* malformed packets, or no slot left */
+    KEEPALIVE_STATS_NUM
+};
+
+/*
+ * Keeps track of the keepalive packets the firmware is sending, by slot, so that a batch of
+ * them can be started or stopped together and a slot is only programmed again when its
+ * packet, addresses or period changed. Makes no HAL calls itself. Not thread safe; callers
+ * hold their own lock, except around getStats and the count methods, whose counters are
+ * atomics so that stats never wait on a HAL call made under that lock.
+ */
+class KeepaliveManager {
+public:
+    static const size_t kMaxSlots = 16;
+    static const size_t kMaxPacketLength = 1500;
+
+    KeepaliveManager();
+
+    /*
+     * Checks that data is exactly one IPv4 packet with a correct header checksum, or one
+     * IPv6 packet, whose length fields agree with len.
+     */
+    static bool validatePacket(const uint8_t *data, size_t len);
+
+    /* validates and fills in packet; returns false, counting a rejection, if it is invalid */
+    bool prepare(int slot, const uint8_t *data, size_t len, const mac_addr srcMac,
+            const mac_addr dstMac, uint32_t periodMs, KeepalivePacket *packet);
+
+    /* true if slot is running and sending exactly packet */
+    bool isProgrammed(const KeepalivePacket &packet) const;
+    bool isRunning(int slot) const;
+
+    /* true if packet's slot is running, or another slot can be started */
+    bool hasRoom(int slot) const;
+
+    void setProgrammed(const KeepalivePacket &packet);
+    void setStopped(int slot);
+    void countUnchanged();
+    void countRejected();
+
+    /* the slots running now, in order */
+    void getRunning(std::vector<int> &slots) const;
+
+    void getStats(int stats[KEEPALIVE_STATS_NUM]) const;
+
+    /* forgets every slot without counting it as stopped, for when the HAL went away */
+    void reset();
+
+private:
+    std::map<int, KeepalivePacket> mRunning;
+    std::atomic<int> mActive;           /* mRunning.size(), for getStats */
+    std::atomic<int> mStarted;
+    std::atomic<int> mStopped;
+    std::atomic<int> mUnchanged;
+    std::atomic<int> mRejected;
+};
+
+}
+
+#endif //__WIFI_KEEPALIVE_H__
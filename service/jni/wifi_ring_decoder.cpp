@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "wifi_ring_decoder.h"
+
+namespace android {
+
+bool RingRecordDecoder::next(RingRecord *record)
+{
+    wifi_ring_buffer_entry entry;
+    if (mSize - mOffset < sizeof(entry)) {
+        return false;
+    }
+
+    memcpy(&entry, mBuffer + mOffset, sizeof(entry));
+    size_t length = sizeof(entry) + entry.entry_size;
+    if (length > mSize - mOffset) {
+        return false;
+    }
+
+    const char *payload = mBuffer + mOffset + sizeof(entry);
+
+    record->timestamp = (entry.flags & RING_BUFFER_ENTRY_FLAGS_HAS_TIMESTAMP) ?
+            entry.timestamp : 0;
+    record->offset = mOffset;
+    record->length = length;
+    record->flags = entry.flags;
+    record->type = entry.type;
+    record->event = 0;
+    record->valid = validatePayload(entry.type, payload, entry.entry_size);
+
+    if (record->valid && (entry.type == ENTRY_TYPE_CONNECT_EVENT
+            || entry.type == ENTRY_TYPE_POWER_EVENT)) {
+        memcpy(&record->event, payload, sizeof(record->event));
+    }
+
+    mOffset += length;
+    return true;
+}
+
+bool RingRecordDecoder::validatePayload(uint8_t type, const char *payload, size_t size)
+{
+    switch (type) {
+        case ENTRY_TYPE_CONNECT_EVENT:
+        case ENTRY_TYPE_POWER_EVENT:
+            /* a u16 event id followed by tlv_log entries */
+            if (size < sizeof(uint16_t)) {
+                return false;
+            }
+            return validateTlvs(payload + sizeof(uint16_t), size - sizeof(uint16_t));
+
+        case ENTRY_TYPE_WAKE_LOCK:
+            return size >= sizeof(wake_lock_event);
+
+        default:
+            /* packet, data and vendor entries are opaque */
+            return true;
+    }
+}
+
+bool RingRecordDecoder::validateTlvs(const char *tlvs, size_t size)
+{
+    size_t offset = 0;
+    while (offset < size) {
+        tlv_log tlv;
+        if (size - offset < sizeof(tlv)) {
+            return false;
+        }
+
+        memcpy(&tlv, tlvs + offset, sizeof(tlv));
+        if (tlv.length > size - offset - sizeof(tlv)) {
+            return false;
+        }
+
+        offset += sizeof(tlv) + tlv.length;
+    }
+
+    return true;
+}
+
+}; // namespace android
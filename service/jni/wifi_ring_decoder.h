@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_RING_DECODER_H__
+#define __WIFI_RING_DECODER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "wifi_hal.h"
+
+namespace android {
+
+/* one wifi_ring_buffer_entry record, as located by RingRecordDecoder */
+struct RingRecord {
+    uint64_t timestamp;         /* 0 unless RING_BUFFER_ENTRY_FLAGS_HAS_TIMESTAMP is set */
+    uint32_t offset;            /* offset of the entry header in the decoded buffer */
+    uint32_t length;            /* header and payload */
+    uint8_t flags;
+    uint8_t type;
+    uint16_t event;             /* event id of connectivity and power events, 0 otherwise */
+    bool valid;                 /* false if the payload does not match its type */
+};
+
+/*
+ * Walks the wifi_ring_buffer_entry records delivered by on_ring_buffer_data without copying
+ * them. The entry headers delimit the records, so decoding stops at the first header whose
+ * entry_size runs past the end of the buffer; a record whose payload is malformed is still
+ * returned, with valid cleared, since the records after it can be located.
+ */
+class RingRecordDecoder {
+public:
+    RingRecordDecoder(const char *buffer, size_t size)
+        : mBuffer(buffer), mSize(size), mOffset(0) {
+    }
+
+    /* returns false once no further complete record is left */
+    bool next(RingRecord *record);
+
+    /* bytes that could not be decoded; only meaningful once next() returned false */
+    size_t remaining() const {
+        return mSize - mOffset;
+    }
+
+    static bool validatePayload(uint8_t type, const char *payload, size_t size);
+
+private:
+    static bool validateTlvs(const char *tlvs, size_t size);
+
+    const char *mBuffer;
+    size_t mSize;
+    size_t mOffset;
+};
+
+}
+
+#endif //__WIFI_RING_DECODER_H__
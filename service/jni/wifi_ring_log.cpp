@@ -0,0 +1,421 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "wifi"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include "wifi_ring_log.h"
+
+namespace android {
+
+static const size_t kEntryHeaderSize = sizeof(wifi_ring_buffer_entry);
+
+/*
+ * Ring names come from the firmware; keep them from escaping the log directory. Files are
+ * named, and their headers hold, the sanitized name. Returns its length.
+ */
+static size_t sanitizeRingName(const char *name, char *out, size_t size)
+{
+    size_t i = 0;
+    for (; name[i] != 0 && i < size - 1; i++) {
+        char ch = name[i];
+        bool ok = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+                (ch >= '0' && ch <= '9') || ch == '_' || ch == '-';
+        out[i] = ok ? ch : '_';
+    }
+    out[i] = 0;
+    return i;
+}
+
+RingLogFile::RingLogFile(int fd, void *map, size_t mapSize)
+    : mFd(fd), mMap(map), mMapSize(mapSize), mNewestTimestamp(0)
+{
+    mHeader = (RingLogHeader *)mMap;
+    mData = (char *)mMap + sizeof(RingLogHeader);
+}
+
+RingLogFile::~RingLogFile()
+{
+    munmap(mMap, mMapSize);
+    close(mFd);
+}
+
+RingLogFile *RingLogFile::open(const char *dir, const char *name, uint32_t capacity)
+{
+    char safeName[sizeof(((RingLogHeader *)0)->name)];
+    if (sanitizeRingName(name, safeName, sizeof(safeName)) == 0
+            || capacity < kEntryHeaderSize) {
+        ALOGE("invalid ring log %s, capacity %u", name, capacity);
+        return NULL;
+    }
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.ring", dir, safeName);
+
+    int fd = TEMP_FAILURE_RETRY(::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0660));
+    if (fd < 0) {
+        ALOGE("could not open %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    size_t mapSize = sizeof(RingLogHeader) + capacity;
+    if (ftruncate(fd, mapSize) != 0) {
+        ALOGE("could not size %s: %s", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        ALOGE("could not map %s: %s", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    RingLogFile *file = new RingLogFile(fd, map, mapSize);
+    if (!file->isValid(capacity) || !file->rebuildIndex()) {
+        ALOGD("initializing ring log %s", path);
+        file->reset(safeName, capacity);
+    }
+    return file;
+}
+
+bool RingLogFile::isValid(uint32_t capacity) const
+{
+    const RingLogHeader &h = *mHeader;
+    if (h.magic != kMagic || h.version != kVersion || h.headerSize != sizeof(RingLogHeader)
+            || h.capacity != capacity) {
+        return false;
+    }
+
+    if (h.head >= capacity || h.tail >= capacity || h.used > capacity
+            || h.totalRecords - h.evictedRecords != h.records) {
+        return false;
+    }
+
+    return ((uint64_t)h.tail + h.used) % capacity == h.head;
+}
+
+void RingLogFile::reset(const char *name, uint32_t capacity)
+{
+    clearIndex();
+    memset(mHeader, 0, sizeof(RingLogHeader));
+    mHeader->magic = kMagic;
+    mHeader->version = kVersion;
+    mHeader->headerSize = sizeof(RingLogHeader);
+    mHeader->capacity = capacity;
+    mHeader->ringId = -1;
+    strlcpy(mHeader->name, name, sizeof(mHeader->name));
+}
+
+void RingLogFile::copyOut(uint32_t offset, void *dst, size_t len) const
+{
+    size_t first = mHeader->capacity - offset;
+    if (first >= len) {
+        memcpy(dst, mData + offset, len);
+    } else {
+        memcpy(dst, mData + offset, first);
+        memcpy((char *)dst + first, mData, len - first);
+    }
+}
+
+void RingLogFile::copyIn(const void *src, size_t len)
+{
+    uint32_t head = mHeader->head;
+    size_t first = mHeader->capacity - head;
+    if (first > len) {
+        memcpy(mData + head, src, len);
+        mHeader->head = head + len;
+    } else {
+        memcpy(mData + head, src, first);
+        memcpy(mData, (const char *)src + first, len - first);
+        mHeader->head = len - first;
+        mHeader->wraps++;
+    }
+}
+
+bool RingLogFile::evictOldest()
+{
+    RingLogHeader &h = *mHeader;
+    if (h.records == 0 || h.used < kEntryHeaderSize) {
+        h.tail = h.head;
+        h.used = 0;
+        h.records = 0;
+        h.evictedRecords = h.totalRecords;
+        clearIndex();
+        return false;
+    }
+
+    wifi_ring_buffer_entry entry;
+    copyOut(h.tail, &entry, kEntryHeaderSize);
+
+    size_t len = kEntryHeaderSize + entry.entry_size;
+    if (len > h.used) {
+        /* only possible if the file was corrupted behind our back */
+        ALOGE("corrupted ring log %s, discarding it", h.name);
+        h.tail = h.head;
+        h.used = 0;
+        h.records = 0;
+        h.evictedRecords = h.totalRecords;
+        clearIndex();
+        return false;
+    }
+
+    std::deque<IndexEntry> &index = mIndex[indexBucket(entry.type)];
+    if (!index.empty() && index.front().seq == h.evictedRecords) {
+        index.pop_front();
+    }
+
+    h.tail = (h.tail + len) % h.capacity;
+    h.used -= len;
+    h.records--;
+    h.evictedRecords++;
+    return true;
+}
+
+size_t RingLogFile::append(const char *buffer, size_t size,
+        const wifi_ring_buffer_status *status, bool *wrapped)
+{
+    RingLogHeader &h = *mHeader;
+    uint32_t wraps = h.wraps;
+    size_t stored = 0;
+
+    if (status != NULL) {
+        h.ringId = status->ring_id;
+        h.ringFlags = status->flags;
+    }
+
+    RingRecordDecoder decoder(buffer, size);
+    RingRecord record;
+    while (decoder.next(&record)) {
+        if (!record.valid || record.length > h.capacity) {
+            h.droppedBytes += record.length;
+            continue;
+        }
+
+        while (h.capacity - h.used < record.length && evictOldest()) {
+        }
+
+        uint32_t offset = h.head;
+        copyIn(buffer + record.offset, record.length);
+        indexRecord(record, h.totalRecords, offset);
+        h.used += record.length;
+        h.records++;
+        h.totalRecords++;
+        h.totalBytes += record.length;
+        stored += record.length;
+    }
+
+    if (decoder.remaining() > 0) {
+        ALOGD("ring log %s: dropping %zu bytes of truncated data", h.name, decoder.remaining());
+        h.droppedBytes += decoder.remaining();
+    }
+
+    if (wrapped != NULL) {
+        *wrapped = (h.wraps != wraps);
+    }
+    return stored;
+}
+
+void RingLogFile::read(std::vector<char> &out) const
+{
+    out.resize(mHeader->used);
+    if (mHeader->used > 0) {
+        copyOut(mHeader->tail, &out[0], mHeader->used);
+    }
+}
+
+void RingLogFile::indexRecord(const RingRecord &record, uint64_t seq, uint32_t offset)
+{
+    /* records without a timestamp, or with one going backwards, sort with their predecessor */
+    if (record.timestamp > mNewestTimestamp) {
+        mNewestTimestamp = record.timestamp;
+    }
+
+    IndexEntry entry;
+    entry.seq = seq;
+    entry.timestamp = mNewestTimestamp;
+    entry.offset = offset;
+    entry.length = record.length;
+    mIndex[indexBucket(record.type)].push_back(entry);
+}
+
+void RingLogFile::clearIndex()
+{
+    for (int i = 0; i < kIndexTypes; i++) {
+        mIndex[i].clear();
+    }
+    mNewestTimestamp = 0;
+}
+
+bool RingLogFile::rebuildIndex()
+{
+    const RingLogHeader &h = *mHeader;
+    std::vector<char> records;
+    read(records);
+
+    clearIndex();
+
+    uint64_t seq = h.evictedRecords;
+    RingRecordDecoder decoder(records.empty() ? NULL : &records[0], records.size());
+    RingRecord record;
+    while (decoder.next(&record)) {
+        if (!record.valid) {
+            return false;
+        }
+        indexRecord(record, seq++, (h.tail + record.offset) % h.capacity);
+    }
+
+    return decoder.remaining() == 0 && seq == h.totalRecords;
+}
+
+bool RingLogFile::compareTimestamp(const uint64_t &timestamp, const IndexEntry &entry)
+{
+    return timestamp <= entry.timestamp;
+}
+
+bool RingLogFile::compareSeq(const IndexEntry *a, const IndexEntry *b)
+{
+    return a->seq < b->seq;
+}
+
+void RingLogFile::query(uint32_t typeMask, uint64_t start, uint64_t end,
+        std::vector<char> &out) const
+{
+    std::vector<const IndexEntry *> hits;
+    size_t total = 0;
+
+    for (int i = 0; i < kIndexTypes; i++) {
+        if ((typeMask & (1 << i)) == 0) {
+            continue;
+        }
+
+        const std::deque<IndexEntry> &index = mIndex[i];
+        std::deque<IndexEntry>::const_iterator it =
+                std::upper_bound(index.begin(), index.end(), start, compareTimestamp);
+        for (; it != index.end() && it->timestamp <= end; ++it) {
+            hits.push_back(&*it);
+            total += it->length;
+        }
+    }
+
+    std::sort(hits.begin(), hits.end(), compareSeq);
+
+    out.resize(total);
+    size_t offset = 0;
+    for (size_t i = 0; i < hits.size(); i++) {
+        copyOut(hits[i]->offset, &out[offset], hits[i]->length);
+        offset += hits[i]->length;
+    }
+}
+
+RingLogSink::RingLogSink(const char *dir, uint32_t bytesPerRing)
+    : mBytesPerRing(bytesPerRing)
+{
+    strlcpy(mDir, dir, sizeof(mDir));
+    if (mkdir(mDir, 0770) != 0 && errno != EEXIST) {
+        ALOGE("could not create %s: %s", mDir, strerror(errno));
+    }
+}
+
+RingLogSink::~RingLogSink()
+{
+    for (size_t i = 0; i < mRings.size(); i++) {
+        delete mRings[i];
+    }
+}
+
+RingLogFile *RingLogSink::findLocked(const char *ringName, bool create)
+{
+    /* the files know their rings by the sanitized name only */
+    char safeName[sizeof(((RingLogHeader *)0)->name)];
+    sanitizeRingName(ringName, safeName, sizeof(safeName));
+    for (size_t i = 0; i < mRings.size(); i++) {
+        if (strcmp(mRings[i]->name(), safeName) == 0) {
+            return mRings[i];
+        }
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    RingLogFile *file = RingLogFile::open(mDir, ringName, mBytesPerRing);
+    if (file != NULL) {
+        mRings.push_back(file);
+    }
+    return file;
+}
+
+size_t RingLogSink::append(const char *ringName, const char *buffer, size_t size,
+        const wifi_ring_buffer_status *status, bool *wrapped)
+{
+    Mutex::Autolock lock(mLock);
+
+    *wrapped = false;
+    RingLogFile *file = findLocked(ringName, true);
+    if (file == NULL) {
+        return 0;
+    }
+
+    return file->append(buffer, size, status, wrapped);
+}
+
+bool RingLogSink::read(const char *ringName, std::vector<char> &out)
+{
+    Mutex::Autolock lock(mLock);
+
+    /* a ring from a previous run is still on disk even if nothing was logged yet */
+    RingLogFile *file = findLocked(ringName, true);
+    if (file == NULL) {
+        return false;
+    }
+
+    file->read(out);
+    return true;
+}
+
+bool RingLogSink::query(const char *ringName, uint32_t typeMask, int64_t start, int64_t end,
+        std::vector<char> &out)
+{
+    Mutex::Autolock lock(mLock);
+
+    RingLogFile *file = findLocked(ringName, true);
+    if (file == NULL) {
+        return false;
+    }
+
+    uint64_t from = start;
+    if (start < 0) {
+        uint64_t newest = file->newestTimestamp();
+        from = (uint64_t)-start < newest ? newest - (uint64_t)-start : 0;
+    }
+
+    /* a negative end leaves the range open up to the newest record */
+    file->query(typeMask, from, end < 0 ? UINT64_MAX : (uint64_t)end, out);
+    return true;
+}
+
+}; // namespace android
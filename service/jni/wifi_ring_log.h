@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_RING_LOG_H__
+#define __WIFI_RING_LOG_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <vector>
+#include <utils/Mutex.h>
+
+#include "wifi_hal.h"
+#include "wifi_ring_decoder.h"
+
+namespace android {
+
+/*
+ * Firmware ring buffer records are kept in one memory mapped file per ring. The file starts
+ * with a RingLogHeader and is followed by a circular data area holding whole
+ * wifi_ring_buffer_entry records; the oldest records are evicted to make room for new ones.
+ * Since the file is mapped shared, its contents survive a restart of the wifi stack.
+ *
+ * Records are numbered in the order they were appended: the live ones are numbered from
+ * evictedRecords up to totalRecords.
+ */
+struct RingLogHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t capacity;          /* size of the data area */
+    uint32_t head;              /* offset at which the next record is written */
+    uint32_t tail;              /* offset of the oldest record */
+    uint32_t used;              /* bytes held between tail and head */
+    uint32_t records;           /* records held between tail and head */
+    uint32_t wraps;             /* number of times head went past the end of the data area */
+    uint64_t totalBytes;        /* bytes appended since the file was created */
+    uint64_t totalRecords;
+    uint64_t evictedRecords;
+    uint64_t droppedBytes;      /* malformed or oversized input that was not stored */
+    int32_t ringId;
+    uint32_t ringFlags;
+    char name[32];
+};
+
+class RingLogFile {
+public:
+    static const uint32_t kMagic = 0x474c5257;     /* "WRLG" */
+    static const uint16_t kVersion = 1;
+
+    static RingLogFile *open(const char *dir, const char *name, uint32_t capacity);
+    ~RingLogFile();
+
+    /*
+     * Appends the wifi_ring_buffer_entry records in buffer. Returns the number of bytes
+     * stored; wrapped is set if the write position went past the end of the data area.
+     */
+    size_t append(const char *buffer, size_t size, const wifi_ring_buffer_status *status,
+            bool *wrapped);
+
+    /* copies held records, oldest first, into out */
+    void read(std::vector<char> &out) const;
+
+    /*
+     * Copies held records, oldest first, whose type is set in typeMask (bit n selects
+     * ENTRY_TYPE n) and whose timestamp lies within [start, end]. Uses the index only;
+     * nothing outside the selected records is decoded.
+     */
+    void query(uint32_t typeMask, uint64_t start, uint64_t end, std::vector<char> &out) const;
+
+    /* timestamp of the most recent record, in the units the firmware uses */
+    uint64_t newestTimestamp() const {
+        return mNewestTimestamp;
+    }
+
+    const char *name() const {
+        return mHeader->name;
+    }
+    const RingLogHeader &header() const {
+        return *mHeader;
+    }
+
+private:
+    RingLogFile(int fd, void *map, size_t mapSize);
+
+    bool isValid(uint32_t capacity) const;
+    void reset(const char *name, uint32_t capacity);
+    void copyOut(uint32_t offset, void *dst, size_t len) const;
+    void copyIn(const void *src, size_t len);
+    bool evictOldest();
+    bool rebuildIndex();
+    void indexRecord(const RingRecord &record, uint64_t seq, uint32_t offset);
+    void clearIndex();
+
+    /* records of types the index does not know about share bucket 0 */
+    static const int kIndexTypes = 8;
+    static int indexBucket(uint8_t type) {
+        return type < kIndexTypes ? type : 0;
+    }
+
+    struct IndexEntry {
+        uint64_t seq;
+        uint64_t timestamp;     /* never decreases within a bucket */
+        uint32_t offset;        /* in the data area */
+        uint32_t length;
+    };
+
+    static bool compareTimestamp(const uint64_t &timestamp, const IndexEntry &entry);
+    static bool compareSeq(const IndexEntry *a, const IndexEntry *b);
+
+    int mFd;
+    void *mMap;
+    size_t mMapSize;
+    RingLogHeader *mHeader;
+    char *mData;
+    std::deque<IndexEntry> mIndex[kIndexTypes];
+    uint64_t mNewestTimestamp;
+
+    RingLogFile(const RingLogFile&);
+    RingLogFile& operator = (const RingLogFile&);
+};
+
+/* owns the per ring files and serializes the HAL callback thread against readers */
+class RingLogSink {
+public:
+    RingLogSink(const char *dir, uint32_t bytesPerRing);
+    ~RingLogSink();
+
+    size_t append(const char *ringName, const char *buffer, size_t size,
+            const wifi_ring_buffer_status *status, bool *wrapped);
+
+    /* returns false if the log for ringName could not be opened */
+    bool read(const char *ringName, std::vector<char> &out);
+
+    /*
+     * See RingLogFile::query; a negative start is taken relative to the newest record, and a
+     * negative end means up to the newest record.
+     */
+    bool query(const char *ringName, uint32_t typeMask, int64_t start, int64_t end,
+            std::vector<char> &out);
+
+private:
+    RingLogFile *findLocked(const char *ringName, bool create);
+
+    Mutex mLock;
+    char mDir[128];
+    uint32_t mBytesPerRing;
+    std::vector<RingLogFile *> mRings;
+};
+
+}
+
+#endif //__WIFI_RING_LOG_H__
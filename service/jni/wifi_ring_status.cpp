@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "wifi"
+
+#include <string.h>
+#include <utils/Log.h>
+
+#include "wifi_ring_status.h"
+
+namespace android {
+
+RingStatusTable::RingStatusTable()
+    : mQueried(false), mThreshold(0)
+{
+}
+
+void RingStatusTable::set(const wifi_ring_buffer_status *status, uint32_t num_rings)
+{
+    Mutex::Autolock lock(mLock);
+
+    std::vector<Entry> rings(num_rings);
+    for (u32 i = 0; i < num_rings; i++) {
+        Entry &entry = rings[i];
+        entry.status = status[i];
+        entry.status.name[sizeof(entry.status.name) - 1] = 0;
+
+        /* keep the notification state of rings we already knew */
+        Entry *old = findLocked(entry.status.ring_id);
+        if (old != NULL) {
+            entry.notifiedWrittenBytes = old->notifiedWrittenBytes;
+            entry.notifiedReadBytes = old->notifiedReadBytes;
+            entry.logBytes = old->logBytes;
+            entry.logWrapped = old->logWrapped;
+        } else {
+            entry.notifiedWrittenBytes = entry.status.written_bytes;
+            entry.notifiedReadBytes = entry.status.read_bytes;
+            entry.logBytes = 0;
+            entry.logWrapped = false;
+        }
+    }
+
+    mRings.swap(rings);
+    mQueried = true;
+    ALOGD("ring status table holds %zu rings", mRings.size());
+}
+
+bool RingStatusTable::isQueried()
+{
+    Mutex::Autolock lock(mLock);
+    return mQueried;
+}
+
+void RingStatusTable::clear()
+{
+    Mutex::Autolock lock(mLock);
+    mRings.clear();
+    mQueried = false;
+}
+
+void RingStatusTable::setThreshold(uint32_t bytes)
+{
+    Mutex::Autolock lock(mLock);
+    mThreshold = bytes;
+}
+
+RingStatusTable::Entry *RingStatusTable::findLocked(wifi_ring_buffer_id id)
+{
+    for (size_t i = 0; i < mRings.size(); i++) {
+        if (mRings[i].status.ring_id == id) {
+            return &mRings[i];
+        }
+    }
+    return NULL;
+}
+
+uint32_t RingStatusTable::thresholdLocked(const Entry &entry) const
+{
+    if (mThreshold != 0) {
+        return mThreshold;
+    }
+
+    uint32_t quarter = entry.status.ring_buffer_byte_size / 4;
+    return quarter > kMinThreshold ? quarter : kMinThreshold;
+}
+
+bool RingStatusTable::update(const wifi_ring_buffer_status *status, uint32_t logBytes,
+        bool logWrapped, RingStatusChange *change)
+{
+    Mutex::Autolock lock(mLock);
+
+    Entry *entry = findLocked(status->ring_id);
+    if (entry == NULL) {
+        /* a ring the HAL did not list; start tracking it from here */
+        Entry added;
+        added.notifiedWrittenBytes = status->written_bytes;
+        added.notifiedReadBytes = status->read_bytes;
+        added.logBytes = 0;
+        added.logWrapped = false;
+        mRings.push_back(added);
+        entry = &mRings.back();
+    }
+
+    entry->status = *status;
+    entry->status.name[sizeof(entry->status.name) - 1] = 0;
+    entry->logBytes += logBytes;
+    entry->logWrapped |= logWrapped;
+
+    /* the counters are free running u32s, so unsigned differences survive wrap around */
+    uint32_t threshold = thresholdLocked(*entry);
+    if (status->written_bytes - entry->notifiedWrittenBytes < threshold
+            && status->read_bytes - entry->notifiedReadBytes < threshold
+            && !entry->logWrapped) {
+        return false;
+    }
+
+    change->status = entry->status;
+    change->logBytes = entry->logBytes;
+    change->logWrapped = entry->logWrapped;
+
+    entry->notifiedWrittenBytes = status->written_bytes;
+    entry->notifiedReadBytes = status->read_bytes;
+    entry->logBytes = 0;
+    entry->logWrapped = false;
+    return true;
+}
+
+void RingStatusTable::snapshot(std::vector<wifi_ring_buffer_status> &out)
+{
+    Mutex::Autolock lock(mLock);
+
+    out.resize(mRings.size());
+    for (size_t i = 0; i < mRings.size(); i++) {
+        out[i] = mRings[i].status;
+    }
+}
+
+}; // namespace android
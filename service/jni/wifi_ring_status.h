@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_RING_STATUS_H__
+#define __WIFI_RING_STATUS_H__
+
+#include <stdint.h>
+#include <vector>
+#include <utils/Mutex.h>
+
+#include "wifi_hal.h"
+
+namespace android {
+
+/* what on_ring_buffer_data reports once a ring crossed its notification threshold */
+struct RingStatusChange {
+    wifi_ring_buffer_status status;
+    uint32_t logBytes;          /* bytes the ring log sink stored since the last notification */
+    bool logWrapped;            /* whether its file wrapped since the last notification */
+};
+
+/*
+ * Keeps the status of every firmware ring. The table is filled from the HAL once and then
+ * kept current from the status that comes with each on_ring_buffer_data callback, so that
+ * Java does not need to poll wifi_get_ring_buffers_status.
+ */
+class RingStatusTable {
+public:
+    RingStatusTable();
+
+    /* replaces the table with what wifi_get_ring_buffers_status returned */
+    void set(const wifi_ring_buffer_status *status, uint32_t num_rings);
+
+    /*
+     * Whether the table was filled from the HAL since it was last cleared. Callbacks may
+     * have added rings before that, but those need not be all the rings there are.
+     */
+    bool isQueried();
+    void clear();
+
+    /* a threshold of 0 notifies every quarter of each ring's size */
+    void setThreshold(uint32_t bytes);
+
+    /*
+     * Records the status delivered with a ring buffer callback, along with what the ring
+     * log sink stored for it. Returns true, and fills in change, once the written or read
+     * counter of the ring moved by the threshold since its last notification or its log
+     * file wrapped.
+     */
+    bool update(const wifi_ring_buffer_status *status, uint32_t logBytes, bool logWrapped,
+            RingStatusChange *change);
+
+    void snapshot(std::vector<wifi_ring_buffer_status> &out);
+
+private:
+    static const uint32_t kMinThreshold = 4096;
+
+    struct Entry {
+        wifi_ring_buffer_status status;
+        uint32_t notifiedWrittenBytes;
+        uint32_t notifiedReadBytes;
+        uint32_t logBytes;
+        bool logWrapped;
+    };
+
+    Entry *findLocked(wifi_ring_buffer_id id);
+    uint32_t thresholdLocked(const Entry &entry) const;
+
+    Mutex mLock;
+    std::vector<Entry> mRings;
+    bool mQueried;
+    uint32_t mThreshold;
+};
+
+}
+
+#endif //__WIFI_RING_STATUS_H__
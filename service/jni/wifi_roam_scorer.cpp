@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <string.h>
+
+#include "wifi_roam_scorer.h"
+
+namespace android {
+
+static uint64_t bssidKey(const mac_addr bssid)
+{
+    uint64_t key = 0;
+    for (int i = 0; i < 6; i++) {
+        key = (key << 8) | bssid[i];
+    }
+    return key;
+}
+
+static inline bool is5GHz(wifi_channel frequency)
+{
+    return frequency >= 4900 && frequency < 5900;
+}
+
+void RoamScorer::clear()
+{
+    memset(&mParams, 0, sizeof(mParams));
+    mBlacklist.clear();
+    mPreferences.clear();
+}
+
+void RoamScorer::setParams(const wifi_roam_params &params)
+{
+    mParams = params;
+}
+
+void RoamScorer::setBlacklist(const mac_addr *bssids, int numBssids)
+{
+    mBlacklist.clear();
+    for (int i = 0; i < numBssids; i++) {
+        mBlacklist.push_back(bssidKey(bssids[i]));
+    }
+    std::sort(mBlacklist.begin(), mBlacklist.end());
+}
+
+void RoamScorer::setPreferences(const wifi_bssid_preference *prefs, int numPrefs)
+{
+    mPreferences.clear();
+    for (int i = 0; i < numPrefs; i++) {
+        Preference preference = { bssidKey(prefs[i].bssid), prefs[i].rssi_modifier };
+        mPreferences.push_back(preference);
+    }
+    /* insertion sort; a handful of BSSIDs, and the last one set for a BSSID wins */
+    for (size_t i = 1; i < mPreferences.size(); i++) {
+        Preference preference = mPreferences[i];
+        size_t j = i;
+        while (j > 0 && mPreferences[j - 1].bssid > preference.bssid) {
+            mPreferences[j] = mPreferences[j - 1];
+            j--;
+        }
+        mPreferences[j] = preference;
+    }
+}
+
+int RoamScorer::preferenceOf(uint64_t bssid) const
+{
+    int modifier = 0;
+    for (size_t i = 0; i < mPreferences.size() && mPreferences[i].bssid <= bssid; i++) {
+        if (mPreferences[i].bssid == bssid) {
+            modifier = mPreferences[i].modifier;
+        }
+    }
+    return modifier;
+}
+
+/* orders candidate indices best first */
+class CandidateOrder {
+public:
+    CandidateOrder(const std::vector<int32_t> &score, const std::vector<int32_t> &rssi,
+            const std::vector<uint64_t> &bssid)
+        : mScore(score), mRssi(rssi), mBssid(bssid) {
+    }
+
+    bool operator()(int a, int b) const {
+        if (mScore[a] != mScore[b]) {
+            return mScore[a] > mScore[b];
+        }
+        if (mRssi[a] != mRssi[b]) {
+            return mRssi[a] > mRssi[b];
+        }
+        return mBssid[a] < mBssid[b];
+    }
+
+private:
+    const std::vector<int32_t> &mScore;
+    const std::vector<int32_t> &mRssi;
+    const std::vector<uint64_t> &mBssid;
+};
+
+int RoamScorer::rank(const wifi_scan_result *results, int numResults, const char *ssid,
+        const mac_addr current, int max, RoamCandidate *out) const
+{
+    uint64_t currentKey = current != NULL ? bssidKey(current) : UINT64_MAX;
+
+    /* gather the candidates into columns, so that scoring them is plain array arithmetic */
+    std::vector<int> source;
+    std::vector<uint64_t> bssid;
+    std::vector<int32_t> rssi, band5, hysteresis, preference;
+    for (int i = 0; i < numResults; i++) {
+        const wifi_scan_result &result = results[i];
+        if (ssid != NULL && strncmp(result.ssid, ssid, sizeof(result.ssid)) != 0) {
+            continue;
+        }
+        uint64_t key = bssidKey(result.bssid);
+        if (std::binary_search(mBlacklist.begin(), mBlacklist.end(), key)) {
+            continue;
+        }
+        source.push_back(i);
+        bssid.push_back(key);
+        rssi.push_back(result.rssi);
+        band5.push_back(is5GHz(result.channel));
+        hysteresis.push_back(key == currentKey ? mParams.lazy_roam_hysteresis : 0);
+        preference.push_back(preferenceOf(key));
+    }
+
+    int n = source.size();
+    std::vector<int32_t> bandBoost(n), score(n);
+    const int32_t boostThreshold = mParams.A_band_boost_threshold;
+    const int32_t boostFactor = mParams.A_band_boost_factor;
+    const int32_t maxBoost = mParams.A_band_max_boost;
+    const int32_t penaltyThreshold = mParams.A_band_penalty_threshold;
+    const int32_t penaltyFactor = mParams.A_band_penalty_factor;
+    for (int i = 0; i < n; i++) {
+        int32_t r = rssi[i] + hysteresis[i];
+        int32_t boost = std::min(boostFactor * (r - boostThreshold), maxBoost);
+        int32_t penalty = penaltyFactor * (r - penaltyThreshold);
+        int32_t b = r > boostThreshold ? boost : (r < penaltyThreshold ? penalty : 0);
+        bandBoost[i] = band5[i] ? b : 0;
+        score[i] = r + bandBoost[i] + preference[i];
+    }
+
+    std::vector<int> order(n);
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    int count = std::max(std::min(n, max), 0);
+    std::partial_sort(order.begin(), order.begin() + count, order.end(),
+            CandidateOrder(score, rssi, bssid));
+
+    for (int i = 0; i < count; i++) {
+        int c = order[i];
+        const wifi_scan_result &result = results[source[c]];
+        RoamCandidate &candidate = out[i];
+        memcpy(candidate.bssid, result.bssid, sizeof(mac_addr));
+        candidate.channel = result.channel;
+        candidate.rssi = rssi[c];
+        candidate.hysteresis = hysteresis[c];
+        candidate.bandBoost = bandBoost[c];
+        candidate.preference = preference[c];
+        candidate.score = score[c];
+    }
+    return count;
+}
+
+}; // namespace android
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_ROAM_SCORER_H__
+#define __WIFI_ROAM_SCORER_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "wifi_hal.h"
+#include "gscan.h"
+
+namespace android {
+
+struct RoamCandidate {
+    mac_addr bssid;
+    wifi_channel channel;
+    wifi_rssi rssi;
+    int hysteresis;             /* for being the current BSSID */
+    int bandBoost;              /* 5 GHz boost, or penalty if negative */
+    int preference;             /* rssi_modifier of its wifi_bssid_preference */
+    int score;                  /* sum of the above */
+};
+
+/*
+ * Ranks roam candidates the way lazy roam is specified to, from the same wifi_roam_params,
+ * BSSID blacklist and BSSID preferences the firmware is given, so that the framework gets
+ * the same ranking whether or not the HAL offloads lazy roam:
+ *
+ *   rssi' = rssi + lazy_roam_hysteresis if it is the current BSSID
+ *   on 5 GHz, above A_band_boost_threshold:
+ *       boost = min(A_band_boost_factor * (rssi' - A_band_boost_threshold), A_band_max_boost)
+ *   on 5 GHz, below A_band_penalty_threshold:
+ *       boost = A_band_penalty_factor * (rssi' - A_band_penalty_threshold)
+ *   score = rssi' + boost + rssi_modifier
+ *
+ * Blacklisted BSSIDs are never candidates. Ties go to the stronger signal, then the lower
+ * BSSID. Not thread safe; the bridge serializes configuring against ranking.
+ */
+class RoamScorer {
+public:
+    RoamScorer() {
+        clear();
+    }
+
+    void clear();
+
+    void setParams(const wifi_roam_params &params);
+    void setBlacklist(const mac_addr *bssids, int numBssids);
+    void setPreferences(const wifi_bssid_preference *prefs, int numPrefs);
+
+    /*
+     * Scores results whose SSID is ssid (any if NULL) and writes the best max of them to
+     * out, best first. current is the BSSID associated to, or NULL. Returns how many were
+     * written.
+     */
+    int rank(const wifi_scan_result *results, int numResults, const char *ssid,
+            const mac_addr current, int max, RoamCandidate *out) const;
+
+private:
+    struct Preference {
+        uint64_t bssid;
+        int modifier;
+    };
+
+    int preferenceOf(uint64_t bssid) const;
+
+    wifi_roam_params mParams;
+    std::vector<uint64_t> mBlacklist;       /* sorted */
+    std::vector<Preference> mPreferences;   /* sorted by BSSID */
+};
+
+}
+
+#endif //__WIFI_ROAM_SCORER_H__
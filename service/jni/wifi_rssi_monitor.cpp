@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "wifi_rssi_monitor.h"
+
+namespace android {
+
+static const s8 kMinRssi = -128;
+static const s8 kMaxRssi = 127;
+
+RssiMonitorMux::RssiMonitorMux()
+    : mRssi(kMinRssi), mIsProgrammed(false), mProgrammedId(0), mProgrammedMin(kMinRssi),
+      mProgrammedMax(kMaxRssi)
+{
+}
+
+void RssiMonitorMux::removeClient(int client)
+{
+    std::multimap<int, int>::iterator it = mThresholds.begin();
+    while (it != mThresholds.end()) {
+        if (it->second == client) {
+            mThresholds.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void RssiMonitorMux::setThresholds(int client, const s8 *thresholds, int numThresholds)
+{
+    removeClient(client);
+    for (int i = 0; i < numThresholds; i++) {
+        mThresholds.insert(std::make_pair((int) thresholds[i], client));
+    }
+}
+
+void RssiMonitorMux::clear()
+{
+    mThresholds.clear();
+}
+
+void RssiMonitorMux::getWindow(s8 rssi, s8 *minRssi, s8 *maxRssi) const
+{
+    std::multimap<int, int>::const_iterator above = mThresholds.upper_bound(rssi);
+    *maxRssi = above != mThresholds.end() ? above->first : kMaxRssi;
+    *minRssi = above != mThresholds.begin() ? (--above)->first : kMinRssi;
+}
+
+void RssiMonitorMux::setRssi(s8 rssi)
+{
+    mRssi = rssi;
+}
+
+void RssiMonitorMux::update(s8 rssi, std::vector<int> &crossed)
+{
+    /* thresholds t with low < t <= high separate the old RSSI from the new */
+    int low = std::min(mRssi, rssi);
+    int high = std::max(mRssi, rssi);
+    mRssi = rssi;
+
+    size_t first = crossed.size();
+    std::multimap<int, int>::const_iterator end = mThresholds.upper_bound(high);
+    for (std::multimap<int, int>::const_iterator it = mThresholds.upper_bound(low); it != end;
+            ++it) {
+        if (std::find(crossed.begin() + first, crossed.end(), it->second) == crossed.end()) {
+            crossed.push_back(it->second);
+        }
+    }
+}
+
+bool RssiMonitorMux::isProgrammed(s8 minRssi, s8 maxRssi) const
+{
+    return mIsProgrammed && mProgrammedMin == minRssi && mProgrammedMax == maxRssi;
+}
+
+void RssiMonitorMux::setProgrammed(wifi_request_id id, s8 minRssi, s8 maxRssi)
+{
+    mIsProgrammed = true;
+    mProgrammedId = id;
+    mProgrammedMin = minRssi;
+    mProgrammedMax = maxRssi;
+}
+
+void RssiMonitorMux::resetProgrammed()
+{
+    mIsProgrammed = false;
+    mProgrammedId = 0;
+}
+
+}; // namespace android
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_RSSI_MONITOR_H__
+#define __WIFI_RSSI_MONITOR_H__
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+#include "wifi_hal.h"
+
+namespace android {
+
+/*
+ * Shares the single HAL RSSI monitor between clients that each have their own thresholds.
+ * All thresholds are kept in one sorted structure; the HAL is given the narrowest window
+ * around the current RSSI that none of them falls inside, and when the RSSI leaves it only
+ * the clients with a threshold between the old and new RSSI are told. A threshold t is
+ * crossed when the RSSI goes from below t to t or above, or back. The window last
+ * programmed is remembered so an unchanged one is not programmed again. Not thread safe;
+ * callers hold their own lock.
+ */
+class RssiMonitorMux {
+public:
+    RssiMonitorMux();
+
+    /* replaces the thresholds of client; with none, the client is removed */
+    void setThresholds(int client, const s8 *thresholds, int numThresholds);
+    void clear();
+
+    bool isEmpty() const {
+        return mThresholds.empty();
+    }
+
+    /*
+     * The window around rssi: minRssi is the highest threshold at or below it and maxRssi
+     * the lowest one above it, or the ends of the s8 range where there is none.
+     */
+    void getWindow(s8 rssi, s8 *minRssi, s8 *maxRssi) const;
+
+    /* takes rssi as current without telling anyone, as a client's thresholds are set */
+    void setRssi(s8 rssi);
+
+    /* takes rssi as current; appends each client with a threshold crossed to get there once */
+    void update(s8 rssi, std::vector<int> &crossed);
+
+    bool isProgrammed(s8 minRssi, s8 maxRssi) const;
+    void setProgrammed(wifi_request_id id, s8 minRssi, s8 maxRssi);
+    void resetProgrammed();
+
+    /* true while the HAL monitor is running */
+    bool isProgrammed() const {
+        return mIsProgrammed;
+    }
+
+    /* the id the HAL monitor was started with; only meaningful while isProgrammed() */
+    wifi_request_id getProgrammedId() const {
+        return mProgrammedId;
+    }
+
+private:
+    void removeClient(int client);
+
+    std::multimap<int, int> mThresholds;        /* client by threshold */
+    s8 mRssi;
+    bool mIsProgrammed;
+    wifi_request_id mProgrammedId;
+    s8 mProgrammedMin;
+    s8 mProgrammedMax;
+};
+
+}
+
+#endif //__WIFI_RSSI_MONITOR_H__
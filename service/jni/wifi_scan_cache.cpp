@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "wifi_scan_cache.h"
+
+namespace android {
+
+WifiScanCache::WifiScanCache(size_t maxScans)
+    : mScans(maxScans > 0 ? maxScans : 1), mHead(0), mCount(0), mEvicted(0)
+{
+}
+
+wifi_cached_scan_results *WifiScanCache::add()
+{
+    if (mCount == mScans.size()) {
+        mHead = (mHead + 1) % mScans.size();
+        mCount--;
+        mEvicted++;
+    }
+
+    wifi_cached_scan_results *scan = &mScans[(mHead + mCount) % mScans.size()];
+    mCount++;
+
+    memset(scan, 0, sizeof(*scan));
+    return scan;
+}
+
+wifi_cached_scan_results *WifiScanCache::addMerged(const wifi_cached_scan_results *scans,
+        int numScans)
+{
+    wifi_cached_scan_results *merged = add();
+    if (numScans <= 0) {
+        return merged;
+    }
+    merged->scan_id = scans[numScans - 1].scan_id;
+    merged->flags = scans[numScans - 1].flags;
+
+    /* newest first, so the first sighting of a BSSID is the one kept */
+    for (int i = numScans - 1; i >= 0 && merged->num_results < MAX_AP_CACHE_PER_SCAN; i--) {
+        int numResults = scans[i].num_results < MAX_AP_CACHE_PER_SCAN ?
+                scans[i].num_results : MAX_AP_CACHE_PER_SCAN;
+        for (int j = 0; j < numResults && merged->num_results < MAX_AP_CACHE_PER_SCAN; j++) {
+            const wifi_scan_result &result = scans[i].results[j];
+            bool seen = false;
+            for (int k = 0; k < merged->num_results && !seen; k++) {
+                seen = memcmp(merged->results[k].bssid, result.bssid, sizeof(mac_addr)) == 0;
+            }
+            if (!seen) {
+                memcpy(&merged->results[merged->num_results++], &result, sizeof(result));
+            }
+        }
+    }
+    return merged;
+}
+
+int WifiScanCache::get(bool flush, int max, wifi_cached_scan_results *out)
+{
+    int num = (size_t)max < mCount ? max : mCount;
+    if (num < 0) {
+        num = 0;
+    }
+
+    for (int i = 0; i < num; i++) {
+        memcpy(&out[i], &mScans[(mHead + i) % mScans.size()], sizeof(wifi_cached_scan_results));
+    }
+
+    if (flush) {
+        mHead = (mHead + num) % mScans.size();
+        mCount -= num;
+    }
+    return num;
+}
+
+const wifi_cached_scan_results *WifiScanCache::newest() const
+{
+    if (mCount == 0) {
+        return NULL;
+    }
+    return &mScans[(mHead + mCount - 1) % mScans.size()];
+}
+
+void WifiScanCache::clear()
+{
+    mHead = 0;
+    mCount = 0;
+}
+
+}; // namespace android
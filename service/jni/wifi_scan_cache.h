@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_SCAN_CACHE_H__
+#define __WIFI_SCAN_CACHE_H__
+
+#include <vector>
+
+#include "wifi_hal.h"
+#include "gscan.h"
+
+namespace android {
+
+/*
+ * Bounded cache of whole scans, in the form wifi_get_cached_gscan_results hands them out.
+ * Storage for every scan is allocated up front; once full, the oldest scan is overwritten.
+ * Not thread safe; callers hold their own lock.
+ */
+class WifiScanCache {
+public:
+    explicit WifiScanCache(size_t maxScans);
+
+    /* returns a zeroed scan to fill in, evicting the oldest one if the cache is full */
+    wifi_cached_scan_results *add();
+
+    /*
+     * Adds one scan holding every BSSID in scans, oldest first, as it was last seen. If they
+     * don't all fit, the BSSIDs seen most recently are kept.
+     */
+    wifi_cached_scan_results *addMerged(const wifi_cached_scan_results *scans, int numScans);
+
+    /* copies up to max scans, oldest first, removing them if flush is set */
+    int get(bool flush, int max, wifi_cached_scan_results *out);
+
+    /* most recent scan, or NULL */
+    const wifi_cached_scan_results *newest() const;
+
+    void clear();
+
+    size_t size() const {
+        return mCount;
+    }
+    size_t capacity() const {
+        return mScans.size();
+    }
+    unsigned evicted() const {
+        return mEvicted;
+    }
+
+private:
+    std::vector<wifi_cached_scan_results> mScans;
+    size_t mHead;               /* oldest scan */
+    size_t mCount;
+    unsigned mEvicted;
+};
+
+}
+
+#endif //__WIFI_SCAN_CACHE_H__
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <limits.h>
+
+#include "wifi_scan_filter.h"
+#include "wifi_ssid_table.h"
+
+namespace android {
+
+static uint64_t bssidKey(const mac_addr bssid)
+{
+    uint64_t key = 0;
+    for (int i = 0; i < 6; i++) {
+        key = (key << 8) | bssid[i];
+    }
+    return key;
+}
+
+/* the 5 GHz DFS channels of 802.11: 52 to 64 and 100 to 144 */
+static inline bool isDfsChannel(wifi_channel frequency)
+{
+    return (frequency >= 5260 && frequency <= 5320) || (frequency >= 5500 && frequency <= 5720);
+}
+
+ScanFilter::ScanFilter(const ScanFilter &other)
+    : mSsids(other.mSsids), mBssids(other.mBssids), mDfsChannels(other.mDfsChannels),
+      mBandMask(other.mBandMask),
+      mMinRssi(other.mMinRssi), mMaxAge(other.mMaxAge), mEmpty(other.mEmpty)
+{
+    SsidTable &table = SsidTable::getInstance();
+    for (size_t i = 0; i < mSsids.size(); i++) {
+        table.acquire(mSsids[i]);
+    }
+}
+
+ScanFilter::~ScanFilter()
+{
+    clear();
+}
+
+ScanFilter &ScanFilter::operator=(const ScanFilter &other)
+{
+    if (this != &other) {
+        /* take the new references before dropping the old, so shared SSIDs keep their ids */
+        SsidTable &table = SsidTable::getInstance();
+        for (size_t i = 0; i < other.mSsids.size(); i++) {
+            table.acquire(other.mSsids[i]);
+        }
+        clear();
+        mSsids = other.mSsids;
+        mBssids = other.mBssids;
+        mDfsChannels = other.mDfsChannels;
+        mBandMask = other.mBandMask;
+        mMinRssi = other.mMinRssi;
+        mMaxAge = other.mMaxAge;
+        mEmpty = other.mEmpty;
+    }
+    return *this;
+}
+
+void ScanFilter::clear()
+{
+    SsidTable &table = SsidTable::getInstance();
+    for (size_t i = 0; i < mSsids.size(); i++) {
+        table.release(mSsids[i]);
+    }
+    mSsids.clear();
+    mBssids.clear();
+    mDfsChannels.clear();
+    mBandMask = 0;
+    mMinRssi = INT_MIN;
+    mMaxAge = 0;
+    mEmpty = true;
+}
+
+void ScanFilter::addSsid(const uint8_t *ssid, size_t len)
+{
+    if (len > SsidTable::kMaxSsidLength) {
+        len = SsidTable::kMaxSsidLength;
+    }
+    int id = SsidTable::getInstance().acquire(ssid, len);
+    if (std::find(mSsids.begin(), mSsids.end(), id) != mSsids.end()) {
+        SsidTable::getInstance().release(id);
+    } else {
+        mSsids.push_back(id);
+    }
+    mEmpty = false;
+}
+
+void ScanFilter::addBssid(const mac_addr bssid)
+{
+    mBssids.push_back(bssidKey(bssid));
+    mEmpty = false;
+}
+
+void ScanFilter::setBandMask(int bandMask)
+{
+    mBandMask = bandMask;
+    mEmpty = mEmpty && bandMask == 0;
+}
+
+void ScanFilter::setMinRssi(wifi_rssi minRssi)
+{
+    mMinRssi = minRssi;
+    mEmpty = mEmpty && minRssi == INT_MIN;
+}
+
+void ScanFilter::setMaxAge(wifi_timestamp maxAgeUs)
+{
+    mMaxAge = maxAgeUs;
+    mEmpty = mEmpty && maxAgeUs == 0;
+}
+
+void ScanFilter::setDfsChannels(const wifi_channel *channels, int numChannels)
+{
+    mDfsChannels.assign(channels, channels + numChannels);
+}
+
+void ScanFilter::commit()
+{
+    std::sort(mDfsChannels.begin(), mDfsChannels.end());
+    std::sort(mSsids.begin(), mSsids.end());
+    std::sort(mBssids.begin(), mBssids.end());
+    mBssids.erase(std::unique(mBssids.begin(), mBssids.end()), mBssids.end());
+}
+
+/* band mask bits a channel frequency in MHz is on, 0 if it is on neither band */
+inline int ScanFilter::bandOf(wifi_channel frequency) const
+{
+    if (frequency >= 2400 && frequency < 2500) {
+        return SCAN_FILTER_BAND_24_GHZ;
+    }
+    if (frequency < 4900 || frequency >= 5900) {
+        return 0;
+    }
+    const int all5Ghz = SCAN_FILTER_BAND_5_GHZ | SCAN_FILTER_BAND_5_GHZ_DFS;
+    if ((mBandMask & all5Ghz) != SCAN_FILTER_BAND_5_GHZ &&
+            (mBandMask & all5Ghz) != SCAN_FILTER_BAND_5_GHZ_DFS) {
+        return all5Ghz;     /* the mask doesn't tell DFS channels apart; skip the lookup */
+    }
+    bool dfs = mDfsChannels.empty() ? isDfsChannel(frequency)
+            : std::binary_search(mDfsChannels.begin(), mDfsChannels.end(), frequency);
+    return dfs ? SCAN_FILTER_BAND_5_GHZ_DFS : SCAN_FILTER_BAND_5_GHZ;
+}
+
+inline bool ScanFilter::passesCheap(const wifi_scan_result &result, wifi_timestamp now) const
+{
+    /* non short circuiting on purpose, so that this compiles to straight line code */
+    bool band = (mBandMask == 0) | ((bandOf(result.channel) & mBandMask) != 0);
+    bool rssi = result.rssi >= mMinRssi;
+    bool age = (mMaxAge == 0) | (now - result.ts <= mMaxAge);
+    return band & rssi & age;
+}
+
+bool ScanFilter::passesSets(const wifi_scan_result &result) const
+{
+    if (!mBssids.empty() &&
+            !std::binary_search(mBssids.begin(), mBssids.end(), bssidKey(result.bssid))) {
+        return false;
+    }
+    if (!mSsids.empty()) {
+        /* an SSID nobody interned can't be one of ours */
+        int id = SsidTable::getInstance().find(result);
+        return id >= 0 && std::binary_search(mSsids.begin(), mSsids.end(), id);
+    }
+    return true;
+}
+
+bool ScanFilter::matches(const wifi_scan_result &result, wifi_timestamp now) const
+{
+    return mEmpty || (passesCheap(result, now) && passesSets(result));
+}
+
+int ScanFilter::select(const wifi_scan_result *results, int numResults, wifi_timestamp now,
+        int *selected) const
+{
+    int n = 0;
+    if (mEmpty) {
+        for (int i = 0; i < numResults; i++) {
+            selected[n++] = i;
+        }
+        return n;
+    }
+
+    /* branch free compaction: always store, only advance past the ones that pass */
+    for (int i = 0; i < numResults; i++) {
+        selected[n] = i;
+        n += passesCheap(results[i], now);
+    }
+
+    if (mSsids.empty() && mBssids.empty()) {
+        return n;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        if (passesSets(results[selected[i]])) {
+            selected[kept++] = selected[i];
+        }
+    }
+    return kept;
+}
+
+}; // namespace android
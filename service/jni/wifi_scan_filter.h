@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_SCAN_FILTER_H__
+#define __WIFI_SCAN_FILTER_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "wifi_hal.h"
+#include "gscan.h"
+
+namespace android {
+
+/* band mask bits; the same values as WifiScanner.WIFI_BAND_* */
+enum {
+    SCAN_FILTER_BAND_24_GHZ     = 1 << 0,
+    SCAN_FILTER_BAND_5_GHZ      = 1 << 1,   /* without the DFS channels */
+    SCAN_FILTER_BAND_5_GHZ_DFS  = 1 << 2,   /* only the DFS channels */
+};
+
+/*
+ * Decides which scan results are worth a ScanResult object before any is created. A result
+ * passes if it is on one of the bands in the band mask, at or above the RSSI floor, no older
+ * than the maximum age, and, for each of the SSID and BSSID sets that isn't empty, in it.
+ * Zero band mask and age mean no limit; a filter that was never set up passes everything.
+ * SSIDs are held by their id in the SsidTable, with a reference on each.
+ */
+class ScanFilter {
+public:
+    ScanFilter() {
+        clear();
+    }
+    ScanFilter(const ScanFilter &other);
+    ~ScanFilter();
+    ScanFilter &operator=(const ScanFilter &other);
+
+    void clear();
+
+    void addSsid(const uint8_t *ssid, size_t len);
+    void addBssid(const mac_addr bssid);
+    void setBandMask(int bandMask);
+    void setMinRssi(wifi_rssi minRssi);
+    void setMaxAge(wifi_timestamp maxAgeUs);
+
+    /*
+     * The 5 GHz channels that are DFS channels here, as the HAL lists them for
+     * WIFI_BAND_A_DFS; until set, those of 802.11 (52 to 64 and 100 to 144).
+     */
+    void setDfsChannels(const wifi_channel *channels, int numChannels);
+
+    /* sorts the sets; call once all of them were added, before filtering */
+    void commit();
+
+    bool isEmpty() const {
+        return mEmpty;
+    }
+
+    bool matches(const wifi_scan_result &result, wifi_timestamp now) const;
+
+    /*
+     * Writes the indices of the results that pass into selected, in order, and returns how
+     * many did. The band, RSSI and age checks are made for all results first without
+     * branching, so the sets are only searched for the results those let through.
+     */
+    int select(const wifi_scan_result *results, int numResults, wifi_timestamp now,
+            int *selected) const;
+
+private:
+    int bandOf(wifi_channel frequency) const;
+    bool passesCheap(const wifi_scan_result &result, wifi_timestamp now) const;
+    bool passesSets(const wifi_scan_result &result) const;
+
+    std::vector<int> mSsids;            /* SsidTable ids, sorted */
+    std::vector<uint64_t> mBssids;      /* sorted */
+    std::vector<wifi_channel> mDfsChannels;     /* sorted; empty for the 802.11 ones */
+    int mBandMask;
+    wifi_rssi mMinRssi;
+    wifi_timestamp mMaxAge;
+    bool mEmpty;
+};
+
+}
+
+#endif //__WIFI_SCAN_FILTER_H__
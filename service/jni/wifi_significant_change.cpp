@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "wifi"
+
+#include <stdlib.h>
+#include <string.h>
+#include <utils/Log.h>
+
+#include "wifi_significant_change.h"
+
+namespace android {
+
+SignificantChangeEngine::SignificantChangeEngine()
+    : mId(0), mRssiSampleSize(0), mLostApSampleSize(0), mMinBreaching(0),
+      mTable(NULL), mMask(0), mResultBuffer(NULL), mResultStride(0), mResults(NULL)
+{
+    memset(&mHandler, 0, sizeof(mHandler));
+}
+
+SignificantChangeEngine::~SignificantChangeEngine()
+{
+    stop();
+}
+
+bool SignificantChangeEngine::start(wifi_request_id id,
+        const wifi_significant_change_params &params, wifi_significant_change_handler handler)
+{
+    stop();
+
+    if (params.num_bssid <= 0 || params.num_bssid > MAX_SIGNIFICANT_CHANGE_APS
+            || handler.on_significant_change == NULL) {
+        ALOGE("Invalid significant change request, %d bssids", params.num_bssid);
+        return false;
+    }
+
+    mId = id;
+    mHandler = handler;
+    mRssiSampleSize = params.rssi_sample_size;
+    if (mRssiSampleSize < 1) {
+        mRssiSampleSize = 1;
+    } else if (mRssiSampleSize > kMaxRssiSamples) {
+        mRssiSampleSize = kMaxRssiSamples;
+    }
+    mLostApSampleSize = params.lost_ap_sample_size;
+    mMinBreaching = params.min_breaching > 0 ? params.min_breaching : 1;
+
+    /* keep the load factor at or below one half */
+    uint32_t size = 4;
+    while (size < (uint32_t)params.num_bssid * 2) {
+        size <<= 1;
+    }
+    mMask = size - 1;
+    mTable = (ApState *)calloc(size, sizeof(ApState));
+
+    mResultStride = sizeof(wifi_significant_change_result)
+            + mRssiSampleSize * sizeof(wifi_rssi);
+    mResultStride = (mResultStride + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    mResultBuffer = (char *)calloc(params.num_bssid, mResultStride);
+    mResults = (wifi_significant_change_result **)calloc(params.num_bssid,
+            sizeof(wifi_significant_change_result *));
+
+    if (mTable == NULL || mResultBuffer == NULL || mResults == NULL) {
+        ALOGE("Error allocating significant change state");
+        stop();
+        return false;
+    }
+
+    for (int i = 0; i < params.num_bssid; i++) {
+        ApState *ap = insert(params.ap[i].bssid);
+        ap->low = params.ap[i].low;
+        ap->high = params.ap[i].high;
+    }
+
+    ALOGD("tracking significant change of %d bssids in software [%d]", params.num_bssid, id);
+    return true;
+}
+
+void SignificantChangeEngine::stop()
+{
+    free(mTable);
+    free(mResultBuffer);
+    free(mResults);
+    mTable = NULL;
+    mResultBuffer = NULL;
+    mResults = NULL;
+    mMask = 0;
+}
+
+uint32_t SignificantChangeEngine::hash(const mac_addr bssid)
+{
+    /* FNV-1a; the OUI alone would put most APs of a deployment in the same slot */
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < sizeof(mac_addr); i++) {
+        h = (h ^ bssid[i]) * 16777619u;
+    }
+    return h;
+}
+
+SignificantChangeEngine::ApState *SignificantChangeEngine::find(const mac_addr bssid)
+{
+    for (uint32_t i = hash(bssid) & mMask; mTable[i].used; i = (i + 1) & mMask) {
+        if (memcmp(mTable[i].bssid, bssid, sizeof(mac_addr)) == 0) {
+            return &mTable[i];
+        }
+    }
+    return NULL;
+}
+
+SignificantChangeEngine::ApState *SignificantChangeEngine::insert(const mac_addr bssid)
+{
+    uint32_t i = hash(bssid) & mMask;
+    for (; mTable[i].used; i = (i + 1) & mMask) {
+        if (memcmp(mTable[i].bssid, bssid, sizeof(mac_addr)) == 0) {
+            return &mTable[i];
+        }
+    }
+
+    memcpy(mTable[i].bssid, bssid, sizeof(mac_addr));
+    mTable[i].used = true;
+    return &mTable[i];
+}
+
+bool SignificantChangeEngine::isBreaching(const ApState &ap) const
+{
+    if (ap.everSeen && mLostApSampleSize > 0 && ap.missed >= mLostApSampleSize) {
+        return true;
+    }
+
+    if (ap.numSamples < mRssiSampleSize) {
+        return false;
+    }
+
+    int sum = 0;
+    for (int i = 0; i < ap.numSamples; i++) {
+        sum += ap.samples[i];
+    }
+
+    int average = sum / ap.numSamples;
+    return average < ap.low || average > ap.high;
+}
+
+void SignificantChangeEngine::fillResult(const ApState &ap,
+        wifi_significant_change_result *result) const
+{
+    memcpy(result->bssid, ap.bssid, sizeof(mac_addr));
+    result->channel = ap.channel;
+    result->num_rssi = ap.numSamples;
+
+    /* most recent sample first */
+    for (int i = 0; i < ap.numSamples; i++) {
+        int index = (ap.nextSample + mRssiSampleSize - 1 - i) % mRssiSampleSize;
+        result->rssi[i] = ap.samples[index];
+    }
+}
+
+void SignificantChangeEngine::onScanResults(const wifi_scan_result *results, int numResults)
+{
+    if (mTable == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < numResults; i++) {
+        ApState *ap = find(results[i].bssid);
+        if (ap == NULL || ap->seen) {
+            continue;
+        }
+
+        ap->seen = true;
+        ap->everSeen = true;
+        ap->missed = 0;
+        ap->channel = results[i].channel;
+        ap->samples[ap->nextSample] = results[i].rssi;
+        ap->nextSample = (ap->nextSample + 1) % mRssiSampleSize;
+        if (ap->numSamples < mRssiSampleSize) {
+            ap->numSamples++;
+        }
+    }
+
+    int breaching = 0;
+    int numResultsOut = 0;
+    for (uint32_t i = 0; i <= mMask; i++) {
+        ApState &ap = mTable[i];
+        if (!ap.used) {
+            continue;
+        }
+
+        if (!ap.seen && ap.everSeen && ap.missed < UINT16_MAX) {
+            ap.missed++;
+        }
+        ap.seen = false;
+
+        if (!isBreaching(ap)) {
+            ap.reported = false;
+            continue;
+        }
+
+        breaching++;
+        if (!ap.reported) {
+            wifi_significant_change_result *result = (wifi_significant_change_result *)
+                    (mResultBuffer + numResultsOut * mResultStride);
+            fillResult(ap, result);
+            mResults[numResultsOut++] = result;
+        }
+    }
+
+    if (numResultsOut == 0 || breaching < mMinBreaching) {
+        return;
+    }
+
+    /* only now mark them, so that APs keep counting until enough of them breach */
+    for (int i = 0; i < numResultsOut; i++) {
+        find(mResults[i]->bssid)->reported = true;
+    }
+
+    mHandler.on_significant_change(mId, numResultsOut, mResults);
+}
+
+}; // namespace android
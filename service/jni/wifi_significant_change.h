@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_SIGNIFICANT_CHANGE_H__
+#define __WIFI_SIGNIFICANT_CHANGE_H__
+
+#include <stdint.h>
+
+#include "wifi_hal.h"
+#include "gscan.h"
+
+namespace android {
+
+/*
+ * Software implementation of significant change tracking, for HALs that do not provide
+ * wifi_set_significant_change_handler. It is fed the results of regular gscan scans and
+ * follows the HAL semantics: each tracked AP keeps a window of its last rssi_sample_size
+ * RSSI readings, and counts as breaching once the window average leaves [low, high] or it
+ * went unseen for lost_ap_sample_size scans. Once at least min_breaching APs breach, those
+ * that were not reported yet are passed to on_significant_change.
+ *
+ * All state is allocated by start(); feeding scans does not allocate. Tracked APs live in an
+ * open addressing table keyed by BSSID. Not thread safe; callers hold their own lock.
+ */
+class SignificantChangeEngine {
+public:
+    static const int kMaxRssiSamples = 16;
+
+    SignificantChangeEngine();
+    ~SignificantChangeEngine();
+
+    bool start(wifi_request_id id, const wifi_significant_change_params &params,
+            wifi_significant_change_handler handler);
+    void stop();
+
+    bool isActive() const {
+        return mTable != NULL;
+    }
+    wifi_request_id id() const {
+        return mId;
+    }
+
+    /* feeds one scan worth of results */
+    void onScanResults(const wifi_scan_result *results, int numResults);
+
+private:
+    struct ApState {
+        mac_addr bssid;
+        bool used;
+        bool seen;              /* in the scan being processed */
+        bool everSeen;
+        bool reported;          /* breaching, and already passed to the handler */
+        uint8_t numSamples;
+        uint8_t nextSample;
+        uint16_t missed;        /* consecutive scans the AP was not seen in */
+        wifi_rssi low;
+        wifi_rssi high;
+        wifi_channel channel;
+        wifi_rssi samples[kMaxRssiSamples];
+    };
+
+    static uint32_t hash(const mac_addr bssid);
+    ApState *find(const mac_addr bssid);
+    ApState *insert(const mac_addr bssid);
+    bool isBreaching(const ApState &ap) const;
+    void fillResult(const ApState &ap, wifi_significant_change_result *result) const;
+
+    wifi_request_id mId;
+    wifi_significant_change_handler mHandler;
+    int mRssiSampleSize;
+    int mLostApSampleSize;
+    int mMinBreaching;
+
+    ApState *mTable;
+    uint32_t mMask;             /* table size - 1; the size is a power of two */
+
+    char *mResultBuffer;        /* one result, with room for every sample, per tracked AP */
+    size_t mResultStride;
+    wifi_significant_change_result **mResults;
+
+    SignificantChangeEngine(const SignificantChangeEngine&);
+    SignificantChangeEngine& operator = (const SignificantChangeEngine&);
+};
+
+}
+
+#endif //__WIFI_SIGNIFICANT_CHANGE_H__
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "wifi_ssid_table.h"
+
+namespace android {
+
+SsidTable &SsidTable::getInstance()
+{
+    static SsidTable sInstance;
+    return sInstance;
+}
+
+/* FNV-1a */
+uint32_t SsidTable::hash(const uint8_t *ssid, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ ssid[i]) * 16777619u;
+    }
+    return hash;
+}
+
+int SsidTable::findLocked(const uint8_t *ssid, size_t len, uint32_t hash) const
+{
+    std::pair<std::multimap<uint32_t, int>::const_iterator,
+            std::multimap<uint32_t, int>::const_iterator> range = mIds.equal_range(hash);
+    for (std::multimap<uint32_t, int>::const_iterator it = range.first; it != range.second;
+            ++it) {
+        const Entry &entry = mEntries[it->second];
+        if (entry.length == len && memcmp(entry.ssid, ssid, len) == 0) {
+            return it->second;
+        }
+    }
+    return -1;
+}
+
+int SsidTable::acquire(const uint8_t *ssid, size_t len)
+{
+    if (len > kMaxSsidLength) {
+        return -1;
+    }
+
+    uint32_t h = hash(ssid, len);
+    Mutex::Autolock _l(mLock);
+    int id = findLocked(ssid, len, h);
+    if (id < 0) {
+        if (!mFree.empty()) {
+            id = mFree.back();
+            mFree.pop_back();
+        } else {
+            id = mEntries.size();
+            mEntries.push_back(Entry());
+        }
+        Entry &entry = mEntries[id];
+        memset(entry.ssid, 0, sizeof(entry.ssid));
+        memcpy(entry.ssid, ssid, len);
+        entry.length = len;
+        entry.hash = h;
+        entry.refs = 0;
+        mIds.insert(std::make_pair(h, id));
+    }
+    mEntries[id].refs++;
+    return id;
+}
+
+void SsidTable::acquire(int id)
+{
+    Mutex::Autolock _l(mLock);
+    if (id >= 0 && id < (int) mEntries.size() && mEntries[id].refs > 0) {
+        mEntries[id].refs++;
+    }
+}
+
+void SsidTable::release(int id)
+{
+    Mutex::Autolock _l(mLock);
+    if (id < 0 || id >= (int) mEntries.size() || mEntries[id].refs <= 0) {
+        return;
+    }
+
+    Entry &entry = mEntries[id];
+    if (--entry.refs == 0) {
+        std::pair<std::multimap<uint32_t, int>::iterator,
+                std::multimap<uint32_t, int>::iterator> range = mIds.equal_range(entry.hash);
+        for (std::multimap<uint32_t, int>::iterator it = range.first; it != range.second; ++it) {
+            if (it->second == id) {
+                mIds.erase(it);
+                break;
+            }
+        }
+        mFree.push_back(id);
+    }
+}
+
+int SsidTable::find(const uint8_t *ssid, size_t len) const
+{
+    if (len > kMaxSsidLength) {
+        return -1;
+    }
+    uint32_t h = hash(ssid, len);
+    Mutex::Autolock _l(mLock);
+    return findLocked(ssid, len, h);
+}
+
+int SsidTable::find(const wifi_scan_result &result) const
+{
+    return find((const uint8_t *) result.ssid, strnlen(result.ssid, kMaxSsidLength));
+}
+
+size_t SsidTable::copy(int id, char *out, size_t size) const
+{
+    memset(out, 0, size);
+    Mutex::Autolock _l(mLock);
+    if (id < 0 || id >= (int) mEntries.size() || mEntries[id].refs <= 0) {
+        return 0;
+    }
+    size_t len = mEntries[id].length < size ? mEntries[id].length : size;
+    memcpy(out, mEntries[id].ssid, len);
+    return len;
+}
+
+int parse_java_ssid(const char *utf, bool stripQuotes, uint8_t out[SsidTable::kMaxSsidLength])
+{
+    size_t len = strnlen(utf, SsidTable::kMaxSsidLength + 3);
+    if (stripQuotes && len > 1 && utf[0] == '"' && utf[len - 1] == '"') {
+        utf++;
+        len -= 2;
+    }
+    if (len > SsidTable::kMaxSsidLength) {
+        return -1;
+    }
+    memcpy(out, utf, len);
+    return len;
+}
+
+}; // namespace android
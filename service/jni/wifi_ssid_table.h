@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_SSID_TABLE_H__
+#define __WIFI_SSID_TABLE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <vector>
+#include <utils/Mutex.h>
+
+#include "wifi_hal.h"
+#include "gscan.h"
+
+namespace android {
+
+/*
+ * SSIDs interned as the bytes that go over the air, each under a small integer id that stays
+ * the same for as long as anyone holds a reference to it, with its hash worked out once.
+ * The whitelist, ePNO and the scan filters hold SSIDs by id, so matching one against a scan
+ * result is a single lookup of the result's SSID followed by integer compares. Ids of SSIDs
+ * nobody references any more are reused. Thread safe; HAL callbacks look SSIDs up while
+ * Java changes the lists that reference them.
+ */
+class SsidTable {
+public:
+    static const size_t kMaxSsidLength = 32;
+
+    static SsidTable &getInstance();
+
+    /* interns ssid and takes a reference to it; returns its id, or -1 if it is too long */
+    int acquire(const uint8_t *ssid, size_t len);
+    void acquire(int id);
+    void release(int id);
+
+    /* id of ssid if it is interned, else -1; takes no reference */
+    int find(const uint8_t *ssid, size_t len) const;
+    int find(const wifi_scan_result &result) const;
+
+    /* copies the SSID of id into out, which is zero filled past it; returns its length */
+    size_t copy(int id, char *out, size_t size) const;
+
+    static uint32_t hash(const uint8_t *ssid, size_t len);
+
+private:
+    struct Entry {
+        uint8_t ssid[kMaxSsidLength];
+        size_t length;
+        uint32_t hash;
+        int refs;
+    };
+
+    int findLocked(const uint8_t *ssid, size_t len, uint32_t hash) const;
+
+    std::vector<Entry> mEntries;                /* by id */
+    std::vector<int> mFree;                     /* ids nobody references */
+    std::multimap<uint32_t, int> mIds;          /* ids by hash */
+    mutable Mutex mLock;
+};
+
+/*
+ * Takes apart an SSID as Java hands it over, dropping the quotes around it if stripQuotes is
+ * set and it has them. Returns its length, or -1 if it is longer than an SSID can be.
+ */
+int parse_java_ssid(const char *utf, bool stripQuotes, uint8_t out[SsidTable::kMaxSsidLength]);
+
+}
+
+#endif //__WIFI_SSID_TABLE_H__
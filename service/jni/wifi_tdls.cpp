@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <functional>
+
+#include "wifi_tdls.h"
+
+namespace android {
+
+static uint64_t peerKey(const mac_addr addr)
+{
+    uint64_t key = 0;
+    for (int i = 0; i < 6; i++) {
+        key = (key << 8) | addr[i];
+    }
+    return key;
+}
+
+static void peerFromKey(uint64_t key, mac_addr addr)
+{
+    for (int i = 5; i >= 0; i--) {
+        addr[i] = key & 0xff;
+        key >>= 8;
+    }
+}
+
+TdlsSessionManager::TdlsSessionManager()
+    : mSetupRate(0), mTeardownRate(0), mMaxSessions(0), mEnabled(false)
+{
+}
+
+void TdlsSessionManager::enable(uint32_t setupRate, uint32_t teardownRate, int maxSessions)
+{
+    /* the link may be to another BSS by now, and no session outlives a roam */
+    mPeers.clear();
+    mPendingSetup.clear();
+    mPendingTeardown.clear();
+    mSetupRate = setupRate;
+    mTeardownRate = std::min(teardownRate, setupRate);
+    mMaxSessions = maxSessions;
+    mEnabled = true;
+}
+
+void TdlsSessionManager::disable()
+{
+    mPendingSetup.clear();
+    std::map<uint64_t, Peer>::iterator it = mPeers.begin();
+    while (it != mPeers.end()) {
+        if (it->second.state == PEER_SETTING_UP || it->second.state == PEER_ESTABLISHED) {
+            queue(mPendingTeardown, it->first);
+        }
+        if (it->second.state != PEER_MANUAL) {
+            mPeers.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    mEnabled = false;
+}
+
+void TdlsSessionManager::queue(std::vector<uint64_t> &pending, uint64_t key)
+{
+    /* a decision that undoes one not taken yet cancels it */
+    std::vector<uint64_t> &other = &pending == &mPendingSetup ? mPendingTeardown : mPendingSetup;
+    std::vector<uint64_t>::iterator it = std::find(other.begin(), other.end(), key);
+    if (it != other.end()) {
+        other.erase(it);
+    } else if (std::find(pending.begin(), pending.end(), key) == pending.end()) {
+        pending.push_back(key);
+    }
+}
+
+void TdlsSessionManager::update(const TdlsPeerTraffic *peers, int numPeers, nsecs_t now)
+{
+    if (!mEnabled) {
+        return;
+    }
+
+    for (int i = 0; i < numPeers; i++) {
+        uint64_t key = peerKey(peers[i].addr);
+        std::map<uint64_t, Peer>::iterator it = mPeers.find(key);
+        if (it == mPeers.end()) {
+            Peer peer = { PEER_IDLE, 0, 0, 0, 0, 0, 0, 0 };
+            it = mPeers.insert(std::make_pair(key, peer)).first;
+        }
+
+        Peer &peer = it->second;
+        uint64_t mpdus = peers[i].mpdus;
+        /* the first sample, and counters that went backwards, only set a baseline */
+        if (peer.sampled != 0 && now > peer.sampled && mpdus >= peer.mpdus) {
+            peer.rate = (mpdus - peer.mpdus) * 1000000000ULL / (now - peer.sampled);
+        } else {
+            peer.rate = 0;
+        }
+        peer.mpdus = mpdus;
+        peer.sampled = now;
+        peer.seen = now;
+    }
+
+    std::vector<std::pair<uint32_t, uint64_t> > candidates;
+    int sessions = 0;
+    std::map<uint64_t, Peer>::iterator it = mPeers.begin();
+    while (it != mPeers.end()) {
+        Peer &peer = it->second;
+        if (peer.seen != now) {
+            peer.rate = 0;
+        }
+        peer.samplesAbove = peer.rate >= mSetupRate ? peer.samplesAbove + 1 : 0;
+        peer.samplesBelow = peer.rate < mTeardownRate ? peer.samplesBelow + 1 : 0;
+
+        switch (peer.state) {
+            case PEER_IDLE:
+                if (peer.samplesAbove >= kSetupSamples && now >= peer.retryAfter) {
+                    candidates.push_back(std::make_pair(peer.rate, it->first));
+                } else if (now - peer.seen > kForgetAfter && now >= peer.retryAfter) {
+                    mPeers.erase(it++);
+                    continue;
+                }
+                break;
+            case PEER_SETTING_UP:
+            case PEER_ESTABLISHED:
+                if (peer.samplesBelow >= kTeardownSamples) {
+                    queue(mPendingTeardown, it->first);
+                    peer.state = PEER_IDLE;
+                    peer.samplesAbove = 0;
+                } else {
+                    sessions++;
+                }
+                break;
+            case PEER_MANUAL:
+                sessions++;
+                break;
+        }
+        ++it;
+    }
+
+    /* busiest first, as long as there is room */
+    std::sort(candidates.begin(), candidates.end(),
+            std::greater<std::pair<uint32_t, uint64_t> >());
+    for (size_t i = 0; i < candidates.size() && sessions < mMaxSessions; i++) {
+        Peer &peer = mPeers[candidates[i].second];
+        queue(mPendingSetup, candidates[i].second);
+        peer.state = PEER_SETTING_UP;
+        peer.samplesBelow = 0;
+        sessions++;
+    }
+}
+
+void TdlsSessionManager::onStateChanged(const mac_addr addr, int state, nsecs_t now)
+{
+    uint64_t key = peerKey(addr);
+    std::map<uint64_t, Peer>::iterator it = mPeers.find(key);
+    if (it == mPeers.end()) {
+        if (state != WIFI_TDLS_ESTABLISHED && state != WIFI_TDLS_ESTABLISHED_OFF_CHANNEL) {
+            return;
+        }
+        /* a session nobody here asked for; count it, but it isn't ours to tear down */
+        Peer peer = { PEER_MANUAL, 0, 0, now, 0, 0, 0, 0 };
+        mPeers.insert(std::make_pair(key, peer));
+        return;
+    }
+
+    Peer &peer = it->second;
+    switch (state) {
+        case WIFI_TDLS_ESTABLISHED:
+        case WIFI_TDLS_ESTABLISHED_OFF_CHANNEL:
+            if (peer.state == PEER_SETTING_UP) {
+                peer.state = PEER_ESTABLISHED;
+            } else if (peer.state == PEER_IDLE) {
+                peer.state = PEER_MANUAL;
+            }
+            break;
+        case WIFI_TDLS_DROPPED:
+        case WIFI_TDLS_FAILED:
+            peer.state = PEER_IDLE;
+            peer.samplesAbove = 0;
+            peer.retryAfter = now + kRetryBackoff;
+            break;
+        case WIFI_TDLS_DISABLED:
+            peer.state = PEER_IDLE;
+            peer.samplesAbove = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+void TdlsSessionManager::setManual(const mac_addr addr, bool enabled, nsecs_t now)
+{
+    uint64_t key = peerKey(addr);
+    mPendingSetup.erase(std::remove(mPendingSetup.begin(), mPendingSetup.end(), key),
+            mPendingSetup.end());
+    mPendingTeardown.erase(std::remove(mPendingTeardown.begin(), mPendingTeardown.end(), key),
+            mPendingTeardown.end());
+
+    std::map<uint64_t, Peer>::iterator it = mPeers.find(key);
+    if (it == mPeers.end()) {
+        Peer peer = { PEER_IDLE, 0, 0, now, 0, 0, 0, 0 };
+        it = mPeers.insert(std::make_pair(key, peer)).first;
+    }
+    Peer &peer = it->second;
+    if (enabled) {
+        peer.state = PEER_MANUAL;
+    } else {
+        /* Java took it down; don't bring it straight back up */
+        peer.state = PEER_IDLE;
+        peer.samplesAbove = 0;
+        peer.retryAfter = now + kRetryBackoff;
+    }
+}
+
+void TdlsSessionManager::takePending(std::vector<TdlsPeerAddr> &setup,
+        std::vector<TdlsPeerAddr> &teardown)
+{
+    for (size_t i = 0; i < mPendingSetup.size(); i++) {
+        TdlsPeerAddr peer;
+        peerFromKey(mPendingSetup[i], peer.addr);
+        setup.push_back(peer);
+    }
+    for (size_t i = 0; i < mPendingTeardown.size(); i++) {
+        TdlsPeerAddr peer;
+        peerFromKey(mPendingTeardown[i], peer.addr);
+        teardown.push_back(peer);
+    }
+    mPendingSetup.clear();
+    mPendingTeardown.clear();
+}
+
+int TdlsSessionManager::getSessionCount() const
+{
+    int sessions = 0;
+    for (std::map<uint64_t, Peer>::const_iterator it = mPeers.begin(); it != mPeers.end();
+            ++it) {
+        sessions += it->second.state != PEER_IDLE;
+    }
+    return sessions;
+}
+
+void TdlsSessionManager::clear()
+{
+    mPeers.clear();
+    mPendingSetup.clear();
+    mPendingTeardown.clear();
+    mEnabled = false;
+}
+
+}; // namespace android
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_TDLS_H__
+#define __WIFI_TDLS_H__
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <utils/Timers.h>
+
+#include "wifi_hal.h"
+
+namespace android {
+
+struct TdlsPeerTraffic {
+    mac_addr addr;
+    uint64_t mpdus;                     /* sent and received so far, from link layer stats */
+};
+
+struct TdlsPeerAddr {
+    mac_addr addr;
+};
+
+/*
+ * Sets TDLS sessions up and tears them down by how much traffic goes to each peer, as seen
+ * in the per-peer link layer stats. A peer gets a session once it carried at least the
+ * setup rate of MPDUs per second for kSetupSamples samples in a row, busiest peers first, as
+ * long as fewer than the maximum number of sessions are up; it loses it again once it fell
+ * below the lower teardown rate for kTeardownSamples samples. A peer whose session failed
+ * or was dropped is left alone for kRetryBackoff. Sessions Java set up itself are counted
+ * but never torn down here. Decisions are queued until taken, so that the HAL is not
+ * called from a HAL callback. Not thread safe; callers hold their own lock.
+ */
+class TdlsSessionManager {
+public:
+    static const int kSetupSamples = 2;
+    static const int kTeardownSamples = 3;
+    static const nsecs_t kRetryBackoff = 60000000000LL;         /* 60s */
+    static const nsecs_t kForgetAfter = 120000000000LL;         /* idle peers not seen */
+
+    TdlsSessionManager();
+
+    /*
+     * Starts managing sessions on the current link, forgetting every peer of the one before,
+     * Java's included. Rates are in MPDUs per second, setupRate above teardownRate.
+     */
+    void enable(uint32_t setupRate, uint32_t teardownRate, int maxSessions);
+
+    /* stops managing sessions, queueing the ones it set up to be torn down */
+    void disable();
+
+    bool isEnabled() const {
+        return mEnabled;
+    }
+
+    /* one link layer stats sample; peers that aren't in it carried no traffic */
+    void update(const TdlsPeerTraffic *peers, int numPeers, nsecs_t now);
+
+    /* what the HAL state callback said about addr, a wifi_tdls_state */
+    void onStateChanged(const mac_addr addr, int state, nsecs_t now);
+
+    /* Java enabled or disabled TDLS with addr itself; a disabled peer is backed off from */
+    void setManual(const mac_addr addr, bool enabled, nsecs_t now);
+
+    /* appends the sessions to set up and tear down decided since the last call */
+    void takePending(std::vector<TdlsPeerAddr> &setup, std::vector<TdlsPeerAddr> &teardown);
+
+    /* number of sessions up or being set up */
+    int getSessionCount() const;
+
+    /* forgets every peer and pending decision, for when the link or the HAL went away */
+    void clear();
+
+private:
+    enum PeerState {
+        PEER_IDLE,
+        PEER_SETTING_UP,
+        PEER_ESTABLISHED,
+        PEER_MANUAL,                    /* set up by Java; never torn down here */
+    };
+
+    struct Peer {
+        PeerState state;
+        uint64_t mpdus;
+        nsecs_t sampled;                /* time of the sample mpdus is from, 0 if none */
+        nsecs_t seen;
+        nsecs_t retryAfter;
+        uint32_t rate;
+        int samplesAbove;
+        int samplesBelow;
+    };
+
+    void queue(std::vector<uint64_t> &pending, uint64_t key);
+
+    std::map<uint64_t, Peer> mPeers;
+    std::vector<uint64_t> mPendingSetup;
+    std::vector<uint64_t> mPendingTeardown;
+    uint32_t mSetupRate;
+    uint32_t mTeardownRate;
+    int mMaxSessions;
+    bool mEnabled;
+};
+
+}
+
+#endif //__WIFI_TDLS_H__
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "wifi_timer_wheel.h"
+
+namespace android {
+
+TimerWheel::TimerWheel(nsecs_t tick, size_t slots)
+    : mTick(tick), mSlots(slots)
+{
+    mCurrent = systemTime(SYSTEM_TIME_MONOTONIC) / mTick;
+}
+
+void TimerWheel::schedule(int id, nsecs_t when)
+{
+    cancel(id);
+
+    /* round up, and never into a tick that was already advanced past */
+    uint64_t due = (when + mTick - 1) / mTick;
+    if (due <= mCurrent) {
+        due = mCurrent + 1;
+    }
+
+    Timer timer;
+    timer.id = id;
+    timer.due = due;
+    mSlots[due % mSlots.size()].push_back(timer);
+    mDue[id] = due;
+}
+
+void TimerWheel::removeFromSlot(int id, uint64_t due)
+{
+    std::vector<Timer> &slot = mSlots[due % mSlots.size()];
+    for (size_t i = 0; i < slot.size(); i++) {
+        if (slot[i].id == id) {
+            slot[i] = slot.back();
+            slot.pop_back();
+            return;
+        }
+    }
+}
+
+void TimerWheel::cancel(int id)
+{
+    std::map<int, uint64_t>::iterator it = mDue.find(id);
+    if (it != mDue.end()) {
+        removeFromSlot(id, it->second);
+        mDue.erase(it);
+    }
+}
+
+void TimerWheel::cancelAll()
+{
+    for (size_t i = 0; i < mSlots.size(); i++) {
+        mSlots[i].clear();
+    }
+    mDue.clear();
+}
+
+nsecs_t TimerWheel::nextExpiry() const
+{
+    if (mDue.empty()) {
+        return -1;
+    }
+
+    uint64_t first = mDue.begin()->second;
+    for (std::map<int, uint64_t>::const_iterator it = mDue.begin(); it != mDue.end(); ++it) {
+        first = std::min(first, it->second);
+    }
+    return first * mTick;
+}
+
+void TimerWheel::collect(uint64_t tick, std::vector<int> &expired)
+{
+    std::vector<Timer> &slot = mSlots[tick % mSlots.size()];
+    for (size_t i = 0; i < slot.size(); ) {
+        if (slot[i].due <= tick) {
+            expired.push_back(slot[i].id);
+            mDue.erase(slot[i].id);
+            slot[i] = slot.back();
+            slot.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
+
+void TimerWheel::advance(nsecs_t now, std::vector<int> &expired)
+{
+    uint64_t target = now / mTick;
+    if (target <= mCurrent) {
+        return;
+    }
+
+    /* after a long stall one sweep over every slot finds everything that expired */
+    uint64_t first = mCurrent + 1;
+    if (target - mCurrent > mSlots.size()) {
+        first = target - mSlots.size() + 1;
+    }
+
+    for (uint64_t tick = first; tick <= target; tick++) {
+        collect(tick, expired);
+    }
+    mCurrent = target;
+}
+
+}; // namespace android
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_TIMER_WHEEL_H__
+#define __WIFI_TIMER_WHEEL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <utils/Timers.h>
+
+namespace android {
+
+/*
+ * Hashed timer wheel: a timer due at tick t lives in slot t % slots, so scheduling and
+ * cancelling are cheap and advancing only looks at the slots of the ticks that passed.
+ * Timers are identified by caller chosen ids. Not thread safe; callers hold their own lock.
+ */
+class TimerWheel {
+public:
+    TimerWheel(nsecs_t tick, size_t slots);
+
+    /* schedules timer id to fire at when; a timer already scheduled under id is moved */
+    void schedule(int id, nsecs_t when);
+    void cancel(int id);
+    void cancelAll();
+
+    bool isScheduled(int id) const {
+        return mDue.find(id) != mDue.end();
+    }
+    bool isEmpty() const {
+        return mDue.empty();
+    }
+    nsecs_t tick() const {
+        return mTick;
+    }
+
+    /* time the earliest scheduled timer becomes due, or -1 when there are none */
+    nsecs_t nextExpiry() const;
+
+    /* advances the wheel to now, appending the ids of expired timers in expiry order */
+    void advance(nsecs_t now, std::vector<int> &expired);
+
+private:
+    struct Timer {
+        int id;
+        uint64_t due;           /* in ticks */
+    };
+
+    void removeFromSlot(int id, uint64_t due);
+    void collect(uint64_t tick, std::vector<int> &expired);
+
+    nsecs_t mTick;
+    uint64_t mCurrent;          /* last tick advanced to */
+    std::vector<std::vector<Timer> > mSlots;
+    std::map<int, uint64_t> mDue;
+};
+
+}
+
+#endif //__WIFI_TIMER_WHEEL_H__
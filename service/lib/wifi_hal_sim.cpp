@@ -0,0 +1,1592 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <algorithm>
+#include <vector>
+
+#include "wifi_hal.h"
+#include "wifi_hal_sim.h"
+
+/*
+ * Simulated vendor HAL. Requests only record state under sLock; everything the HAL
+ * reports is generated on the thread running wifi_event_loop and delivered with the lock
+ * dropped, the way a driver backed HAL delivers netlink events.
+ */
+
+#define SIM_IFACE_NAME              "wlan0"
+#define SIM_IE_MAX                  64
+#define SIM_CACHED_SCANS            16
+#define SIM_MAX_RSSI_SAMPLES        16
+#define SIM_MIN_RING_RECORD         16
+#define SIM_MAX_RING_RECORD         1024
+#define SIM_RING_SIZE               (256 * 1024)
+#define SIM_MAX_OFFLOADED_PACKETS   4
+#define SIM_MAX_TDLS_PEERS          4
+#define SIM_MEMORY_DUMP_SIZE        (64 * 1024)
+#define SIM_MIN_PERIOD_NS           10000000LL
+#define SIM_NUM_RINGS               3
+
+#define SIM_ARRAY_SIZE(a)           (sizeof(a) / sizeof((a)[0]))
+
+static const wifi_channel sChannels24[] = {
+    2412, 2417, 2422, 2427, 2432, 2437, 2442, 2447, 2452, 2457, 2462
+};
+static const wifi_channel sChannels5[] = {
+    5180, 5200, 5220, 5240, 5745, 5765, 5785, 5805, 5825
+};
+static const wifi_channel sChannelsDfs[] = {
+    5260, 5280, 5300, 5320, 5500, 5520, 5540, 5560, 5580, 5600, 5620, 5640, 5660, 5680, 5700
+};
+
+static const char *sRingNames[SIM_NUM_RINGS] = {
+    "wifi_connectivity_events", "wifi_power_events", "fw_verbose"
+};
+static const u8 sRingEntryTypes[SIM_NUM_RINGS] = {
+    ENTRY_TYPE_CONNECT_EVENT, ENTRY_TYPE_POWER_EVENT, ENTRY_TYPE_DATA
+};
+
+struct SimAp {
+    mac_addr bssid;
+    char ssid[32 + 1];
+    wifi_channel channel;
+    int baseRssi;
+    int rssi;
+    bool visible;
+};
+
+struct SimHotlistAp {
+    ap_threshold_param param;
+    int ap;                     /* index into the population, -1 if not part of it */
+    bool seen;
+    int missed;
+};
+
+struct SimSignificantAp {
+    ap_threshold_param param;
+    int ap;
+    int rssi;
+};
+
+struct SimRtt {
+    wifi_request_id id;
+    int64_t due;
+    std::vector<wifi_rtt_config> configs;
+    wifi_rtt_event_handler handler;
+};
+
+struct SimRing {
+    wifi_ring_buffer_status status;
+    bool logging;
+    int64_t next;
+};
+
+static pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sCond;
+static pthread_once_t sOnce = PTHREAD_ONCE_INIT;
+
+static int sSimWifiHandle;
+static int sSimIfaceHandle;
+
+static wifi_hal_sim_config sConfig;
+static bool sConfigured;
+static bool sInitialized;
+static bool sExit;
+static wifi_cleaned_up_handler sCleanedUpHandler;
+static int64_t sStartTime;
+static u32 sRandom;
+static std::vector<SimAp> sAps;
+
+static bool sScanning;
+static wifi_request_id sScanId;
+static wifi_scan_cmd_params sScanParams;
+static wifi_scan_result_handler sScanHandler;
+static int64_t sBucketNext[MAX_BUCKETS];
+static wifi_cached_scan_results sCache[SIM_CACHED_SCANS];
+static int sCacheHead;
+static int sCacheCount;
+static int sScanSeq;
+static int sScansSinceReport;
+
+static bool sEpno;
+static wifi_request_id sEpnoId;
+static std::vector<wifi_epno_network> sEpnoNetworks;
+static wifi_epno_handler sEpnoHandler;
+
+static bool sHotlist;
+static wifi_request_id sHotlistId;
+static int sHotlistLostSamples;
+static std::vector<SimHotlistAp> sHotlistAps;
+static wifi_hotlist_ap_found_handler sHotlistHandler;
+static int64_t sHotlistNext;
+
+static bool sSignificantChange;
+static wifi_request_id sSignificantChangeId;
+static wifi_significant_change_params sSignificantChangeParams;
+static std::vector<SimSignificantAp> sSignificantAps;
+static wifi_significant_change_handler sSignificantChangeHandler;
+static int64_t sSignificantChangeNext;
+
+static bool sRssiMonitor;
+static wifi_request_id sRssiMonitorId;
+static s8 sMaxRssi;
+static s8 sMinRssi;
+static wifi_rssi_event_handler sRssiHandler;
+static int sRssi;
+static bool sRssiBreached;
+static int64_t sRssiNext;
+
+static std::vector<SimRtt> sRtt;
+
+static bool sLogHandlerSet;
+static wifi_ring_buffer_data_handler sLogHandler;
+static wifi_alert_handler sAlertHandler;
+static SimRing sRings[SIM_NUM_RINGS];
+
+static char sCountryCode[3];
+static wifi_request_id sOffloadedPackets[SIM_MAX_OFFLOADED_PACKETS];
+static int sNumOffloadedPackets;
+static std::vector<SimAp> sTdlsPeers;
+
+/* buffers only used by the event loop while delivering callbacks */
+static std::vector<int> sSeen;
+static std::vector<u64> sFullResults;
+static std::vector<wifi_scan_result> sResults;
+static std::vector<wifi_scan_result> sLostResults;
+static std::vector<u64> sSignificantResults;
+static std::vector<wifi_significant_change_result *> sSignificantResultPtrs;
+static std::vector<wifi_rtt_result> sRttResults;
+static std::vector<wifi_rtt_result *> sRttResultPtrs;
+static u8 sRingRecord[sizeof(wifi_ring_buffer_entry) + SIM_MAX_RING_RECORD];
+static char sRingName[32 + 1];
+
+static const size_t kFullResultWords =
+        (sizeof(wifi_scan_result) + SIM_IE_MAX + sizeof(u64) - 1) / sizeof(u64);
+static const size_t kSignificantResultWords =
+        (sizeof(wifi_significant_change_result) + SIM_MAX_RSSI_SAMPLES * sizeof(wifi_rssi)
+         + sizeof(u64) - 1) / sizeof(u64);
+
+struct SimConfigKey {
+    const char *name;
+    size_t offset;
+};
+
+#define SIM_CONFIG_KEY(field) { #field, offsetof(wifi_hal_sim_config, field) }
+
+static const SimConfigKey sConfigKeys[] = {
+    SIM_CONFIG_KEY(seed),
+    SIM_CONFIG_KEY(num_aps),
+    SIM_CONFIG_KEY(visible_percent),
+    SIM_CONFIG_KEY(scan_hz),
+    SIM_CONFIG_KEY(hotlist_hz),
+    SIM_CONFIG_KEY(significant_change_hz),
+    SIM_CONFIG_KEY(rssi_hz),
+    SIM_CONFIG_KEY(ring_hz),
+    SIM_CONFIG_KEY(ring_record_bytes),
+    SIM_CONFIG_KEY(rtt_latency_ms),
+    SIM_CONFIG_KEY(link_stats_peers),
+};
+
+void wifi_hal_sim_get_default_config(wifi_hal_sim_config *config) {
+    memset(config, 0, sizeof(*config));
+    config->seed = 1;
+    config->num_aps = 64;
+    config->visible_percent = 80;
+    config->scan_hz = 0;
+    config->hotlist_hz = 1;
+    config->significant_change_hz = 1;
+    config->rssi_hz = 1;
+    config->ring_hz = 1;
+    config->ring_record_bytes = 128;
+    config->rtt_latency_ms = 100;
+    config->link_stats_peers = 1;
+
+    const char *env = getenv("WIFI_HAL_SIM");
+    if (env == NULL) {
+        return;
+    }
+
+    char buf[256];
+    strncpy(buf, env, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    char *saveptr = NULL;
+    for (char *pair = strtok_r(buf, ",", &saveptr); pair != NULL;
+            pair = strtok_r(NULL, ",", &saveptr)) {
+        char *value = strchr(pair, '=');
+        if (value == NULL) {
+            continue;
+        }
+        *value++ = '\0';
+
+        for (size_t i = 0; i < SIM_ARRAY_SIZE(sConfigKeys); i++) {
+            if (strcmp(pair, sConfigKeys[i].name) == 0) {
+                /* every field is an int or an unsigned */
+                *(int *)((char *) config + sConfigKeys[i].offset) = strtol(value, NULL, 0);
+                break;
+            }
+        }
+    }
+}
+
+void wifi_hal_sim_set_config(const wifi_hal_sim_config *config) {
+    pthread_mutex_lock(&sLock);
+    sConfig = *config;
+    sConfigured = true;
+    pthread_mutex_unlock(&sLock);
+}
+
+static void simInitOnce() {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sCond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static int64_t simNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static wifi_timestamp simTimestampUs() {
+    struct timespec ts;
+#ifdef CLOCK_BOOTTIME
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static int64_t simPeriod(int hz) {
+    return hz > 0 ? std::max(1000000000LL / hz, SIM_MIN_PERIOD_NS) : -1;
+}
+
+/* next firing of a periodic stream; a stalled loop skips ahead rather than bursting */
+static int64_t simAdvance(int64_t next, int64_t period, int64_t now) {
+    next += period;
+    return next > now ? next : now + period;
+}
+
+static u32 simRandom() {
+    u32 x = sRandom;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return sRandom = x;
+}
+
+static int simRandomRange(int low, int high) {
+    return low + (int)(simRandom() % (u32)(high - low + 1));
+}
+
+static int simClamp(int value, int low, int high) {
+    return std::min(std::max(value, low), high);
+}
+
+static bool simIsVisible() {
+    return simRandomRange(0, 99) < sConfig.visible_percent;
+}
+
+static int simChannelNumber(wifi_channel freq) {
+    if (freq == 2484) {
+        return 14;
+    } else if (freq < 3000) {
+        return (freq - 2407) / 5;
+    } else {
+        return (freq - 5000) / 5;
+    }
+}
+
+static int simFindAp(const mac_addr bssid) {
+    for (size_t i = 0; i < sAps.size(); i++) {
+        if (memcmp(sAps[i].bssid, bssid, sizeof(mac_addr)) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void simBuildPopulation() {
+    sRandom = sConfig.seed != 0 ? sConfig.seed : 1;
+    sAps.resize(std::max(sConfig.num_aps, 0));
+
+    for (size_t i = 0; i < sAps.size(); i++) {
+        SimAp &ap = sAps[i];
+        ap.bssid[0] = 0x02;     /* locally administered */
+        ap.bssid[1] = 0x00;
+        ap.bssid[2] = 0x00;
+        ap.bssid[3] = (i >> 16) & 0xff;
+        ap.bssid[4] = (i >> 8) & 0xff;
+        ap.bssid[5] = i & 0xff;
+
+        /* a few BSSs per network, like a real deployment */
+        snprintf(ap.ssid, sizeof(ap.ssid), "sim-%zu", i % std::max((size_t) 1, sAps.size() / 3));
+
+        int band = simRandomRange(0, 99);
+        if (band < 50) {
+            ap.channel = sChannels24[simRandom() % SIM_ARRAY_SIZE(sChannels24)];
+        } else if (band < 85) {
+            ap.channel = sChannels5[simRandom() % SIM_ARRAY_SIZE(sChannels5)];
+        } else {
+            ap.channel = sChannelsDfs[simRandom() % SIM_ARRAY_SIZE(sChannelsDfs)];
+        }
+
+        ap.baseRssi = simRandomRange(-90, -35);
+        ap.rssi = ap.baseRssi;
+        ap.visible = simIsVisible();
+    }
+}
+
+static void simFillResult(const SimAp &ap, wifi_timestamp ts, wifi_scan_result *result,
+        bool ies) {
+    memset(result, 0, sizeof(*result));
+    result->ts = ts;
+    memcpy(result->ssid, ap.ssid, sizeof(result->ssid));
+    memcpy(result->bssid, ap.bssid, sizeof(mac_addr));
+    result->channel = ap.channel;
+    result->rssi = ap.rssi;
+    result->beacon_period = 100;
+    result->capability = 0x0011;        /* ESS, privacy */
+
+    if (ies) {
+        /* SSID and DS parameter set elements */
+        u8 *ie = (u8 *) result->ie_data;
+        size_t len = strlen(ap.ssid);
+        ie[0] = 0;
+        ie[1] = len;
+        memcpy(ie + 2, ap.ssid, len);
+        ie += 2 + len;
+        ie[0] = 3;
+        ie[1] = 1;
+        ie[2] = simChannelNumber(ap.channel);
+        result->ie_length = len + 5;
+    }
+}
+
+static bool simBandHasChannel(wifi_band band, wifi_channel channel) {
+    for (size_t i = 0; i < SIM_ARRAY_SIZE(sChannelsDfs); i++) {
+        if (sChannelsDfs[i] == channel) {
+            return (band & WIFI_BAND_A_DFS) != 0;
+        }
+    }
+    return channel < 3000 ? (band & WIFI_BAND_BG) != 0 : (band & WIFI_BAND_A) != 0;
+}
+
+static bool simInBuckets(wifi_channel channel, unsigned buckets) {
+    for (int i = 0; i < sScanParams.num_buckets; i++) {
+        if ((buckets & (1 << i)) == 0) {
+            continue;
+        }
+
+        const wifi_scan_bucket_spec &spec = sScanParams.buckets[i];
+        if (spec.num_channels == 0) {
+            if (simBandHasChannel(spec.band, channel)) {
+                return true;
+            }
+            continue;
+        }
+        for (int j = 0; j < spec.num_channels; j++) {
+            if (spec.channels[j].channel == channel) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static int64_t simBucketPeriod(int bucket) {
+    if (sConfig.scan_hz > 0) {
+        return simPeriod(sConfig.scan_hz);
+    }
+
+    int period = sScanParams.buckets[bucket].period;
+    if (period <= 0) {
+        period = sScanParams.base_period;
+    }
+    return std::max(period * 1000000LL, SIM_MIN_PERIOD_NS);
+}
+
+static unsigned simReportThreshold() {
+    unsigned threshold = SIM_CACHED_SCANS;
+    if (sScanParams.report_threshold_num_scans > 0) {
+        threshold = std::min(threshold, (unsigned) sScanParams.report_threshold_num_scans);
+    }
+    if (sScanParams.report_threshold_percent > 0) {
+        unsigned scans = (SIM_CACHED_SCANS * sScanParams.report_threshold_percent + 99) / 100;
+        threshold = std::min(threshold, std::max(scans, 1u));
+    }
+    return threshold;
+}
+
+static bool simCompareRssi(int a, int b) {
+    return sAps[a].rssi > sAps[b].rssi;
+}
+
+static void simRunScans(int64_t now) {
+    if (!sScanning) {
+        return;
+    }
+
+    unsigned due = 0, full = 0;
+    bool each = false, batch = false;
+    for (int i = 0; i < sScanParams.num_buckets; i++) {
+        if (now < sBucketNext[i]) {
+            continue;
+        }
+        due |= 1 << i;
+        sBucketNext[i] = simAdvance(sBucketNext[i], simBucketPeriod(i), now);
+
+        byte events = sScanParams.buckets[i].report_events;
+        if ((events & REPORT_EVENTS_FULL_RESULTS) != 0) {
+            full |= 1 << i;
+        }
+        each = each || (events & REPORT_EVENTS_EACH_SCAN) != 0;
+        batch = batch || (events & REPORT_EVENTS_NO_BATCH) == 0;
+    }
+    if (due == 0) {
+        return;
+    }
+
+    /* the air changes a little between scans */
+    std::vector<int> &seen = sSeen;
+    seen.clear();
+    for (size_t i = 0; i < sAps.size(); i++) {
+        SimAp &ap = sAps[i];
+        ap.rssi = simClamp(ap.rssi + simRandomRange(-3, 3), ap.baseRssi - 10, ap.baseRssi + 10);
+        ap.visible = simIsVisible();
+        if (ap.visible && simInBuckets(ap.channel, due)) {
+            seen.push_back(i);
+        }
+    }
+
+    wifi_timestamp ts = simTimestampUs();
+
+    size_t numFull = 0;
+    sFullResults.resize(seen.size() * kFullResultWords);
+    for (size_t i = 0; i < seen.size() && full != 0; i++) {
+        if (simInBuckets(sAps[seen[i]].channel, full)) {
+            wifi_scan_result *result =
+                    (wifi_scan_result *) &sFullResults[numFull++ * kFullResultWords];
+            simFillResult(sAps[seen[i]], ts, result, true);
+        }
+    }
+
+    bool report = false;
+    if (batch) {
+        int max = MAX_AP_CACHE_PER_SCAN;
+        if (sScanParams.max_ap_per_scan > 0 && sScanParams.max_ap_per_scan < max) {
+            max = sScanParams.max_ap_per_scan;
+        }
+        if (seen.size() > (size_t) max) {
+            std::partial_sort(seen.begin(), seen.begin() + max, seen.end(), simCompareRssi);
+        }
+
+        if (sCacheCount == SIM_CACHED_SCANS) {
+            sCacheHead = (sCacheHead + 1) % SIM_CACHED_SCANS;
+            sCacheCount--;
+        }
+        wifi_cached_scan_results *scan = &sCache[(sCacheHead + sCacheCount) % SIM_CACHED_SCANS];
+        sCacheCount++;
+
+        memset(scan, 0, sizeof(*scan));
+        scan->scan_id = sScanSeq++;
+        scan->num_results = std::min(seen.size(), (size_t) max);
+        for (int i = 0; i < scan->num_results; i++) {
+            simFillResult(sAps[seen[i]], ts, &scan->results[i], false);
+        }
+
+        sScansSinceReport++;
+        report = each || sScansSinceReport >= (int) simReportThreshold();
+        if (report) {
+            sScansSinceReport = 0;
+        }
+    }
+
+    sResults.clear();
+    for (size_t i = 0; i < seen.size() && sEpno; i++) {
+        const SimAp &ap = sAps[seen[i]];
+        for (size_t j = 0; j < sEpnoNetworks.size(); j++) {
+            if (strcmp(ap.ssid, sEpnoNetworks[j].ssid) == 0
+                    && ap.rssi >= sEpnoNetworks[j].rssi_threshold) {
+                wifi_scan_result result;
+                simFillResult(ap, ts, &result, false);
+                sResults.push_back(result);
+                break;
+            }
+        }
+    }
+
+    wifi_request_id id = sScanId;
+    wifi_scan_result_handler handler = sScanHandler;
+    unsigned cached = sCacheCount;
+    wifi_request_id epnoId = sEpnoId;
+    wifi_epno_handler epnoHandler = sEpnoHandler;
+
+    pthread_mutex_unlock(&sLock);
+    if (handler.on_full_scan_result != NULL) {
+        for (size_t i = 0; i < numFull; i++) {
+            handler.on_full_scan_result(id,
+                    (wifi_scan_result *) &sFullResults[i * kFullResultWords]);
+        }
+    }
+    if (report && handler.on_scan_results_available != NULL) {
+        handler.on_scan_results_available(id, cached);
+    }
+    if (!sResults.empty() && epnoHandler.on_network_found != NULL) {
+        epnoHandler.on_network_found(epnoId, sResults.size(), &sResults[0]);
+    }
+    pthread_mutex_lock(&sLock);
+}
+
+static void simRunHotlist(int64_t now) {
+    if (!sHotlist || sConfig.hotlist_hz <= 0 || now < sHotlistNext) {
+        return;
+    }
+    sHotlistNext = simAdvance(sHotlistNext, simPeriod(sConfig.hotlist_hz), now);
+
+    wifi_timestamp ts = simTimestampUs();
+    sResults.clear();
+    sLostResults.clear();
+
+    for (size_t i = 0; i < sHotlistAps.size(); i++) {
+        SimHotlistAp &hotlistAp = sHotlistAps[i];
+
+        SimAp ap;
+        if (hotlistAp.ap >= 0) {
+            ap = sAps[hotlistAp.ap];
+        } else {
+            memset(&ap, 0, sizeof(ap));
+            memcpy(ap.bssid, hotlistAp.param.bssid, sizeof(mac_addr));
+            ap.channel = sChannels24[i % SIM_ARRAY_SIZE(sChannels24)];
+            ap.rssi = simRandomRange(-90, -40);
+        }
+
+        bool visible = simIsVisible() && ap.rssi >= hotlistAp.param.low;
+        if (visible) {
+            hotlistAp.missed = 0;
+            if (!hotlistAp.seen) {
+                hotlistAp.seen = true;
+                wifi_scan_result result;
+                simFillResult(ap, ts, &result, false);
+                sResults.push_back(result);
+            }
+        } else if (hotlistAp.seen && ++hotlistAp.missed >= sHotlistLostSamples) {
+            hotlistAp.seen = false;
+            wifi_scan_result result;
+            simFillResult(ap, ts, &result, false);
+            sLostResults.push_back(result);
+        }
+    }
+
+    wifi_request_id id = sHotlistId;
+    wifi_hotlist_ap_found_handler handler = sHotlistHandler;
+
+    pthread_mutex_unlock(&sLock);
+    if (!sResults.empty() && handler.on_hotlist_ap_found != NULL) {
+        handler.on_hotlist_ap_found(id, sResults.size(), &sResults[0]);
+    }
+    if (!sLostResults.empty() && handler.on_hotlist_ap_lost != NULL) {
+        handler.on_hotlist_ap_lost(id, sLostResults.size(), &sLostResults[0]);
+    }
+    pthread_mutex_lock(&sLock);
+}
+
+static void simRunSignificantChange(int64_t now) {
+    if (!sSignificantChange || sConfig.significant_change_hz <= 0
+            || now < sSignificantChangeNext) {
+        return;
+    }
+    sSignificantChangeNext = simAdvance(sSignificantChangeNext,
+            simPeriod(sConfig.significant_change_hz), now);
+
+    int samples = simClamp(sSignificantChangeParams.rssi_sample_size, 1, SIM_MAX_RSSI_SAMPLES);
+    sSignificantResults.resize(sSignificantAps.size() * kSignificantResultWords);
+    sSignificantResultPtrs.clear();
+
+    for (size_t i = 0; i < sSignificantAps.size(); i++) {
+        SimSignificantAp &ap = sSignificantAps[i];
+        ap.rssi = simClamp(ap.rssi + simRandomRange(-8, 8), -100, -20);
+        if (ap.rssi >= ap.param.low && ap.rssi <= ap.param.high) {
+            continue;
+        }
+
+        wifi_significant_change_result *result = (wifi_significant_change_result *)
+                &sSignificantResults[sSignificantResultPtrs.size() * kSignificantResultWords];
+        memcpy(result->bssid, ap.param.bssid, sizeof(mac_addr));
+        result->channel = ap.ap >= 0 ? sAps[ap.ap].channel : sChannels24[0];
+        result->num_rssi = samples;
+        for (int j = 0; j < samples; j++) {
+            result->rssi[j] = ap.rssi + simRandomRange(-2, 2);
+        }
+        sSignificantResultPtrs.push_back(result);
+    }
+
+    if (sSignificantResultPtrs.empty() || (int) sSignificantResultPtrs.size()
+            < std::max(sSignificantChangeParams.min_breaching, 1)) {
+        return;
+    }
+
+    wifi_request_id id = sSignificantChangeId;
+    wifi_significant_change_handler handler = sSignificantChangeHandler;
+
+    pthread_mutex_unlock(&sLock);
+    if (handler.on_significant_change != NULL) {
+        handler.on_significant_change(id, sSignificantResultPtrs.size(),
+                &sSignificantResultPtrs[0]);
+    }
+    pthread_mutex_lock(&sLock);
+}
+
+static void simRunRssi(int64_t now) {
+    if (!sRssiMonitor || sConfig.rssi_hz <= 0 || now < sRssiNext) {
+        return;
+    }
+    sRssiNext = simAdvance(sRssiNext, simPeriod(sConfig.rssi_hz), now);
+
+    sRssi = simClamp(sRssi + simRandomRange(-4, 4), -100, -20);
+    bool breached = sRssi > sMaxRssi || sRssi < sMinRssi;
+    bool report = breached && !sRssiBreached;
+    sRssiBreached = breached;
+    if (!report) {
+        return;
+    }
+
+    mac_addr bssid;
+    memset(bssid, 0, sizeof(bssid));
+    if (!sAps.empty()) {
+        memcpy(bssid, sAps[0].bssid, sizeof(bssid));
+    }
+    wifi_request_id id = sRssiMonitorId;
+    wifi_rssi_event_handler handler = sRssiHandler;
+    s8 rssi = sRssi;
+
+    pthread_mutex_unlock(&sLock);
+    if (handler.on_rssi_threshold_breached != NULL) {
+        handler.on_rssi_threshold_breached(id, bssid, rssi);
+    }
+    pthread_mutex_lock(&sLock);
+}
+
+static void simRunRtt(int64_t now) {
+    for (size_t i = 0; i < sRtt.size(); ) {
+        if (now < sRtt[i].due) {
+            i++;
+            continue;
+        }
+
+        SimRtt request = sRtt[i];
+        sRtt.erase(sRtt.begin() + i);
+
+        wifi_timestamp ts = simTimestampUs();
+        sRttResults.resize(request.configs.size());
+        sRttResultPtrs.resize(request.configs.size());
+        for (size_t j = 0; j < request.configs.size(); j++) {
+            const wifi_rtt_config &config = request.configs[j];
+            wifi_rtt_result &result = sRttResults[j];
+            memset(&result, 0, sizeof(result));
+
+            memcpy(result.addr, config.addr, sizeof(mac_addr));
+            result.measurement_number = 1;
+            result.success_number = 1;
+            result.number_per_burst_peer = config.num_frames_per_burst;
+            result.status = RTT_STATUS_SUCCESS;
+            result.type = config.type;
+            result.rssi = simRandomRange(-80, -40);
+            result.distance = simRandomRange(100, 5000);            /* cm */
+            result.distance_sd = result.distance / 10;
+            result.rtt = (wifi_timespan) result.distance * 200 / 3;  /* ps, round trip */
+            result.rtt_sd = result.rtt / 10;
+            result.ts = ts;
+            sRttResultPtrs[j] = &result;
+        }
+
+        pthread_mutex_unlock(&sLock);
+        if (request.handler.on_rtt_results != NULL) {
+            request.handler.on_rtt_results(request.id, sRttResultPtrs.size(),
+                    sRttResultPtrs.empty() ? NULL : &sRttResultPtrs[0]);
+        }
+        pthread_mutex_lock(&sLock);
+
+        /* the list may have changed while unlocked */
+        i = 0;
+    }
+}
+
+/* a connectivity style record: event id, BSSID TLV, vendor TLV padding to the record size */
+static int simBuildRingRecord(int ring) {
+    wifi_ring_buffer_entry *entry = (wifi_ring_buffer_entry *) sRingRecord;
+    u8 *payload = sRingRecord + sizeof(wifi_ring_buffer_entry);
+
+    int size = simClamp(sConfig.ring_record_bytes, SIM_MIN_RING_RECORD, SIM_MAX_RING_RECORD);
+    memset(payload, 0, size);
+
+    u16 event = ring == 0 ? WIFI_EVENT_ASSOC_COMPLETE : 0;
+    memcpy(payload, &event, sizeof(event));
+    int len = sizeof(event);
+
+    tlv_log tlv;
+    tlv.tag = WIFI_TAG_BSSID;
+    tlv.length = sizeof(mac_addr);
+    memcpy(payload + len, &tlv, sizeof(tlv));
+    len += sizeof(tlv);
+    if (!sAps.empty()) {
+        memcpy(payload + len, sAps[simRandom() % sAps.size()].bssid, sizeof(mac_addr));
+    }
+    len += sizeof(mac_addr);
+
+    if (size - len >= (int) sizeof(tlv)) {
+        tlv.tag = WIFI_TAG_VENDOR_SPECIFIC;
+        tlv.length = size - len - sizeof(tlv);
+        memcpy(payload + len, &tlv, sizeof(tlv));
+        len = size;
+    }
+
+    entry->entry_size = len;
+    entry->flags = RING_BUFFER_ENTRY_FLAGS_HAS_BINARY | RING_BUFFER_ENTRY_FLAGS_HAS_TIMESTAMP;
+    entry->type = sRingEntryTypes[ring];
+    entry->timestamp = simTimestampUs();
+    return sizeof(wifi_ring_buffer_entry) + len;
+}
+
+static void simRunRings(int64_t now) {
+    for (int i = 0; i < SIM_NUM_RINGS; i++) {
+        SimRing &ring = sRings[i];
+        if (!sLogHandlerSet || !ring.logging || sConfig.ring_hz <= 0 || now < ring.next) {
+            continue;
+        }
+        ring.next = simAdvance(ring.next, simPeriod(sConfig.ring_hz), now);
+
+        int size = simBuildRingRecord(i);
+        ring.status.written_bytes += size;
+        ring.status.read_bytes += size;
+        ring.status.written_records++;
+
+        wifi_ring_buffer_status status = ring.status;
+        wifi_ring_buffer_data_handler handler = sLogHandler;
+        strncpy(sRingName, sRingNames[i], sizeof(sRingName) - 1);
+
+        pthread_mutex_unlock(&sLock);
+        if (handler.on_ring_buffer_data != NULL) {
+            handler.on_ring_buffer_data(sRingName, (char *) sRingRecord, size, &status);
+        }
+        pthread_mutex_lock(&sLock);
+    }
+}
+
+static int64_t simNextEvent() {
+    int64_t next = -1;
+#define SIM_CONSIDER(cond, when) \
+    if ((cond) && (next < 0 || (when) < next)) next = (when)
+
+    for (int i = 0; sScanning && i < sScanParams.num_buckets; i++) {
+        SIM_CONSIDER(true, sBucketNext[i]);
+    }
+    SIM_CONSIDER(sHotlist && sConfig.hotlist_hz > 0, sHotlistNext);
+    SIM_CONSIDER(sSignificantChange && sConfig.significant_change_hz > 0,
+            sSignificantChangeNext);
+    SIM_CONSIDER(sRssiMonitor && sConfig.rssi_hz > 0, sRssiNext);
+    for (size_t i = 0; i < sRtt.size(); i++) {
+        SIM_CONSIDER(true, sRtt[i].due);
+    }
+    for (int i = 0; i < SIM_NUM_RINGS; i++) {
+        SIM_CONSIDER(sLogHandlerSet && sRings[i].logging && sConfig.ring_hz > 0,
+                sRings[i].next);
+    }
+
+#undef SIM_CONSIDER
+    return next;
+}
+
+static void simResetRequests() {
+    sScanning = false;
+    sCacheHead = 0;
+    sCacheCount = 0;
+    sScansSinceReport = 0;
+    sEpno = false;
+    sEpnoNetworks.clear();
+    sHotlist = false;
+    sHotlistAps.clear();
+    sSignificantChange = false;
+    sSignificantAps.clear();
+    sRssiMonitor = false;
+    sRtt.clear();
+    sLogHandlerSet = false;
+    memset(&sAlertHandler, 0, sizeof(sAlertHandler));
+    sNumOffloadedPackets = 0;
+    sTdlsPeers.clear();
+
+    for (int i = 0; i < SIM_NUM_RINGS; i++) {
+        SimRing &ring = sRings[i];
+        memset(&ring, 0, sizeof(ring));
+        strncpy((char *) ring.status.name, sRingNames[i], sizeof(ring.status.name) - 1);
+        ring.status.flags = RING_BUFFER_FLAG_HAS_BINARY_ENTRIES;
+        ring.status.ring_id = i;
+        ring.status.ring_buffer_byte_size = SIM_RING_SIZE;
+    }
+}
+
+static void simWake() {
+    pthread_cond_signal(&sCond);
+}
+
+/* ------------------------------------------------------------------------------------ */
+
+static wifi_error wifi_initialize_sim(wifi_handle *handle) {
+    pthread_once(&sOnce, simInitOnce);
+
+    pthread_mutex_lock(&sLock);
+    if (!sConfigured) {
+        wifi_hal_sim_get_default_config(&sConfig);
+        sConfigured = true;
+    }
+    simBuildPopulation();
+    simResetRequests();
+    sStartTime = simNow();
+    sRssi = -60;
+    sInitialized = true;
+    sExit = false;
+    pthread_mutex_unlock(&sLock);
+
+    *handle = (wifi_handle) &sSimWifiHandle;
+    return WIFI_SUCCESS;
+}
+
+static void wifi_cleanup_sim(wifi_handle handle, wifi_cleaned_up_handler handler) {
+    pthread_mutex_lock(&sLock);
+    sCleanedUpHandler = handler;
+    sExit = true;
+    simWake();
+    pthread_mutex_unlock(&sLock);
+}
+
+static void wifi_event_loop_sim(wifi_handle handle) {
+    pthread_mutex_lock(&sLock);
+    while (!sExit) {
+        int64_t now = simNow();
+        simRunScans(now);
+        simRunHotlist(now);
+        simRunSignificantChange(now);
+        simRunRssi(now);
+        simRunRtt(now);
+        simRunRings(now);
+        if (sExit) {
+            break;
+        }
+
+        int64_t next = simNextEvent();
+        if (next < 0) {
+            pthread_cond_wait(&sCond, &sLock);
+        } else if (next > simNow()) {
+            struct timespec ts;
+            ts.tv_sec = next / 1000000000LL;
+            ts.tv_nsec = next % 1000000000LL;
+            pthread_cond_timedwait(&sCond, &sLock, &ts);
+        }
+    }
+
+    simResetRequests();
+    sInitialized = false;
+    sExit = false;
+    wifi_cleaned_up_handler handler = sCleanedUpHandler;
+    sCleanedUpHandler = NULL;
+    pthread_mutex_unlock(&sLock);
+
+    if (handler != NULL) {
+        handler(handle);
+    }
+}
+
+static void wifi_get_error_info_sim(wifi_error err, const char **msg) {
+    switch (err) {
+        case WIFI_SUCCESS:                  *msg = "success"; break;
+        case WIFI_ERROR_NOT_SUPPORTED:      *msg = "not supported"; break;
+        case WIFI_ERROR_INVALID_ARGS:       *msg = "invalid arguments"; break;
+        case WIFI_ERROR_INVALID_REQUEST_ID: *msg = "invalid request id"; break;
+        case WIFI_ERROR_TOO_MANY_REQUESTS:  *msg = "too many requests"; break;
+        default:                            *msg = "simulated HAL error"; break;
+    }
+}
+
+static wifi_error wifi_get_supported_feature_set_sim(wifi_interface_handle iface,
+        feature_set *set) {
+    *set = WIFI_FEATURE_INFRA | WIFI_FEATURE_INFRA_5G | WIFI_FEATURE_GSCAN
+            | WIFI_FEATURE_D2AP_RTT | WIFI_FEATURE_TDLS | WIFI_FEATURE_LINK_LAYER_STATS
+            | WIFI_FEATURE_LOGGER | WIFI_FEATURE_HAL_EPNO | WIFI_FEATURE_RSSI_MONITOR
+            | WIFI_FEATURE_MKEEP_ALIVE;
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_concurrency_matrix_sim(wifi_interface_handle iface, int max_size,
+        feature_set *matrix, int *size) {
+    *size = 0;
+    if (max_size > 0) {
+        wifi_get_supported_feature_set_sim(iface, &matrix[0]);
+        *size = 1;
+    }
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_set_scanning_mac_oui_sim(wifi_interface_handle iface,
+        unsigned char *oui) {
+    return WIFI_SUCCESS;
+}
+
+static int simCopyChannels(int band, int max, wifi_channel *channels) {
+    int num = 0;
+    for (size_t i = 0; (band & WIFI_BAND_BG) && i < SIM_ARRAY_SIZE(sChannels24) && num < max; i++) {
+        channels[num++] = sChannels24[i];
+    }
+    for (size_t i = 0; (band & WIFI_BAND_A) && i < SIM_ARRAY_SIZE(sChannels5) && num < max; i++) {
+        channels[num++] = sChannels5[i];
+    }
+    for (size_t i = 0; (band & WIFI_BAND_A_DFS) && i < SIM_ARRAY_SIZE(sChannelsDfs) && num < max;
+            i++) {
+        channels[num++] = sChannelsDfs[i];
+    }
+    return num;
+}
+
+/* *size holds the capacity of list on entry */
+static wifi_error wifi_get_supported_channels_sim(wifi_handle handle, int *size,
+        wifi_channel *list) {
+    *size = simCopyChannels(WIFI_BAND_ABG_WITH_DFS, *size, list);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_is_epr_supported_sim(wifi_handle handle) {
+    return WIFI_ERROR_NOT_SUPPORTED;
+}
+
+static wifi_error wifi_get_ifaces_sim(wifi_handle handle, int *num,
+        wifi_interface_handle **ifaces) {
+    static wifi_interface_handle iface = (wifi_interface_handle) &sSimIfaceHandle;
+    *num = 1;
+    *ifaces = &iface;
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_iface_name_sim(wifi_interface_handle iface, char *name,
+        size_t size) {
+    snprintf(name, size, "%s", SIM_IFACE_NAME);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_set_iface_event_handler_sim(wifi_request_id id,
+        wifi_interface_handle iface, wifi_event_handler eh) {
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_reset_iface_event_handler_sim(wifi_request_id id,
+        wifi_interface_handle iface) {
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_start_gscan_sim(wifi_request_id id, wifi_interface_handle iface,
+        wifi_scan_cmd_params params, wifi_scan_result_handler handler) {
+    if (params.num_buckets <= 0 || params.num_buckets > MAX_BUCKETS) {
+        return WIFI_ERROR_INVALID_ARGS;
+    }
+
+    pthread_mutex_lock(&sLock);
+    sScanning = true;
+    sScanId = id;
+    sScanParams = params;
+    sScanHandler = handler;
+    sCacheHead = 0;
+    sCacheCount = 0;
+    sScansSinceReport = 0;
+
+    int64_t now = simNow();
+    for (int i = 0; i < params.num_buckets; i++) {
+        sBucketNext[i] = now;
+    }
+    simWake();
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_stop_gscan_sim(wifi_request_id id, wifi_interface_handle iface) {
+    pthread_mutex_lock(&sLock);
+    wifi_error result = WIFI_ERROR_INVALID_REQUEST_ID;
+    if (sScanning && sScanId == id) {
+        sScanning = false;
+        result = WIFI_SUCCESS;
+    }
+    pthread_mutex_unlock(&sLock);
+    return result;
+}
+
+static wifi_error wifi_get_cached_gscan_results_sim(wifi_interface_handle iface, byte flush,
+        int max, wifi_cached_scan_results *results, int *num) {
+    pthread_mutex_lock(&sLock);
+    int n = std::max(std::min(max, sCacheCount), 0);
+    for (int i = 0; i < n; i++) {
+        results[i] = sCache[(sCacheHead + i) % SIM_CACHED_SCANS];
+    }
+    if (flush) {
+        sCacheHead = (sCacheHead + n) % SIM_CACHED_SCANS;
+        sCacheCount -= n;
+    }
+    *num = n;
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_set_bssid_hotlist_sim(wifi_request_id id, wifi_interface_handle iface,
+        wifi_bssid_hotlist_params params, wifi_hotlist_ap_found_handler handler) {
+    if (params.num_bssid < 0 || params.num_bssid > MAX_HOTLIST_APS) {
+        return WIFI_ERROR_INVALID_ARGS;
+    }
+
+    pthread_mutex_lock(&sLock);
+    sHotlist = true;
+    sHotlistId = id;
+    sHotlistHandler = handler;
+    sHotlistLostSamples = params.lost_ap_sample_size > 0 ? params.lost_ap_sample_size : 3;
+    sHotlistAps.resize(params.num_bssid);
+    for (int i = 0; i < params.num_bssid; i++) {
+        sHotlistAps[i].param = params.ap[i];
+        sHotlistAps[i].ap = simFindAp(params.ap[i].bssid);
+        sHotlistAps[i].seen = false;
+        sHotlistAps[i].missed = 0;
+    }
+    sHotlistNext = simNow();
+    simWake();
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_reset_bssid_hotlist_sim(wifi_request_id id, wifi_interface_handle iface) {
+    pthread_mutex_lock(&sLock);
+    sHotlist = false;
+    sHotlistAps.clear();
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_set_significant_change_handler_sim(wifi_request_id id,
+        wifi_interface_handle iface, wifi_significant_change_params params,
+        wifi_significant_change_handler handler) {
+    if (params.num_bssid < 0 || params.num_bssid > MAX_SIGNIFICANT_CHANGE_APS) {
+        return WIFI_ERROR_INVALID_ARGS;
+    }
+
+    pthread_mutex_lock(&sLock);
+    sSignificantChange = true;
+    sSignificantChangeId = id;
+    sSignificantChangeParams = params;
+    sSignificantChangeHandler = handler;
+    sSignificantAps.resize(params.num_bssid);
+    for (int i = 0; i < params.num_bssid; i++) {
+        SimSignificantAp &ap = sSignificantAps[i];
+        ap.param = params.ap[i];
+        ap.ap = simFindAp(params.ap[i].bssid);
+        ap.rssi = ap.ap >= 0 ? sAps[ap.ap].rssi : (params.ap[i].low + params.ap[i].high) / 2;
+    }
+    sSignificantChangeNext = simNow();
+    simWake();
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_reset_significant_change_handler_sim(wifi_request_id id,
+        wifi_interface_handle iface) {
+    pthread_mutex_lock(&sLock);
+    sSignificantChange = false;
+    sSignificantAps.clear();
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_gscan_capabilities_sim(wifi_interface_handle iface,
+        wifi_gscan_capabilities *capabilities) {
+    memset(capabilities, 0, sizeof(*capabilities));
+    capabilities->max_scan_cache_size = SIM_CACHED_SCANS * MAX_AP_CACHE_PER_SCAN;
+    capabilities->max_scan_buckets = MAX_BUCKETS;
+    capabilities->max_ap_cache_per_scan = MAX_AP_CACHE_PER_SCAN;
+    capabilities->max_rssi_sample_size = SIM_MAX_RSSI_SAMPLES;
+    capabilities->max_scan_reporting_threshold = 100;
+    capabilities->max_hotlist_bssids = MAX_HOTLIST_APS;
+    capabilities->max_significant_wifi_change_aps = MAX_SIGNIFICANT_CHANGE_APS;
+    capabilities->max_number_epno_networks = MAX_PNO_SSID;
+    capabilities->max_number_epno_networks_by_ssid = MAX_PNO_SSID;
+    capabilities->max_number_of_white_listed_ssid = MAX_WHITELIST_SSID;
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_set_link_stats_sim(wifi_interface_handle iface,
+        wifi_link_layer_params params) {
+    return WIFI_SUCCESS;
+}
+
+/* counters grow with time since wifi_initialize, so successive reads look plausible */
+static wifi_error wifi_get_link_stats_sim(wifi_request_id id, wifi_interface_handle iface,
+        wifi_stats_result_handler handler) {
+    pthread_mutex_lock(&sLock);
+    u32 ms = (u32)((simNow() - sStartTime) / 1000000LL);
+    int peers = std::max(sConfig.link_stats_peers, 0);
+    int rssi = sRssi;
+    pthread_mutex_unlock(&sLock);
+
+    std::vector<u64> buf((sizeof(wifi_iface_stat) + peers * sizeof(wifi_peer_info)
+            + sizeof(u64) - 1) / sizeof(u64), 0);
+    wifi_iface_stat *stat = (wifi_iface_stat *) &buf[0];
+
+    stat->iface = iface;
+    stat->info.mode = WIFI_INTERFACE_STA;
+    stat->info.state = WIFI_ASSOCIATED;
+    stat->beacon_rx = ms / 100;
+    stat->rssi_mgmt = rssi;
+    stat->rssi_data = rssi;
+    stat->rssi_ack = rssi;
+    for (int ac = 0; ac < WIFI_AC_MAX; ac++) {
+        stat->ac[ac].ac = (wifi_traffic_ac) ac;
+        stat->ac[ac].tx_mpdu = ms / (ac + 1);
+        stat->ac[ac].rx_mpdu = 2 * ms / (ac + 1);
+        stat->ac[ac].mpdu_lost = ms / (100 * (ac + 1));
+        stat->ac[ac].retries = ms / (20 * (ac + 1));
+    }
+    stat->num_peers = peers;
+    for (int i = 0; i < peers; i++) {
+        stat->peer_info[i].type = i == 0 ? WIFI_PEER_AP : WIFI_PEER_TDLS;
+        stat->peer_info[i].peer_mac_address[0] = 0x02;
+        stat->peer_info[i].peer_mac_address[5] = i;
+    }
+
+    wifi_radio_stat radio;
+    memset(&radio, 0, sizeof(radio));
+    radio.on_time = ms;
+    radio.tx_time = ms / 10;
+    radio.rx_time = ms / 5;
+    radio.on_time_scan = ms / 20;
+
+    if (handler.on_link_stats_results != NULL) {
+        handler.on_link_stats_results(id, stat, 1, &radio);
+    }
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_clear_link_stats_sim(wifi_interface_handle iface,
+        u32 stats_clear_req_mask, u32 *stats_clear_rsp_mask, u8 stop_req, u8 *stop_rsp) {
+    *stats_clear_rsp_mask = stats_clear_req_mask;
+    *stop_rsp = stop_req;
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_valid_channels_sim(wifi_interface_handle iface, int band,
+        int max_channels, wifi_channel *channels, int *num_channels) {
+    *num_channels = simCopyChannels(band, max_channels, channels);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_rtt_range_request_sim(wifi_request_id id, wifi_interface_handle iface,
+        unsigned num_rtt_config, wifi_rtt_config rtt_config[],
+        wifi_rtt_event_handler handler) {
+    pthread_mutex_lock(&sLock);
+    SimRtt request;
+    request.id = id;
+    request.due = simNow() + std::max(sConfig.rtt_latency_ms, 0) * 1000000LL;
+    request.configs.assign(rtt_config, rtt_config + num_rtt_config);
+    request.handler = handler;
+    sRtt.push_back(request);
+    simWake();
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_rtt_range_cancel_sim(wifi_request_id id, wifi_interface_handle iface,
+        unsigned num_devices, mac_addr addr[]) {
+    pthread_mutex_lock(&sLock);
+    for (size_t i = 0; i < sRtt.size(); ) {
+        std::vector<wifi_rtt_config> &configs = sRtt[i].configs;
+        for (size_t j = 0; j < configs.size(); ) {
+            bool cancel = num_devices == 0;
+            for (unsigned k = 0; k < num_devices && !cancel; k++) {
+                cancel = memcmp(configs[j].addr, addr[k], sizeof(mac_addr)) == 0;
+            }
+            if (sRtt[i].id == id && cancel) {
+                configs.erase(configs.begin() + j);
+            } else {
+                j++;
+            }
+        }
+        if (configs.empty()) {
+            sRtt.erase(sRtt.begin() + i);
+        } else {
+            i++;
+        }
+    }
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_rtt_capabilities_sim(wifi_interface_handle iface,
+        wifi_rtt_capabilities *capabilities) {
+    memset(capabilities, 0, sizeof(*capabilities));
+    capabilities->rtt_one_sided_supported = 1;
+    capabilities->rtt_ftm_supported = 1;
+    capabilities->preamble_support = WIFI_RTT_PREAMBLE_LEGACY;
+    capabilities->bw_support = WIFI_RTT_BW_20;
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_start_logging_sim(wifi_interface_handle iface, u32 verbose_level,
+        u32 flags, u32 max_interval_sec, u32 min_data_size, char *buffer_name) {
+    wifi_error result = WIFI_ERROR_INVALID_ARGS;
+
+    pthread_mutex_lock(&sLock);
+    for (int i = 0; i < SIM_NUM_RINGS; i++) {
+        if (buffer_name != NULL && strcmp(buffer_name, sRingNames[i]) == 0) {
+            sRings[i].status.verbose_level = verbose_level;
+            sRings[i].logging = verbose_level > 0;
+            sRings[i].next = simNow();
+            result = WIFI_SUCCESS;
+        }
+    }
+    simWake();
+    pthread_mutex_unlock(&sLock);
+    return result;
+}
+
+static wifi_error wifi_set_epno_list_sim(int id, wifi_interface_info *iface, int num_networks,
+        wifi_epno_network *networks, wifi_epno_handler handler) {
+    if (num_networks < 0 || num_networks > MAX_PNO_SSID) {
+        return WIFI_ERROR_INVALID_ARGS;
+    }
+
+    pthread_mutex_lock(&sLock);
+    sEpno = num_networks > 0;
+    sEpnoId = id;
+    sEpnoHandler = handler;
+    sEpnoNetworks.assign(networks, networks + num_networks);
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_set_country_code_sim(wifi_interface_handle iface, const char *code) {
+    pthread_mutex_lock(&sLock);
+    snprintf(sCountryCode, sizeof(sCountryCode), "%s", code);
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_firmware_memory_dump_sim(wifi_interface_handle iface,
+        wifi_firmware_memory_dump_handler handler) {
+    std::vector<char> dump(SIM_MEMORY_DUMP_SIZE);
+    for (size_t i = 0; i < dump.size(); i++) {
+        dump[i] = (char) i;
+    }
+    if (handler.on_firmware_memory_dump != NULL) {
+        handler.on_firmware_memory_dump(&dump[0], dump.size());
+    }
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_set_log_handler_sim(wifi_request_id id, wifi_interface_handle iface,
+        wifi_ring_buffer_data_handler handler) {
+    pthread_mutex_lock(&sLock);
+    sLogHandler = handler;
+    sLogHandlerSet = true;
+    simWake();
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_reset_log_handler_sim(wifi_request_id id, wifi_interface_handle iface) {
+    pthread_mutex_lock(&sLock);
+    sLogHandlerSet = false;
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_set_alert_handler_sim(wifi_request_id id, wifi_interface_handle iface,
+        wifi_alert_handler handler) {
+    pthread_mutex_lock(&sLock);
+    sAlertHandler = handler;
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_reset_alert_handler_sim(wifi_request_id id, wifi_interface_handle iface) {
+    pthread_mutex_lock(&sLock);
+    memset(&sAlertHandler, 0, sizeof(sAlertHandler));
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_firmware_version_sim(wifi_interface_handle iface, char *buffer,
+        int buffer_size) {
+    snprintf(buffer, buffer_size, "sim-fw 1.0");
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_driver_version_sim(wifi_interface_handle iface, char *buffer,
+        int buffer_size) {
+    snprintf(buffer, buffer_size, "sim-driver 1.0");
+    return WIFI_SUCCESS;
+}
+
+/* *num_rings holds the capacity of status on entry */
+static wifi_error wifi_get_ring_buffers_status_sim(wifi_interface_handle iface,
+        u32 *num_rings, wifi_ring_buffer_status *status) {
+    pthread_mutex_lock(&sLock);
+    u32 num = std::min(*num_rings, (u32) SIM_NUM_RINGS);
+    for (u32 i = 0; i < num; i++) {
+        status[i] = sRings[i].status;
+    }
+    *num_rings = num;
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_logger_supported_feature_set_sim(wifi_interface_handle iface,
+        unsigned int *support) {
+    *support = WIFI_LOGGER_MEMORY_DUMP_SUPPORTED | WIFI_LOGGER_CONNECT_EVENT_SUPPORTED
+            | WIFI_LOGGER_POWER_EVENT_SUPPORTED | WIFI_LOGGER_VERBOSE_SUPPORTED;
+    return WIFI_SUCCESS;
+}
+
+/* flushes the ring by having the event loop emit a record right away */
+static wifi_error wifi_get_ring_data_sim(wifi_interface_handle iface, char *ring_name) {
+    wifi_error result = WIFI_ERROR_INVALID_ARGS;
+
+    pthread_mutex_lock(&sLock);
+    for (int i = 0; i < SIM_NUM_RINGS; i++) {
+        if (ring_name != NULL && strcmp(ring_name, sRingNames[i]) == 0) {
+            sRings[i].next = simNow();
+            result = WIFI_SUCCESS;
+        }
+    }
+    simWake();
+    pthread_mutex_unlock(&sLock);
+    return result;
+}
+
+static wifi_error wifi_enable_tdls_sim(wifi_interface_handle iface, mac_addr addr,
+        wifi_tdls_params *params, wifi_tdls_handler handler) {
+    wifi_error result = WIFI_SUCCESS;
+
+    pthread_mutex_lock(&sLock);
+    if (sTdlsPeers.size() >= SIM_MAX_TDLS_PEERS) {
+        result = WIFI_ERROR_TOO_MANY_REQUESTS;
+    } else {
+        SimAp peer;
+        memset(&peer, 0, sizeof(peer));
+        memcpy(peer.bssid, addr, sizeof(mac_addr));
+        peer.channel = params != NULL ? params->channel : 0;
+        sTdlsPeers.push_back(peer);
+    }
+    pthread_mutex_unlock(&sLock);
+    return result;
+}
+
+static wifi_error wifi_disable_tdls_sim(wifi_interface_handle iface, mac_addr addr) {
+    pthread_mutex_lock(&sLock);
+    for (size_t i = 0; i < sTdlsPeers.size(); i++) {
+        if (memcmp(sTdlsPeers[i].bssid, addr, sizeof(mac_addr)) == 0) {
+            sTdlsPeers.erase(sTdlsPeers.begin() + i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_tdls_status_sim(wifi_interface_handle iface, mac_addr addr,
+        wifi_tdls_status *status) {
+    memset(status, 0, sizeof(*status));
+    status->state = WIFI_TDLS_DISABLED;
+
+    pthread_mutex_lock(&sLock);
+    for (size_t i = 0; i < sTdlsPeers.size(); i++) {
+        if (memcmp(sTdlsPeers[i].bssid, addr, sizeof(mac_addr)) == 0) {
+            status->channel = sTdlsPeers[i].channel;
+            status->state = WIFI_TDLS_ESTABLISHED;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_get_tdls_capabilities_sim(wifi_interface_handle iface,
+        wifi_tdls_capabilities *capabilities) {
+    memset(capabilities, 0, sizeof(*capabilities));
+    capabilities->max_concurrent_tdls_session_num = SIM_MAX_TDLS_PEERS;
+    capabilities->is_per_mac_tdls_supported = 1;
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_set_nodfs_flag_sim(wifi_interface_handle iface, u32 nodfs) {
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_set_ssid_white_list_sim(wifi_request_id id, wifi_interface_handle iface,
+        int num_networks, wifi_ssid *ssids) {
+    return num_networks <= MAX_WHITELIST_SSID ? WIFI_SUCCESS : WIFI_ERROR_INVALID_ARGS;
+}
+
+static wifi_error wifi_set_gscan_roam_params_sim(wifi_request_id id,
+        wifi_interface_handle iface, wifi_roam_params *params) {
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_set_bssid_preference_sim(wifi_request_id id,
+        wifi_interface_handle iface, int num_bssid, wifi_bssid_preference *prefs) {
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_set_bssid_blacklist_sim(wifi_request_id id, wifi_interface_handle iface,
+        wifi_bssid_params params) {
+    return params.num_bssid <= MAX_BLACKLIST_BSSID ? WIFI_SUCCESS : WIFI_ERROR_INVALID_ARGS;
+}
+
+static wifi_error wifi_enable_lazy_roam_sim(wifi_request_id id, wifi_interface_handle iface,
+        int enable) {
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_start_sending_offloaded_packet_sim(wifi_request_id id,
+        wifi_interface_handle iface, u8 *ip_packet, u16 ip_packet_len,
+        u8 *src_mac_addr, u8 *dst_mac_addr, u32 period_msec) {
+    wifi_error result = WIFI_SUCCESS;
+
+    pthread_mutex_lock(&sLock);
+    int i = 0;
+    while (i < sNumOffloadedPackets && sOffloadedPackets[i] != id) {
+        i++;
+    }
+    if (i == sNumOffloadedPackets) {
+        if (sNumOffloadedPackets == SIM_MAX_OFFLOADED_PACKETS) {
+            result = WIFI_ERROR_TOO_MANY_REQUESTS;
+        } else {
+            sOffloadedPackets[sNumOffloadedPackets++] = id;
+        }
+    }
+    pthread_mutex_unlock(&sLock);
+    return result;
+}
+
+static wifi_error wifi_stop_sending_offloaded_packet_sim(wifi_request_id id,
+        wifi_interface_handle iface) {
+    wifi_error result = WIFI_ERROR_INVALID_REQUEST_ID;
+
+    pthread_mutex_lock(&sLock);
+    for (int i = 0; i < sNumOffloadedPackets; i++) {
+        if (sOffloadedPackets[i] == id) {
+            sOffloadedPackets[i] = sOffloadedPackets[--sNumOffloadedPackets];
+            result = WIFI_SUCCESS;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sLock);
+    return result;
+}
+
+static wifi_error wifi_start_rssi_monitoring_sim(wifi_request_id id,
+        wifi_interface_handle iface, s8 max_rssi, s8 min_rssi, wifi_rssi_event_handler eh) {
+    pthread_mutex_lock(&sLock);
+    sRssiMonitor = true;
+    sRssiMonitorId = id;
+    sMaxRssi = max_rssi;
+    sMinRssi = min_rssi;
+    sRssiHandler = eh;
+    sRssiBreached = false;
+    sRssiNext = simNow();
+    simWake();
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+static wifi_error wifi_stop_rssi_monitoring_sim(wifi_request_id id,
+        wifi_interface_handle iface) {
+    pthread_mutex_lock(&sLock);
+    sRssiMonitor = false;
+    pthread_mutex_unlock(&sLock);
+    return WIFI_SUCCESS;
+}
+
+wifi_error init_wifi_vendor_hal_func_table(wifi_hal_fn *fn) {
+    if (fn == NULL) {
+        return WIFI_ERROR_UNKNOWN;
+    }
+
+    fn->wifi_initialize = wifi_initialize_sim;
+    fn->wifi_cleanup = wifi_cleanup_sim;
+    fn->wifi_event_loop = wifi_event_loop_sim;
+    fn->wifi_get_error_info = wifi_get_error_info_sim;
+    fn->wifi_get_supported_feature_set = wifi_get_supported_feature_set_sim;
+    fn->wifi_get_concurrency_matrix = wifi_get_concurrency_matrix_sim;
+    fn->wifi_set_scanning_mac_oui = wifi_set_scanning_mac_oui_sim;
+    fn->wifi_get_supported_channels = wifi_get_supported_channels_sim;
+    fn->wifi_is_epr_supported = wifi_is_epr_supported_sim;
+    fn->wifi_get_ifaces = wifi_get_ifaces_sim;
+    fn->wifi_get_iface_name = wifi_get_iface_name_sim;
+    fn->wifi_set_iface_event_handler = wifi_set_iface_event_handler_sim;
+    fn->wifi_reset_iface_event_handler = wifi_reset_iface_event_handler_sim;
+    fn->wifi_start_gscan = wifi_start_gscan_sim;
+    fn->wifi_stop_gscan = wifi_stop_gscan_sim;
+    fn->wifi_get_cached_gscan_results = wifi_get_cached_gscan_results_sim;
+    fn->wifi_set_bssid_hotlist = wifi_set_bssid_hotlist_sim;
+    fn->wifi_reset_bssid_hotlist = wifi_reset_bssid_hotlist_sim;
+    fn->wifi_set_significant_change_handler = wifi_set_significant_change_handler_sim;
+    fn->wifi_reset_significant_change_handler = wifi_reset_significant_change_handler_sim;
+    fn->wifi_get_gscan_capabilities = wifi_get_gscan_capabilities_sim;
+    fn->wifi_set_link_stats = wifi_set_link_stats_sim;
+    fn->wifi_get_link_stats = wifi_get_link_stats_sim;
+    fn->wifi_clear_link_stats = wifi_clear_link_stats_sim;
+    fn->wifi_get_valid_channels = wifi_get_valid_channels_sim;
+    fn->wifi_rtt_range_request = wifi_rtt_range_request_sim;
+    fn->wifi_rtt_range_cancel = wifi_rtt_range_cancel_sim;
+    fn->wifi_get_rtt_capabilities = wifi_get_rtt_capabilities_sim;
+    fn->wifi_start_logging = wifi_start_logging_sim;
+    fn->wifi_set_epno_list = wifi_set_epno_list_sim;
+    fn->wifi_set_country_code = wifi_set_country_code_sim;
+    fn->wifi_get_firmware_memory_dump = wifi_get_firmware_memory_dump_sim;
+    fn->wifi_set_log_handler = wifi_set_log_handler_sim;
+    fn->wifi_reset_log_handler = wifi_reset_log_handler_sim;
+    fn->wifi_set_alert_handler = wifi_set_alert_handler_sim;
+    fn->wifi_reset_alert_handler = wifi_reset_alert_handler_sim;
+    fn->wifi_get_firmware_version = wifi_get_firmware_version_sim;
+    fn->wifi_get_ring_buffers_status = wifi_get_ring_buffers_status_sim;
+    fn->wifi_get_logger_supported_feature_set = wifi_get_logger_supported_feature_set_sim;
+    fn->wifi_get_ring_data = wifi_get_ring_data_sim;
+    fn->wifi_get_driver_version = wifi_get_driver_version_sim;
+    fn->wifi_enable_tdls = wifi_enable_tdls_sim;
+    fn->wifi_disable_tdls = wifi_disable_tdls_sim;
+    fn->wifi_get_tdls_status = wifi_get_tdls_status_sim;
+    fn->wifi_get_tdls_capabilities = wifi_get_tdls_capabilities_sim;
+    fn->wifi_set_nodfs_flag = wifi_set_nodfs_flag_sim;
+    fn->wifi_set_ssid_white_list = wifi_set_ssid_white_list_sim;
+    fn->wifi_set_gscan_roam_params = wifi_set_gscan_roam_params_sim;
+    fn->wifi_set_bssid_preference = wifi_set_bssid_preference_sim;
+    fn->wifi_set_bssid_blacklist = wifi_set_bssid_blacklist_sim;
+    fn->wifi_enable_lazy_roam = wifi_enable_lazy_roam_sim;
+    fn->wifi_start_sending_offloaded_packet = wifi_start_sending_offloaded_packet_sim;
+    fn->wifi_stop_sending_offloaded_packet = wifi_stop_sending_offloaded_packet_sim;
+    fn->wifi_start_rssi_monitoring = wifi_start_rssi_monitoring_sim;
+    fn->wifi_stop_rssi_monitoring = wifi_stop_rssi_monitoring_sim;
+    return WIFI_SUCCESS;
+}
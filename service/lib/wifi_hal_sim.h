@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_SIM_H__
+#define __WIFI_HAL_SIM_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include "wifi_hal.h"
+
+/*
+ * Knobs of the simulated vendor HAL (libwifi-hal-sim). Rates are events per second while
+ * the matching request is active; 0 turns a stream off. The same seed always produces the
+ * same population and the same sequence of events.
+ */
+typedef struct {
+    unsigned seed;
+    int num_aps;                    /* simulated population */
+    int visible_percent;            /* share of the population seen by any one scan */
+    int scan_hz;                    /* scan completions; 0 follows the bucket periods */
+    int hotlist_hz;                 /* hotlist found / lost rounds */
+    int significant_change_hz;      /* significant change rounds */
+    int rssi_hz;                    /* RSSI samples checked against the monitor range */
+    int ring_hz;                    /* ring buffer data callbacks, per logging ring */
+    int ring_record_bytes;          /* payload of each ring buffer record */
+    int rtt_latency_ms;             /* delay before RTT results come back */
+    int link_stats_peers;           /* peers in each link layer stats report */
+} wifi_hal_sim_config;
+
+/*
+ * The defaults, overridden by "key=value,..." pairs from the WIFI_HAL_SIM environment
+ * variable, e.g. WIFI_HAL_SIM="num_aps=500,scan_hz=10"; keys are the field names above.
+ */
+void wifi_hal_sim_get_default_config(wifi_hal_sim_config *config);
+
+/* replaces the configuration; takes effect at the next wifi_initialize */
+void wifi_hal_sim_set_config(const wifi_hal_sim_config *config);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //__WIFI_HAL_SIM_H__
@@ -251,3 +251,12 @@ wifi_error wifi_start_sending_offloaded_packet_stub(wifi_request_id id,
 wifi_error wifi_stop_sending_offloaded_packet_stub(wifi_request_id id, wifi_interface_handle iface) {
     return WIFI_ERROR_NOT_SUPPORTED;
 }
+
+wifi_error wifi_start_rssi_monitoring_stub(wifi_request_id id, wifi_interface_handle iface,
+        s8 max_rssi, s8 min_rssi, wifi_rssi_event_handler eh) {
+    return WIFI_ERROR_NOT_SUPPORTED;
+}
+
+wifi_error wifi_stop_rssi_monitoring_stub(wifi_request_id id, wifi_interface_handle iface) {
+    return WIFI_ERROR_NOT_SUPPORTED;
+}
@@ -0,0 +1,139 @@
+# Copyright (C) 2016 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+LOCAL_PATH := $(call my-dir)
+
+# Fuzz the ring buffer record decoder and the ring logs built on it
+# ============================================================
+
+include $(CLEAR_VARS)
+
+LOCAL_CFLAGS += -Wno-unused-parameter
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../../jni \
+	$(call include-path-for, libhardware_legacy)/hardware_legacy
+
+LOCAL_SRC_FILES := \
+	wifi_ring_record_fuzzer.cpp \
+	../../jni/wifi_ring_decoder.cpp \
+	../../jni/wifi_ring_log.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+	libutils \
+	libcutils \
+	liblog
+
+LOCAL_MODULE := wifi_ring_record_fuzzer
+
+include $(BUILD_HOST_FUZZ_TEST)
+
+# Fuzz the IE summary handed to Java with full scan results
+# ============================================================
+
+include $(CLEAR_VARS)
+
+LOCAL_CFLAGS += -Wno-unused-parameter
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../../jni \
+	$(call include-path-for, libhardware_legacy)/hardware_legacy
+
+LOCAL_SRC_FILES := \
+	wifi_ie_summary_fuzzer.cpp \
+	../../jni/wifi_ie_summary.cpp
+
+LOCAL_MODULE := wifi_ie_summary_fuzzer
+
+include $(BUILD_HOST_FUZZ_TEST)
+
+# Fuzz the ANQP payload indexer; start it from corpus/anqp
+# ============================================================
+
+include $(CLEAR_VARS)
+
+LOCAL_CFLAGS += -Wno-unused-parameter
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../../jni
+
+LOCAL_SRC_FILES := \
+	wifi_anqp_fuzzer.cpp \
+	../../jni/wifi_anqp.cpp
+
+LOCAL_MODULE := wifi_anqp_fuzzer
+
+include $(BUILD_HOST_FUZZ_TEST)
+
+# Benchmark the JNI bridge against a fake JNIEnv and the simulated HAL
+# ============================================================
+
+include $(CLEAR_VARS)
+
+LOCAL_CFLAGS += -Wno-unused-parameter
+
+# include/ first, so its AndroidRuntime.h stands in for libandroid_runtime's
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/include \
+	$(LOCAL_PATH)/../../jni \
+	$(LOCAL_PATH)/../../lib \
+	$(JNI_H_INCLUDE) \
+	$(call include-path-for, libhardware_legacy)/hardware_legacy \
+	libcore/include \
+	external/zlib
+
+# the bridge itself is compiled in by wifi_jni_benchmark.cpp
+LOCAL_SRC_FILES := \
+	wifi_jni_benchmark.cpp \
+	fake_jni_env.cpp \
+	../../jni/jni_helper.cpp \
+	../../jni/wifi_fw_dump.cpp \
+	../../jni/wifi_ring_log.cpp \
+	../../jni/wifi_ring_decoder.cpp \
+	../../jni/wifi_ring_status.cpp \
+	../../jni/wifi_epno.cpp \
+	../../jni/wifi_hotlist.cpp \
+	../../jni/wifi_significant_change.cpp \
+	../../jni/wifi_timer_wheel.cpp \
+	../../jni/wifi_scan_cache.cpp \
+	../../jni/wifi_gscan_emu.cpp \
+	../../jni/wifi_hal_trace.cpp \
+	../../jni/wifi_call_stats.cpp \
+	../../jni/wifi_ie_summary.cpp \
+	../../jni/wifi_anqp.cpp \
+	../../jni/wifi_domain_trie.cpp \
+	../../jni/wifi_scan_filter.cpp \
+	../../jni/wifi_roam_scorer.cpp \
+	../../jni/wifi_blacklist.cpp \
+	../../jni/wifi_ssid_table.cpp \
+	../../jni/wifi_keepalive.cpp \
+	../../jni/wifi_rssi_monitor.cpp \
+	../../jni/wifi_tdls.cpp \
+	../../lib/wifi_hal_stub.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libnativehelper
+
+LOCAL_STATIC_LIBRARIES := \
+	libwifi-hal-sim \
+	libutils \
+	libcutils \
+	liblog \
+	libz
+
+LOCAL_LDLIBS := -lpthread
+
+LOCAL_MODULE := wifi_jni_benchmark
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,877 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "fake_jni_env.h"
+
+namespace android {
+
+/*
+ * Rough cost of each call under ART on a mid-range arm64 device, in ns. Lookups walk the
+ * class's members by name, and FindClass also goes through the class loader; allocations
+ * include their share of GC; upcalls are to compiled code. Only their ratios matter.
+ */
+enum {
+    COST_FIND_CLASS         = 2500,
+    COST_GET_FIELD_ID       = 350,
+    COST_GET_METHOD_ID      = 450,
+    COST_THROW              = 2000,
+    COST_REF                = 15,       /* local refs, IsSameObject, GetObjectClass */
+    COST_GLOBAL_REF         = 80,
+    COST_ALLOC_OBJECT       = 150,
+    COST_CONSTRUCTOR        = 100,      /* the upcall into <init> */
+    COST_ALLOC_ARRAY        = 100,
+    COST_ALLOC_STRING       = 150,
+    COST_PER_BYTE_DIV       = 4,        /* copies cost 1 ns per this many bytes */
+    COST_FIELD              = 20,
+    COST_OBJECT_FIELD       = 30,       /* includes the card mark */
+    COST_ARRAY_ELEMENTS     = 60,       /* Get/Release<Type>ArrayElements, each */
+    COST_ARRAY_REGION       = 40,
+    COST_STRING_CHARS       = 100,
+    COST_UPCALL             = 350,
+    COST_CHECK              = 5,        /* ExceptionCheck, GetArrayLength and the like */
+    COST_NATIVE_CALL        = 180,      /* the thread state transitions of a regular native */
+    COST_FAST_NATIVE_CALL   = 60,       /* a "!" native skips them */
+};
+
+enum {
+    KIND_OBJECT,
+    KIND_CLASS,
+    KIND_STRING,
+    KIND_ARRAY,
+    KIND_OBJECT_ARRAY,
+};
+
+struct FakeJni::Member {
+    Object *cls;
+    std::string name;
+    std::string signature;
+    void *native;                   /* methods registered with RegisterNatives */
+    bool fast;
+};
+
+struct FakeJni::Object {
+    Object *cls;                    /* NULL for classes */
+    int kind;
+    int globalRefs;
+    std::map<const Member *, jvalue> fields;        /* statics, for a class */
+    std::string string;                             /* contents, or a class's name */
+    std::vector<uint8_t> data;                      /* primitive array contents */
+    std::vector<jobject> elements;                  /* object array contents */
+    size_t length;
+    std::map<std::string, Member *> members;        /* a class's fields and methods */
+};
+
+FakeJni::FakeJni()
+{
+    memset(&mFunctions, 0, sizeof(mFunctions));
+    mFunctions.GetVersion = GetVersion;
+    mFunctions.FindClass = FindClass;
+    mFunctions.ThrowNew = ThrowNew;
+    mFunctions.ExceptionOccurred = ExceptionOccurred;
+    mFunctions.ExceptionDescribe = ExceptionDescribe;
+    mFunctions.ExceptionClear = ExceptionClear;
+    mFunctions.ExceptionCheck = ExceptionCheck;
+    mFunctions.PushLocalFrame = PushLocalFrame;
+    mFunctions.PopLocalFrame = PopLocalFrame;
+    mFunctions.NewGlobalRef = NewGlobalRef;
+    mFunctions.DeleteGlobalRef = DeleteGlobalRef;
+    mFunctions.DeleteLocalRef = DeleteLocalRef;
+    mFunctions.IsSameObject = IsSameObject;
+    mFunctions.NewLocalRef = NewLocalRef;
+    mFunctions.EnsureLocalCapacity = EnsureLocalCapacity;
+    mFunctions.AllocObject = AllocObject;
+    mFunctions.NewObjectV = NewObjectV;
+    mFunctions.GetObjectClass = GetObjectClass;
+    mFunctions.IsInstanceOf = IsInstanceOf;
+    mFunctions.GetMethodID = GetMethodID;
+    mFunctions.GetFieldID = GetFieldID;
+    mFunctions.GetObjectField = GetObjectField;
+    mFunctions.GetBooleanField = GetBooleanField;
+    mFunctions.GetByteField = GetByteField;
+    mFunctions.GetIntField = GetIntField;
+    mFunctions.GetLongField = GetLongField;
+    mFunctions.SetObjectField = SetObjectField;
+    mFunctions.SetBooleanField = SetBooleanField;
+    mFunctions.SetByteField = SetByteField;
+    mFunctions.SetIntField = SetIntField;
+    mFunctions.SetLongField = SetLongField;
+    mFunctions.GetStaticMethodID = GetStaticMethodID;
+    mFunctions.CallStaticBooleanMethodV = CallStaticBooleanMethodV;
+    mFunctions.CallStaticIntMethodV = CallStaticIntMethodV;
+    mFunctions.CallStaticVoidMethodV = CallStaticVoidMethodV;
+    mFunctions.GetStaticFieldID = GetStaticFieldID;
+    mFunctions.GetStaticObjectField = GetStaticObjectField;
+    mFunctions.GetStaticLongField = GetStaticLongField;
+    mFunctions.SetStaticObjectField = SetStaticObjectField;
+    mFunctions.SetStaticLongField = SetStaticLongField;
+    mFunctions.NewStringUTF = NewStringUTF;
+    mFunctions.GetStringUTFLength = GetStringUTFLength;
+    mFunctions.GetStringUTFChars = GetStringUTFChars;
+    mFunctions.ReleaseStringUTFChars = ReleaseStringUTFChars;
+    mFunctions.GetArrayLength = GetArrayLength;
+    mFunctions.NewObjectArray = NewObjectArray;
+    mFunctions.GetObjectArrayElement = GetObjectArrayElement;
+    mFunctions.SetObjectArrayElement = SetObjectArrayElement;
+    mFunctions.NewByteArray = NewByteArray;
+    mFunctions.NewIntArray = NewIntArray;
+    mFunctions.NewLongArray = NewLongArray;
+    mFunctions.GetByteArrayElements = GetByteArrayElements;
+    mFunctions.GetIntArrayElements = GetIntArrayElements;
+    mFunctions.GetLongArrayElements = GetLongArrayElements;
+    mFunctions.ReleaseByteArrayElements = ReleaseByteArrayElements;
+    mFunctions.ReleaseIntArrayElements = ReleaseIntArrayElements;
+    mFunctions.ReleaseLongArrayElements = ReleaseLongArrayElements;
+    mFunctions.GetByteArrayRegion = GetByteArrayRegion;
+    mFunctions.GetIntArrayRegion = GetIntArrayRegion;
+    mFunctions.GetLongArrayRegion = GetLongArrayRegion;
+    mFunctions.SetByteArrayRegion = SetByteArrayRegion;
+    mFunctions.SetIntArrayRegion = SetIntArrayRegion;
+    mFunctions.SetLongArrayRegion = SetLongArrayRegion;
+    mFunctions.RegisterNatives = RegisterNatives;
+    mFunctions.GetJavaVM = GetJavaVM;
+    mFunctions.GetPrimitiveArrayCritical = GetPrimitiveArrayCritical;
+    mFunctions.ReleasePrimitiveArrayCritical = ReleasePrimitiveArrayCritical;
+
+    memset(&mInvokeFunctions, 0, sizeof(mInvokeFunctions));
+    mInvokeFunctions.DestroyJavaVM = DestroyJavaVM;
+    mInvokeFunctions.AttachCurrentThread = AttachCurrentThread;
+    mInvokeFunctions.DetachCurrentThread = DetachCurrentThread;
+    mInvokeFunctions.GetEnv = GetEnv;
+
+    mEnv.env.functions = &mFunctions;
+    mEnv.owner = this;
+    mVM.vm.functions = &mInvokeFunctions;
+    mVM.owner = this;
+
+    mLiveLocalRefs = 0;
+    mException = false;
+    resetCounters();
+}
+
+FakeJni::~FakeJni()
+{
+    for (size_t i = 0; i < mObjects.size(); i++) {
+        Object *object = mObjects[i];
+        for (std::map<std::string, Member *>::iterator it = object->members.begin();
+                it != object->members.end(); ++it) {
+            delete it->second;
+        }
+        delete object;
+    }
+}
+
+FakeJni *FakeJni::self(JNIEnv *env)
+{
+    return reinterpret_cast<Env *>(env)->owner;
+}
+
+FakeJni *FakeJni::self(JavaVM *vm)
+{
+    return reinterpret_cast<VM *>(vm)->owner;
+}
+
+void FakeJni::resetCounters()
+{
+    memset(&mCounters, 0, sizeof(mCounters));
+    mCounters.peakLocalRefs = mLiveLocalRefs;
+}
+
+void FakeJni::collect()
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < mObjects.size(); i++) {
+        Object *object = mObjects[i];
+        if (object->kind == KIND_CLASS || object->globalRefs > 0) {
+            mObjects[kept++] = object;
+        } else {
+            delete object;
+        }
+    }
+    mObjects.resize(kept);
+    mLiveLocalRefs = 0;
+}
+
+bool FakeJni::takeException()
+{
+    bool pending = mException;
+    mException = false;
+    return pending;
+}
+
+uint64_t FakeJni::callCostNs(bool fast)
+{
+    return fast ? COST_FAST_NATIVE_CALL : COST_NATIVE_CALL;
+}
+
+void FakeJni::charge(uint64_t ns)
+{
+    mCounters.calls++;
+    mCounters.costNs += ns;
+}
+
+void FakeJni::lookup(uint64_t ns)
+{
+    charge(ns);
+    mCounters.lookups++;
+}
+
+jobject FakeJni::localRef(Object *object)
+{
+    if (object == NULL) {
+        return NULL;
+    }
+    mCounters.localRefs++;
+    mLiveLocalRefs++;
+    mCounters.peakLocalRefs = std::max(mCounters.peakLocalRefs, mLiveLocalRefs);
+    return reinterpret_cast<jobject>(object);
+}
+
+FakeJni::Object *FakeJni::newObject(Object *cls, int kind, size_t length, size_t elementSize)
+{
+    Object *object = new Object();
+    object->cls = cls;
+    object->kind = kind;
+    object->globalRefs = 0;
+    object->length = length;
+    if (kind == KIND_ARRAY) {
+        object->data.resize(length * elementSize);
+    } else if (kind == KIND_OBJECT_ARRAY) {
+        object->elements.resize(length);
+    }
+    mObjects.push_back(object);
+    if (kind != KIND_CLASS) {
+        mCounters.allocations++;
+    }
+    return object;
+}
+
+jclass FakeJni::findClass(const char *name)
+{
+    std::map<std::string, Object *>::iterator it = mClasses.find(name);
+    if (it != mClasses.end()) {
+        return reinterpret_cast<jclass>(it->second);
+    }
+    Object *cls = newObject(NULL, KIND_CLASS, 0, 0);
+    cls->string = name;
+    cls->globalRefs = 1;
+    mClasses[name] = cls;
+    return reinterpret_cast<jclass>(cls);
+}
+
+FakeJni::Member *FakeJni::findMember(jclass clazz, const char *name, const char *sig,
+        bool isStatic, bool isMethod)
+{
+    Object *cls = object(clazz);
+    if (cls == NULL || name == NULL || sig == NULL) {
+        return NULL;
+    }
+
+    std::string key(isStatic ? (isMethod ? "SM " : "SF ") : (isMethod ? "IM " : "IF "));
+    key += name;
+    key += ' ';
+    key += sig;
+
+    std::map<std::string, Member *>::iterator it = cls->members.find(key);
+    if (it != cls->members.end()) {
+        return it->second;
+    }
+    Member *member = new Member();
+    member->cls = cls;
+    member->name = name;
+    member->signature = sig;
+    member->native = NULL;
+    member->fast = false;
+    cls->members[key] = member;
+    return member;
+}
+
+void *FakeJni::findNative(const char *className, const char *name, const char *signature,
+        bool *fast)
+{
+    jclass cls = findClass(className);
+    Member *member = findMember(cls, name, signature, false, true);
+    if (member->native == NULL) {
+        member = findMember(cls, name, signature, true, true);
+    }
+    *fast = member->fast;
+    return member->native;
+}
+
+FakeJni::Object *FakeJni::object(jobject obj)
+{
+    return reinterpret_cast<Object *>(obj);
+}
+
+jvalue *FakeJni::field(jobject obj, jfieldID fieldID)
+{
+    jvalue &value = object(obj)->fields[reinterpret_cast<const Member *>(fieldID)];
+    return &value;
+}
+
+jvalue *FakeJni::staticField(jclass clazz, jfieldID fieldID)
+{
+    const Member *member = reinterpret_cast<const Member *>(fieldID);
+    jvalue &value = member->cls->fields[member];
+    return &value;
+}
+
+void *FakeJni::arrayElements(jarray array, size_t elementSize)
+{
+    Object *a = object(array);
+    return a->data.empty() ? NULL : &a->data[0];
+}
+
+jint FakeJni::GetVersion(JNIEnv *env)
+{
+    self(env)->charge(COST_CHECK);
+    return JNI_VERSION_1_6;
+}
+
+jclass FakeJni::FindClass(JNIEnv *env, const char *name)
+{
+    FakeJni *jni = self(env);
+    jni->lookup(COST_FIND_CLASS);
+    return (jclass) jni->localRef(object(jni->findClass(name)));
+}
+
+jint FakeJni::ThrowNew(JNIEnv *env, jclass clazz, const char *message)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_THROW);
+    jni->mException = true;
+    return JNI_OK;
+}
+
+jthrowable FakeJni::ExceptionOccurred(JNIEnv *env)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_CHECK);
+    if (!jni->mException) {
+        return NULL;
+    }
+    Object *cls = object(jni->findClass("java/lang/Exception"));
+    return (jthrowable) jni->localRef(jni->newObject(cls, KIND_OBJECT, 0, 0));
+}
+
+void FakeJni::ExceptionDescribe(JNIEnv *env)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_CHECK);
+    if (jni->mException) {
+        fprintf(stderr, "fake JNI: exception pending\n");
+    }
+}
+
+void FakeJni::ExceptionClear(JNIEnv *env)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_CHECK);
+    jni->mException = false;
+}
+
+jboolean FakeJni::ExceptionCheck(JNIEnv *env)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_CHECK);
+    return jni->mException;
+}
+
+jint FakeJni::PushLocalFrame(JNIEnv *env, jint capacity)
+{
+    self(env)->charge(COST_REF);
+    return JNI_OK;
+}
+
+jobject FakeJni::PopLocalFrame(JNIEnv *env, jobject result)
+{
+    self(env)->charge(COST_REF);
+    return result;
+}
+
+jobject FakeJni::NewGlobalRef(JNIEnv *env, jobject obj)
+{
+    self(env)->charge(COST_GLOBAL_REF);
+    if (obj != NULL) {
+        object(obj)->globalRefs++;
+    }
+    return obj;
+}
+
+void FakeJni::DeleteGlobalRef(JNIEnv *env, jobject globalRef)
+{
+    self(env)->charge(COST_GLOBAL_REF);
+    if (globalRef != NULL && object(globalRef)->globalRefs > 0) {
+        object(globalRef)->globalRefs--;
+    }
+}
+
+void FakeJni::DeleteLocalRef(JNIEnv *env, jobject localRef)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_REF);
+    if (localRef != NULL && jni->mLiveLocalRefs > 0) {
+        jni->mLiveLocalRefs--;
+    }
+}
+
+jboolean FakeJni::IsSameObject(JNIEnv *env, jobject ref1, jobject ref2)
+{
+    self(env)->charge(COST_REF);
+    return ref1 == ref2;
+}
+
+jobject FakeJni::NewLocalRef(JNIEnv *env, jobject ref)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_REF);
+    return jni->localRef(object(ref));
+}
+
+jint FakeJni::EnsureLocalCapacity(JNIEnv *env, jint capacity)
+{
+    self(env)->charge(COST_CHECK);
+    return JNI_OK;
+}
+
+jobject FakeJni::AllocObject(JNIEnv *env, jclass clazz)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_ALLOC_OBJECT);
+    return jni->localRef(jni->newObject(object(clazz), KIND_OBJECT, 0, 0));
+}
+
+jobject FakeJni::NewObjectV(JNIEnv *env, jclass clazz, jmethodID methodID, va_list args)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_ALLOC_OBJECT + COST_CONSTRUCTOR);
+    jni->mCounters.upcalls++;
+    return jni->localRef(jni->newObject(object(clazz), KIND_OBJECT, 0, 0));
+}
+
+jclass FakeJni::GetObjectClass(JNIEnv *env, jobject obj)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_REF);
+    if (obj == NULL) {
+        return NULL;
+    }
+    Object *o = object(obj);
+    Object *cls = o->kind == KIND_CLASS ? object(jni->findClass("java/lang/Class")) : o->cls;
+    return (jclass) jni->localRef(cls);
+}
+
+jboolean FakeJni::IsInstanceOf(JNIEnv *env, jobject obj, jclass clazz)
+{
+    self(env)->charge(COST_REF);
+    return obj == NULL || object(obj)->cls == object(clazz);
+}
+
+jmethodID FakeJni::GetMethodID(JNIEnv *env, jclass clazz, const char *name, const char *sig)
+{
+    FakeJni *jni = self(env);
+    jni->lookup(COST_GET_METHOD_ID);
+    return reinterpret_cast<jmethodID>(jni->findMember(clazz, name, sig, false, true));
+}
+
+jfieldID FakeJni::GetFieldID(JNIEnv *env, jclass clazz, const char *name, const char *sig)
+{
+    FakeJni *jni = self(env);
+    jni->lookup(COST_GET_FIELD_ID);
+    return reinterpret_cast<jfieldID>(jni->findMember(clazz, name, sig, false, false));
+}
+
+jobject FakeJni::GetObjectField(JNIEnv *env, jobject obj, jfieldID fieldID)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_OBJECT_FIELD);
+    return jni->localRef(object(field(obj, fieldID)->l));
+}
+
+jboolean FakeJni::GetBooleanField(JNIEnv *env, jobject obj, jfieldID fieldID)
+{
+    self(env)->charge(COST_FIELD);
+    return field(obj, fieldID)->z;
+}
+
+jbyte FakeJni::GetByteField(JNIEnv *env, jobject obj, jfieldID fieldID)
+{
+    self(env)->charge(COST_FIELD);
+    return field(obj, fieldID)->b;
+}
+
+jint FakeJni::GetIntField(JNIEnv *env, jobject obj, jfieldID fieldID)
+{
+    self(env)->charge(COST_FIELD);
+    return field(obj, fieldID)->i;
+}
+
+jlong FakeJni::GetLongField(JNIEnv *env, jobject obj, jfieldID fieldID)
+{
+    self(env)->charge(COST_FIELD);
+    return field(obj, fieldID)->j;
+}
+
+void FakeJni::SetObjectField(JNIEnv *env, jobject obj, jfieldID fieldID, jobject value)
+{
+    self(env)->charge(COST_OBJECT_FIELD);
+    field(obj, fieldID)->l = value;
+}
+
+void FakeJni::SetBooleanField(JNIEnv *env, jobject obj, jfieldID fieldID, jboolean value)
+{
+    self(env)->charge(COST_FIELD);
+    field(obj, fieldID)->z = value;
+}
+
+void FakeJni::SetByteField(JNIEnv *env, jobject obj, jfieldID fieldID, jbyte value)
+{
+    self(env)->charge(COST_FIELD);
+    field(obj, fieldID)->b = value;
+}
+
+void FakeJni::SetIntField(JNIEnv *env, jobject obj, jfieldID fieldID, jint value)
+{
+    self(env)->charge(COST_FIELD);
+    field(obj, fieldID)->i = value;
+}
+
+void FakeJni::SetLongField(JNIEnv *env, jobject obj, jfieldID fieldID, jlong value)
+{
+    self(env)->charge(COST_FIELD);
+    field(obj, fieldID)->j = value;
+}
+
+jmethodID FakeJni::GetStaticMethodID(JNIEnv *env, jclass clazz, const char *name,
+        const char *sig)
+{
+    FakeJni *jni = self(env);
+    jni->lookup(COST_GET_METHOD_ID);
+    return reinterpret_cast<jmethodID>(jni->findMember(clazz, name, sig, true, true));
+}
+
+/* Java code is not there to run; an upcall succeeds and returns true or 0 */
+jboolean FakeJni::CallStaticBooleanMethodV(JNIEnv *env, jclass clazz, jmethodID methodID,
+        va_list args)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_UPCALL);
+    jni->mCounters.upcalls++;
+    return JNI_TRUE;
+}
+
+jint FakeJni::CallStaticIntMethodV(JNIEnv *env, jclass clazz, jmethodID methodID,
+        va_list args)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_UPCALL);
+    jni->mCounters.upcalls++;
+    return 0;
+}
+
+void FakeJni::CallStaticVoidMethodV(JNIEnv *env, jclass clazz, jmethodID methodID,
+        va_list args)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_UPCALL);
+    jni->mCounters.upcalls++;
+}
+
+jfieldID FakeJni::GetStaticFieldID(JNIEnv *env, jclass clazz, const char *name,
+        const char *sig)
+{
+    FakeJni *jni = self(env);
+    jni->lookup(COST_GET_FIELD_ID);
+    return reinterpret_cast<jfieldID>(jni->findMember(clazz, name, sig, true, false));
+}
+
+jobject FakeJni::GetStaticObjectField(JNIEnv *env, jclass clazz, jfieldID fieldID)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_OBJECT_FIELD);
+    return jni->localRef(object(staticField(clazz, fieldID)->l));
+}
+
+jlong FakeJni::GetStaticLongField(JNIEnv *env, jclass clazz, jfieldID fieldID)
+{
+    self(env)->charge(COST_FIELD);
+    return staticField(clazz, fieldID)->j;
+}
+
+void FakeJni::SetStaticObjectField(JNIEnv *env, jclass clazz, jfieldID fieldID, jobject value)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_OBJECT_FIELD);
+    /* whatever a static field holds stays reachable */
+    jvalue *held = staticField(clazz, fieldID);
+    if (held->l != NULL) {
+        object(held->l)->globalRefs--;
+    }
+    if (value != NULL) {
+        object(value)->globalRefs++;
+    }
+    held->l = value;
+}
+
+void FakeJni::SetStaticLongField(JNIEnv *env, jclass clazz, jfieldID fieldID, jlong value)
+{
+    self(env)->charge(COST_FIELD);
+    staticField(clazz, fieldID)->j = value;
+}
+
+jstring FakeJni::NewStringUTF(JNIEnv *env, const char *bytes)
+{
+    FakeJni *jni = self(env);
+    if (bytes == NULL) {
+        jni->charge(COST_CHECK);
+        return NULL;
+    }
+    size_t length = strlen(bytes);
+    jni->charge(COST_ALLOC_STRING + length / COST_PER_BYTE_DIV);
+    Object *string = jni->newObject(object(jni->findClass("java/lang/String")), KIND_STRING,
+            length, 1);
+    string->string = bytes;
+    return (jstring) jni->localRef(string);
+}
+
+jsize FakeJni::GetStringUTFLength(JNIEnv *env, jstring string)
+{
+    self(env)->charge(COST_CHECK);
+    return object(string)->string.size();
+}
+
+const char *FakeJni::GetStringUTFChars(JNIEnv *env, jstring string, jboolean *isCopy)
+{
+    Object *s = object(string);
+    self(env)->charge(COST_STRING_CHARS + s->string.size() / COST_PER_BYTE_DIV);
+    if (isCopy != NULL) {
+        *isCopy = JNI_TRUE;
+    }
+    return s->string.c_str();
+}
+
+void FakeJni::ReleaseStringUTFChars(JNIEnv *env, jstring string, const char *utf)
+{
+    self(env)->charge(COST_CHECK);
+}
+
+jsize FakeJni::GetArrayLength(JNIEnv *env, jarray array)
+{
+    self(env)->charge(COST_CHECK);
+    return object(array)->length;
+}
+
+jobjectArray FakeJni::NewObjectArray(JNIEnv *env, jsize length, jclass elementClass,
+        jobject initialElement)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_ALLOC_ARRAY + length * sizeof(jobject) / COST_PER_BYTE_DIV);
+    Object *array = jni->newObject(object(jni->findClass("[Ljava/lang/Object;")),
+            KIND_OBJECT_ARRAY, length, 0);
+    std::fill(array->elements.begin(), array->elements.end(), initialElement);
+    return (jobjectArray) jni->localRef(array);
+}
+
+jobject FakeJni::GetObjectArrayElement(JNIEnv *env, jobjectArray array, jsize index)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_OBJECT_FIELD);
+    Object *a = object(array);
+    if (index < 0 || (size_t) index >= a->length) {
+        jni->mException = true;
+        return NULL;
+    }
+    return jni->localRef(object(a->elements[index]));
+}
+
+void FakeJni::SetObjectArrayElement(JNIEnv *env, jobjectArray array, jsize index,
+        jobject value)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_OBJECT_FIELD);
+    Object *a = object(array);
+    if (index < 0 || (size_t) index >= a->length) {
+        jni->mException = true;
+        return;
+    }
+    a->elements[index] = value;
+}
+
+jbyteArray FakeJni::NewByteArray(JNIEnv *env, jsize length)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_ALLOC_ARRAY + length / COST_PER_BYTE_DIV);
+    return (jbyteArray) jni->localRef(
+            jni->newObject(object(jni->findClass("[B")), KIND_ARRAY, length, sizeof(jbyte)));
+}
+
+jintArray FakeJni::NewIntArray(JNIEnv *env, jsize length)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_ALLOC_ARRAY + length * sizeof(jint) / COST_PER_BYTE_DIV);
+    return (jintArray) jni->localRef(
+            jni->newObject(object(jni->findClass("[I")), KIND_ARRAY, length, sizeof(jint)));
+}
+
+jlongArray FakeJni::NewLongArray(JNIEnv *env, jsize length)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_ALLOC_ARRAY + length * sizeof(jlong) / COST_PER_BYTE_DIV);
+    return (jlongArray) jni->localRef(
+            jni->newObject(object(jni->findClass("[J")), KIND_ARRAY, length, sizeof(jlong)));
+}
+
+jbyte *FakeJni::GetByteArrayElements(JNIEnv *env, jbyteArray array, jboolean *isCopy)
+{
+    self(env)->charge(COST_ARRAY_ELEMENTS);
+    if (isCopy != NULL) {
+        *isCopy = JNI_FALSE;
+    }
+    return (jbyte *) arrayElements(array, sizeof(jbyte));
+}
+
+jint *FakeJni::GetIntArrayElements(JNIEnv *env, jintArray array, jboolean *isCopy)
+{
+    self(env)->charge(COST_ARRAY_ELEMENTS);
+    if (isCopy != NULL) {
+        *isCopy = JNI_FALSE;
+    }
+    return (jint *) arrayElements(array, sizeof(jint));
+}
+
+jlong *FakeJni::GetLongArrayElements(JNIEnv *env, jlongArray array, jboolean *isCopy)
+{
+    self(env)->charge(COST_ARRAY_ELEMENTS);
+    if (isCopy != NULL) {
+        *isCopy = JNI_FALSE;
+    }
+    return (jlong *) arrayElements(array, sizeof(jlong));
+}
+
+void FakeJni::ReleaseByteArrayElements(JNIEnv *env, jbyteArray array, jbyte *elems, jint mode)
+{
+    self(env)->charge(COST_ARRAY_ELEMENTS);
+}
+
+void FakeJni::ReleaseIntArrayElements(JNIEnv *env, jintArray array, jint *elems, jint mode)
+{
+    self(env)->charge(COST_ARRAY_ELEMENTS);
+}
+
+void FakeJni::ReleaseLongArrayElements(JNIEnv *env, jlongArray array, jlong *elems, jint mode)
+{
+    self(env)->charge(COST_ARRAY_ELEMENTS);
+}
+
+/* region copies; an out of range region throws, as ArrayIndexOutOfBoundsException would */
+#define FAKE_ARRAY_REGION(Name, ArrayType, Type, Const, Get) \
+void FakeJni::Name(JNIEnv *env, ArrayType array, jsize start, jsize len, Const Type *buf) \
+{ \
+    FakeJni *jni = self(env); \
+    jni->charge(COST_ARRAY_REGION + len * sizeof(Type) / COST_PER_BYTE_DIV); \
+    Object *a = object(array); \
+    if (start < 0 || len < 0 || (size_t) start + len > a->length) { \
+        jni->mException = true; \
+        return; \
+    } \
+    if (len > 0) { \
+        Type *elems = (Type *) arrayElements(array, sizeof(Type)) + start; \
+        if (Get) { \
+            memcpy((void *) buf, elems, len * sizeof(Type)); \
+        } else { \
+            memcpy(elems, buf, len * sizeof(Type)); \
+        } \
+    } \
+}
+
+FAKE_ARRAY_REGION(GetByteArrayRegion, jbyteArray, jbyte, , true)
+FAKE_ARRAY_REGION(GetIntArrayRegion, jintArray, jint, , true)
+FAKE_ARRAY_REGION(GetLongArrayRegion, jlongArray, jlong, , true)
+FAKE_ARRAY_REGION(SetByteArrayRegion, jbyteArray, jbyte, const, false)
+FAKE_ARRAY_REGION(SetIntArrayRegion, jintArray, jint, const, false)
+FAKE_ARRAY_REGION(SetLongArrayRegion, jlongArray, jlong, const, false)
+
+jint FakeJni::RegisterNatives(JNIEnv *env, jclass clazz, const JNINativeMethod *methods,
+        jint nMethods)
+{
+    FakeJni *jni = self(env);
+    for (int i = 0; i < nMethods; i++) {
+        const char *signature = methods[i].signature;
+        bool fast = signature[0] == '!';
+        if (fast) {
+            signature++;
+        }
+
+        /* whether the method is static is only known to the class file; register both */
+        Member *member = jni->findMember(clazz, methods[i].name, signature, false, true);
+        member->native = methods[i].fnPtr;
+        member->fast = fast;
+        member = jni->findMember(clazz, methods[i].name, signature, true, true);
+        member->native = methods[i].fnPtr;
+        member->fast = fast;
+    }
+    return JNI_OK;
+}
+
+jint FakeJni::GetJavaVM(JNIEnv *env, JavaVM **vm)
+{
+    FakeJni *jni = self(env);
+    jni->charge(COST_CHECK);
+    *vm = jni->vm();
+    return JNI_OK;
+}
+
+void *FakeJni::GetPrimitiveArrayCritical(JNIEnv *env, jarray array, jboolean *isCopy)
+{
+    self(env)->charge(COST_ARRAY_ELEMENTS);
+    if (isCopy != NULL) {
+        *isCopy = JNI_FALSE;
+    }
+    return arrayElements(array, 1);
+}
+
+void FakeJni::ReleasePrimitiveArrayCritical(JNIEnv *env, jarray array, void *carray,
+        jint mode)
+{
+    self(env)->charge(COST_ARRAY_ELEMENTS);
+}
+
+jint FakeJni::DestroyJavaVM(JavaVM *vm)
+{
+    return JNI_ERR;
+}
+
+jint FakeJni::AttachCurrentThread(JavaVM *vm, JNIEnv **env, void *args)
+{
+    *env = self(vm)->env();
+    return JNI_OK;
+}
+
+jint FakeJni::DetachCurrentThread(JavaVM *vm)
+{
+    return JNI_OK;
+}
+
+jint FakeJni::GetEnv(JavaVM *vm, void **env, jint version)
+{
+    *env = self(vm)->env();
+    return JNI_OK;
+}
+
+}; // namespace android
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FAKE_JNI_ENV_H__
+#define __FAKE_JNI_ENV_H__
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "jni.h"
+
+namespace android {
+
+/* what the code under test asked of the VM since the last resetCounters() */
+struct FakeJniCounters {
+    uint64_t calls;                 /* JNIEnv functions called */
+    uint64_t lookups;               /* FindClass and Get*ID calls */
+    uint64_t allocations;           /* objects, arrays and strings created */
+    uint64_t localRefs;             /* local refs handed out */
+    uint64_t peakLocalRefs;         /* most local refs alive at once */
+    uint64_t upcalls;               /* Java methods called */
+    uint64_t costNs;                /* what the calls would have cost on a device */
+};
+
+/*
+ * A JNIEnv and JavaVM backed by a tiny in-process object model instead of a VM. Classes,
+ * fields and methods spring into existence the first time they are looked up, so the
+ * bridge runs without any Java code; objects hold whatever was stored in them and arrays
+ * and strings hold their contents.
+ *
+ * Nothing is timed by spinning. Every call instead adds what it would roughly cost under
+ * ART on a mid-range device to FakeJniCounters::costNs, so a benchmark can report the
+ * bridge's own time and the modelled VM time side by side, and the figures are stable
+ * from run to run.
+ *
+ * One thread at a time; objects live until collect().
+ */
+class FakeJni {
+public:
+    FakeJni();
+    ~FakeJni();
+
+    JNIEnv *env() {
+        return &mEnv.env;
+    }
+    JavaVM *vm() {
+        return &mVM.vm;
+    }
+
+    /* the class of the given name, as a global ref */
+    jclass findClass(const char *name);
+
+    /* a native registered with RegisterNatives, or NULL; fast says it was a "!" method */
+    void *findNative(const char *className, const char *name, const char *signature,
+            bool *fast);
+
+    /* what a regular and a "!" native call cost, on top of the native code itself */
+    static uint64_t callCostNs(bool fast);
+
+    const FakeJniCounters &counters() const {
+        return mCounters;
+    }
+    void resetCounters();
+
+    /* frees every object that is neither a class nor held by a global ref */
+    void collect();
+
+    /* like a VM, tells whether the last call left an exception pending, and clears it */
+    bool takeException();
+
+private:
+    struct Object;
+    struct Member;
+
+    /* lead from the JNIEnv and JavaVM pointers the code under test holds back to this */
+    struct Env {
+        JNIEnv env;
+        FakeJni *owner;
+    };
+    struct VM {
+        JavaVM vm;
+        FakeJni *owner;
+    };
+
+    static FakeJni *self(JNIEnv *env);
+    static FakeJni *self(JavaVM *vm);
+
+    void charge(uint64_t ns);
+    void lookup(uint64_t ns);
+    jobject localRef(Object *object);
+    Object *newObject(Object *cls, int kind, size_t length, size_t elementSize);
+    Member *findMember(jclass clazz, const char *name, const char *sig, bool isStatic,
+            bool isMethod);
+
+    static Object *object(jobject obj);
+    static jvalue *field(jobject obj, jfieldID fieldID);
+    static jvalue *staticField(jclass clazz, jfieldID fieldID);
+    static void *arrayElements(jarray array, size_t elementSize);
+
+    /* the JNINativeInterface and JNIInvokeInterface entries */
+    static jint GetVersion(JNIEnv *env);
+    static jclass FindClass(JNIEnv *env, const char *name);
+    static jint ThrowNew(JNIEnv *env, jclass clazz, const char *message);
+    static jthrowable ExceptionOccurred(JNIEnv *env);
+    static void ExceptionDescribe(JNIEnv *env);
+    static void ExceptionClear(JNIEnv *env);
+    static jboolean ExceptionCheck(JNIEnv *env);
+    static jint PushLocalFrame(JNIEnv *env, jint capacity);
+    static jobject PopLocalFrame(JNIEnv *env, jobject result);
+    static jobject NewGlobalRef(JNIEnv *env, jobject obj);
+    static void DeleteGlobalRef(JNIEnv *env, jobject globalRef);
+    static void DeleteLocalRef(JNIEnv *env, jobject localRef);
+    static jboolean IsSameObject(JNIEnv *env, jobject ref1, jobject ref2);
+    static jobject NewLocalRef(JNIEnv *env, jobject ref);
+    static jint EnsureLocalCapacity(JNIEnv *env, jint capacity);
+    static jobject AllocObject(JNIEnv *env, jclass clazz);
+    static jobject NewObjectV(JNIEnv *env, jclass clazz, jmethodID methodID, va_list args);
+    static jclass GetObjectClass(JNIEnv *env, jobject obj);
+    static jboolean IsInstanceOf(JNIEnv *env, jobject obj, jclass clazz);
+    static jmethodID GetMethodID(JNIEnv *env, jclass clazz, const char *name, const char *sig);
+    static jfieldID GetFieldID(JNIEnv *env, jclass clazz, const char *name, const char *sig);
+    static jobject GetObjectField(JNIEnv *env, jobject obj, jfieldID fieldID);
+    static jboolean GetBooleanField(JNIEnv *env, jobject obj, jfieldID fieldID);
+    static jbyte GetByteField(JNIEnv *env, jobject obj, jfieldID fieldID);
+    static jint GetIntField(JNIEnv *env, jobject obj, jfieldID fieldID);
+    static jlong GetLongField(JNIEnv *env, jobject obj, jfieldID fieldID);
+    static void SetObjectField(JNIEnv *env, jobject obj, jfieldID fieldID, jobject value);
+    static void SetBooleanField(JNIEnv *env, jobject obj, jfieldID fieldID, jboolean value);
+    static void SetByteField(JNIEnv *env, jobject obj, jfieldID fieldID, jbyte value);
+    static void SetIntField(JNIEnv *env, jobject obj, jfieldID fieldID, jint value);
+    static void SetLongField(JNIEnv *env, jobject obj, jfieldID fieldID, jlong value);
+    static jmethodID GetStaticMethodID(JNIEnv *env, jclass clazz, const char *name,
+            const char *sig);
+    static jboolean CallStaticBooleanMethodV(JNIEnv *env, jclass clazz, jmethodID methodID,
+            va_list args);
+    static jint CallStaticIntMethodV(JNIEnv *env, jclass clazz, jmethodID methodID,
+            va_list args);
+    static void CallStaticVoidMethodV(JNIEnv *env, jclass clazz, jmethodID methodID,
+            va_list args);
+    static jfieldID GetStaticFieldID(JNIEnv *env, jclass clazz, const char *name,
+            const char *sig);
+    static jobject GetStaticObjectField(JNIEnv *env, jclass clazz, jfieldID fieldID);
+    static jlong GetStaticLongField(JNIEnv *env, jclass clazz, jfieldID fieldID);
+    static void SetStaticObjectField(JNIEnv *env, jclass clazz, jfieldID fieldID, jobject value);
+    static void SetStaticLongField(JNIEnv *env, jclass clazz, jfieldID fieldID, jlong value);
+    static jstring NewStringUTF(JNIEnv *env, const char *bytes);
+    static jsize GetStringUTFLength(JNIEnv *env, jstring string);
+    static const char *GetStringUTFChars(JNIEnv *env, jstring string, jboolean *isCopy);
+    static void ReleaseStringUTFChars(JNIEnv *env, jstring string, const char *utf);
+    static jsize GetArrayLength(JNIEnv *env, jarray array);
+    static jobjectArray NewObjectArray(JNIEnv *env, jsize length, jclass elementClass,
+            jobject initialElement);
+    static jobject GetObjectArrayElement(JNIEnv *env, jobjectArray array, jsize index);
+    static void SetObjectArrayElement(JNIEnv *env, jobjectArray array, jsize index,
+            jobject value);
+    static jbyteArray NewByteArray(JNIEnv *env, jsize length);
+    static jintArray NewIntArray(JNIEnv *env, jsize length);
+    static jlongArray NewLongArray(JNIEnv *env, jsize length);
+    static jbyte *GetByteArrayElements(JNIEnv *env, jbyteArray array, jboolean *isCopy);
+    static jint *GetIntArrayElements(JNIEnv *env, jintArray array, jboolean *isCopy);
+    static jlong *GetLongArrayElements(JNIEnv *env, jlongArray array, jboolean *isCopy);
+    static void ReleaseByteArrayElements(JNIEnv *env, jbyteArray array, jbyte *elems, jint mode);
+    static void ReleaseIntArrayElements(JNIEnv *env, jintArray array, jint *elems, jint mode);
+    static void ReleaseLongArrayElements(JNIEnv *env, jlongArray array, jlong *elems, jint mode);
+    static void GetByteArrayRegion(JNIEnv *env, jbyteArray array, jsize start, jsize len,
+            jbyte *buf);
+    static void GetIntArrayRegion(JNIEnv *env, jintArray array, jsize start, jsize len,
+            jint *buf);
+    static void GetLongArrayRegion(JNIEnv *env, jlongArray array, jsize start, jsize len,
+            jlong *buf);
+    static void SetByteArrayRegion(JNIEnv *env, jbyteArray array, jsize start, jsize len,
+            const jbyte *buf);
+    static void SetIntArrayRegion(JNIEnv *env, jintArray array, jsize start, jsize len,
+            const jint *buf);
+    static void SetLongArrayRegion(JNIEnv *env, jlongArray array, jsize start, jsize len,
+            const jlong *buf);
+    static jint RegisterNatives(JNIEnv *env, jclass clazz, const JNINativeMethod *methods,
+            jint nMethods);
+    static jint GetJavaVM(JNIEnv *env, JavaVM **vm);
+    static void *GetPrimitiveArrayCritical(JNIEnv *env, jarray array, jboolean *isCopy);
+    static void ReleasePrimitiveArrayCritical(JNIEnv *env, jarray array, void *carray,
+            jint mode);
+
+    static jint DestroyJavaVM(JavaVM *vm);
+    static jint AttachCurrentThread(JavaVM *vm, JNIEnv **env, void *args);
+    static jint DetachCurrentThread(JavaVM *vm);
+    static jint GetEnv(JavaVM *vm, void **env, jint version);
+
+    Env mEnv;
+    VM mVM;
+    JNINativeInterface mFunctions;
+    JNIInvokeInterface mInvokeFunctions;
+    FakeJniCounters mCounters;
+    uint64_t mLiveLocalRefs;
+    bool mException;
+
+    std::map<std::string, Object *> mClasses;
+    std::vector<Object *> mObjects;
+};
+
+}
+
+#endif //__FAKE_JNI_ENV_H__
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * libandroid_runtime is not built for the host. The bridge only needs it to register its
+ * natives, which the host benchmark does straight with its JNIEnv.
+ */
+
+#ifndef __HOST_ANDROID_RUNTIME_H__
+#define __HOST_ANDROID_RUNTIME_H__
+
+#include "jni.h"
+#include "JNIHelp.h"
+
+namespace android {
+
+class AndroidRuntime {
+public:
+    static int registerNativeMethods(JNIEnv* env, const char* className,
+            const JNINativeMethod* gMethods, int numMethods) {
+        return jniRegisterNativeMethods(env, className, gMethods, numMethods);
+    }
+};
+
+}
+
+#endif //__HOST_ANDROID_RUNTIME_H__
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Feeds arbitrary bytes to index_anqp_payload as an ANQP response payload. Beyond not
+ * reading outside the payload, the index must be the same whatever room it is given, must
+ * never be written past that room, and must only point inside the payload: every element
+ * record inside its element, in order, and every string table entry inside the element it
+ * came out of.
+ *
+ * corpus/anqp holds well formed and malformed payloads of each indexed element to start
+ * from; anqp/TestDriver checks the same files against ANQPFactory.parsePayload.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "wifi_anqp.h"
+
+using namespace android;
+
+#define FUZZ_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            abort(); \
+        } \
+    } while (0)
+
+static const int32_t kCanary = 0x5a5a5a5a;
+
+static void checkIndex(const int32_t *index, int n, size_t size)
+{
+    int numElements = index[ANQP_INDEX_ELEMENT_COUNT];
+    int numEntries = index[ANQP_INDEX_ENTRY_COUNT];
+    FUZZ_CHECK(numElements >= 0 && numEntries >= 0);
+    FUZZ_CHECK(n == ANQP_INDEX_HEADER_LEN + numElements * ANQP_ELEMENT_RECORD_LEN
+            + numEntries * ANQP_ENTRY_RECORD_LEN);
+
+    const int32_t *entries = index + ANQP_INDEX_HEADER_LEN + numElements * ANQP_ELEMENT_RECORD_LEN;
+    size_t elementEnd = 0;
+    int nextEntry = 0;
+    for (int i = 0; i < numElements; i++) {
+        const int32_t *record = index + ANQP_INDEX_HEADER_LEN + i * ANQP_ELEMENT_RECORD_LEN;
+        size_t offset = record[ANQP_ELEMENT_OFFSET];
+        size_t length = record[ANQP_ELEMENT_LENGTH];
+        FUZZ_CHECK(record[ANQP_ELEMENT_OFFSET] >= 0 && record[ANQP_ELEMENT_LENGTH] >= 0);
+        FUZZ_CHECK(offset >= elementEnd + 4);       /* past the previous element and a header */
+        FUZZ_CHECK(offset + length <= size);
+        elementEnd = offset + length;
+
+        /* the entries of each element follow those of the one before */
+        FUZZ_CHECK(record[ANQP_ELEMENT_FIRST_ENTRY] == nextEntry);
+        int count = record[ANQP_ELEMENT_ENTRY_COUNT];
+        FUZZ_CHECK(count >= 0 && nextEntry + count <= numEntries);
+        for (int e = nextEntry; e < nextEntry + count; e++) {
+            const int32_t *entry = entries + e * ANQP_ENTRY_RECORD_LEN;
+            FUZZ_CHECK(entry[ANQP_ENTRY_KIND] >= ANQP_ENTRY_DOMAIN
+                    && entry[ANQP_ENTRY_KIND] <= ANQP_ENTRY_OSU_SERVER);
+            FUZZ_CHECK(entry[ANQP_ENTRY_OFFSET] >= 0 && entry[ANQP_ENTRY_LENGTH] >= 0);
+            FUZZ_CHECK((size_t)entry[ANQP_ENTRY_OFFSET] >= offset);
+            FUZZ_CHECK((size_t)entry[ANQP_ENTRY_OFFSET] + entry[ANQP_ENTRY_LENGTH]
+                    <= offset + length);
+        }
+        nextEntry += count;
+    }
+    FUZZ_CHECK(nextEntry == numEntries);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    /* exactly the payload, so any read past it trips the sanitizer */
+    std::vector<uint8_t> payload(data, data + size);
+    const uint8_t *p = payload.empty() ? NULL : &payload[0];
+
+    int n = index_anqp_payload(p, size, NULL, 0);
+    if (n < 0) {
+        return 0;
+    }
+    FUZZ_CHECK(n >= ANQP_INDEX_HEADER_LEN);
+
+    /* given room for only part of it, the index must say the same and stay in that room */
+    size_t partial = n / 2;
+    std::vector<int32_t> index(n + 1, kCanary);
+    FUZZ_CHECK(index_anqp_payload(p, size, &index[0], partial) == n);
+    for (size_t i = partial; i < index.size(); i++) {
+        FUZZ_CHECK(index[i] == kCanary);
+    }
+
+    FUZZ_CHECK(index_anqp_payload(p, size, &index[0], n) == n);
+    FUZZ_CHECK(index[n] == kCanary);
+    checkIndex(&index[0], n, size);
+    return 0;
+}
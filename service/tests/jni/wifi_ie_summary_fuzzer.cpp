@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Feeds arbitrary bytes to parse_ie_summary as the IEs of a full scan result. The input is
+ * copied to a buffer of exactly its size, so any read past it trips the sanitizer. Beyond
+ * that, every field of the summary must agree with a plain walk of the same bytes over the
+ * elements the summary says Java gets; the channel fields are read the way
+ * WifiNative.populateScanResult does it when no summary is given.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "wifi_ie_summary.h"
+
+using namespace android;
+
+#define FUZZ_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            abort(); \
+        } \
+    } while (0)
+
+static const int EID_BSS_LOAD = 11;
+static const int EID_HT_CAPABILITIES = 45;
+static const int EID_RSN = 48;
+static const int EID_HT_OPERATION = 61;
+static const int EID_INTERWORKING = 107;
+static const int EID_EXTENDED_CAPS = 127;
+static const int EID_VHT_CAPABILITIES = 191;
+static const int EID_VHT_OPERATION = 192;
+static const int EID_VENDOR_SPECIFIC = 221;
+static const int RTT_RESP_ENABLE_BIT = 70;
+
+/* the security fields of one RSN or WPA element, as the summary reports them */
+struct Suites {
+    bool valid;
+    int32_t group;
+    int32_t pairwise;
+    int32_t akms;
+    int32_t capabilities;
+};
+
+static int le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static const uint8_t kRsnOui[3] = { 0x00, 0x0f, 0xac };
+static const uint8_t kWpaOui[3] = { 0x00, 0x50, 0xf2 };
+static const uint8_t kWfaOui[3] = { 0x50, 0x6f, 0x9a };
+
+/* the suite type of a selector with the given OUI that fits a mask bit, or -1 */
+static int suiteType(const uint8_t *p, const uint8_t oui[3])
+{
+    return p[0] == oui[0] && p[1] == oui[1] && p[2] == oui[2] && p[3] < 32 ? p[3] : -1;
+}
+
+/*
+ * Parses an RSN element, or a WPA one past its OUI and type: version 1, then group cipher,
+ * pairwise list, AKM list and capabilities, where a field may only be missing if everything
+ * after it is missing too.
+ */
+static Suites parseSuites(const uint8_t *p, size_t len, const uint8_t oui[3])
+{
+    Suites s = { false, 4, 1 << 4, 1 << 1, 0 };
+    if (len < 2 || le16(p) != 1) {
+        return s;
+    }
+    size_t pos = 2;
+    if (len - pos < 4) {
+        s.valid = len == pos;
+        return s;
+    }
+    s.group = std::max(suiteType(p + pos, oui), 0);
+    pos += 4;
+
+    int32_t *lists[2] = { &s.pairwise, &s.akms };
+    for (int l = 0; l < 2; l++) {
+        if (len - pos < 2) {
+            s.valid = len == pos;
+            return s;
+        }
+        size_t count = le16(p + pos);
+        pos += 2;
+        if (count * 4 > len - pos) {
+            return s;
+        }
+        *lists[l] = 0;
+        for (size_t n = 0; n < count; n++, pos += 4) {
+            int type = suiteType(p + pos, oui);
+            if (type >= 0) {
+                *lists[l] |= 1 << type;
+            }
+        }
+    }
+    if (len - pos >= 2) {
+        s.capabilities = le16(p + pos);
+    }
+    s.valid = true;
+    return s;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    std::vector<u8> ies(data, data + size);
+    int32_t summary[IE_SUMMARY_LEN];
+    parse_ie_summary(ies.empty() ? NULL : &ies[0], ies.size(), summary);
+
+    int32_t flags = summary[IE_SUMMARY_FLAGS];
+    int count = summary[IE_SUMMARY_ELEMENT_COUNT];
+    FUZZ_CHECK(count >= 0 && (size_t) count <= size / 2);
+
+    /* the counted elements must be framed inside the buffer, and be long enough */
+    int secondaryOffset = 0, width = 0, index0 = 0, index1 = 0;
+    bool ht = false, vht = false, rtt = false;
+    Suites rsn = { false, 0, 0, 0, 0 }, wpa = { false, 0, 0, 0, 0 };
+    int32_t htCaps = -1, vhtCaps = 0, stations = 0, utilization = 0, capacity = 0;
+    bool hasVhtCaps = false, bssLoad = false, internet = false;
+    int ant = -1, hsRelease = -1, domainId = -1;
+    size_t i = 0;
+    for (int n = 0; n < count; n++) {
+        FUZZ_CHECK(i + 1 < size);
+        int type = data[i];
+        size_t len = data[i + 1];
+        FUZZ_CHECK(i + 2 + len <= size);
+        const uint8_t *p = data + i + 2;
+        if (type == EID_BSS_LOAD && len == 5) {
+            stations = le16(p);
+            utilization = p[2];
+            capacity = le16(p + 3);
+            bssLoad = true;
+        } else if (type == EID_HT_CAPABILITIES && len >= 2) {
+            htCaps = le16(p);
+        } else if (type == EID_VHT_CAPABILITIES && len >= 4) {
+            vhtCaps = (int32_t) (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24));
+            hasVhtCaps = true;
+        } else if (type == EID_RSN) {
+            Suites parsed = parseSuites(p, len, kRsnOui);
+            if (parsed.valid) {
+                rsn = parsed;
+            }
+        } else if (type == EID_INTERWORKING && len >= 1) {
+            ant = p[0] & 0x0f;
+            internet = (p[0] & 0x10) != 0;
+        } else if (type == EID_VENDOR_SPECIFIC && len >= 4
+                && memcmp(p, kWpaOui, 3) == 0 && p[3] == 0x01) {
+            Suites parsed = parseSuites(p + 4, len - 4, kWpaOui);
+            if (parsed.valid) {
+                parsed.capabilities = 0;
+                wpa = parsed;
+            }
+        } else if (type == EID_VENDOR_SPECIFIC && len >= 5
+                && memcmp(p, kWfaOui, 3) == 0 && p[3] == 0x10) {
+            hsRelease = (p[4] >> 4) & 0x0f;
+            domainId = (p[4] & 0x04) && len >= 7 ? le16(p + 5) : -1;
+        } else if (type == EID_HT_OPERATION) {
+            FUZZ_CHECK(len >= 2);
+            secondaryOffset = p[1] & 0x3;
+            ht = true;
+        } else if (type == EID_VHT_OPERATION) {
+            FUZZ_CHECK(len >= 3);
+            width = p[0];
+            index0 = p[1];
+            index1 = p[2];
+            vht = true;
+        } else if (type == EID_EXTENDED_CAPS) {
+            rtt = len >= RTT_RESP_ENABLE_BIT / 8 + 1
+                    && (p[RTT_RESP_ENABLE_BIT / 8] & (1 << (RTT_RESP_ENABLE_BIT % 8))) != 0;
+        }
+        i += len + 2;
+    }
+
+    FUZZ_CHECK(summary[IE_SUMMARY_HT_SECONDARY_OFFSET] == secondaryOffset);
+    FUZZ_CHECK(summary[IE_SUMMARY_VHT_CHANNEL_WIDTH] == width);
+    FUZZ_CHECK(summary[IE_SUMMARY_VHT_CENTER_INDEX0] == index0);
+    FUZZ_CHECK(summary[IE_SUMMARY_VHT_CENTER_INDEX1] == index1);
+    FUZZ_CHECK(((flags & IE_SUMMARY_HAS_HT_OPERATION) != 0) == ht);
+    FUZZ_CHECK(((flags & IE_SUMMARY_HAS_VHT_OPERATION) != 0) == vht);
+    FUZZ_CHECK(((flags & IE_SUMMARY_RTT_RESPONDER) != 0) == rtt);
+
+    FUZZ_CHECK(((flags & IE_SUMMARY_HAS_RSN) != 0) == rsn.valid);
+    FUZZ_CHECK(summary[IE_SUMMARY_RSN_GROUP_CIPHER] == rsn.group);
+    FUZZ_CHECK(summary[IE_SUMMARY_RSN_PAIRWISE_CIPHERS] == rsn.pairwise);
+    FUZZ_CHECK(summary[IE_SUMMARY_RSN_AKMS] == rsn.akms);
+    FUZZ_CHECK(summary[IE_SUMMARY_RSN_CAPABILITIES] == rsn.capabilities);
+    FUZZ_CHECK(((flags & IE_SUMMARY_HAS_WPA) != 0) == wpa.valid);
+    FUZZ_CHECK(summary[IE_SUMMARY_WPA_GROUP_CIPHER] == wpa.group);
+    FUZZ_CHECK(summary[IE_SUMMARY_WPA_PAIRWISE_CIPHERS] == wpa.pairwise);
+    FUZZ_CHECK(summary[IE_SUMMARY_WPA_AKMS] == wpa.akms);
+    FUZZ_CHECK(((flags & IE_SUMMARY_HAS_HT) != 0) == (htCaps >= 0));
+    FUZZ_CHECK(summary[IE_SUMMARY_HT_CAPABILITIES] == std::max(htCaps, 0));
+    FUZZ_CHECK(((flags & IE_SUMMARY_HAS_VHT) != 0) == hasVhtCaps);
+    FUZZ_CHECK(summary[IE_SUMMARY_VHT_CAPABILITIES] == vhtCaps);
+    FUZZ_CHECK(((flags & IE_SUMMARY_HAS_BSS_LOAD) != 0) == bssLoad);
+    FUZZ_CHECK(summary[IE_SUMMARY_STATION_COUNT] == stations);
+    FUZZ_CHECK(summary[IE_SUMMARY_CHANNEL_UTILIZATION] == utilization);
+    FUZZ_CHECK(summary[IE_SUMMARY_AVAILABLE_CAPACITY] == capacity);
+    FUZZ_CHECK(((flags & IE_SUMMARY_HAS_INTERWORKING) != 0) == (ant >= 0));
+    FUZZ_CHECK(summary[IE_SUMMARY_ACCESS_NETWORK_TYPE] == std::max(ant, 0));
+    FUZZ_CHECK(((flags & IE_SUMMARY_INTERNET) != 0) == internet);
+    FUZZ_CHECK(((flags & IE_SUMMARY_HAS_HS20) != 0) == (hsRelease >= 0));
+    FUZZ_CHECK(summary[IE_SUMMARY_HS20_RELEASE] == std::max(hsRelease, 0));
+    FUZZ_CHECK(((flags & IE_SUMMARY_HAS_ANQP_DOMAIN_ID) != 0) == (domainId >= 0));
+    FUZZ_CHECK(summary[IE_SUMMARY_ANQP_DOMAIN_ID] == std::max(domainId, 0));
+    FUZZ_CHECK(summary[IE_SUMMARY_CAPABILITY_INFO] == 0);
+
+    /* the walk stopped either at the end, or at an element that is flagged */
+    if (i + 1 < size) {
+        FUZZ_CHECK(flags & IE_SUMMARY_MALFORMED);
+        int type = data[i];
+        size_t len = data[i + 1];
+        FUZZ_CHECK(i + 2 + len > size
+                || (type == EID_HT_OPERATION && len < 2)
+                || (type == EID_VHT_OPERATION && len < 3));
+    } else {
+        FUZZ_CHECK(!(flags & IE_SUMMARY_MALFORMED));
+    }
+    return 0;
+}
@@ -0,0 +1,773 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times the hot conversion paths of the JNI bridge on the host, against FakeJni and the
+ * simulated vendor HAL (libwifi-hal-sim):
+ *
+ *   wifi_jni_benchmark [name]
+ *
+ * runs every benchmark whose name contains the argument; "javaIeParse" is the Java IE walk
+ * that "parseIeSummary" replaces, run over the same bytes; "nativeCalls" compares what each
+ * "!" native costs registered as is and as a regular native. Each is run at a few population
+ * sizes, and each line reports per converted item (a scan result, an RTT result, a field,
+ * a command): the time spent in the bridge and the fake, the VM time FakeJni's cost model
+ * charges for the same calls, objects allocated, and per call the local refs handed out,
+ * the most alive at once and the class, field and method lookups.
+ *
+ * The bridge is compiled in rather than linked so its static conversion helpers and HAL
+ * callbacks can be called directly; the HAL data they convert comes from the simulator.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "fake_jni_env.h"
+#include "wifi_hal_sim.h"
+
+#include "com_android_server_wifi_WifiNative.cpp"
+
+using namespace android;
+
+/* libhardware_legacy is not built for the host; this is the supplicant the bridge talks to */
+
+static std::string sSupplicantReply;
+
+extern "C" {
+
+int wifi_load_driver() { return 0; }
+int wifi_unload_driver() { return 0; }
+int is_wifi_driver_loaded() { return 1; }
+int wifi_start_supplicant(int p2pSupported) { return 0; }
+int wifi_stop_supplicant(int p2pSupported) { return 0; }
+int wifi_connect_to_supplicant() { return 0; }
+void wifi_close_supplicant_connection() { }
+int wifi_wait_for_event(char *buf, size_t len) { return 0; }
+
+int wifi_command(const char *command, char *reply, size_t *reply_len)
+{
+    size_t len = std::min(sSupplicantReply.size(), *reply_len);
+    memcpy(reply, sSupplicantReply.data(), len);
+    *reply_len = len;
+    return 0;
+}
+
+}
+
+#define BENCH_MIN_ITERATIONS        20
+#define BENCH_MIN_NS                200000000LL
+#define BENCH_MAX_RESULTS           (MAX_AP_CACHE_PER_SCAN * 4)
+#define BENCH_REQUEST_ID            42
+
+static const char *kWifiNativeClass = "com/android/server/wifi/WifiNative";
+
+static FakeJni *sJni;
+static jclass sWifiNative;
+static wifi_handle sHalHandle;
+static pthread_t sEventLoop;
+
+/* what the simulator produced for the current population */
+static Mutex sCaptureLock;
+static bool sCapturing;
+static std::vector<std::vector<char> > sFullResults;
+static std::vector<wifi_rtt_result> sRttResults;
+static bool sRttDone;
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void captureFullScanResult(wifi_request_id id, wifi_scan_result *result)
+{
+    Mutex::Autolock _l(sCaptureLock);
+    if (sCapturing && sFullResults.size() < BENCH_MAX_RESULTS) {
+        const char *bytes = (const char *) result;
+        sFullResults.push_back(std::vector<char>(bytes,
+                bytes + offsetof(wifi_scan_result, ie_data) + result->ie_length));
+    }
+}
+
+static void captureScanResultsAvailable(wifi_request_id id, unsigned num_results)
+{
+}
+
+static void captureRttResults(wifi_request_id id, unsigned num_results,
+        wifi_rtt_result *results[])
+{
+    Mutex::Autolock _l(sCaptureLock);
+    for (unsigned i = 0; i < num_results; i++) {
+        sRttResults.push_back(*results[i]);
+        sRttResults.back().LCI = NULL;
+        sRttResults.back().LCR = NULL;
+    }
+    sRttDone = true;
+}
+
+static void *runEventLoop(void *arg)
+{
+    hal_fn.wifi_event_loop(sHalHandle);
+    return NULL;
+}
+
+static void halCleanedUp(wifi_handle handle)
+{
+}
+
+static void stopSimulator()
+{
+    if (sHalHandle != NULL) {
+        hal_fn.wifi_cleanup(sHalHandle, halCleanedUp);
+        pthread_join(sEventLoop, NULL);
+        sHalHandle = NULL;
+    }
+}
+
+/*
+ * Brings the simulator up with the given population, the way startHal and getInterfaces
+ * would, then lets it run a few scans and an RTT request to collect data to convert. The
+ * scans stay cached in the simulator for getScanResults.
+ */
+static bool startSimulator(int numAps)
+{
+    stopSimulator();
+
+    wifi_hal_sim_config config;
+    wifi_hal_sim_get_default_config(&config);
+    config.num_aps = numAps;
+    config.visible_percent = 100;
+    config.scan_hz = 50;
+    config.hotlist_hz = 0;
+    config.significant_change_hz = 0;
+    config.rssi_hz = 0;
+    config.ring_hz = 0;
+    config.rtt_latency_ms = 0;
+    wifi_hal_sim_set_config(&config);
+
+    if (init_wifi_hal_func_table(&hal_fn) != 0
+            || init_wifi_vendor_hal_func_table(&hal_fn) != WIFI_SUCCESS
+            || hal_fn.wifi_initialize(&sHalHandle) != WIFI_SUCCESS) {
+        fprintf(stderr, "could not start the simulated HAL\n");
+        return false;
+    }
+    pthread_create(&sEventLoop, NULL, runEventLoop, NULL);
+
+    JNIEnv *env = sJni->env();
+    {
+        JNIHelper helper(env);
+        helper.setStaticLongField(sWifiNative, WifiHandleVarName, (jlong) sHalHandle);
+    }
+    if (android_net_wifi_getInterfaces(env, sWifiNative) <= 0) {
+        fprintf(stderr, "the simulated HAL has no interfaces\n");
+        return false;
+    }
+    wifi_interface_handle iface = sIfaceHandles[0];
+
+    {
+        Mutex::Autolock _l(sCaptureLock);
+        sCapturing = true;
+        sFullResults.clear();
+        sRttResults.clear();
+        sRttDone = false;
+    }
+
+    wifi_scan_cmd_params params;
+    memset(&params, 0, sizeof(params));
+    params.base_period = 10000;
+    params.max_ap_per_scan = MAX_AP_CACHE_PER_SCAN;
+    params.report_threshold_num_scans = 1;
+    params.num_buckets = 1;
+    params.buckets[0].band = WIFI_BAND_ABG_WITH_DFS;
+    params.buckets[0].period = 10000;
+    params.buckets[0].report_events = REPORT_EVENTS_EACH_SCAN | REPORT_EVENTS_FULL_RESULTS;
+
+    wifi_scan_result_handler handler;
+    memset(&handler, 0, sizeof(handler));
+    handler.on_full_scan_result = captureFullScanResult;
+    handler.on_scan_results_available = captureScanResultsAvailable;
+    hal_fn.wifi_start_gscan(BENCH_REQUEST_ID, iface, params, handler);
+
+    /* enough scans to fill the simulator's cache */
+    wifi_cached_scan_results *cached = new wifi_cached_scan_results[64];
+    int64_t deadline = nowNs() + 5000000000LL;
+    int num = 0;
+    while (nowNs() < deadline) {
+        hal_fn.wifi_get_cached_gscan_results(iface, 0, 64, cached, &num);
+        if (num >= 16) {
+            break;
+        }
+        usleep(10000);
+    }
+    hal_fn.wifi_stop_gscan(BENCH_REQUEST_ID, iface);
+
+    /* range every AP the scans saw */
+    std::vector<wifi_rtt_config> configs;
+    for (int i = 0; i < num && configs.size() < (size_t) MaxRttConfigs; i++) {
+        for (int j = 0; j < cached[i].num_results && configs.size() < (size_t) MaxRttConfigs;
+                j++) {
+            wifi_rtt_config config;
+            memset(&config, 0, sizeof(config));
+            memcpy(config.addr, cached[i].results[j].bssid, sizeof(mac_addr));
+            config.type = RTT_TYPE_2_SIDED;
+            config.channel.center_freq = cached[i].results[j].channel;
+            configs.push_back(config);
+        }
+    }
+    delete[] cached;
+
+    wifi_rtt_event_handler rttHandler;
+    memset(&rttHandler, 0, sizeof(rttHandler));
+    rttHandler.on_rtt_results = captureRttResults;
+    if (!configs.empty()) {
+        hal_fn.wifi_rtt_range_request(BENCH_REQUEST_ID, iface, configs.size(), &configs[0],
+                rttHandler);
+    }
+    while (nowNs() < deadline) {
+        {
+            Mutex::Autolock _l(sCaptureLock);
+            if (sRttDone || configs.empty()) {
+                break;
+            }
+        }
+        usleep(1000);
+    }
+
+    Mutex::Autolock _l(sCaptureLock);
+    sCapturing = false;
+    return true;
+}
+
+struct Measurement {
+    int64_t ns;
+    uint64_t items;
+    uint64_t calls;
+    FakeJniCounters jni;
+
+    Measurement() : ns(0), items(0), calls(0) {
+        memset(&jni, 0, sizeof(jni));
+    }
+};
+
+/* runs one call of a benchmark, converting some number of items; returns the count */
+typedef uint64_t (*bench_fn)(JNIEnv *env, int population);
+
+static void measure(bench_fn fn, int population, Measurement *m)
+{
+    JNIEnv *env = sJni->env();
+
+    /* one untimed call, so one-off lookups and caches don't skew the figures */
+    fn(env, population);
+    sJni->collect();
+
+    while (m->calls < BENCH_MIN_ITERATIONS || m->ns < BENCH_MIN_NS) {
+        sJni->resetCounters();
+        int64_t start = nowNs();
+        uint64_t items = fn(env, population);
+        m->ns += nowNs() - start;
+        m->items += items;
+        m->calls++;
+
+        const FakeJniCounters &c = sJni->counters();
+        m->jni.calls += c.calls;
+        m->jni.lookups += c.lookups;
+        m->jni.allocations += c.allocations;
+        m->jni.localRefs += c.localRefs;
+        m->jni.peakLocalRefs = std::max(m->jni.peakLocalRefs, c.peakLocalRefs);
+        m->jni.upcalls += c.upcalls;
+        m->jni.costNs += c.costNs;
+
+        if (sJni->takeException()) {
+            fprintf(stderr, "an exception was left pending\n");
+        }
+        sJni->collect();
+    }
+}
+
+static void report(const char *name, int population, const Measurement &m)
+{
+    double items = m.items > 0 ? m.items : 1;
+    double calls = m.calls > 0 ? m.calls : 1;
+    printf("%-22s %6d %10.0f %10.0f %10.2f %10.2f %6llu %10.2f\n", name, population,
+            m.ns / items, m.jni.costNs / items, m.jni.allocations / items,
+            m.jni.localRefs / calls, (unsigned long long) m.jni.peakLocalRefs,
+            m.jni.lookups / calls);
+}
+
+static wifi_scan_result *fullResult(size_t i)
+{
+    return (wifi_scan_result *) &sFullResults[i % sFullResults.size()][0];
+}
+
+/* population: scan results converted per call */
+static uint64_t benchCreateScanResult(JNIEnv *env, int population)
+{
+    JNIHelper helper(env);
+    for (int i = 0; i < population; i++) {
+        JNIObject<jobject> scanResult = createScanResult(helper, fullResult(i));
+    }
+    return population;
+}
+
+/* population: simulated APs; every cached scan is converted each call */
+static uint64_t benchGetScanResults(JNIEnv *env, int population)
+{
+    JNIHelper helper(env);
+    JNIObject<jobjectArray> data(helper,
+            (jobjectArray) android_net_wifi_getScanResults(env, sWifiNative, 0, JNI_FALSE, NULL));
+    if (data == NULL) {
+        return 0;
+    }
+
+    uint64_t results = 0;
+    int num = helper.getArrayLength(data);
+    for (int i = 0; i < num; i++) {
+        JNIObject<jobject> scan = helper.getObjectArrayElement(data, i);
+        JNIObject<jobjectArray> scanResults = helper.getArrayField(scan, "mResults",
+                "[Landroid/net/wifi/ScanResult;");
+        results += helper.getArrayLength(scanResults);
+    }
+    return results;
+}
+
+/* population: simulated APs; one full scan result per call */
+static uint64_t benchOnFullScanResult(JNIEnv *env, int population)
+{
+    static size_t next = 0;
+    onFullScanResult(BENCH_REQUEST_ID, fullResult(next++));
+    return 1;
+}
+
+/* population: RTT results delivered per call */
+static uint64_t benchOnRttResults(JNIEnv *env, int population)
+{
+    wifi_rtt_result *results[MaxRttConfigs];
+    int num = std::min(population, (int) sRttResults.size());
+    for (int i = 0; i < num; i++) {
+        results[i] = &sRttResults[i];
+    }
+    onRttResults(BENCH_REQUEST_ID, num, results);
+    return num;
+}
+
+/* population: fields set per call, on one ScanResult */
+static uint64_t benchSetFields(JNIEnv *env, int population)
+{
+    JNIHelper helper(env);
+    JNIObject<jobject> scanResult = helper.createObject("android/net/wifi/ScanResult");
+    for (int i = 0; i < population; i++) {
+        switch (i % 3) {
+            case 0:
+                helper.setIntField(scanResult, "level", -50);
+                break;
+            case 1:
+                helper.setLongField(scanResult, "timestamp", i);
+                break;
+            default:
+                helper.setStringField(scanResult, "BSSID", "02:00:00:00:00:01");
+                break;
+        }
+    }
+    return population;
+}
+
+/* population: bytes in each supplicant reply, which doStringCommand returns as a String */
+static uint64_t benchDoCommand(JNIEnv *env, int population)
+{
+    static int replySize = -1;
+    if (replySize != population) {
+        replySize = population;
+        sSupplicantReply.assign(population, 'x');
+        if (population >= 2) {
+            sSupplicantReply.replace(0, 2, "OK");
+        }
+    }
+
+    JNIHelper helper(env);
+    JNIObject<jstring> command = helper.newStringUTF("IFNAME=wlan0 STATUS");
+    JNIObject<jstring> reply(helper, android_net_wifi_doStringCommand(env, NULL, command));
+    return 1;
+}
+
+/* the elements of a typical beacon, repeated up to the population by benchParseIeSummary */
+static const u8 kBeaconIes[] = {
+    0, 8, 'b', 'e', 'n', 'c', 'h', 'n', 'e', 't',                       /* SSID */
+    1, 8, 0x8c, 0x12, 0x98, 0x24, 0xb0, 0x48, 0x60, 0x6c,               /* rates */
+    3, 1, 36,                                                           /* DS */
+    5, 4, 0, 1, 0, 0,                                                   /* TIM */
+    7, 6, 'U', 'S', ' ', 36, 4, 23,                                     /* country */
+    11, 5, 3, 0, 40, 0, 0,                                              /* BSS load */
+    45, 26, 0xef, 0x09, 0x1b, 0xff, 0xff, 0, 0, 0, 0, 0, 0, 0, 0, 0,    /* HT caps */
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    48, 20, 1, 0, 0x00, 0x0f, 0xac, 4, 1, 0, 0x00, 0x0f, 0xac, 4,       /* RSN */
+            1, 0, 0x00, 0x0f, 0xac, 2, 0x0c, 0,
+    61, 22, 36, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,      /* HT operation */
+            0, 0, 0, 0,
+    127, 9, 0x04, 0, 0, 0, 0, 0, 0, 0, 0x40,                            /* extended caps */
+    191, 12, 0xb1, 0x01, 0x80, 0x33, 0xfa, 0xff, 0, 0, 0xfa, 0xff,      /* VHT caps */
+            0, 0,
+    192, 5, 1, 42, 0, 0, 0,                                             /* VHT operation */
+    107, 1, 0x12,                                                       /* interworking */
+    221, 7, 0x50, 0x6f, 0x9a, 0x10, 0x14, 0x3a, 0x01,                   /* HS2.0 */
+    221, 24, 0x00, 0x50, 0xf2, 2, 1, 1, 0x80, 0, 3, 0xa4, 0, 0, 0x27,   /* WMM */
+            0xa4, 0, 0, 0x42, 0x43, 0x5e, 0, 0x62, 0x32, 0x2f, 0,
+};
+
+/* kBeaconIes repeated up to population elements */
+static const std::vector<u8> &beaconIes(int population)
+{
+    static std::vector<u8> ies;
+    static int elements = -1;
+    if (elements != population) {
+        elements = population;
+        ies.clear();
+        size_t j = 0;
+        for (int i = 0; i < population; i++) {
+            size_t len = 2 + kBeaconIes[j + 1];
+            ies.insert(ies.end(), kBeaconIes + j, kBeaconIes + j + len);
+            j = (j + len) % sizeof(kBeaconIes);
+        }
+    }
+    return ies;
+}
+
+/* population: elements in each result's IEs; parses 64 results per call */
+static uint64_t benchParseIeSummary(JNIEnv *env, int population)
+{
+    const std::vector<u8> &ies = beaconIes(population);
+    int32_t summary[IE_SUMMARY_LEN];
+    int32_t found = 0;
+    for (int i = 0; i < 64; i++) {
+        parse_ie_summary(&ies[0], ies.size(), summary);
+        found += summary[IE_SUMMARY_ELEMENT_COUNT];
+    }
+    return found == 64 * population ? 64 : 0;
+}
+
+/*
+ * What Java does with the IEs of a full scan result when there is no summary, transliterated
+ * so that it can be timed against parse_ie_summary on the same bytes: the NetworkDetail
+ * constructor's walk, then WifiParser.parse_akm's walk of the RSN and WPA elements. Every
+ * ByteBuffer and byte[] the Java code creates is allocated here too. The GC and interpreter
+ * costs those carry on a device are not modelled, so this is a lower bound for the Java side.
+ */
+struct JavaByteBuffer {
+    const u8 *array;
+    size_t position;
+    size_t limit;
+
+    size_t remaining() const {
+        return limit - position;
+    }
+    int get() {
+        return array[position++];
+    }
+    int getShort() {
+        int v = array[position] | (array[position + 1] << 8);
+        position += 2;
+        return v;
+    }
+};
+
+static JavaByteBuffer *duplicatePayload(JavaByteBuffer *data, size_t length)
+{
+    JavaByteBuffer *payload = new JavaByteBuffer(*data);
+    payload->limit = payload->position + length;
+    data->position += length;
+    return payload;
+}
+
+static int javaNetworkDetail(const u8 *ies, size_t len)
+{
+    JavaByteBuffer *data = new JavaByteBuffer();
+    data->array = ies;
+    data->position = 0;
+    data->limit = len;
+
+    int fields = 0;
+    while (data->remaining() > 1) {
+        int eid = data->get();
+        size_t elementLength = data->get();
+        if (elementLength > data->remaining()) {
+            break;
+        }
+        JavaByteBuffer *element = NULL;
+        switch (eid) {
+            case 0: {
+                u8 *ssidOctets = new u8[elementLength];
+                memcpy(ssidOctets, ies + data->position, elementLength);
+                data->position += elementLength;
+                fields += ssidOctets[0] != 0;
+                delete[] ssidOctets;
+                break;
+            }
+            case 11:
+                if (elementLength != 5) {
+                    delete data;
+                    return fields;
+                }
+                fields += data->getShort() + data->get() + data->getShort();
+                break;
+            case 61:
+                element = duplicatePayload(data, elementLength);
+                element->get();
+                fields += element->get() & 0x3;
+                break;
+            case 192:
+                element = duplicatePayload(data, elementLength);
+                fields += element->get() + element->get() + element->get();
+                break;
+            case 107:
+                fields += data->get() & 0x0f;
+                data->position += elementLength - 1;
+                break;
+            case 221:
+                element = duplicatePayload(data, elementLength);
+                if (elementLength >= 5 && memcmp(element->array + element->position,
+                        "\x50\x6f\x9a\x10", 4) == 0) {
+                    element->position += 4;
+                    int hsConf = element->get();
+                    fields += hsConf >> 4;
+                    if ((hsConf & 0x04) && elementLength >= 7) {
+                        fields += element->getShort();
+                    }
+                }
+                break;
+            case 127: {
+                element = new JavaByteBuffer(*data);
+                u8 *octets = new u8[elementLength];
+                memcpy(octets, ies + data->position, elementLength);
+                data->position += elementLength;
+                fields += elementLength > 8 && (octets[8] & 0x40);
+                delete[] octets;
+                break;
+            }
+            default:
+                data->position += elementLength;
+                break;
+        }
+        delete element;
+    }
+    delete data;
+    return fields;
+}
+
+/* walks one RSN element, or a WPA one past its OUI and type; returns the AKMs found */
+static int javaAkms(JavaByteBuffer *buf)
+{
+    if (buf->remaining() < 8 || buf->getShort() != 1) {
+        return -1;
+    }
+    buf->position += 4;
+    int pairwise = buf->getShort();
+    if (buf->remaining() < (size_t) pairwise * 4 + 2) {
+        return -1;
+    }
+    buf->position += pairwise * 4;
+    int akms = buf->getShort();
+    if (buf->remaining() < (size_t) akms * 4) {
+        return -1;
+    }
+    int found = 0;
+    for (int i = 0; i < akms; i++) {
+        found |= 1 << buf->array[buf->position + 3];
+        buf->position += 4;
+    }
+    return found;
+}
+
+static int javaParseAkm(const u8 *ies, size_t len)
+{
+    std::string capabilities;
+    for (size_t i = 0; i + 1 < len && i + 2 + ies[i + 1] <= len; i += 2 + ies[i + 1]) {
+        int id = ies[i];
+        const u8 *p = ies + i + 2;
+        size_t elen = ies[i + 1];
+        bool wpa = id == 221 && elen >= 4 && memcmp(p, "\x00\x50\xf2\x01", 4) == 0;
+        if (id != 48 && !wpa) {
+            continue;
+        }
+        JavaByteBuffer *buf = new JavaByteBuffer();
+        buf->array = p;
+        buf->position = wpa ? 4 : 0;
+        buf->limit = elen;
+        int akms = javaAkms(buf);
+        delete buf;
+        if (akms < 0) {
+            return -1;
+        }
+        capabilities += wpa ? "[WPA" : "[WPA2";
+        capabilities += (akms & (1 << 2)) ? "-PSK]" : "-EAP]";
+    }
+    return capabilities.size();
+}
+
+/* population: elements in each result's IEs; parses 64 results per call */
+static uint64_t benchJavaIeParse(JNIEnv *env, int population)
+{
+    const std::vector<u8> &ies = beaconIes(population);
+    int found = 0;
+    for (int i = 0; i < 64; i++) {
+        found += javaNetworkDetail(&ies[0], ies.size());
+        found += javaParseAkm(&ies[0], ies.size());
+    }
+    return found != 0 ? 64 : 0;
+}
+
+/* the "!" native benchNativeCall calls, through what RegisterNatives was given for it */
+static const char *sNativeSignature;
+static void *sNativeFn;
+
+static void callNative(JNIEnv *env, const char *signature, void *fn)
+{
+    if (strcmp(signature, "(I)I") == 0) {
+        ((jint (*)(JNIEnv *, jclass, jint)) fn)(env, sWifiNative, 0);
+    } else if (strcmp(signature, "()I") == 0) {
+        ((jint (*)(JNIEnv *, jclass)) fn)(env, sWifiNative);
+    } else if (strcmp(signature, "()Z") == 0) {
+        ((jboolean (*)(JNIEnv *, jclass)) fn)(env, sWifiNative);
+    } else if (signature[0] == '(' && signature[1] == ')' && signature[2] == '[') {
+        ((jobject (*)(JNIEnv *, jclass)) fn)(env, sWifiNative);
+    } else if (strcmp(signature, "(Z)V") == 0) {
+        ((void (*)(JNIEnv *, jclass, jboolean)) fn)(env, sWifiNative, JNI_FALSE);
+    }
+}
+
+/* population: calls per iteration */
+static uint64_t benchNativeCall(JNIEnv *env, int population)
+{
+    for (int i = 0; i < population; i++) {
+        callNative(env, sNativeSignature, sNativeFn);
+    }
+    return population;
+}
+
+/*
+ * What each "!" native costs per call: its own time, the VM time of the JNI calls it
+ * makes, and what the VM would add for the call itself registered as is and as a regular
+ * native. A "!" native must also never block, since the calling thread can't be suspended
+ * for GC while it runs.
+ */
+static void compareNativeCalls()
+{
+    printf("\n%-36s %6s %10s %10s %10s %10s\n", "native", "fast", "ns/call", "vm ns/call",
+            "as fast", "as regular");
+    for (size_t i = 0; i < NELEM(gWifiFastMethods); i++) {
+        const JNINativeMethod &method = gWifiFastMethods[i];
+        const char *signature = method.signature[0] == '!' ? method.signature + 1
+                : method.signature;
+        bool fast = false;
+        sNativeSignature = signature;
+        sNativeFn = sJni->findNative(kWifiNativeClass, method.name, signature, &fast);
+        if (sNativeFn != method.fnPtr) {
+            fprintf(stderr, "%s is not registered\n", method.name);
+            continue;
+        }
+
+        Measurement m;
+        measure(benchNativeCall, 1000, &m);
+        double calls = m.items > 0 ? m.items : 1;
+        double vm = m.jni.costNs / calls;
+        printf("%-36s %6s %10.0f %10.0f %10.0f %10.0f\n", method.name, fast ? "yes" : "no",
+                m.ns / calls, vm, vm + FakeJni::callCostNs(true),
+                vm + FakeJni::callCostNs(false));
+    }
+}
+
+struct Benchmark {
+    const char *name;
+    bench_fn fn;
+    bool usesSimulator;             /* the population is the simulator's */
+    int populations[3];
+};
+
+static const Benchmark kBenchmarks[] = {
+    { "createScanResult",   benchCreateScanResult,  false,  { 16, 64, 256 } },
+    { "getScanResults",     benchGetScanResults,    true,   { 16, 64, 500 } },
+    { "onFullScanResult",   benchOnFullScanResult,  true,   { 16, 64, 500 } },
+    { "parseIeSummary",     benchParseIeSummary,    false,  { 4, 14, 56 } },
+    { "javaIeParse",        benchJavaIeParse,       false,  { 4, 14, 56 } },
+    { "onRttResults",       benchOnRttResults,      false,  { 1, 4, 16 } },
+    { "setFields",          benchSetFields,         false,  { 3, 30, 300 } },
+    { "doCommand",          benchDoCommand,         false,  { 16, 512, 4096 } },
+};
+
+int main(int argc, char **argv)
+{
+    const char *filter = argc > 1 ? argv[1] : "";
+
+    sJni = new FakeJni();
+    JNIEnv *env = sJni->env();
+    sWifiNative = sJni->findClass(kWifiNativeClass);
+
+    /* the entry point WifiNative's static initializer calls on a device */
+    if (Java_com_android_server_wifi_WifiNative_registerNatives(env, sWifiNative) < 0) {
+        fprintf(stderr, "could not register the natives\n");
+        return 1;
+    }
+
+    /* what startHal keeps for the HAL callbacks */
+    mVM = sJni->vm();
+    mCls = sWifiNative;
+
+    /* the default population serves the benchmarks whose population is their own */
+    int simulated = -1;
+
+    printf("%-22s %6s %10s %10s %10s %10s %6s %10s\n", "benchmark", "pop", "ns/item",
+            "vm ns/item", "allocs", "refs/call", "peak", "lookups");
+    for (size_t i = 0; i < NELEM(kBenchmarks); i++) {
+        const Benchmark &b = kBenchmarks[i];
+        if (strstr(b.name, filter) == NULL) {
+            continue;
+        }
+        for (int j = 0; j < 3; j++) {
+            int population = b.populations[j];
+            int numAps = b.usesSimulator ? population : 64;
+            if (numAps != simulated) {
+                if (!startSimulator(numAps)) {
+                    return 1;
+                }
+                simulated = numAps;
+            }
+            if (sFullResults.empty()) {
+                fprintf(stderr, "the simulated HAL reported no full scan results\n");
+                return 1;
+            }
+
+            Measurement m;
+            measure(b.fn, population, &m);
+            report(b.name, population, m);
+        }
+    }
+
+    if (strstr("nativeCalls", filter) != NULL) {
+        if (simulated < 0 && !startSimulator(64)) {
+            return 1;
+        }
+        compareNativeCalls();
+    }
+
+    stopSimulator();
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Feeds arbitrary bytes to the ring buffer record decoder and to the ring log built on it.
+ * The first byte picks what is fuzzed: an on_ring_buffer_data delivery appended to a log,
+ * or the contents of a log file left behind by an earlier run. Beyond not crashing, the
+ * decoder must account for every byte, and a log must answer an unbounded query with
+ * exactly what it holds, before and after its index is rebuilt from the file.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "wifi_ring_decoder.h"
+#include "wifi_ring_log.h"
+
+using namespace android;
+
+#define FUZZ_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            abort(); \
+        } \
+    } while (0)
+
+static const char kRingName[] = "fuzz_ring";
+
+static const char *logDir()
+{
+    static char dir[] = "/tmp/wifi_ring_record_fuzzer.XXXXXX";
+    static bool made = false;
+    if (!made) {
+        FUZZ_CHECK(mkdtemp(dir) != NULL);
+        made = true;
+    }
+    return dir;
+}
+
+static void logPath(char *path, size_t size)
+{
+    snprintf(path, size, "%s/%s.ring", logDir(), kRingName);
+}
+
+/* the records of buffer must tile it, up to whatever is left over */
+static void checkDecoder(const char *buffer, size_t size)
+{
+    RingRecordDecoder decoder(buffer, size);
+    RingRecord record;
+    size_t offset = 0;
+    while (decoder.next(&record)) {
+        FUZZ_CHECK(record.offset == offset);
+        FUZZ_CHECK(record.length >= sizeof(wifi_ring_buffer_entry));
+        FUZZ_CHECK(record.length <= size - offset);
+        offset += record.length;
+    }
+    FUZZ_CHECK(offset + decoder.remaining() == size);
+}
+
+/* what a log holds must decode cleanly, and an open query must return all of it */
+static void checkLog(const RingLogFile *file, std::vector<char> &held)
+{
+    const RingLogHeader &h = file->header();
+    FUZZ_CHECK(h.used <= h.capacity);
+    FUZZ_CHECK(h.totalRecords - h.evictedRecords == h.records);
+
+    file->read(held);
+    FUZZ_CHECK(held.size() == h.used);
+
+    RingRecordDecoder decoder(held.empty() ? NULL : &held[0], held.size());
+    RingRecord record;
+    uint32_t records = 0;
+    while (decoder.next(&record)) {
+        FUZZ_CHECK(record.valid);
+        records++;
+    }
+    FUZZ_CHECK(decoder.remaining() == 0);
+    FUZZ_CHECK(records == h.records);
+
+    std::vector<char> all;
+    file->query(0xff, 0, UINT64_MAX, all);
+    FUZZ_CHECK(all == held);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size < 3) {
+        return 0;
+    }
+
+    bool asFile = data[0] & 1;
+    uint32_t capacity = sizeof(wifi_ring_buffer_entry) + (data[1] | (data[2] << 8));
+    const char *buffer = (const char *) data + 3;
+    size -= 3;
+
+    checkDecoder(buffer, size);
+
+    char path[128];
+    logPath(path, sizeof(path));
+    unlink(path);
+
+    if (asFile) {
+        /* whatever is on disk is only trusted if it is consistent */
+        FILE *f = fopen(path, "w");
+        FUZZ_CHECK(f != NULL);
+        FUZZ_CHECK(fwrite(buffer, 1, size, f) == size);
+        fclose(f);
+        if (size >= sizeof(RingLogHeader) + sizeof(wifi_ring_buffer_entry)) {
+            capacity = size - sizeof(RingLogHeader);
+        }
+    }
+
+    RingLogFile *file = RingLogFile::open(logDir(), kRingName, capacity);
+    FUZZ_CHECK(file != NULL);
+
+    std::vector<char> held;
+    checkLog(file, held);
+
+    if (!asFile) {
+        /* twice, so records of the first append get evicted by the second */
+        bool wrapped;
+        file->append(buffer, size, NULL, &wrapped);
+        checkLog(file, held);
+        file->append(buffer, size, NULL, &wrapped);
+        checkLog(file, held);
+    }
+    delete file;
+
+    /* the index rebuilt from the file must agree with the one built while appending */
+    file = RingLogFile::open(logDir(), kRingName, capacity);
+    FUZZ_CHECK(file != NULL);
+    std::vector<char> reopened;
+    checkLog(file, reopened);
+    FUZZ_CHECK(reopened == held);
+    delete file;
+
+    unlink(path);
+    return 0;
+}